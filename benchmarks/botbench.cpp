@@ -0,0 +1,130 @@
+/*
+ * Copyright (c) 2015, Romain Létendart
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <benchmark/benchmark.h>
+
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "bot.h"
+#include "corpus.h"
+#include "logger.h"
+#include "trafficrecorder.h"
+#include "webinforetriever.h"
+
+namespace
+{
+
+/**
+ * Lines of a channel, as received from the server (see tests/data)
+ */
+const std::vector<std::string>& getLines()
+{
+    static const std::vector<std::string> lines = geecxx::benchcorpus::readLines("irc-lines.txt");
+    return lines;
+}
+
+std::ostream& nullOutput()
+{
+    static std::ofstream output("/dev/null");
+    return output;
+}
+
+void BM_ParseURL(benchmark::State& state)
+{
+    const std::vector<std::string>& lines = getLines();
+    geecxx::Bot bot;
+    std::vector<std::string_view> urls;
+    size_t urlCount = 0;
+    size_t i = 0;
+    for (auto _ : state) {
+        if (bot.parseURL(lines[i], urls)) {
+            urlCount += urls.size();
+        }
+        i = (i + 1) % lines.size();
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.counters["urls_per_line"] = static_cast<double>(urlCount) / state.iterations();
+}
+
+/**
+ * Handle the lines of the corpus with an offline bot, titles being served
+ * from fixtures
+ *
+ * With state.range(0) set to 0, lines with URLs are left out: only the
+ * parsing of the lines (prefix, command, parameters) and the URL search
+ * are measured.
+ */
+void BM_HandleLine(benchmark::State& state)
+{
+    const bool withUrls = 0 != state.range(0);
+    std::vector<std::string> lines;
+    std::shared_ptr<geecxx::TitleFixtures> titles = std::make_shared<geecxx::TitleFixtures>();
+    {
+        const std::vector<std::string> recordedTitles = geecxx::benchcorpus::readLines("titles.txt");
+        geecxx::Bot bot;
+        std::vector<std::string_view> urls;
+        for (const std::string& line : getLines()) {
+            if (!bot.parseURL(line, urls)) {
+                lines.push_back(line);
+            } else if (withUrls) {
+                lines.push_back(line);
+                for (std::string_view url : urls) {
+                    (*titles)[std::string(url)] = geecxx::RecordedTitle{
+                        true, recordedTitles[titles->size() % recordedTitles.size()]};
+                }
+            }
+        }
+    }
+
+    geecxx::Logger& logger = geecxx::Logger::getInstance();
+    logger.setOutput(nullOutput());
+    geecxx::WebInfoRetriever::getInstance().setTitleFixtures(titles);
+    size_t sentLineCount = 0;
+    geecxx::Bot bot;
+    bot.initOffline("geecxx", "#geecxx", nullptr, [&sentLineCount](std::string_view) {
+        ++sentLineCount;
+    });
+
+    size_t i = 0;
+    for (auto _ : state) {
+        bot.handleLine(lines[i]);
+        i = (i + 1) % lines.size();
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.counters["replies_per_line"] = static_cast<double>(sentLineCount) / state.iterations();
+
+    geecxx::WebInfoRetriever::getInstance().setTitleFixtures(nullptr);
+    logger.flush();
+    logger.setOutput(std::cout);
+}
+
+}
+
+BENCHMARK(BM_ParseURL);
+BENCHMARK(BM_HandleLine)->Arg(0)->Arg(1);
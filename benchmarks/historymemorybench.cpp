@@ -0,0 +1,137 @@
+/*
+ * Copyright (c) 2015, Romain Létendart
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <benchmark/benchmark.h>
+
+#include <cstdio>
+#include <functional>
+#include <list>
+#include <malloc.h>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "stringutils.h"
+#include "urlhistorymanager.h"
+
+namespace
+{
+
+/**
+ * Reference: the history layout used before strings were moved to an arena,
+ * every string being allocated on its own
+ */
+class NaiveUrlHistory
+{
+public:
+    explicit NaiveUrlHistory(size_t maxSize)
+        : _maxSize(maxSize)
+    {
+    }
+
+    bool insert(const std::string& url, std::string title, std::string messageAuthor)
+    {
+        std::string formattedUrl = geecxx::stringutils::formatUrl(url);
+        if (_entries.end() != _entries.find(formattedUrl)) {
+            return false;
+        }
+        if (_entries.size() == _maxSize) {
+            _entries.erase(_history.front());
+            _history.pop_front();
+        }
+        geecxx::UrlHistoryEntry newEntry{++_nextId, std::move(title), std::move(messageAuthor)};
+        _history.push_back(formattedUrl);
+        _entries.emplace(std::move(formattedUrl), std::move(newEntry));
+        return true;
+    }
+
+private:
+    const size_t _maxSize;
+    size_t _nextId = 0;
+    std::map<std::string, geecxx::UrlHistoryEntry> _entries;
+    std::list<std::string> _history;
+};
+
+size_t heapBytesInUse()
+{
+    const struct mallinfo2 info = mallinfo2();
+    return info.uordblks + info.hblkhd;
+}
+
+// Realistic shapes: 50 to 90 byte URLs, ~50 byte titles and a few hundred
+// distinct nicknames posting most of the links. Sizes don't drift along with
+// the number of insertions so that evicted slots are fit for new entries.
+void fillHistory(size_t count, const std::function<void(const std::string&, std::string, std::string)>& insert)
+{
+    const std::string slug(40, 's');
+    for (size_t i = 0; i < count; ++i) {
+        char number[32];
+        snprintf(number, sizeof(number), "%09zu", i);
+        insert("https://www.website" + std::to_string(i % 1009) + ".com/articles/"
+                   + number + "/" + slug.substr((i * 7919) % slug.size()),
+               "Some article title number " + std::string(number) + " - Website",
+               "nickname" + std::to_string(i % 300));
+    }
+}
+
+template <typename History>
+void runMemoryBenchmark(benchmark::State& state, const std::function<History*(size_t)>& makeHistory)
+{
+    const size_t capacity = state.range(0);
+    size_t bytes = 0;
+
+    for (auto _ : state) {
+        const size_t before = heapBytesInUse();
+        std::unique_ptr<History> history(makeHistory(capacity));
+        // Twice the capacity so that evicted slots get recycled as well
+        fillHistory(2 * capacity, [&history](const std::string& url, std::string title, std::string author) {
+            history->insert(url, std::move(title), std::move(author));
+        });
+        bytes = heapBytesInUse() - before;
+        benchmark::DoNotOptimize(history.get());
+    }
+
+    state.counters["heap_bytes"] = bytes;
+    state.counters["bytes_per_entry"] = static_cast<double>(bytes) / capacity;
+}
+
+void BM_NaiveHistoryMemory(benchmark::State& state)
+{
+    runMemoryBenchmark<NaiveUrlHistory>(state, [](size_t capacity) {
+        return new NaiveUrlHistory(capacity);
+    });
+}
+
+void BM_ArenaHistoryMemory(benchmark::State& state)
+{
+    runMemoryBenchmark<geecxx::UrlHistoryManager>(state, [](size_t capacity) {
+        return new geecxx::UrlHistoryManager(capacity, "");
+    });
+}
+
+}
+
+BENCHMARK(BM_NaiveHistoryMemory)->Arg(10000)->Arg(100000)->Arg(1000000)->Iterations(1)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_ArenaHistoryMemory)->Arg(10000)->Arg(100000)->Arg(1000000)->Iterations(1)->Unit(benchmark::kMillisecond);
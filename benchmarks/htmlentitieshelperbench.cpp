@@ -0,0 +1,70 @@
+/*
+ * Copyright (c) 2015, Romain Létendart
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <benchmark/benchmark.h>
+
+#include <string>
+#include <vector>
+
+#include "corpus.h"
+#include "htmlentitieshelper.h"
+
+namespace
+{
+
+/**
+ * Decode the raw titles of the corpus, as found between "<title>" tags
+ */
+void BM_DecodeTitle(benchmark::State& state)
+{
+    const std::vector<std::string> titles = geecxx::benchcorpus::readLines("titles.txt");
+    geecxx::HTMLEntitiesHelper htmlEntitiesHelper;
+    size_t byteCount = 0;
+    size_t i = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(htmlEntitiesHelper.decode(titles[i]));
+        byteCount += titles[i].size();
+        i = (i + 1) % titles.size();
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.SetBytesProcessed(byteCount);
+}
+
+/**
+ * Decode text without any entity, e.g. most of a page
+ */
+void BM_DecodeWithoutEntities(benchmark::State& state)
+{
+    const std::string text(state.range(0), 'a');
+    geecxx::HTMLEntitiesHelper htmlEntitiesHelper;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(htmlEntitiesHelper.decode(text));
+    }
+    state.SetBytesProcessed(state.iterations() * text.size());
+}
+
+}
+
+BENCHMARK(BM_DecodeTitle);
+BENCHMARK(BM_DecodeWithoutEntities)->RangeMultiplier(10)->Range(10, 10000);
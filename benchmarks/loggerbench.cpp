@@ -0,0 +1,229 @@
+/*
+ * Copyright (c) 2015, Romain Létendart
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <benchmark/benchmark.h>
+
+#include <chrono>
+#include <cstdio>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <unistd.h>
+
+#include "logger.h"
+#include "logsink.h"
+
+namespace
+{
+
+const std::string MESSAGE = "Reading: :nickname!~user@host.example.org PRIVMSG #channel :have a look at "
+                            "https://www.website.com/articles/42";
+const std::string LINE = ":nickname!~user@host.example.org PRIVMSG #channel :have a look at "
+                         "https://www.website.com/articles/42";
+
+std::ostream& nullOutput()
+{
+    static std::ofstream output("/dev/null");
+    return output;
+}
+
+/**
+ * Reference: the logger as it was before it went asynchronous, writing
+ * under a global mutex from the calling thread
+ */
+class SynchronousLogger
+{
+public:
+    void log(const std::string& message)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        std::time_t now = std::chrono::system_clock::to_time_t(
+                                    std::chrono::system_clock::now());
+        char formattedTime[20];
+
+        if (0 == strftime(formattedTime, 20, "%F %T", localtime(&now))) {
+            formattedTime[0] = '\0';
+        }
+
+        std::istringstream stream(message);
+        std::string messageChunk;
+        while (std::getline(stream, messageChunk)) {
+            nullOutput() << "[" << formattedTime << "][" << "INFO" << "]: "
+                         << messageChunk << std::endl;
+        }
+    }
+
+private:
+    std::mutex _mutex;
+};
+
+void BM_SynchronousLogger(benchmark::State& state)
+{
+    static SynchronousLogger logger;
+    for (auto _ : state) {
+        logger.log(MESSAGE);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+void runAsynchronousLogger(benchmark::State& state, geecxx::LogOverflowPolicy overflowPolicy)
+{
+    geecxx::Logger& logger = geecxx::Logger::getInstance();
+    if (0 == state.thread_index()) {
+        logger.setOutput(nullOutput());
+        logger.setOverflowPolicy(overflowPolicy);
+    }
+    for (auto _ : state) {
+        LOG_INFO(MESSAGE);
+    }
+    if (0 == state.thread_index()) {
+        // Writing is part of the cost, even if it happens elsewhere
+        logger.flush();
+        logger.setOverflowPolicy(geecxx::LogOverflowPolicy::BLOCK);
+        logger.setOutput(std::cout);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+void BM_AsynchronousLoggerBlock(benchmark::State& state)
+{
+    runAsynchronousLogger(state, geecxx::LogOverflowPolicy::BLOCK);
+}
+
+void BM_AsynchronousLoggerDrop(benchmark::State& state)
+{
+    runAsynchronousLogger(state, geecxx::LogOverflowPolicy::DROP);
+}
+
+// What Bot::readHandler pays for its LOG_DEBUG when DEBUG is disabled (the
+// default WITH_LOG_LEVEL=1): the message used to be built before the level
+// was checked, it isn't evaluated anymore
+void BM_ReadHandlerDisabledEager(benchmark::State& state)
+{
+    for (auto _ : state) {
+        geecxx::Logger::getInstance().log(geecxx::LogModule::GENERAL, geecxx::LogLevel::DEBUG, "Reading: " + LINE);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+void BM_ReadHandlerDisabled(benchmark::State& state)
+{
+    for (auto _ : state) {
+        LOG_DEBUG("Reading: ", LINE);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+// Same message at a level compiled in, but disabled at run time for the
+// module: costs a relaxed load and a comparison
+void BM_ReadHandlerRuntimeDisabled(benchmark::State& state)
+{
+    geecxx::Logger::setThreshold(geecxx::LogModule::GENERAL, geecxx::LogLevel::WARNING);
+    for (auto _ : state) {
+        LOG_INFO("Reading: ", LINE);
+    }
+    geecxx::Logger::setThreshold(geecxx::LogModule::GENERAL, geecxx::LogLevel::DEBUG);
+    state.SetItemsProcessed(state.iterations());
+}
+
+// Same message when enabled: concatenated by the caller, or passed as
+// arguments and concatenated by the writer thread
+void BM_ReadHandlerEnabledEager(benchmark::State& state)
+{
+    geecxx::Logger& logger = geecxx::Logger::getInstance();
+    logger.setOutput(nullOutput());
+    for (auto _ : state) {
+        LOG_INFO("Reading: " + LINE);
+    }
+    logger.flush();
+    logger.setOutput(std::cout);
+    state.SetItemsProcessed(state.iterations());
+}
+
+void BM_ReadHandlerEnabled(benchmark::State& state)
+{
+    geecxx::Logger& logger = geecxx::Logger::getInstance();
+    logger.setOutput(nullOutput());
+    for (auto _ : state) {
+        LOG_INFO("Reading: ", LINE);
+    }
+    logger.flush();
+    logger.setOutput(std::cout);
+    state.SetItemsProcessed(state.iterations());
+}
+
+// Throughput of each sink through the logger: messages with typed fields
+// are written to /dev/null as text, and to a rotated file in the given
+// format (text for reference, JSON lines or binary)
+void BM_LoggerSink(benchmark::State& state)
+{
+    const geecxx::LogFormat format = static_cast<geecxx::LogFormat>(state.range(0));
+    char directoryPath[] = "/tmp/geecxx-bench-log-XXXXXX";
+    if (nullptr == mkdtemp(directoryPath)) {
+        state.SkipWithError("Couldn't create temporary directory");
+        return;
+    }
+    const std::string filePath = std::string(directoryPath) + "/geecxx.log";
+    std::shared_ptr<geecxx::LogSink> sink = std::make_shared<geecxx::LogSink>(format, filePath,
+                                                                              64 * 1024 * 1024, 1);
+    if (!sink->open()) {
+        state.SkipWithError("Couldn't open log file");
+        return;
+    }
+
+    geecxx::Logger& logger = geecxx::Logger::getInstance();
+    logger.setOutput(nullOutput());
+    logger.addSink(sink);
+    std::int64_t latency = 0;
+    for (auto _ : state) {
+        LOG_INFO("Retrieved title of https://www.website.com/articles/42",
+                 geecxx::logField("channel", "#channel"), geecxx::logField("latency_us", ++latency));
+    }
+    logger.removeSink(sink);
+    logger.setOutput(std::cout);
+    state.SetItemsProcessed(state.iterations());
+
+    sink.reset();
+    std::remove(filePath.c_str());
+    std::remove((filePath + ".1").c_str());
+    rmdir(directoryPath);
+}
+
+}
+
+BENCHMARK(BM_LoggerSink)->Arg(static_cast<int>(geecxx::LogFormat::TEXT))
+                        ->Arg(static_cast<int>(geecxx::LogFormat::JSON))
+                        ->Arg(static_cast<int>(geecxx::LogFormat::BINARY))->UseRealTime();
+BENCHMARK(BM_ReadHandlerDisabledEager);
+BENCHMARK(BM_ReadHandlerDisabled);
+BENCHMARK(BM_ReadHandlerRuntimeDisabled);
+BENCHMARK(BM_ReadHandlerEnabledEager);
+BENCHMARK(BM_ReadHandlerEnabled);
+BENCHMARK(BM_SynchronousLogger)->ThreadRange(1, 8)->UseRealTime();
+BENCHMARK(BM_AsynchronousLoggerBlock)->ThreadRange(1, 8)->UseRealTime();
+BENCHMARK(BM_AsynchronousLoggerDrop)->ThreadRange(1, 8)->UseRealTime();
@@ -0,0 +1,103 @@
+/*
+ * Copyright (c) 2015, Romain Létendart
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <benchmark/benchmark.h>
+
+#include <atomic>
+#include <mutex>
+#include <string>
+
+#include "metrics.h"
+
+namespace
+{
+
+geecxx::MetricsRegistry& registry()
+{
+    static geecxx::MetricsRegistry metricsRegistry;
+    return metricsRegistry;
+}
+
+// Reference: a counter behind a mutex, as a naive registry would do
+std::mutex lockedCounterMutex;
+std::uint64_t lockedCounter = 0;
+
+void BM_LockedCounter(benchmark::State& state)
+{
+    for (auto _ : state) {
+        std::lock_guard<std::mutex> lock(lockedCounterMutex);
+        benchmark::DoNotOptimize(++lockedCounter);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+// What Connection::readHandler pays per line received, all threads sharing
+// the same counter
+void BM_CounterIncrement(benchmark::State& state)
+{
+    geecxx::Counter& counter = registry().getCounter("bench_lines_total", "Lines");
+    for (auto _ : state) {
+        counter.increment();
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+void BM_HistogramRecord(benchmark::State& state)
+{
+    geecxx::Histogram& histogram = registry().getHistogram("bench_duration_microseconds", "Duration");
+    std::uint64_t value = 1;
+    for (auto _ : state) {
+        histogram.record(value);
+        // Spread values over the usual latencies (1us to ~1s)
+        value = (value * 7 + 13) & 0xFFFFF;
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+// One scrape of a registry the size of the bot's
+void BM_MetricsWrite(benchmark::State& state)
+{
+    geecxx::MetricsRegistry metricsRegistry;
+    for (int i = 0; i < 30; ++i) {
+        metricsRegistry.getCounter("bench_counter_" + std::to_string(i) + "_total", "Counter").increment(i);
+    }
+    for (int i = 0; i < 3; ++i) {
+        metricsRegistry.getHistogram("bench_histogram_" + std::to_string(i) + "_microseconds", "Histogram")
+                       .record(1000 * i);
+    }
+    std::string text;
+    for (auto _ : state) {
+        text.clear();
+        metricsRegistry.write(text);
+        benchmark::DoNotOptimize(text.data());
+    }
+    state.SetBytesProcessed(state.iterations() * text.size());
+}
+
+}
+
+BENCHMARK(BM_LockedCounter)->ThreadRange(1, 8)->UseRealTime();
+BENCHMARK(BM_CounterIncrement)->ThreadRange(1, 8)->UseRealTime();
+BENCHMARK(BM_HistogramRecord)->ThreadRange(1, 8)->UseRealTime();
+BENCHMARK(BM_MetricsWrite);
@@ -0,0 +1,310 @@
+/*
+ * Copyright (c) 2015, Romain Létendart
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "corpus.h"
+#include "stringutils.h"
+
+namespace
+{
+
+/**
+ * Reference: the URL formatting used before URLs were canonicalized
+ */
+std::string legacyFormatUrl(const std::string& url)
+{
+    size_t startIndex = url.find("//");
+    startIndex = std::string::npos != startIndex ? startIndex + 2 : 0;
+    size_t endIndex = url.rfind("#");
+    std::string formattedUrl = std::string::npos == endIndex ? url.substr(startIndex)
+                                                             : url.substr(startIndex, endIndex - startIndex);
+    endIndex = std::min(formattedUrl.find("/"), formattedUrl.size());
+    std::transform(formattedUrl.begin(), formattedUrl.begin() + endIndex, formattedUrl.begin(), tolower);
+    startIndex = formattedUrl.find("www.");
+    return formattedUrl.substr(std::string::npos != startIndex ? startIndex + 4 : 0);
+}
+
+/**
+ * URLs as posted on a channel, one per line in the file named by
+ * GEECXX_URL_CORPUS (e.g. extracted from channel logs), or generated: pages
+ * posted one to three times each, under the spellings people paste.
+ */
+const std::vector<std::string>& getCorpus()
+{
+    static std::vector<std::string> corpus;
+    if (!corpus.empty()) {
+        return corpus;
+    }
+
+    const char* corpusFilePath = std::getenv("GEECXX_URL_CORPUS");
+    if (nullptr != corpusFilePath) {
+        std::ifstream corpusFile(corpusFilePath);
+        std::string url;
+        while (std::getline(corpusFile, url)) {
+            if (!url.empty()) {
+                corpus.push_back(url);
+            }
+        }
+        return corpus;
+    }
+
+    for (size_t page = 0; page < 20000; ++page) {
+        const std::string host = "website" + std::to_string(page % 97) + ".com";
+        const std::string path = "/~author" + std::to_string(page % 13) + "/articles/" + std::to_string(page);
+        const std::string query = "?id=" + std::to_string(page);
+        for (size_t post = 0; post <= page % 3; ++post) {
+            switch ((page * 7 + post * 3) % 8) {
+            case 0: corpus.push_back("https://" + host + path + query); break;
+            case 1: corpus.push_back("http://www." + host + path + query); break;
+            case 2: corpus.push_back(host + path + query + "#comments"); break;
+            case 3: corpus.push_back("https://WWW." + host + ":443" + path + query); break;
+            case 4: corpus.push_back("https://" + host + "/%7Eauthor" + path.substr(8) + query); break;
+            case 5: corpus.push_back("https://" + host + "/feed/.." + path + query); break;
+            case 6: corpus.push_back("https://" + host + path + query + "#section-2#top"); break;
+            default: corpus.push_back("https://" + host + "/./" + path.substr(1) + query); break;
+            }
+        }
+    }
+    return corpus;
+}
+
+void BM_LegacyFormatUrl(benchmark::State& state)
+{
+    const std::vector<std::string>& corpus = getCorpus();
+    size_t i = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(legacyFormatUrl(corpus[i++ % corpus.size()]));
+    }
+}
+
+void BM_CanonicalizeUrl(benchmark::State& state)
+{
+    const std::vector<std::string>& corpus = getCorpus();
+    std::string canonicalUrl;
+    size_t i = 0;
+    for (auto _ : state) {
+        geecxx::stringutils::canonicalizeUrl(corpus[i++ % corpus.size()], canonicalUrl);
+        benchmark::DoNotOptimize(canonicalUrl.data());
+    }
+}
+
+/**
+ * Format the URLs posted on channels (see tests/data/urls.txt), as done
+ * before each history lookup
+ */
+void BM_FormatUrl(benchmark::State& state)
+{
+    const std::vector<std::string> urls = geecxx::benchcorpus::readLines("urls.txt");
+    size_t i = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(geecxx::stringutils::formatUrl(urls[i]));
+        i = (i + 1) % urls.size();
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+/**
+ * Share of posted URLs recognized as already posted, i.e. of fetches saved
+ */
+template <typename Format>
+void runDedupBenchmark(benchmark::State& state, Format format)
+{
+    const std::vector<std::string>& corpus = getCorpus();
+    size_t hitCount = 0;
+    for (auto _ : state) {
+        std::unordered_set<std::string> knownUrls;
+        hitCount = 0;
+        for (const std::string& url : corpus) {
+            hitCount += knownUrls.insert(format(url)).second ? 0 : 1;
+        }
+    }
+    state.counters["hit_rate"] = static_cast<double>(hitCount) / corpus.size();
+}
+
+void BM_LegacyDedupHitRate(benchmark::State& state)
+{
+    runDedupBenchmark(state, legacyFormatUrl);
+}
+
+void BM_CanonicalDedupHitRate(benchmark::State& state)
+{
+    runDedupBenchmark(state, geecxx::stringutils::formatUrl);
+}
+
+/**
+ * Reference: formatInline before it worked in place
+ */
+void legacyFormatInline(std::string& s)
+{
+    char titleCopy[s.size() + 1];
+    memcpy(titleCopy, s.c_str(), s.size() + 1);
+
+    char *strtokContext = nullptr;
+    const char delim[] = "\n\r\t\v\f ";
+    std::stringstream outputStream;
+    char* word = strtok_r(titleCopy, delim, &strtokContext);
+    while (nullptr != word) {
+        outputStream << word;
+        word = strtok_r(nullptr, delim, &strtokContext);
+        if (nullptr != word) {
+            outputStream << " ";
+        }
+    }
+    s = outputStream.str();
+}
+
+/**
+ * Page title as extracted from HTML, once entities are decoded: indented,
+ * spread over lines, with no-break spaces
+ */
+std::string makeTitle(size_t size)
+{
+    const std::string chunk("\n      Breaking\xc2\xa0news: the  quick brown fox jumps over the lazy dog\t|\r\n");
+    std::string title;
+    while (title.size() < size) {
+        title.append(chunk, 0, std::min(chunk.size(), size - title.size()));
+    }
+    return title;
+}
+
+void BM_LegacyFormatInline(benchmark::State& state)
+{
+    const std::string title = makeTitle(state.range(0));
+    std::string s;
+    for (auto _ : state) {
+        s = title;
+        legacyFormatInline(s);
+        benchmark::DoNotOptimize(s.data());
+    }
+    state.SetBytesProcessed(state.iterations() * title.size());
+}
+
+void BM_FormatInline(benchmark::State& state)
+{
+    const std::string title = makeTitle(state.range(0));
+    std::string s;
+    for (auto _ : state) {
+        s = title;
+        geecxx::stringutils::formatInline(s);
+        benchmark::DoNotOptimize(s.data());
+    }
+    state.SetBytesProcessed(state.iterations() * title.size());
+}
+
+/**
+ * HTML page of a given size, its only "</title>" being at the end: the
+ * whole page is scanned, as when a title is missing
+ */
+std::string makeHtmlPage(size_t size)
+{
+    const std::string chunk("<div class=\"Article\"><p>Lorem ipsum <a href=\"/t/TITLE\">Title</a> dolor "
+                            "<span>sit</span> amet, <TiTlE-like>consectetur</TiTlE-like> elit.</p></div>\n");
+    const std::string end("</title>");
+    std::string page;
+    while (page.size() + end.size() < size) {
+        page.append(chunk, 0, std::min(chunk.size(), size - end.size() - page.size()));
+    }
+    return page + end;
+}
+
+void BM_LegacyFindNoCase(benchmark::State& state)
+{
+    const std::string page = makeHtmlPage(state.range(0));
+    const std::string needle("</title>");
+    for (auto _ : state) {
+        auto it = std::search(page.begin(), page.end(), needle.begin(), needle.end(),
+                              [](char c1, char c2) { return std::toupper(c1) == std::toupper(c2); });
+        benchmark::DoNotOptimize(it);
+    }
+    state.SetBytesProcessed(state.iterations() * page.size());
+}
+
+void runFindNoCaseBenchmark(benchmark::State& state, geecxx::stringutils::NoCaseSearcher::Implementation implementation)
+{
+    if (!geecxx::stringutils::NoCaseSearcher::isSupported(implementation)) {
+        state.SkipWithError("Not supported by the CPU");
+        return;
+    }
+    const std::string page = makeHtmlPage(state.range(0));
+    const geecxx::stringutils::NoCaseSearcher searcher("</title>", implementation);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(searcher.find(page));
+    }
+    state.SetBytesProcessed(state.iterations() * page.size());
+}
+
+void BM_FindNoCaseScalar(benchmark::State& state)
+{
+    runFindNoCaseBenchmark(state, geecxx::stringutils::NoCaseSearcher::Implementation::SCALAR);
+}
+
+void BM_FindNoCaseSse2(benchmark::State& state)
+{
+    runFindNoCaseBenchmark(state, geecxx::stringutils::NoCaseSearcher::Implementation::SSE2);
+}
+
+void BM_FindNoCaseAvx2(benchmark::State& state)
+{
+    runFindNoCaseBenchmark(state, geecxx::stringutils::NoCaseSearcher::Implementation::AVX2);
+}
+
+/**
+ * Search the title of a news article (see tests/data/page.html), after
+ * about 25 KiB of scripts and styles
+ */
+void BM_FindNoCasePage(benchmark::State& state)
+{
+    const std::string page = geecxx::benchcorpus::readFile("page.html");
+    const size_t scannedSize = geecxx::stringutils::findNoCase(page, "<title>") + 7;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(geecxx::stringutils::findNoCase(page, "<title>"));
+    }
+    state.SetBytesProcessed(state.iterations() * scannedSize);
+}
+
+}
+
+BENCHMARK(BM_LegacyFormatUrl);
+BENCHMARK(BM_CanonicalizeUrl);
+BENCHMARK(BM_FormatUrl);
+BENCHMARK(BM_LegacyDedupHitRate)->Iterations(1)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_CanonicalDedupHitRate)->Iterations(1)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_LegacyFindNoCase)->RangeMultiplier(10)->Range(100, 1000000);
+BENCHMARK(BM_FindNoCaseScalar)->RangeMultiplier(10)->Range(100, 1000000);
+BENCHMARK(BM_FindNoCaseSse2)->RangeMultiplier(10)->Range(100, 1000000);
+BENCHMARK(BM_FindNoCaseAvx2)->RangeMultiplier(10)->Range(100, 1000000);
+BENCHMARK(BM_FindNoCasePage);
+BENCHMARK(BM_LegacyFormatInline)->RangeMultiplier(10)->Range(100, 100000);
+BENCHMARK(BM_FormatInline)->RangeMultiplier(10)->Range(100, 100000);
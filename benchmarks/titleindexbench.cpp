@@ -0,0 +1,165 @@
+/*
+ * Copyright (c) 2015, Romain Létendart
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <benchmark/benchmark.h>
+
+#include <chrono>
+#include <cstdint>
+#include <malloc.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "titleindex.h"
+
+namespace
+{
+
+const size_t VOCABULARY_SIZE = 50000;
+
+size_t heapBytesInUse()
+{
+    const struct mallinfo2 info = mallinfo2();
+    return info.uordblks + info.hblkhd;
+}
+
+// xorshift64
+std::uint64_t nextRandom(std::uint64_t& state)
+{
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return state;
+}
+
+// Skewed towards the first words of the vocabulary, like natural language
+size_t randomWord(std::uint64_t& state)
+{
+    const double uniform = static_cast<double>(nextRandom(state) % 1000000) / 1000000;
+    return static_cast<size_t>(VOCABULARY_SIZE * uniform * uniform * uniform);
+}
+
+std::string word(size_t rank)
+{
+    static const char* const syllables[] = {"ka", "lo", "mi", "ne", "ru", "sa", "ti", "vo"};
+    std::string generated;
+    do {
+        generated += syllables[rank % 8];
+        rank /= 8;
+    } while (rank > 0);
+    return generated;
+}
+
+// 4 to 10 words per title
+const std::vector<std::string>& titleCorpus(size_t titleCount)
+{
+    static std::vector<std::string> titles;
+    std::uint64_t randomState = 0x9E3779B97F4A7C15ull;
+    while (titles.size() < titleCount) {
+        std::string title;
+        const size_t wordCount = 4 + nextRandom(randomState) % 7;
+        for (size_t i = 0; i < wordCount; ++i) {
+            title += (0 == i ? "" : " ") + word(randomWord(randomState));
+        }
+        titles.push_back(title + " - Website");
+    }
+    return titles;
+}
+
+void BM_TitleIndexBuild(benchmark::State& state)
+{
+    const size_t titleCount = state.range(0);
+    const std::vector<std::string>& titles = titleCorpus(titleCount);
+    size_t bytes = 0;
+    size_t termCount = 0;
+    size_t postingCount = 0;
+
+    for (auto _ : state) {
+        const size_t before = heapBytesInUse();
+        std::unique_ptr<geecxx::TitleIndex> index(new geecxx::TitleIndex());
+        for (size_t i = 0; i < titleCount; ++i) {
+            index->add(i + 1, titles[i]);
+        }
+        bytes = heapBytesInUse() - before;
+        termCount = index->getTermCount();
+        postingCount = index->getPostingCount();
+        benchmark::DoNotOptimize(index.get());
+    }
+
+    state.counters["heap_bytes"] = bytes;
+    state.counters["bytes_per_title"] = static_cast<double>(bytes) / titleCount;
+    state.counters["terms"] = termCount;
+    state.counters["postings"] = postingCount;
+}
+
+// Two-term queries, one term drawn from the whole vocabulary and one among
+// the most common words
+void BM_TitleIndexQuery(benchmark::State& state)
+{
+    const size_t titleCount = state.range(0);
+    const std::vector<std::string>& titles = titleCorpus(titleCount);
+    static std::unique_ptr<geecxx::TitleIndex> index;
+    static size_t indexedTitleCount = 0;
+    if (indexedTitleCount != titleCount) {
+        index.reset(new geecxx::TitleIndex());
+        for (size_t i = 0; i < titleCount; ++i) {
+            index->add(i + 1, titles[i]);
+        }
+        indexedTitleCount = titleCount;
+    }
+
+    std::uint64_t randomState = 0xD1B54A32D192ED03ull;
+    for (auto _ : state) {
+        const std::string query = word(nextRandom(randomState) % VOCABULARY_SIZE) + " "
+                                  + word(nextRandom(randomState) % 100);
+        benchmark::DoNotOptimize(index->search(query, 3));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+// Steady state of a full history: each new title evicts the oldest one
+void BM_TitleIndexUpdate(benchmark::State& state)
+{
+    const size_t titleCount = state.range(0);
+    const std::vector<std::string>& titles = titleCorpus(2 * titleCount);
+    geecxx::TitleIndex index;
+    for (size_t i = 0; i < titleCount; ++i) {
+        index.add(i + 1, titles[i]);
+    }
+
+    size_t oldest = 0;
+    for (auto _ : state) {
+        index.remove(oldest + 1, titles[oldest % titles.size()]);
+        const size_t newest = oldest + titleCount;
+        index.add(newest + 1, titles[newest % titles.size()]);
+        ++oldest;
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+}
+
+BENCHMARK(BM_TitleIndexBuild)->Arg(1000000)->Iterations(1)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_TitleIndexQuery)->Arg(1000000)->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_TitleIndexUpdate)->Arg(1000000);
@@ -0,0 +1,64 @@
+/*
+ * Copyright (c) 2015, Romain Létendart
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <benchmark/benchmark.h>
+
+#include "trace.h"
+
+namespace
+{
+
+// What each traced step costs when tracing is disabled
+void BM_ScopedSpanDisabled(benchmark::State& state)
+{
+    for (auto _ : state) {
+        geecxx::ScopedSpan span("step");
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+// A traced line with the spans of a fetched URL, below the threshold
+void BM_TracedLine(benchmark::State& state)
+{
+    geecxx::Tracer::getInstance().setThreshold(1000000);
+    for (auto _ : state) {
+        geecxx::Trace trace("line");
+        geecxx::Trace::setCurrent(&trace);
+        for (int i = 0; i < 8; ++i) {
+            geecxx::ScopedSpan span("step");
+            benchmark::ClobberMemory();
+        }
+        geecxx::Trace::setCurrent(nullptr);
+        trace.finish();
+        benchmark::DoNotOptimize(geecxx::Tracer::getInstance().submit(trace));
+    }
+    geecxx::Tracer::getInstance().setThreshold(0);
+    state.SetItemsProcessed(state.iterations());
+}
+
+}
+
+BENCHMARK(BM_ScopedSpanDisabled);
+BENCHMARK(BM_TracedLine);
@@ -0,0 +1,135 @@
+/*
+ * Copyright (c) 2015, Romain Létendart
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <benchmark/benchmark.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <unistd.h>
+
+#include "stringutils.h"
+#include "urlarchive.h"
+#include "urlhistorymanager.h"
+
+namespace
+{
+
+const size_t HOT_HISTORY_SIZE = 1024;
+const size_t ARCHIVED_URL_COUNT = 65536;
+const size_t BUCKET_COUNT = 256;
+
+std::string archivedUrl(size_t i)
+{
+    return "https://www.website" + std::to_string(i % 97) + ".com/articles/" + std::to_string(i);
+}
+
+std::string unseenUrl(std::uint64_t i)
+{
+    return "https://www.otherwebsite" + std::to_string(i % 89) + ".org/posts/" + std::to_string(i);
+}
+
+/**
+ * Archive filled with ARCHIVED_URL_COUNT URLs in a temporary directory
+ */
+class ArchiveFixture
+{
+public:
+    ArchiveFixture()
+    {
+        char directoryPath[] = "/tmp/geecxx-bench-archive-XXXXXX";
+        if (nullptr == mkdtemp(directoryPath)) {
+            std::abort();
+        }
+        _directoryPath = directoryPath;
+
+        _archive.reset(new geecxx::UrlArchive(_directoryPath, 4 * ARCHIVED_URL_COUNT, 0.01, BUCKET_COUNT));
+        _archive->init();
+        _history.setArchive(_archive);
+        for (size_t i = 0; i < ARCHIVED_URL_COUNT + HOT_HISTORY_SIZE; ++i) {
+            _history.insert(archivedUrl(i), "Some page title", "nickname");
+        }
+        _archive->flush();
+    }
+
+    ~ArchiveFixture()
+    {
+        char bucketFileName[48];
+        for (size_t bucket = 0; bucket < BUCKET_COUNT; ++bucket) {
+            std::snprintf(bucketFileName, sizeof(bucketFileName), "/bucket-%03zu.txt", bucket);
+            std::remove((_directoryPath + bucketFileName).c_str());
+        }
+        std::remove((_directoryPath + "/filter.bin").c_str());
+        rmdir(_directoryPath.c_str());
+    }
+
+    std::string _directoryPath;
+    std::shared_ptr<geecxx::UrlArchive> _archive;
+    geecxx::UrlHistoryManager _history{HOT_HISTORY_SIZE, ""};
+};
+
+/**
+ * "Already posted" checks, 99% of them for URLs never seen before
+ *
+ * Arg 0 looks into the hot history, then the cold store on a miss. Arg 1
+ * puts the membership filter in front of both.
+ */
+void BM_ArchiveLookup(benchmark::State& state)
+{
+    ArchiveFixture fixture;
+    const bool filtered = state.range(0) != 0;
+    geecxx::UrlHistoryManager unfilteredHistory(HOT_HISTORY_SIZE, "");
+    if (!filtered) {
+        for (size_t i = ARCHIVED_URL_COUNT; i < ARCHIVED_URL_COUNT + HOT_HISTORY_SIZE; ++i) {
+            unfilteredHistory.insert(archivedUrl(i), "Some page title", "nickname");
+        }
+    }
+
+    std::uint64_t i = 0;
+    geecxx::UrlHistoryEntry entry;
+    for (auto _ : state) {
+        const std::string url = 0 == i % 100 ? archivedUrl(i % ARCHIVED_URL_COUNT) : unseenUrl(i);
+        if (filtered) {
+            benchmark::DoNotOptimize(fixture._history.find(url, entry));
+        } else {
+            benchmark::DoNotOptimize(unfilteredHistory.find(url, entry)
+                                     || fixture._archive->find(geecxx::stringutils::formatUrl(url), entry));
+        }
+        ++i;
+    }
+    state.SetItemsProcessed(state.iterations());
+
+    if (filtered) {
+        const geecxx::UrlArchiveStats stats = fixture._archive->getStats();
+        state.counters["avoided_pct"] = 100.0 * stats._avoidedLookupCount / stats._lookupCount;
+        state.counters["fp_rate"] = stats._estimatedFalsePositiveRate;
+        state.counters["filter_bytes"] = stats._filterBitCount / 8;
+    }
+}
+
+}
+
+BENCHMARK(BM_ArchiveLookup)->Arg(0)->Arg(1);
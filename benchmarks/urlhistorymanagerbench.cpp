@@ -0,0 +1,310 @@
+/*
+ * Copyright (c) 2015, Romain Létendart
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <benchmark/benchmark.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+#include "corpus.h"
+#include "shardedurlhistorymanager.h"
+#include "stringutils.h"
+#include "urlhistorymanager.h"
+
+namespace
+{
+
+const size_t HISTORY_MAX_SIZE = 16384;
+
+// Keys are drawn from a space larger than the history so that lookups
+// both hit and miss, and insertions keep evicting entries
+const std::vector<std::string>& urlCorpus()
+{
+    static const std::vector<std::string> urls = []() {
+        std::vector<std::string> generated;
+        generated.reserve(4 * HISTORY_MAX_SIZE);
+        for (size_t i = 0; i < 4 * HISTORY_MAX_SIZE; ++i) {
+            generated.push_back("https://www.website" + std::to_string(i % 97)
+                                + ".com/articles/" + std::to_string(i) + "?page=2");
+        }
+        return generated;
+    }();
+    return urls;
+}
+
+/**
+ * Distinct URLs shaped like the ones posted on channels (see
+ * tests/data/urls.txt)
+ */
+std::vector<std::string> makeUrls(size_t count)
+{
+    static const std::vector<std::string> postedUrls = geecxx::benchcorpus::readLines("urls.txt");
+    std::vector<std::string> urls;
+    urls.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        // Fragments are left out, they aren't part of the formatted URL
+        const std::string& postedUrl = postedUrls[i % postedUrls.size()];
+        const std::string url = postedUrl.substr(0, postedUrl.find('#'));
+        urls.push_back(url + (std::string::npos == url.find('?') ? "?n=" : "&n=") + std::to_string(i));
+    }
+    return urls;
+}
+
+/**
+ * Insert the first count URLs into a history, titled as pages of the corpus
+ * (see tests/data/titles.txt)
+ */
+void fillHistory(geecxx::UrlHistoryManager& history, const std::vector<std::string>& urls, size_t count)
+{
+    static const std::vector<std::string> titles = []() {
+        std::vector<std::string> formattedTitles = geecxx::benchcorpus::readLines("titles.txt");
+        for (std::string& title : formattedTitles) {
+            geecxx::stringutils::formatInline(title);
+        }
+        return formattedTitles;
+    }();
+    for (size_t i = 0; i < count; ++i) {
+        history.insert(urls[i], titles[i % titles.size()], "nickname");
+    }
+}
+
+// xorshift64, cheap enough not to shadow the measured operations
+std::uint64_t nextRandom(std::uint64_t& state)
+{
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return state;
+}
+
+/**
+ * Reference: the regular history behind a single mutex
+ */
+class LockedUrlHistoryManager
+{
+public:
+    LockedUrlHistoryManager()
+        : _history(HISTORY_MAX_SIZE, "")
+    {
+    }
+
+    bool insert(const std::string& url, std::string title, std::string messageAuthor)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _history.insert(url, std::move(title), std::move(messageAuthor));
+    }
+
+    bool find(const std::string& url, geecxx::UrlHistoryEntry& entry)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _history.find(url, entry);
+    }
+
+private:
+    std::mutex _mutex;
+    geecxx::UrlHistoryManager _history;
+};
+
+// 90% lookups, 10% insertions
+template <typename History>
+void runMixedWorkload(benchmark::State& state, History& history)
+{
+    const std::vector<std::string>& urls = urlCorpus();
+    std::uint64_t randomState = 0x9E3779B97F4A7C15ull * (state.thread_index() + 1);
+    geecxx::UrlHistoryEntry entry;
+
+    for (auto _ : state) {
+        const std::uint64_t random = nextRandom(randomState);
+        const std::string& url = urls[random % urls.size()];
+        if (0 == (random >> 32) % 10) {
+            history.insert(url, "Some page title", "nickname");
+        } else {
+            benchmark::DoNotOptimize(history.find(url, entry));
+        }
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+void BM_LockedHistoryMixed(benchmark::State& state)
+{
+    // Shared by every thread of every run
+    static LockedUrlHistoryManager history;
+    runMixedWorkload(state, history);
+}
+
+void BM_ShardedHistoryMixed(benchmark::State& state)
+{
+    // Shared by every thread of every run
+    static geecxx::ShardedUrlHistoryManager history(HISTORY_MAX_SIZE, 16, "");
+    runMixedWorkload(state, history);
+}
+
+// Insertions into a full history of state.range(0) entries: each one evicts
+// an entry, both the URL and the id indexes are updated
+void BM_HistoryInsert(benchmark::State& state)
+{
+    const size_t size = state.range(0);
+    const std::vector<std::string> urls = makeUrls(2 * size);
+    geecxx::UrlHistoryManager history(size, "");
+    fillHistory(history, urls, size);
+    geecxx::UrlHistoryEntry entry;
+    size_t i = size;
+
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(history.insert(urls[i], "Some page title", "nickname", entry));
+        i = (i + 1) % urls.size();
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+// Lookups by URL in a full history of state.range(0) entries, half of them
+// for URLs which were never posted
+void BM_HistoryFind(benchmark::State& state)
+{
+    const size_t size = state.range(0);
+    const std::vector<std::string> urls = makeUrls(2 * size);
+    geecxx::UrlHistoryManager history(size, "");
+    fillHistory(history, urls, size);
+
+    std::uint64_t randomState = 0x9E3779B97F4A7C15ull;
+    geecxx::UrlHistoryEntry entry;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(history.find(urls[nextRandom(randomState) % urls.size()], entry));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+// Lookups by id, half of them for evicted entries
+void BM_HistoryFindById(benchmark::State& state)
+{
+    const std::vector<std::string>& urls = urlCorpus();
+    geecxx::UrlHistoryManager history(HISTORY_MAX_SIZE, "");
+    for (size_t i = 0; i < 2 * HISTORY_MAX_SIZE; ++i) {
+        history.insert(urls[i], "Some page title", "nickname");
+    }
+
+    std::uint64_t randomState = 0x9E3779B97F4A7C15ull;
+    geecxx::UrlHistoryRecord record;
+    for (auto _ : state) {
+        const std::uint64_t id = 1 + nextRandom(randomState) % (2 * HISTORY_MAX_SIZE);
+        benchmark::DoNotOptimize(history.findById(id, record));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+/**
+ * History file in a temporary directory, removed once done
+ */
+class HistoryFile
+{
+public:
+    HistoryFile()
+    {
+        char directoryPath[] = "/tmp/geecxx-bench-history-XXXXXX";
+        if (nullptr != mkdtemp(directoryPath)) {
+            _directoryPath = directoryPath;
+            _filePath = _directoryPath + "/url-history.txt";
+        }
+    }
+
+    ~HistoryFile()
+    {
+        if (!_directoryPath.empty()) {
+            std::remove(_filePath.c_str());
+            rmdir(_directoryPath.c_str());
+        }
+    }
+
+    const std::string& getPath() const
+    {
+        return _filePath;
+    }
+
+private:
+    std::string _directoryPath;
+    std::string _filePath;
+};
+
+// Saving of a history of state.range(0) entries
+void BM_HistorySave(benchmark::State& state)
+{
+    const size_t size = state.range(0);
+    HistoryFile historyFile;
+    if (historyFile.getPath().empty()) {
+        state.SkipWithError("Couldn't create temporary directory");
+        return;
+    }
+    geecxx::UrlHistoryManager history(size, historyFile.getPath());
+    fillHistory(history, makeUrls(size), size);
+
+    for (auto _ : state) {
+        if (!history.saveToFile()) {
+            state.SkipWithError("Couldn't save history");
+            break;
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * size);
+}
+
+// Loading of a history of state.range(0) entries, indexes included
+void BM_HistoryLoad(benchmark::State& state)
+{
+    const size_t size = state.range(0);
+    HistoryFile historyFile;
+    if (historyFile.getPath().empty()) {
+        state.SkipWithError("Couldn't create temporary directory");
+        return;
+    }
+    {
+        geecxx::UrlHistoryManager history(size, historyFile.getPath());
+        fillHistory(history, makeUrls(size), size);
+        if (!history.saveToFile()) {
+            state.SkipWithError("Couldn't save history");
+            return;
+        }
+    }
+
+    for (auto _ : state) {
+        geecxx::UrlHistoryManager history(size, historyFile.getPath());
+        if (!history.initFromFile() || size != history.getSize()) {
+            state.SkipWithError("Couldn't load history");
+            break;
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * size);
+}
+
+}
+
+BENCHMARK(BM_LockedHistoryMixed)->ThreadRange(1, 16)->UseRealTime();
+BENCHMARK(BM_ShardedHistoryMixed)->ThreadRange(1, 16)->UseRealTime();
+BENCHMARK(BM_HistoryInsert)->Arg(512)->Arg(16384)->Arg(262144);
+BENCHMARK(BM_HistoryFind)->Arg(512)->Arg(16384)->Arg(262144);
+BENCHMARK(BM_HistoryFindById);
+BENCHMARK(BM_HistorySave)->Arg(512)->Arg(16384)->Arg(262144)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_HistoryLoad)->Arg(512)->Arg(16384)->Arg(262144)->Unit(benchmark::kMillisecond);
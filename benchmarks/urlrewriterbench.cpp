@@ -0,0 +1,147 @@
+/*
+ * Copyright (c) 2015, Romain Létendart
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <benchmark/benchmark.h>
+
+#include <sstream>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "stringutils.h"
+#include "urlrewriter.h"
+
+namespace
+{
+
+/**
+ * Same rules as conf/url-rewrite.rules, followed by as many filler rules
+ * for unrelated hosts
+ */
+void loadRules(geecxx::UrlRewriter& rewriter, size_t fillerRuleCount)
+{
+    std::ostringstream rules;
+    rules << "* strip-params utm_* fbclid gclid dclid msclkid mc_cid mc_eid igshid yclid _hsenc _hsmi\n"
+             "youtu.be url youtube.com/watch?v={path1}\n"
+             "m.youtube.com host youtube.com\n"
+             "music.youtube.com host youtube.com\n"
+             "youtube.com keep-params v list\n"
+             "*.m.wikipedia.org host {sub}.wikipedia.org\n"
+             "mobile.twitter.com host twitter.com\n"
+             "m.facebook.com host facebook.com\n"
+             "*.cdn.ampproject.org url {path3+}\n"
+             "* strip-params amp amp_js_v usqp\n";
+    for (size_t i = 0; i < fillerRuleCount; ++i) {
+        rules << "*.site" << i << ".com host site" << i << ".com\n";
+    }
+    std::istringstream input(rules.str());
+    rewriter.load(input, "benchmark");
+}
+
+/**
+ * Formatted URLs as posted on a channel: the same pages shared under the
+ * spellings rules map onto a single one, among unrelated pages
+ */
+const std::vector<std::string>& getCorpus()
+{
+    static std::vector<std::string> corpus;
+    if (!corpus.empty()) {
+        return corpus;
+    }
+
+    for (size_t page = 0; page < 20000; ++page) {
+        const std::string id = std::to_string(page);
+        const std::string site = "news" + std::to_string(page % 97);
+        for (size_t post = 0; post <= page % 3; ++post) {
+            std::string url;
+            switch ((page % 5) * 3 + (page + post) % 3) {
+            case 0: url = "https://www.youtube.com/watch?v=" + id; break;
+            case 1: url = "https://youtu.be/" + id + "?t=42"; break;
+            case 2: url = "https://m.youtube.com/watch?v=" + id + "&feature=share"; break;
+            case 3: url = "https://en.wikipedia.org/wiki/Page_" + id; break;
+            case 4: url = "https://en.m.wikipedia.org/wiki/Page_" + id; break;
+            case 5: url = "https://en.wikipedia.org/wiki/Page_" + id + "?utm_source=irc"; break;
+            case 6: url = "https://" + site + ".com/article/" + id; break;
+            case 7: url = "https://" + site + ".com/article/" + id + "?fbclid=x" + id; break;
+            case 8: url = "https://" + site + "-com.cdn.ampproject.org/c/s/" + site + ".com/article/" + id + "?amp=1"; break;
+            // Pages no rule applies to
+            default: url = "https://" + site + ".org/post/" + id + "?page=" + std::to_string(post); break;
+            }
+            corpus.push_back(geecxx::stringutils::formatUrl(url));
+        }
+    }
+    return corpus;
+}
+
+/**
+ * Cost of rewriting a formatted URL, with a growing number of rules
+ */
+void BM_RewriteUrl(benchmark::State& state)
+{
+    geecxx::UrlRewriter rewriter;
+    loadRules(rewriter, state.range(0));
+    const std::vector<std::string>& corpus = getCorpus();
+    std::string rewrittenUrl;
+    size_t i = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(rewriter.rewrite(corpus[i++ % corpus.size()], rewrittenUrl));
+    }
+}
+
+/**
+ * Share of posted URLs recognized as already posted, i.e. of fetches saved
+ */
+void runDedupBenchmark(benchmark::State& state, const geecxx::UrlRewriter* rewriter)
+{
+    const std::vector<std::string>& corpus = getCorpus();
+    std::string rewrittenUrl;
+    size_t hitCount = 0;
+    for (auto _ : state) {
+        std::unordered_set<std::string> knownUrls;
+        hitCount = 0;
+        for (const std::string& url : corpus) {
+            const bool rewritten = rewriter && rewriter->rewrite(url, rewrittenUrl);
+            hitCount += knownUrls.insert(rewritten ? rewrittenUrl : url).second ? 0 : 1;
+        }
+    }
+    state.counters["hit_rate"] = static_cast<double>(hitCount) / corpus.size();
+}
+
+void BM_FormattedDedupHitRate(benchmark::State& state)
+{
+    runDedupBenchmark(state, nullptr);
+}
+
+void BM_RewrittenDedupHitRate(benchmark::State& state)
+{
+    geecxx::UrlRewriter rewriter;
+    loadRules(rewriter, 0);
+    runDedupBenchmark(state, &rewriter);
+}
+
+}
+
+BENCHMARK(BM_RewriteUrl)->Arg(0)->Arg(1000);
+BENCHMARK(BM_FormattedDedupHitRate)->Iterations(1)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_RewrittenDedupHitRate)->Iterations(1)->Unit(benchmark::kMillisecond);
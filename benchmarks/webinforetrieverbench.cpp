@@ -0,0 +1,103 @@
+/*
+ * Copyright (c) 2015, Romain Létendart
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <benchmark/benchmark.h>
+
+#include <chrono>
+#include <string>
+
+#include "corpus.h"
+#include "httpstubserver.h"
+#include "webinforetriever.h"
+
+namespace
+{
+
+/**
+ * Retrieve the title of a page of the stub server, of state.range(0) bytes
+ * with the title after state.range(1) bytes
+ */
+void runRetrievalBenchmark(benchmark::State& state, bool secure)
+{
+    geecxx::HttpStubServer server(secure ? GEECXX_SOURCE_TEST_DATA_DIR : "");
+    if (!server.start()) {
+        state.SkipWithError("Couldn't start stub server");
+        return;
+    }
+    geecxx::HttpStubPage page;
+    page._body = geecxx::HttpStubServer::makeHtml("Benchmarked page", state.range(1), state.range(0));
+    server.setPage("/page", page);
+    const std::string url = server.getUrl("/page");
+    geecxx::WebInfoRetriever& webInfoRetriever = geecxx::WebInfoRetriever::getInstance();
+    webInfoRetriever.setCaFilePath(GEECXX_SOURCE_TEST_DATA_DIR "stub-ca.pem");
+
+    std::string title;
+    for (auto _ : state) {
+        if (!webInfoRetriever.retrievePageTitle(url, title)) {
+            state.SkipWithError("Couldn't retrieve title");
+            break;
+        }
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.SetBytesProcessed(state.iterations() * page._body.size());
+    webInfoRetriever.setCaFilePath(GEECXX_CONF_DIR "ca-bundle.crt");
+}
+
+void BM_RetrievePageTitleHttp(benchmark::State& state)
+{
+    runRetrievalBenchmark(state, false);
+}
+
+void BM_RetrievePageTitleHttps(benchmark::State& state)
+{
+    runRetrievalBenchmark(state, true);
+}
+
+/**
+ * Extract the title of a news article (see tests/data/page.html), its head
+ * holding about 25 KiB of scripts and styles before the title
+ *
+ * With state.range(0) set to 0, the title is removed and the whole page
+ * scanned, as for pages without title.
+ */
+void BM_ExtractTitleFromContent(benchmark::State& state)
+{
+    std::string page = geecxx::benchcorpus::readFile("page.html");
+    if (0 == state.range(0)) {
+        const size_t titleBegin = page.find("<TITLE>");
+        page.erase(titleBegin, page.find("</Title>") + 8 - titleBegin);
+    }
+    geecxx::WebInfoRetriever& webInfoRetriever = geecxx::WebInfoRetriever::getInstance();
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(webInfoRetriever.extractTitleFromContent(page));
+    }
+}
+
+}
+
+BENCHMARK(BM_RetrievePageTitleHttp)->Args({1 << 10, 0})->Args({1 << 17, 0})->Args({1 << 20, 1 << 19})
+                                   ->UseRealTime()->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_RetrievePageTitleHttps)->Args({1 << 10, 0})->Args({1 << 17, 0})
+                                    ->UseRealTime()->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_ExtractTitleFromContent)->Arg(1)->Arg(0);
@@ -0,0 +1,216 @@
+/*
+ * Copyright (c) 2015, Romain Létendart
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#define GEECXX_LOG_MODULE geecxx::LogModule::HISTORY
+
+#include "bloomfilter.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+#include "logger.h"
+
+namespace
+{
+
+const char FILE_MAGIC[4] = {'G', 'X', 'B', 'F'};
+const std::uint32_t FILE_VERSION = 1;
+
+}
+
+namespace geecxx
+{
+
+BloomFilter::BloomFilter(size_t expectedItemCount, double falsePositiveRate)
+    : _expectedItemCount(std::max<size_t>(expectedItemCount, 1)),
+      _falsePositiveRate(std::min(std::max(falsePositiveRate, 1e-9), 0.5))
+{
+    // Optimal sizing: m = -n.ln(p) / ln(2)^2 and k = m/n.ln(2)
+    const double ln2 = std::log(2.0);
+    const double bitCount = std::ceil(-static_cast<double>(_expectedItemCount)
+                                      * std::log(_falsePositiveRate) / (ln2 * ln2));
+    const size_t wordCount = std::max<size_t>(1, static_cast<size_t>((bitCount + 63) / 64));
+    _words.assign(wordCount, 0);
+    _hashCount = std::max<size_t>(1, static_cast<size_t>(std::round(
+                                  64.0 * wordCount / _expectedItemCount * ln2)));
+}
+
+bool BloomFilter::add(const std::string& item)
+{
+    std::uint64_t h1;
+    std::uint64_t h2;
+    hash(item, h1, h2);
+
+    const std::uint64_t bitCount = getBitCount();
+    bool added = false;
+    for (size_t i = 0; i < _hashCount; ++i) {
+        const std::uint64_t bit = (h1 + i * h2) % bitCount;
+        const std::uint64_t mask = std::uint64_t(1) << (bit % 64);
+        added = added || 0 == (_words[bit / 64] & mask);
+        _words[bit / 64] |= mask;
+    }
+    if (added) {
+        ++_itemCount;
+    }
+    return added;
+}
+
+bool BloomFilter::mightContain(const std::string& item) const
+{
+    std::uint64_t h1;
+    std::uint64_t h2;
+    hash(item, h1, h2);
+
+    const std::uint64_t bitCount = getBitCount();
+    for (size_t i = 0; i < _hashCount; ++i) {
+        const std::uint64_t bit = (h1 + i * h2) % bitCount;
+        if (0 == (_words[bit / 64] & (std::uint64_t(1) << (bit % 64)))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void BloomFilter::clear()
+{
+    std::fill(_words.begin(), _words.end(), 0);
+    _itemCount = 0;
+}
+
+size_t BloomFilter::getBitCount() const
+{
+    return 64 * _words.size();
+}
+
+size_t BloomFilter::getHashCount() const
+{
+    return _hashCount;
+}
+
+std::uint64_t BloomFilter::getItemCount() const
+{
+    return _itemCount;
+}
+
+size_t BloomFilter::getExpectedItemCount() const
+{
+    return _expectedItemCount;
+}
+
+double BloomFilter::getTargetFalsePositiveRate() const
+{
+    return _falsePositiveRate;
+}
+
+double BloomFilter::getEstimatedFalsePositiveRate() const
+{
+    // p = (1 - e^(-k.n/m))^k
+    const double exponent = -static_cast<double>(_hashCount) * _itemCount / getBitCount();
+    return std::pow(1.0 - std::exp(exponent), static_cast<double>(_hashCount));
+}
+
+bool BloomFilter::saveToFile(const std::string& filePath) const
+{
+    const std::string tmpFilePath = filePath + ".tmp";
+    std::ofstream file(tmpFilePath, std::ios_base::binary | std::ios_base::trunc);
+    if (!file) {
+        LOG_ERROR("Couldn't open filter file for writing: ", tmpFilePath);
+        return false;
+    }
+
+    const std::uint64_t header[] = {_expectedItemCount, _hashCount, _itemCount, _words.size()};
+    file.write(FILE_MAGIC, sizeof(FILE_MAGIC));
+    file.write(reinterpret_cast<const char*>(&FILE_VERSION), sizeof(FILE_VERSION));
+    file.write(reinterpret_cast<const char*>(&_falsePositiveRate), sizeof(_falsePositiveRate));
+    file.write(reinterpret_cast<const char*>(header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(_words.data()), _words.size() * sizeof(std::uint64_t));
+    file.close();
+
+    if (!file || 0 != std::rename(tmpFilePath.c_str(), filePath.c_str())) {
+        LOG_ERROR("Couldn't write filter file: ", filePath);
+        std::remove(tmpFilePath.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool BloomFilter::loadFromFile(const std::string& filePath)
+{
+    std::ifstream file(filePath, std::ios_base::binary);
+    if (!file) {
+        return false;
+    }
+
+    char magic[sizeof(FILE_MAGIC)];
+    std::uint32_t version = 0;
+    double falsePositiveRate = 0;
+    std::uint64_t header[4];
+    file.read(magic, sizeof(magic));
+    file.read(reinterpret_cast<char*>(&version), sizeof(version));
+    file.read(reinterpret_cast<char*>(&falsePositiveRate), sizeof(falsePositiveRate));
+    file.read(reinterpret_cast<char*>(header), sizeof(header));
+    if (!file || 0 != std::memcmp(magic, FILE_MAGIC, sizeof(FILE_MAGIC))
+        || FILE_VERSION != version || 0 == header[1] || 0 == header[3]) {
+        LOG_ERROR("Invalid filter file: ", filePath);
+        return false;
+    }
+
+    std::vector<std::uint64_t> words(header[3]);
+    file.read(reinterpret_cast<char*>(words.data()), words.size() * sizeof(std::uint64_t));
+    if (!file) {
+        LOG_ERROR("Truncated filter file: ", filePath);
+        return false;
+    }
+
+    _expectedItemCount = header[0];
+    _falsePositiveRate = falsePositiveRate;
+    _hashCount = header[1];
+    _itemCount = header[2];
+    _words.swap(words);
+    return true;
+}
+
+void BloomFilter::hash(const std::string& item, std::uint64_t& h1, std::uint64_t& h2)
+{
+    // FNV-1a, then a splitmix64 finalizer to derive the second hash
+    std::uint64_t h = 14695981039346656037ull;
+    for (const char c : item) {
+        h ^= static_cast<unsigned char>(c);
+        h *= 1099511628211ull;
+    }
+    h1 = h;
+
+    h ^= h >> 30;
+    h *= 0xBF58476D1CE4E5B9ull;
+    h ^= h >> 27;
+    h *= 0x94D049BB133111EBull;
+    h ^= h >> 31;
+    // An even step could only ever reach half of the bits
+    h2 = h | 1;
+}
+
+}
@@ -0,0 +1,149 @@
+/*
+ * Copyright (c) 2015, Romain Létendart
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace geecxx
+{
+
+/**
+ * The BloomFilter class is a probabilistic set of strings.
+ *
+ * It answers "definitely not in the set" or "probably in the set" using a
+ * fixed amount of memory, whatever the size of the strings. Its size is
+ * computed from the number of strings it is expected to hold and the wanted
+ * false positive rate. Going over the expected number of strings doesn't
+ * break anything but makes false positives more frequent.
+ */
+class BloomFilter
+{
+public:
+    /**
+     * Constructor
+     *
+     * @param[in] expectedItemCount number of strings the filter is sized for
+     * @param[in] falsePositiveRate wanted false positive rate, in ]0, 1[
+     */
+    BloomFilter(size_t expectedItemCount = 1000000, double falsePositiveRate = 0.01);
+
+    /**
+     * Add a string to the set
+     *
+     * @param[in] item string to be added
+     * @return false if every bit of the string was already set, i.e. the
+     *         string (or one colliding with it) had already been added
+     */
+    bool add(const std::string& item);
+
+    /**
+     * Check whether a string might be in the set
+     *
+     * @param[in] item string to be checked
+     * @return false if the string has never been added, true if it probably
+     *         has been
+     */
+    bool mightContain(const std::string& item) const;
+
+    /**
+     * Remove every string from the set
+     */
+    void clear();
+
+    /**
+     * Get size of the filter
+     * @return number of bits of the filter
+     */
+    size_t getBitCount() const;
+
+    /**
+     * Get number of bits set for every string
+     * @return number of hash functions
+     */
+    size_t getHashCount() const;
+
+    /**
+     * Get number of distinct strings added so far
+     *
+     * Strings whose bits were all set already aren't counted, so that adding
+     * the same strings again (e.g. on every restart) leaves it unchanged.
+     * @return number of added strings
+     */
+    std::uint64_t getItemCount() const;
+
+    /**
+     * Get number of strings the filter has been sized for
+     * @return expected number of strings
+     */
+    size_t getExpectedItemCount() const;
+
+    /**
+     * Get false positive rate the filter has been sized for
+     * @return target false positive rate
+     */
+    double getTargetFalsePositiveRate() const;
+
+    /**
+     * Estimate current false positive rate from the number of strings added
+     * @return estimated false positive rate
+     */
+    double getEstimatedFalsePositiveRate() const;
+
+    /**
+     * Save the filter into a binary file
+     *
+     * @param[in] filePath path to the file
+     * @return true upon successful writing
+     */
+    bool saveToFile(const std::string& filePath) const;
+
+    /**
+     * Replace the filter with one read from a binary file
+     *
+     * Parameters of the read filter (size, hash count) replace the current
+     * ones.
+     * @param[in] filePath path to the file
+     * @return true upon successful reading, the filter is left untouched
+     *         otherwise
+     */
+    bool loadFromFile(const std::string& filePath);
+
+private:
+    /**
+     * Compute the two base hashes used to derive every bit position
+     * (double hashing)
+     */
+    static void hash(const std::string& item, std::uint64_t& h1, std::uint64_t& h2);
+
+    size_t _expectedItemCount;
+    double _falsePositiveRate;
+    size_t _hashCount;
+    std::uint64_t _itemCount = 0;
+    std::vector<std::uint64_t> _words;
+};
+
+}
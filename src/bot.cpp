@@ -22,28 +22,82 @@
  * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
  * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
+#define GEECXX_LOG_MODULE geecxx::LogModule::BOT
+
 #include "bot.h"
 
 #include <boost/regex/pattern_except.hpp>
 #include <boost/regex.hpp>
 #include <cctype>
-#include <iostream>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
 #include <string>
 #include <sstream>
-#include <thread>
+#include <sys/stat.h>
 
 #include "logger.h"
+#include "stringutils.h"
+#include "trace.h"
+#include "trafficrecorder.h"
+#include "urlrewriter.h"
 #include "webinforetriever.h"
 
 namespace geecxx
 {
 
+namespace
+{
+
+Counter& privateMessageCount = MetricsRegistry::getInstance().getCounter(
+        "geecxx_bot_messages_total", "PRIVMSG messages received");
+Counter& commandCount = MetricsRegistry::getInstance().getCounter(
+        "geecxx_bot_commands_total", "Bot commands (e.g. !url) received");
+Counter& foundUrlCount = MetricsRegistry::getInstance().getCounter(
+        "geecxx_bot_urls_found_total", "URLs found in messages");
+Histogram& readHandlerDuration = MetricsRegistry::getInstance().getHistogram(
+        "geecxx_bot_read_handler_duration_microseconds",
+        "Time spent handling each line received, title retrieval included");
+
+/**
+ * Encode bytes on a single line, for the state passed on with the IRC
+ * session
+ */
+std::string toHex(const std::string& bytes)
+{
+    static const char digits[] = "0123456789abcdef";
+    std::string hex;
+    hex.reserve(bytes.size() * 2);
+    for (const char c : bytes) {
+        hex.push_back(digits[static_cast<unsigned char>(c) >> 4]);
+        hex.push_back(digits[static_cast<unsigned char>(c) & 0xf]);
+    }
+    return hex;
+}
+
+std::string fromHex(const std::string& hex)
+{
+    std::string bytes;
+    bytes.reserve(hex.size() / 2);
+    for (size_t i = 0; i + 1 < hex.size(); i += 2) {
+        const char digits[] = {hex[i], hex[i + 1], '\0'};
+        bytes.push_back(static_cast<char>(std::strtoul(digits, nullptr, 16)));
+    }
+    return bytes;
+}
+
+}
+
 Bot::Bot()
+    : _historyPersister(_urlHistory.getHistoryFilePath())
 {
 }
 
 Bot::~Bot()
 {
+    for (const std::string& name : _exposedMetricNames) {
+        MetricsRegistry::getInstance().removeCallback(name);
+    }
 }
 
 bool Bot::init(std::unique_ptr<ConfigurationProvider> configurationProvider)
@@ -53,48 +107,140 @@ bool Bot::init(std::unique_ptr<ConfigurationProvider> configurationProvider)
         return false;
     }
     _configurationProvider.swap(configurationProvider);
+    // The previous process saves its history before passing the session on,
+    // it must be read after that
+    const auto takeOverStart = std::chrono::steady_clock::now();
+    int takenOverFileDescriptor = -1;
+    std::string pendingInput;
+    if (_configurationProvider->needsTakeOver() && !takeOver(takenOverFileDescriptor, pendingInput)) {
+        LOG_ERROR("Couldn't initialize bot, IRC session can't be taken over");
+        return false;
+    }
+    // The archive must know every URL of the history, it is attached first
+    _urlArchive = std::make_shared<UrlArchive>(GEECXX_LOCAL_DATA_DIR "url-archive",
+                                               _configurationProvider->getArchiveCapacity(),
+                                               _configurationProvider->getArchiveFalsePositiveRate());
+    if (!_urlArchive->init()) {
+        LOG_ERROR("Couldn't initialize bot, URL archive is invalid");
+        return false;
+    }
+    _urlHistory.setArchive(_urlArchive);
+    _urlHistory.enableTitleIndex();
+    _urlHistory.setMaxAge(std::time_t(_configurationProvider->getMaxAgeDays()) * 24 * 3600);
+    _historyPersister.setArchive(_urlArchive);
+    // URLs read from the history file are rewritten too, so that entries
+    // saved before a rule was added match its results
+    // Rules are optional, only the ones asked for must be there
+    const std::string rewriteRulesPath = _configurationProvider->getRewriteRulesPath();
+    struct stat rewriteRulesStat;
+    if (!rewriteRulesPath.empty() && _configurationProvider->isDefaultRewriteRulesPath()
+        && 0 != stat(rewriteRulesPath.c_str(), &rewriteRulesStat) && ENOENT == errno) {
+        LOG_INFO("No URL rewrite rules at ", rewriteRulesPath, ", URLs are looked up as they are");
+    } else if (!rewriteRulesPath.empty()) {
+        std::shared_ptr<UrlRewriter> urlRewriter = std::make_shared<UrlRewriter>();
+        if (!urlRewriter->loadFromFile(rewriteRulesPath)) {
+            LOG_ERROR("Couldn't initialize bot, URL rewrite rules are invalid");
+            return false;
+        }
+        _urlHistory.setRewriter(urlRewriter);
+    }
     if (!_urlHistory.initFromFile()) {
         LOG_ERROR("Couldn't initialize bot, history file is invalid");
         return false;
     }
+    _historyPersister.start();
     _connection.reset(new Connection(_configurationProvider->getServer(), std::to_string(_configurationProvider->getPortNumber())));
     if (!_connection) {
         LOG_ERROR("Couldn't initialize bot, connection object is null");
         return false;
     }
-    _connection->setExternalReadHandler([this](const std::string& message){
-        this->readHandler(message);
+    if (_tookOver && !_connection->adopt(takenOverFileDescriptor, pendingInput)) {
+        LOG_ERROR("Couldn't initialize bot, IRC session can't be taken over");
+        return false;
+    }
+    if (!_configurationProvider->getTrafficFilePath().empty()) {
+        std::shared_ptr<TrafficRecorder> trafficRecorder =
+                std::make_shared<TrafficRecorder>(_configurationProvider->getTrafficFilePath());
+        if (!trafficRecorder->open()) {
+            LOG_ERROR("Couldn't initialize bot, traffic can't be recorded");
+            return false;
+        }
+        _connection->setRecorder(trafficRecorder);
+        WebInfoRetriever::getInstance().setRecorder(trafficRecorder);
+    }
+    _connection->setExternalReadHandler([this](std::string_view message){
+        const auto start = std::chrono::steady_clock::now();
+        this->handleLine(message);
+        readHandlerDuration.record(std::chrono::duration_cast<std::chrono::microseconds>(
+                                       std::chrono::steady_clock::now() - start).count());
     });
+    _expiryTimer.reset(new boost::asio::steady_timer(_connection->getIoService()));
+    registerMetrics();
+    if (0 != _configurationProvider->getMetricsPort()) {
+        _metricsServer.reset(new MetricsServer(_connection->getIoService()));
+        if (!_metricsServer->open(_configurationProvider->getMetricsPort())) {
+            LOG_ERROR("Couldn't initialize bot, metrics can't be served");
+            return false;
+        }
+    }
+    if (!_configurationProvider->getControlSocketPath().empty()) {
+        _controlServer.reset(new ControlServer(_connection->getIoService(),
+                                               [this](const std::string& command, std::string& output,
+                                                      int& fileDescriptor) {
+            return executeCommand(command, output, fileDescriptor);
+        }));
+        if (!_controlServer->open(_configurationProvider->getControlSocketPath())) {
+            LOG_ERROR("Couldn't initialize bot, control socket can't be opened");
+            return false;
+        }
+    }
+    if (_tookOver) {
+        LOG_INFO("Took over IRC session as ", _nickname, " on ", _currentChannel,
+                 logField("handover_us", std::chrono::duration_cast<std::chrono::microseconds>(
+                                             std::chrono::steady_clock::now() - takeOverStart).count()));
+    }
 
     return true;
 }
 
+void Bot::initOffline(const std::string& nickname, const std::string& channel,
+                      std::shared_ptr<const UrlRewriter> urlRewriter, const WriteHandler& writeHandler)
+{
+    _urlHistory.enableTitleIndex();
+    if (urlRewriter) {
+        _urlHistory.setRewriter(urlRewriter);
+    }
+    _savesHistory = false;
+    _connection.reset(new Connection("", ""));
+    _connection->setExternalWriteHandler(writeHandler);
+    _nickname = nickname;
+    _currentChannel = channel;
+}
+
 bool Bot::run()
 {
     if (!_connection) {
         LOG_ERROR("Couldn't run bot, connection object is null");
         return false;
     }
-    if (!_connection->open()) {
-        return false;
-    }
-
-    // TODO Manage failures of NICK and JOIN commands
-    nick(_configurationProvider->getNickname());
-    join(_configurationProvider->getChannelName(), _configurationProvider->getChannelKey());
+    if (!_tookOver) {
+        if (!_connection->open()) {
+            return false;
+        }
 
-    std::thread cliThread([this]() {
-        openCli();
-    });
+        // TODO Manage failures of NICK and JOIN commands
+        nick(_configurationProvider->getNickname());
+        join(_configurationProvider->getChannelName(), _configurationProvider->getChannelKey());
+    }
+    if (0 != _urlHistory.getMaxAge()) {
+        scheduleExpiry();
+    }
 
     if (!_connection->listen()) {
         LOG_ERROR("Couldn't run bot, listening on the connection failed");
-        // TODO Find a proper way to terminate the thread in that case
         return false;
     }
 
-    cliThread.join();
-
     return true;
 }
 
@@ -114,193 +260,642 @@ void Bot::nick(const std::string& nickname)
 
 void Bot::join(const std::string& channel, const std::string& key)
 {
-    LOG_INFO(std::string("JOIN ") + channel + " " + key);
+    LOG_INFO("JOIN ", channel, " ", key);
 
     std::lock_guard<std::mutex> lock(_connectionMutex);
     _connection->writeMessage(std::string("JOIN ") + channel + " " + key);
     _currentChannel = channel;
 }
 
-void Bot::say(const std::string& message)
+void Bot::say(std::string_view message)
 {
     msg(_currentChannel, message);
 }
 
-void Bot::msg(const std::string& receiver, const std::string& message)
+void Bot::msg(std::string_view receiver, std::string_view message)
 {
-    std::istringstream stream(message);
-    std::string messageChunk;
+    const size_t maxMessageSize = getMaxMessageSize(receiver);
+    char shortMessage[MAX_LINE_SIZE];
 
     std::lock_guard<std::mutex> lock(_connectionMutex);
-    while (std::getline(stream, messageChunk)) {
-        if (messageChunk != "") {
-            _connection->writeMessage(std::string("PRIVMSG ") + receiver + " :" + messageChunk);
+    while (!message.empty()) {
+        const size_t chunkEnd = std::min(message.find('\n'), message.size());
+        std::string_view messageChunk = message.substr(0, chunkEnd);
+        message.remove_prefix(std::min(chunkEnd + 1, message.size()));
+        if (!messageChunk.empty()) {
+            // Longer lines would be cut by the server, wherever it happens
+            if (messageChunk.size() > maxMessageSize) {
+                messageChunk = std::string_view(shortMessage,
+                                                stringutils::shorten(messageChunk, maxMessageSize, shortMessage));
+            }
+            _outputLine.assign("PRIVMSG ").append(receiver).append(" :").append(messageChunk);
+            _connection->writeMessage(_outputLine);
         }
     }
 }
 
-void Bot::pong(const std::string& serverName)
+size_t Bot::getMaxMessageSize(std::string_view receiver) const
+{
+    // ":<nick>!~<user>@<host> PRIVMSG <receiver> :<message>\r\n", the user
+    // name being the nickname (see nick())
+    const size_t sourceSize = 1 + _nickname.size() + 2 + _nickname.size() + 1 + MAX_HOST_SIZE + 1;
+    const size_t commandSize = std::string("PRIVMSG ").size() + receiver.size() + 2 + 2;
+    return sourceSize + commandSize < MAX_LINE_SIZE ? MAX_LINE_SIZE - sourceSize - commandSize : 0;
+}
+
+void Bot::pong(std::string_view serverName)
 {
     std::lock_guard<std::mutex> lock(_connectionMutex);
-    _connection->writeMessage(std::string("PONG ") + serverName);
+    _outputLine.assign("PONG ").append(serverName);
+    _connection->writeMessage(_outputLine);
 }
 
 void Bot::quit()
 {
+    // Make sure the whole history reaches the disk before shutting down,
+    // without blocking the connection meanwhile
+    {
+        std::lock_guard<std::mutex> lock(_urlHistoryMutex);
+        _historyPersister.submit(_urlHistory.takeSnapshot());
+    }
+    if (!_historyPersister.flush()) {
+        LOG_ERROR("Couldn't save URL history before shutting down");
+    }
+    const HistoryPersisterStats stats = _historyPersister.getStats();
+    LOG_INFO("URL history saved ", stats._flushCount, " time(s), ", stats._failedFlushCount,
+             " failure(s), max latency: ", stats._maxFlushLatency.count(), "us, max backlog: ",
+             stats._maxBacklogDepth);
+    if (_urlArchive) {
+        const UrlArchiveStats archiveStats = _urlArchive->getStats();
+        const double avoidedLookupPercentage = 0 == archiveStats._lookupCount ? 0.0 :
+                100.0 * archiveStats._avoidedLookupCount / archiveStats._lookupCount;
+        LOG_INFO("URL archive filter: ", archiveStats._filterBitCount / 8, " bytes, ",
+                 archiveStats._filterItemCount, " URL(s), false positive rate: ",
+                 archiveStats._estimatedFalsePositiveRate, " (target: ",
+                 archiveStats._targetFalsePositiveRate, ")");
+        LOG_INFO("URL archive lookups: ", archiveStats._lookupCount, ", ", avoidedLookupPercentage,
+                 "% avoided, ", archiveStats._coldHitCount, " cold hit(s), ",
+                 archiveStats._falsePositiveCount, " false positive(s)");
+    }
+
+    if (_controlServer) {
+        _controlServer->close();
+    }
+
     std::lock_guard<std::mutex> lock(_connectionMutex);
-    _urlHistory.saveToFile();
     if (_connection && _connection->isAlive()) {
         _connection->writeMessage(std::string("QUIT : Shutting down."));
         _connection->close();
     }
 }
 
-std::istringstream& Bot::skipToContent(std::istringstream& iss)
+std::string_view Bot::getContent(std::string_view parameters)
 {
-    char c = 0;
-    while(!iss.eof() && c != ':') {
-        iss >> c;
-    }
-    return iss;
+    const size_t contentBegin = parameters.find(':');
+    return std::string_view::npos == contentBegin ? std::string_view() : parameters.substr(contentBegin + 1);
 }
 
-void Bot::readHandler(const std::string& message)
+void Bot::handleLine(std::string_view message)
 {
-    LOG_DEBUG("Reading: " + message);
+    LOG_DEBUG("Reading: ", message);
 
-    std::istringstream iss(message);
-    std::string command;
-    std::string sender = "";
-    iss >> command;
+    std::string_view parameters = message;
+    std::string_view command = stringutils::nextWord(parameters);
+    std::string_view sender;
 
     if (command.size() > 1 && command[0] == ':') {
     //this is probably a privmsg
         size_t pos = command.find('!');
-        if (pos != std::string::npos) {
+        if (pos != std::string_view::npos) {
             sender = command.substr(1, pos - 1);
-            iss >> command;
+            command = stringutils::nextWord(parameters);
         }
     }
 
     if (command == "PRIVMSG") {
-        std::string recipient;
-        iss >> recipient;
-        LOG_DEBUG("PRIVMSG FROM " + sender + " TO " + recipient);
+        privateMessageCount.increment();
+        const std::string_view recipient = stringutils::nextWord(parameters);
+        LOG_DEBUG("PRIVMSG FROM ", sender, " TO ", recipient);
 
         if (recipient == _nickname) {
             return;
         }
 
-        std::vector<std::string> urlCandidates;
-        if (parseURL(message, urlCandidates)) {
-            for (std::string& url : urlCandidates) {
+        const std::string_view content = getContent(parameters);
+        if (processCommand(content, sender, recipient)) {
+            commandCount.increment();
+            return;
+        }
+
+        bool containsURL;
+        {
+            ScopedSpan span("parse_urls");
+            containsURL = parseURL(message, _urlCandidates);
+        }
+        if (containsURL) {
+            foundUrlCount.increment(_urlCandidates.size());
+            for (std::string_view url : _urlCandidates) {
                 processURL(url, sender, recipient);
             }
         }
     } else if (command == "PING") {
-        skipToContent(iss);
-        std::string host;
-        iss >> host;
-        pong(host);
+        std::string_view content = getContent(parameters);
+        pong(stringutils::nextWord(content));
     }
 
 }
 
-void Bot::openCli(void)
+bool Bot::executeCommand(const std::string& command, std::string& output, int& fileDescriptor)
 {
-    std::string line, comm;
-    bool running = true;
-    while (running) {
-        std::getline(std::cin, line);
-        std::istringstream iss(line);
-        iss >> comm;
-        if (comm == "/n") {
-            iss >> comm;
-            nick(comm);
-        } else if (comm == "/j") {
-            iss >> comm;
-            join(comm);
-        } else if (comm == "/m") {
-            iss >> comm;
-            iss.seekg(1, std::ios_base::cur); //skipping space
-            std::string message;
-            std::getline(iss, message);
-            msg(comm, message);
-        } else if (comm == "/s") {
-            iss.seekg(1, std::ios_base::cur); //skipping space
-            std::string message;
-            std::getline(iss, message);
-            say(message);
-        } else if (comm == "/q") {
-            iss >> comm;
-            quit();
-            running = false;
+    std::istringstream iss(command);
+    std::string name;
+    iss >> name;
+    output.clear();
+
+    if (name == "/n") {
+        std::string nickname;
+        if (!(iss >> nickname)) {
+            output = "Usage: /n <nickname>";
+            return false;
+        }
+        nick(nickname);
+    } else if (name == "/j") {
+        std::string channel, key;
+        if (!(iss >> channel)) {
+            output = "Usage: /j <channel> [key]";
+            return false;
+        }
+        iss >> key;
+        join(channel, key);
+    } else if (name == "/m") {
+        std::string receiver, message;
+        iss >> receiver;
+        std::getline(iss, message);
+        stringutils::trim(message);
+        if (receiver.empty() || message.empty()) {
+            output = "Usage: /m <receiver> <message>";
+            return false;
+        }
+        msg(receiver, message);
+    } else if (name == "/s") {
+        std::string message;
+        std::getline(iss, message);
+        stringutils::trim(message);
+        if (message.empty()) {
+            output = "Usage: /s <message>";
+            return false;
+        }
+        say(message);
+    } else if (name == "/l") {
+        std::string specification;
+        iss >> specification;
+        if (!specification.empty() && !Logger::setThresholds(specification)) {
+            output = "Invalid log levels: " + specification;
+            return false;
+        }
+        output = Logger::getThresholds();
+    } else if (name == "/stats") {
+        MetricsRegistry::getInstance().write(output);
+    } else if (name == "/flush") {
+        {
+            std::lock_guard<std::mutex> lock(_urlHistoryMutex);
+            _historyPersister.submit(_urlHistory.takeSnapshot());
+            _unsavedUrlCount = 0;
+        }
+        // Blocks the connection until the file is written, like quitting does
+        if (!_historyPersister.flush()) {
+            output = "Couldn't save URL history";
+            return false;
+        }
+    } else if (name == "/url") {
+        std::uint64_t id = 0;
+        if (!(iss >> id)) {
+            output = "Usage: /url <id>";
+            return false;
         }
+        UrlHistoryRecord record;
+        std::lock_guard<std::mutex> lock(_urlHistoryMutex);
+        if (!_urlHistory.findById(id, record)) {
+            output = "Unknown URL#" + std::to_string(id);
+            return false;
+        }
+        output = formatRecord(record) + " (posted by " + record._entry._messageAuthor + ")";
+    } else if (name == "/find") {
+        std::string url;
+        if (!(iss >> url)) {
+            output = "Usage: /find <url>";
+            return false;
+        }
+        UrlHistoryEntry entry;
+        std::lock_guard<std::mutex> lock(_urlHistoryMutex);
+        if (!_urlHistory.find(url, entry)) {
+            output = "Never posted: " + url;
+            return false;
+        }
+        output = "URL#" + std::to_string(entry._id) + " posted by " + entry._messageAuthor;
+    } else if (name == "/search") {
+        std::string query;
+        std::getline(iss, query);
+        stringutils::trim(query);
+        if (query.empty()) {
+            output = "Usage: /search <terms>";
+            return false;
+        }
+        std::vector<UrlHistoryRecord> records;
+        {
+            std::lock_guard<std::mutex> lock(_urlHistoryMutex);
+            records = _urlHistory.search(query, _maxSearchResultCount);
+        }
+        for (const UrlHistoryRecord& record : records) {
+            output += formatRecord(record) + "\n";
+        }
+    } else if (name == "/q") {
+        // Quitting stops the io_service, give the client its answer first
+        _connection->getIoService().post([this]() {
+            quit();
+        });
+    } else if (name == "/handover") {
+        return handOver(output, fileDescriptor);
+    } else if (name == "/help") {
+        output = "/n <nickname>\n"
+                 "/j <channel> [key]\n"
+                 "/m <receiver> <message>\n"
+                 "/s <message>\n"
+                 "/l [module=level,...]\n"
+                 "/stats\n"
+                 "/flush\n"
+                 "/url <id>\n"
+                 "/find <url>\n"
+                 "/search <terms>\n"
+                 "/handover\n"
+                 "/q\n";
+    } else {
+        output = "Unknown command \"" + name + "\", see /help";
+        return false;
     }
+
+    return true;
 }
 
-bool Bot::parseURL(const std::string& message, std::vector<std::string>& results)
+bool Bot::parseURL(std::string_view message, std::vector<std::string_view>& results)
 {
-    boost::regex urlRegex;
-    try {
-        // Source of the regular expression:
-        // http://daringfireball.net/2010/07/improved_regex_for_matching_urls
-        urlRegex.assign(R"((?:https?://|www\d{0,3}[.]|[a-z0-9.\-]+[.][a-z]{2,4}/)(?:[^\s()<>]+|\(([^\s()<>]+|(\([^\s()<>]+\)))*\))+(?:\(([^\s()<>]+|(\([^\s()<>]+\)))*\)|[^\s`!()\[\]{};:'".,<>?«»“”‘’]))",
+    // Compiled once, the same expression being used for every line
+    static const boost::regex urlRegex = []() {
+        boost::regex regex;
+        try {
+            // Source of the regular expression:
+            // http://daringfireball.net/2010/07/improved_regex_for_matching_urls
+            regex.assign(R"((?:https?://|www\d{0,3}[.]|[a-z0-9.\-]+[.][a-z]{2,4}/)(?:[^\s()<>]+|\(([^\s()<>]+|(\([^\s()<>]+\)))*\))+(?:\(([^\s()<>]+|(\([^\s()<>]+\)))*\)|[^\s`!()\[\]{};:'".,<>?«»“”‘’]))",
                          boost::regex::ECMAScript);
-    } catch(boost::regex_error& error) {
-        LOG_ERROR("Invalid regular expression: " + std::string(error.what()));
+        } catch(boost::regex_error& error) {
+            LOG_ERROR("Invalid regular expression: ", error.what());
+        }
+        return regex;
+    }();
+    results.clear();
+    if (urlRegex.empty()) {
         return false;
     }
 
-    boost::sregex_iterator regexIterator(message.begin(), message.end(), urlRegex);
-    const boost::sregex_iterator endIterator = boost::sregex_iterator{};
-    bool containsURL = regexIterator != endIterator;
-    results.clear();
-    while (regexIterator != endIterator) {
-        results.push_back((*regexIterator)[0]);
-        ++regexIterator;
+    const char* position = message.data();
+    const char* const end = message.data() + message.size();
+    boost::match_flag_type flags = boost::match_default;
+    while (boost::regex_search(position, end, _urlMatch, urlRegex, flags)) {
+        results.emplace_back(_urlMatch[0].first, _urlMatch[0].length());
+        position = _urlMatch[0].second;
+        flags |= boost::match_prev_avail;
     }
 
-    return containsURL;
+    return !results.empty();
 }
 
-void Bot::processURL(const std::string& url, const std::string& sender, const std::string& recipient)
+void Bot::processURL(std::string_view candidate, std::string_view sender, std::string_view recipient)
 {
-    LOG_DEBUG("Found URL: " + url);
+    const std::string url(candidate);
+    LOG_DEBUG("Found URL: ", url, logField("channel", recipient));
+    ScopedSpan span("process_url");
+    if (nullptr != Trace::getCurrent()) {
+        Trace::getCurrent()->addLabel(url);
+    }
 
     UrlHistoryEntry historyEntry;
-    bool alreadyPosted = _urlHistory.find(url, historyEntry);
+    bool alreadyPosted;
+    std::time_t now;
+    {
+        ScopedSpan lookupSpan("history_lookup");
+        std::lock_guard<std::mutex> lock(_urlHistoryMutex);
+        alreadyPosted = _urlHistory.find(url, historyEntry);
+        if (alreadyPosted) {
+            _urlHistory.markSeen(url);
+        }
+        now = _urlHistory.now();
+    }
     if (!alreadyPosted) {
         // First time the URL has been posted, we first need to
         // retrieve the title
         std::string title;
-        if (!WebInfoRetriever::getInstance().retrievePageTitle(url, title)) {
-            title = "";
-        } // else title already set
-
-        // Add the URL to our history
-        _urlHistory.insert(url, title, sender);
-        if (0 == (_urlHistory.getSize() % _maxUnsavedUrlCount)) {
-            _urlHistory.saveToFile();
+        const auto retrievalStart = std::chrono::steady_clock::now();
+        {
+            ScopedSpan fetchSpan("fetch");
+            if (!WebInfoRetriever::getInstance().retrievePageTitle(url, title)) {
+                title = "";
+            } // else title already set
+        }
+        LOG_DEBUG("Retrieved title of ", url, logField("channel", recipient),
+                  logField("latency_us", std::chrono::duration_cast<std::chrono::microseconds>(
+                                             std::chrono::steady_clock::now() - retrievalStart).count()));
+
+        // Add the URL to our history, disk writes happen on the persister's
+        // own thread
+        ScopedSpan insertSpan("history_insert");
+        std::lock_guard<std::mutex> lock(_urlHistoryMutex);
+        if (!_urlHistory.insert(url, title, std::string(sender), historyEntry)) {
+            _urlHistory.find(url, historyEntry);
+        }
+        if (_savesHistory && ++_unsavedUrlCount >= _maxUnsavedUrlCount) {
+            _historyPersister.submit(_urlHistory.takeSnapshot());
+            _unsavedUrlCount = 0;
         }
-        _urlHistory.find(url, historyEntry);
     }
 
     std::stringstream titleOutput;
     if (historyEntry._title != "") {
-        titleOutput << historyEntry._title << " (URL#" << historyEntry._id << ")";
+        // Long titles are shortened rather than the reference to the URL
+        const std::string urlReference = " (URL#" + std::to_string(historyEntry._id) + ")";
+        const size_t maxMessageSize = getMaxMessageSize(getReplyReceiver(sender, recipient));
+        const size_t maxTitleSize = maxMessageSize > urlReference.size() ? maxMessageSize - urlReference.size() : 0;
+        char shortTitle[MAX_LINE_SIZE];
+        titleOutput.write(shortTitle, stringutils::shorten(historyEntry._title, maxTitleSize, shortTitle));
+        titleOutput << urlReference;
     }
 
     if (alreadyPosted) {
         titleOutput << std::endl << sender << ": Already posted by " << historyEntry._messageAuthor;
+        if (0 != historyEntry._insertionTime) {
+            titleOutput << " " << stringutils::formatElapsedTime(now - historyEntry._insertionTime)
+                        << " ago";
+        }
         titleOutput << " (URL#" << historyEntry._id << ")";
     }
 
-    if (recipient == _currentChannel) {
-        say(titleOutput.str());
-    } else {
-        msg(sender, titleOutput.str());
+    reply(sender, recipient, titleOutput.str());
+}
+
+void Bot::scheduleExpiry()
+{
+    // Expiry runs on the connection's thread, once per second
+    _expiryTimer->expires_from_now(std::chrono::seconds(1));
+    _expiryTimer->async_wait([this](const boost::system::error_code& error) {
+        if (error) {
+            return;
+        }
+        size_t expiredCount;
+        {
+            std::lock_guard<std::mutex> lock(_urlHistoryMutex);
+            expiredCount = _urlHistory.expire();
+        }
+        if (0 != expiredCount) {
+            LOG_DEBUG(expiredCount, " URL(s) expired from history");
+        }
+        scheduleExpiry();
+    });
+}
+
+bool Bot::handOver(std::string& state, int& fileDescriptor)
+{
+    // The next process reads the history back, it must be complete
+    {
+        std::lock_guard<std::mutex> lock(_urlHistoryMutex);
+        _historyPersister.submit(_urlHistory.takeSnapshot());
+        _unsavedUrlCount = 0;
+    }
+    if (!_historyPersister.flush()) {
+        state = "Couldn't save URL history, the session is kept";
+        return false;
+    }
+
+    std::string pendingInput;
+    {
+        std::lock_guard<std::mutex> lock(_connectionMutex);
+        fileDescriptor = _connection->release(pendingInput);
+    }
+    if (0 > fileDescriptor) {
+        state = "Couldn't release IRC connection";
+        return false;
+    }
+    if (_controlServer) {
+        // Replaced by the next process's
+        _controlServer->close(false);
+    }
+
+    // Lines received but not handled yet are handled by the next process,
+    // writes are synchronous so nothing is left to be sent
+    state = "nick " + _nickname + "\n"
+            "channel " + _currentChannel + "\n"
+            "input " + toHex(pendingInput) + "\n";
+    LOG_INFO("Handing IRC session over", logField("pending_bytes", pendingInput.size()));
+    return true;
+}
+
+bool Bot::takeOver(int& fileDescriptor, std::string& pendingInput)
+{
+    const std::string& socketPath = _configurationProvider->getControlSocketPath();
+    if (socketPath.empty()) {
+        LOG_ERROR("Can't take over IRC session without control socket");
+        return false;
+    }
+
+    std::string state;
+    if (!ControlServer::sendCommand(socketPath, "/handover", state, fileDescriptor)) {
+        LOG_ERROR("Previous instance couldn't hand its IRC session over: ", state);
+        return false;
+    }
+    if (0 > fileDescriptor) {
+        LOG_ERROR("Previous instance didn't pass its IRC connection");
+        return false;
+    }
+
+    std::istringstream stateStream(state);
+    std::string line;
+    while (std::getline(stateStream, line)) {
+        const size_t separator = line.find(' ');
+        const std::string key = line.substr(0, separator);
+        const std::string value = std::string::npos == separator ? "" : line.substr(separator + 1);
+        if (key == "nick") {
+            _nickname = value;
+        } else if (key == "channel") {
+            _currentChannel = value;
+        } else if (key == "input") {
+            pendingInput = fromHex(value);
+        } // else from a later version, ignored
+    }
+    _tookOver = true;
+    return true;
+}
+
+void Bot::registerMetrics()
+{
+    exposeMetric("geecxx_history_entries", "URLs in the in-memory history", MetricType::GAUGE, [this]() {
+        std::lock_guard<std::mutex> lock(_urlHistoryMutex);
+        return static_cast<double>(_urlHistory.getSize());
+    });
+    exposeMetric("geecxx_log_queue_depth", "Log messages waiting to be written", MetricType::GAUGE, []() {
+        return static_cast<double>(Logger::getInstance().getQueueDepth());
+    });
+    exposeMetric("geecxx_log_dropped_messages_total", "Log messages dropped because the queue was full",
+                 MetricType::COUNTER, []() {
+        return static_cast<double>(Logger::getInstance().getDroppedCount());
+    });
+
+    exposeMetric("geecxx_history_persister_backlog", "History snapshots waiting to be written",
+                 MetricType::GAUGE, [this]() {
+        return static_cast<double>(_historyPersister.getStats()._backlogDepth);
+    });
+    exposeMetric("geecxx_history_persister_max_backlog", "Highest number of snapshots waiting at once",
+                 MetricType::GAUGE, [this]() {
+        return static_cast<double>(_historyPersister.getStats()._maxBacklogDepth);
+    });
+    exposeMetric("geecxx_history_persister_flushes_total", "History snapshots written (successfully or not)",
+                 MetricType::COUNTER, [this]() {
+        return static_cast<double>(_historyPersister.getStats()._flushCount);
+    });
+    exposeMetric("geecxx_history_persister_failed_flushes_total", "History snapshots that couldn't be written",
+                 MetricType::COUNTER, [this]() {
+        return static_cast<double>(_historyPersister.getStats()._failedFlushCount);
+    });
+    exposeMetric("geecxx_history_persister_dropped_snapshots_total",
+                 "History snapshots superseded by a newer one before being written",
+                 MetricType::COUNTER, [this]() {
+        return static_cast<double>(_historyPersister.getStats()._droppedSnapshotCount);
+    });
+    exposeMetric("geecxx_history_persister_last_flush_duration_microseconds",
+                 "Time spent writing the last history snapshot", MetricType::GAUGE, [this]() {
+        return static_cast<double>(_historyPersister.getStats()._lastFlushLatency.count());
+    });
+
+    if (!_urlArchive) {
+        return;
+    }
+    exposeMetric("geecxx_archive_filter_bytes", "Size of the URL archive filter", MetricType::GAUGE, [this]() {
+        return static_cast<double>(_urlArchive->getStats()._filterBitCount / 8);
+    });
+    exposeMetric("geecxx_archive_filter_urls", "URLs added to the URL archive filter", MetricType::GAUGE, [this]() {
+        return static_cast<double>(_urlArchive->getStats()._filterItemCount);
+    });
+    exposeMetric("geecxx_archive_filter_false_positive_rate",
+                 "False positive rate of the URL archive filter, estimated from its size",
+                 MetricType::GAUGE, [this]() {
+        return _urlArchive->getStats()._estimatedFalsePositiveRate;
+    });
+    exposeMetric("geecxx_archive_lookups_total", "Lookups that went through the URL archive filter",
+                 MetricType::COUNTER, [this]() {
+        return static_cast<double>(_urlArchive->getStats()._lookupCount);
+    });
+    exposeMetric("geecxx_archive_avoided_lookups_total", "Lookups answered by the URL archive filter alone",
+                 MetricType::COUNTER, [this]() {
+        return static_cast<double>(_urlArchive->getStats()._avoidedLookupCount);
+    });
+    exposeMetric("geecxx_archive_cold_hits_total", "Lookups answered by the URL archive cold store",
+                 MetricType::COUNTER, [this]() {
+        return static_cast<double>(_urlArchive->getStats()._coldHitCount);
+    });
+    exposeMetric("geecxx_archive_false_positives_total", "Lookups the URL archive filter let through in vain",
+                 MetricType::COUNTER, [this]() {
+        return static_cast<double>(_urlArchive->getStats()._falsePositiveCount);
+    });
+}
+
+void Bot::exposeMetric(const std::string& name, const std::string& help, MetricType type,
+                       std::function<double()> callback)
+{
+    if (MetricsRegistry::getInstance().setCallback(name, help, type, std::move(callback))) {
+        _exposedMetricNames.push_back(name);
+    }
+}
+
+bool Bot::processCommand(std::string_view content, std::string_view sender, std::string_view recipient)
+{
+    if (content.empty() || content[0] != '!') {
+        return false;
+    }
+
+    std::istringstream iss{std::string(content)};
+    std::string command;
+    iss >> command;
+
+    if (command == "!url") {
+        std::uint64_t id = 0;
+        if (!(iss >> id)) {
+            reply(sender, recipient, std::string(sender) + ": Usage: !url <id>");
+            return true;
+        }
+
+        UrlHistoryRecord record;
+        bool found;
+        {
+            std::lock_guard<std::mutex> lock(_urlHistoryMutex);
+            found = _urlHistory.findById(id, record);
+        }
+
+        if (found) {
+            reply(sender, recipient, formatRecord(record) + " (posted by "
+                                     + record._entry._messageAuthor + ")");
+        } else {
+            reply(sender, recipient, std::string(sender) + ": Unknown URL#" + std::to_string(id));
+        }
+        return true;
+    }
+
+    if (command == "!search") {
+        std::string query;
+        std::getline(iss, query);
+        stringutils::trim(query);
+        if (query.empty()) {
+            reply(sender, recipient, std::string(sender) + ": Usage: !search <terms>");
+            return true;
+        }
+
+        std::vector<UrlHistoryRecord> records;
+        {
+            std::lock_guard<std::mutex> lock(_urlHistoryMutex);
+            records = _urlHistory.search(query, _maxSearchResultCount);
+        }
+
+        if (records.empty()) {
+            reply(sender, recipient, std::string(sender) + ": No match for \"" + query + "\"");
+            return true;
+        }
+        std::stringstream output;
+        for (const UrlHistoryRecord& record : records) {
+            output << formatRecord(record) << std::endl;
+        }
+        reply(sender, recipient, output.str());
+        return true;
     }
+
+    return false;
+}
+
+std::string Bot::formatRecord(const UrlHistoryRecord& record)
+{
+    std::string output = "URL#" + std::to_string(record._entry._id) + ": " + record._url;
+    if (record._entry._title != "") {
+        output += " - " + record._entry._title;
+    }
+    return output;
+}
+
+void Bot::reply(std::string_view sender, std::string_view recipient, std::string_view message)
+{
+    // Includes waiting for the connection
+    ScopedSpan span("reply");
+    msg(getReplyReceiver(sender, recipient), message);
+}
+
+std::string_view Bot::getReplyReceiver(std::string_view sender, std::string_view recipient) const
+{
+    // Messages sent to the channel are answered on it, others privately
+    return recipient == _currentChannel ? recipient : sender;
 }
 
 }
@@ -24,15 +24,24 @@
  */
 #pragma once
 
+#include <boost/asio/steady_timer.hpp>
+#include <boost/regex.hpp>
 #include <memory>
 #include <mutex>
 #include <string>
+#include <string_view>
 #include <sstream>
 #include <vector>
 
 #include "configurationprovider.h"
 #include "connection.h"
+#include "controlserver.h"
+#include "historypersister.h"
+#include "metrics.h"
+#include "metricsserver.h"
+#include "urlarchive.h"
 #include "urlhistorymanager.h"
+#include "urlrewriter.h"
 
 namespace geecxx
 {
@@ -43,29 +52,130 @@ public:
     Bot();
     ~Bot();
     bool init(std::unique_ptr<ConfigurationProvider> configurationProvider);
+
+    /**
+     * Initialize the bot to handle recorded traffic instead of an IRC session
+     *
+     * Nothing goes through the network: the caller passes the lines to
+     * handleLine() and the lines sent by the bot are passed to writeHandler.
+     * The history only lives in memory, titles are retrieved as usual (see
+     * WebInfoRetriever::setTitleFixtures()).
+     * @param[in] nickname nickname of the bot in the recorded session
+     * @param[in] channel channel of the recorded session
+     * @param[in] urlRewriter rules URLs are rewritten with, nullptr for none
+     * @param[in] writeHandler handler of the lines sent by the bot
+     */
+    void initOffline(const std::string& nickname, const std::string& channel,
+                     std::shared_ptr<const UrlRewriter> urlRewriter, const WriteHandler& writeHandler);
     bool run();
     void nick(const std::string& nickname);
     void join(const std::string& channel, const std::string &key = "");
-    void say(const std::string& message);
-    void msg(const std::string& receiver, const std::string& message);
-    void pong(const std::string& message);
+    void say(std::string_view message);
+    void msg(std::string_view receiver, std::string_view message);
+    void pong(std::string_view message);
     void quit();
 
+    /**
+     * Execute an administration command, as received on the control socket
+     *
+     * @param[in] command the command and its arguments, e.g. "/j #channel"
+     * @param[out] output result of the command, or description of the error
+     * @param[out] fileDescriptor file descriptor to be passed with the
+     *             result, -1 if there is none
+     * @return true upon success, false otherwise
+     */
+    bool executeCommand(const std::string& command, std::string& output, int& fileDescriptor);
+
+    /**
+     * Handle a line received from the IRC server
+     *
+     * Lines without URLs nor commands are handled without allocating
+     * memory, once the buffers of the bot are large enough.
+     * @param[in] message the line, without "\r\n"
+     */
+    void handleLine(std::string_view message);
+
+    /**
+     * Find the URLs of a message
+     *
+     * @param[in] message content of the message
+     * @param[out] results URLs found, pointing into message
+     * @return true if at least one URL has been found
+     */
+    bool parseURL(std::string_view message, std::vector<std::string_view>& results);
+
 private:
-    bool parseURL(const std::string& message, std::vector<std::string>& results);
-    void processURL(const std::string& url, const std::string& sender, const std::string& recipient);
-    std::istringstream& skipToContent(std::istringstream& iss);
-    void readHandler(const std::string& message);
-    void openCli(void);
+    void processURL(std::string_view candidate, std::string_view sender, std::string_view recipient);
+    bool processCommand(std::string_view content, std::string_view sender, std::string_view recipient);
+    void reply(std::string_view sender, std::string_view recipient, std::string_view message);
+    std::string_view getReplyReceiver(std::string_view sender, std::string_view recipient) const;
+
+    /**
+     * Longest message which can be sent to a receiver in a single line, as
+     * relayed by the server to other clients
+     *
+     * @param[in] receiver nickname or channel the message is sent to
+     * @return maximum size of the message, in bytes
+     */
+    size_t getMaxMessageSize(std::string_view receiver) const;
+    static std::string formatRecord(const UrlHistoryRecord& record);
+    static std::string_view getContent(std::string_view parameters);
+    void scheduleExpiry();
+    bool handOver(std::string& state, int& fileDescriptor);
+    bool takeOver(int& fileDescriptor, std::string& pendingInput);
+    void registerMetrics();
+    void exposeMetric(const std::string& name, const std::string& help, MetricType type,
+                      std::function<double()> callback);
+
+    /**
+     * Longest IRC line, "\r\n" included (RFC 2812)
+     */
+    static const size_t MAX_LINE_SIZE = 512;
+
+    /**
+     * Longest host name in the prefix servers add to relayed messages,
+     * ours being unknown
+     */
+    static const size_t MAX_HOST_SIZE = 63;
 
     const size_t _maxUnsavedUrlCount = 10;
+    const size_t _maxSearchResultCount = 3;
+    size_t _unsavedUrlCount = 0;
+    /**
+     * Whether the history is saved to its file, false for offline bots
+     */
+    bool _savesHistory = true;
 
     std::unique_ptr<Connection> _connection;
     std::mutex _connectionMutex;
     std::unique_ptr<ConfigurationProvider> _configurationProvider;
     UrlHistoryManager _urlHistory;
+    std::mutex _urlHistoryMutex;
+    HistoryPersister _historyPersister;
+    std::shared_ptr<UrlArchive> _urlArchive;
+    std::unique_ptr<boost::asio::steady_timer> _expiryTimer;
+    std::unique_ptr<MetricsServer> _metricsServer;
+    std::unique_ptr<ControlServer> _controlServer;
+    /**
+     * Names of the metrics read from the bot's members, to be removed from
+     * the registry with the bot
+     */
+    std::vector<std::string> _exposedMetricNames;
     std::string _currentChannel;
     std::string _nickname;
+    /**
+     * Buffers of the line being handled, kept so that their memory is
+     * reused: URLs found in it, the last match of the URL expression and
+     * the line being sent, protected by _connectionMutex
+     */
+    std::vector<std::string_view> _urlCandidates;
+    boost::cmatch _urlMatch;
+    std::string _outputLine;
+    /**
+     * Whether the IRC session was taken over from another process, rather
+     * than opened
+     */
+    bool _tookOver = false;
 };
 
 }
@@ -30,13 +30,15 @@
 #include <vector>
 #include <boost/program_options.hpp>
 
+#include "globalconfig.h"
+
 namespace po = boost::program_options;
 
 namespace geecxx
 {
 
-ConfigurationProvider::ConfigurationProvider() :
-    _help(false)
+ConfigurationProvider::ConfigurationProvider(std::string defaultRewriteRulesPath) :
+    _defaultRewriteRulesPath(true), _help(false)
 {
     po::options_description mandatory("Mandatory arguments");
     mandatory.add_options()
@@ -48,6 +50,23 @@ ConfigurationProvider::ConfigurationProvider() :
     optional.add_options()
         ("key", po::value<std::string>(&_channelKey)->default_value(std::string()), "the protection key for the channel")
         ("nick", po::value<std::string>(&_nickname)->default_value(std::string("geecxx")), "the bot's nickname")
+        ("archive-capacity", po::value<size_t>(&_archiveCapacity)->default_value(1000000), "number of URLs the \"already posted\" filter is sized for")
+        ("archive-fp-rate", po::value<double>(&_archiveFalsePositiveRate)->default_value(0.01), "false positive rate of the \"already posted\" filter")
+        ("max-age", po::value<unsigned int>(&_maxAgeDays)->default_value(0), "days after which a URL that hasn't been posted again is forgotten, 0 to never forget")
+        ("rewrite-rules", po::value<std::string>(&_rewriteRulesPath)->default_value(std::move(defaultRewriteRulesPath)), "rewrite URLs leading to the same content according to the rules of this file before looking them up, empty to disable")
+        ("metrics-port", po::value<std::uint16_t>(&_metricsPort)->default_value(0), "serve Prometheus metrics on http://127.0.0.1:<port>/metrics, 0 to disable")
+        ("control-socket", po::value<std::string>(&_controlSocketPath)->default_value(GEECXX_LOCAL_DATA_DIR "control.sock"), "accept administration commands on this Unix domain socket, empty to disable")
+        ("takeover", po::bool_switch(&_takeOver), "continue the IRC session of the instance listening on --control-socket, e.g. to upgrade it, instead of connecting")
+        ("trace-threshold", po::value<unsigned int>(&_traceThresholdMs)->default_value(0), "milliseconds after which the handling of a line is logged as slow, with the time spent in each step, 0 to disable tracing")
+        ("trace-sample", po::value<unsigned int>(&_traceSampleRate)->default_value(1), "log one slow line out of this many")
+        ("trace-file", po::value<std::string>(&_traceFilePath)->default_value(std::string()), "also write slow lines to this file, in the Chrome trace event format")
+        ("record-traffic", po::value<std::string>(&_trafficFilePath)->default_value(std::string()), "record the lines received and the titles retrieved to this file, to be replayed by geecxx-replay")
+        ("log-level", po::value<std::string>(&_logLevels)->default_value(std::string()), "lowest level logged per module, e.g. \"all=warning,connection=debug\" (modules: general, connection, bot, fetch, history, html)")
+        ("log-overflow", po::value<std::string>(&_logOverflowPolicy)->default_value("block"), "what to do with log messages when the log queue is full: \"block\" or \"drop\"")
+        ("log-file", po::value<std::string>(&_logFilePath)->default_value(std::string()), "also write logs to this file, in a structured format")
+        ("log-format", po::value<std::string>(&_logFileFormat)->default_value("json"), "format of the log file: \"json\" (one object per line) or \"binary\" (see geecxx-logdecode)")
+        ("log-max-size", po::value<std::uint64_t>(&_logFileMaxSize)->default_value(64), "size in MiB after which the log file is rotated")
+        ("log-max-files", po::value<size_t>(&_logFileMaxCount)->default_value(5), "number of rotated log files to keep")
     ;
     po::options_description generic("Generic options");
     generic.add_options()
@@ -75,6 +94,16 @@ bool ConfigurationProvider::parseCommandLineArgs(int argc, char *argv[])
         }
 
         po::notify(vm); 
+        _defaultRewriteRulesPath = vm["rewrite-rules"].defaulted();
+
+        if (_logOverflowPolicy != "block" && _logOverflowPolicy != "drop") {
+            std::cerr << "Invalid log overflow policy: " << _logOverflowPolicy << std::endl;
+            return false;
+        }
+        if (_logFileFormat != "json" && _logFileFormat != "binary") {
+            std::cerr << "Invalid log format: " << _logFileFormat << std::endl;
+            return false;
+        }
 
     } catch (po::required_option& e) {
         return false;
@@ -119,6 +148,96 @@ std::string ConfigurationProvider::getChannelKey() const
     return _channelKey;
 }
 
+size_t ConfigurationProvider::getArchiveCapacity() const
+{
+    return _archiveCapacity;
+}
+
+double ConfigurationProvider::getArchiveFalsePositiveRate() const
+{
+    return _archiveFalsePositiveRate;
+}
+
+unsigned int ConfigurationProvider::getMaxAgeDays() const
+{
+    return _maxAgeDays;
+}
+
+std::uint16_t ConfigurationProvider::getMetricsPort() const
+{
+    return _metricsPort;
+}
+
+std::string ConfigurationProvider::getRewriteRulesPath() const
+{
+    return _rewriteRulesPath;
+}
+
+bool ConfigurationProvider::isDefaultRewriteRulesPath() const
+{
+    return _defaultRewriteRulesPath;
+}
+
+std::string ConfigurationProvider::getControlSocketPath() const
+{
+    return _controlSocketPath;
+}
+
+bool ConfigurationProvider::needsTakeOver() const
+{
+    return _takeOver;
+}
+
+unsigned int ConfigurationProvider::getTraceThresholdMs() const
+{
+    return _traceThresholdMs;
+}
+
+unsigned int ConfigurationProvider::getTraceSampleRate() const
+{
+    return _traceSampleRate;
+}
+
+std::string ConfigurationProvider::getTraceFilePath() const
+{
+    return _traceFilePath;
+}
+
+std::string ConfigurationProvider::getTrafficFilePath() const
+{
+    return _trafficFilePath;
+}
+
+std::string ConfigurationProvider::getLogLevels() const
+{
+    return _logLevels;
+}
+
+LogOverflowPolicy ConfigurationProvider::getLogOverflowPolicy() const
+{
+    return "drop" == _logOverflowPolicy ? LogOverflowPolicy::DROP : LogOverflowPolicy::BLOCK;
+}
+
+std::string ConfigurationProvider::getLogFilePath() const
+{
+    return _logFilePath;
+}
+
+LogFormat ConfigurationProvider::getLogFileFormat() const
+{
+    return "binary" == _logFileFormat ? LogFormat::BINARY : LogFormat::JSON;
+}
+
+std::uint64_t ConfigurationProvider::getLogFileMaxSize() const
+{
+    return _logFileMaxSize * 1024 * 1024;
+}
+
+size_t ConfigurationProvider::getLogFileMaxCount() const
+{
+    return _logFileMaxCount;
+}
+
 bool ConfigurationProvider::needsHelp() const
 {
     return _help;
@@ -28,6 +28,9 @@
 #include <string>
 #include <boost/program_options.hpp>
 
+#include "globalconfig.h"
+#include "logger.h"
+
 namespace po = boost::program_options;
 
 namespace geecxx
@@ -42,8 +45,9 @@ class ConfigurationProvider
 public:
     /**
      * Default constructor.
+     * @param[in] defaultRewriteRulesPath rules file used when none is given
      */
-    ConfigurationProvider();
+    explicit ConfigurationProvider(std::string defaultRewriteRulesPath = GEECXX_CONF_DIR "url-rewrite.rules");
 
     /**
      * Parse command line arguments forwarded from main() to retrieve and store
@@ -70,6 +74,47 @@ public:
     std::string getChannelName() const;
 
     std::string getChannelKey() const;
+
+    size_t getArchiveCapacity() const;
+
+    double getArchiveFalsePositiveRate() const;
+
+    unsigned int getMaxAgeDays() const;
+
+    std::string getRewriteRulesPath() const;
+
+    /**
+     * Tell whether the rewrite rules path is the default one, which may not
+     * exist, e.g. when running from the build tree
+     * @return true if no path has been given on the command line
+     */
+    bool isDefaultRewriteRulesPath() const;
+
+    std::uint16_t getMetricsPort() const;
+
+    std::string getControlSocketPath() const;
+
+    bool needsTakeOver() const;
+
+    unsigned int getTraceThresholdMs() const;
+
+    unsigned int getTraceSampleRate() const;
+
+    std::string getTraceFilePath() const;
+
+    std::string getTrafficFilePath() const;
+
+    std::string getLogLevels() const;
+
+    LogOverflowPolicy getLogOverflowPolicy() const;
+
+    std::string getLogFilePath() const;
+
+    LogFormat getLogFileFormat() const;
+
+    std::uint64_t getLogFileMaxSize() const;
+
+    size_t getLogFileMaxCount() const;
     
     bool needsHelp() const;
 private:
@@ -80,6 +125,24 @@ private:
     std::string _nickname;
     std::string _channelName;
     std::string _channelKey; // Channel key is empty by default
+    size_t _archiveCapacity;
+    double _archiveFalsePositiveRate;
+    unsigned int _maxAgeDays;
+    std::string _rewriteRulesPath;
+    bool _defaultRewriteRulesPath;
+    std::uint16_t _metricsPort; // Metrics aren't served by default
+    std::string _controlSocketPath;
+    bool _takeOver;
+    unsigned int _traceThresholdMs; // Tracing is disabled by default
+    unsigned int _traceSampleRate;
+    std::string _traceFilePath; // No trace file by default
+    std::string _trafficFilePath; // Traffic isn't recorded by default
+    std::string _logLevels; // Build time threshold for every module by default
+    std::string _logOverflowPolicy;
+    std::string _logFilePath; // No structured log file by default
+    std::string _logFileFormat;
+    std::uint64_t _logFileMaxSize; // MiB
+    size_t _logFileMaxCount;
     bool _help;
 };
 
@@ -22,15 +22,40 @@
  * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
  * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
+#define GEECXX_LOG_MODULE geecxx::LogModule::CONNECTION
+
 #include "connection.h"
 
 #include <boost/bind.hpp>
+#include <sys/socket.h>
+#include <unistd.h>
 
 #include "logger.h"
+#include "metrics.h"
+#include "trace.h"
+#include "trafficrecorder.h"
 
 namespace geecxx
 {
 
+namespace
+{
+
+Counter& connectionAttemptCount = MetricsRegistry::getInstance().getCounter(
+        "geecxx_connection_attempts_total", "Connections attempted to the IRC server");
+Counter& connectionFailureCount = MetricsRegistry::getInstance().getCounter(
+        "geecxx_connection_failures_total", "Connections to the IRC server that failed");
+Counter& receivedLineCount = MetricsRegistry::getInstance().getCounter(
+        "geecxx_connection_received_lines_total", "Lines received from the IRC server");
+Counter& receivedByteCount = MetricsRegistry::getInstance().getCounter(
+        "geecxx_connection_received_bytes_total", "Bytes received from the IRC server");
+Counter& sentLineCount = MetricsRegistry::getInstance().getCounter(
+        "geecxx_connection_sent_lines_total", "Lines sent to the IRC server");
+Counter& sentByteCount = MetricsRegistry::getInstance().getCounter(
+        "geecxx_connection_sent_bytes_total", "Bytes sent to the IRC server");
+
+}
+
 Connection::Connection(const std::string& addr, const std::string& port)
     : _addr(addr), _port(port), _socket(_ioService)
 {
@@ -57,9 +82,57 @@ void Connection::close()
 {
     _ioService.stop();
     if (_socket.is_open()) {
-        _socket.shutdown(boost::asio::socket_base::shutdown_both);
-        _socket.close();
+        // Fails if the socket never got connected, it is closed anyway
+        boost::system::error_code ignoredError;
+        _socket.shutdown(boost::asio::socket_base::shutdown_both, ignoredError);
+        _socket.close(ignoredError);
+    }
+}
+
+bool Connection::adopt(int fileDescriptor, const std::string& pendingInput)
+{
+    sockaddr_storage address;
+    socklen_t addressSize = sizeof(address);
+    boost::system::error_code error;
+    if (0 != ::getsockname(fileDescriptor, reinterpret_cast<sockaddr*>(&address), &addressSize)) {
+        error = boost::system::error_code(errno, boost::system::system_category());
+    } else {
+        _socket.assign(AF_INET6 == address.ss_family ? boost::asio::ip::tcp::v6() : boost::asio::ip::tcp::v4(),
+                       fileDescriptor, error);
+    }
+    if (error) {
+        LOG_ERROR("Couldn't take over connection to ", _addr, ":", _port, ": ", error.message());
+        ::close(fileDescriptor);
+        return false;
+    }
+
+    std::ostream pendingStream(&_responseBuffer);
+    pendingStream << pendingInput;
+    LOG_INFO("Took over connection.", logField("connection", _addr + ":" + _port));
+
+    asyncRead();
+
+    return true;
+}
+
+int Connection::release(std::string& pendingInput)
+{
+    pendingInput.assign(boost::asio::buffers_begin(_responseBuffer.data()),
+                        boost::asio::buffers_end(_responseBuffer.data()));
+    _responseBuffer.consume(_responseBuffer.size());
+
+    // Cancels the pending read, the session itself is left untouched. The
+    // next owner may not expect a non-blocking socket.
+    boost::system::error_code error;
+    _socket.native_non_blocking(false, error);
+    const int fileDescriptor = _socket.release(error);
+    _ioService.stop();
+    if (error) {
+        LOG_ERROR("Couldn't release connection: ", error.message());
+        close();
+        return -1;
     }
+    return fileDescriptor;
 }
 
 bool Connection::listen()
@@ -80,6 +153,11 @@ bool Connection::isAlive() const
     return _socket.is_open();
 }
 
+boost::asio::io_service& Connection::getIoService()
+{
+    return _ioService;
+}
+
 void Connection::setExternalReadHandler(const ReadHandler& externalReadHandler)
 {
     if (!externalReadHandler) {
@@ -89,14 +167,43 @@ void Connection::setExternalReadHandler(const ReadHandler& externalReadHandler)
     }
 }
 
-bool Connection::writeMessage(const std::string& message)
+void Connection::setExternalWriteHandler(const WriteHandler& externalWriteHandler)
+{
+    _externalWriteHandler = externalWriteHandler;
+}
+
+void Connection::setRecorder(std::shared_ptr<TrafficRecorder> recorder)
 {
+    _recorder = std::move(recorder);
+}
+
+bool Connection::writeMessage(std::string_view message)
+{
+    if (_externalWriteHandler) {
+        _externalWriteHandler(message);
+        sentLineCount.increment();
+        sentByteCount.increment(message.size() + 2);
+        return true;
+    }
     if (!isAlive()) {
         LOG_ERROR("Cannot write on closed connection");
         return false;
     }
 
-    boost::asio::write(_socket, boost::asio::buffer(message + "\r\n"));
+    ScopedSpan span("write");
+    static const char lineEnd[] = "\r\n";
+    const std::array<boost::asio::const_buffer, 2> line = {
+        {boost::asio::buffer(message.data(), message.size()), boost::asio::buffer(lineEnd, sizeof(lineEnd) - 1)}};
+    boost::system::error_code error;
+    const size_t size = boost::asio::write(_socket, line, error);
+    if (error) {
+        // The session is lost, lines still buffered aren't worth handling
+        LOG_ERROR("Couldn't write on connection: ", error.message());
+        close();
+        return false;
+    }
+    sentLineCount.increment();
+    sentByteCount.increment(size);
     return true;
 }
 
@@ -105,10 +212,30 @@ void Connection::readHandler(const boost::system::error_code& error, std::size_t
     if (error) {
         close();
     } else {
-        std::istream responseStream(&_responseBuffer);
-        std::string response;
-        std::getline(responseStream, response);
-        _externalReadHandler(response);
+        receivedLineCount.increment();
+        receivedByteCount.increment(count);
+        // The line is handled in place, its memory stays valid until the
+        // next read even once consumed
+        const char* data = boost::asio::buffer_cast<const char*>(_responseBuffer.data());
+        std::string_view response(data, count);
+        while (!response.empty() && ('\n' == response.back() || '\r' == response.back())) {
+            response.remove_suffix(1);
+        }
+        _responseBuffer.consume(count);
+        if (_recorder) {
+            _recorder->recordLine(response);
+        }
+        if (Tracer::getInstance().isEnabled()) {
+            // Everything done about the line, up to the reply, is traced
+            Trace trace("line");
+            Trace::setCurrent(&trace);
+            _externalReadHandler(response);
+            Trace::setCurrent(nullptr);
+            trace.finish();
+            Tracer::getInstance().submit(trace);
+        } else {
+            _externalReadHandler(response);
+        }
         asyncRead();
     }
 }
@@ -118,27 +245,32 @@ bool Connection::connect()
     boost::asio::ip::tcp::resolver resolver(_ioService);
     boost::asio::ip::tcp::resolver::query query(_addr, _port);
 
-    boost::asio::ip::tcp::resolver::iterator iter;
-
     // Default initialization is enough here
     boost::asio::ip::tcp::resolver::iterator end;
-    boost::system::error_code error = boost::asio::error::host_not_found;
-    LOG_INFO("Trying to connect to " + _addr + ":" + _port + "...");
+    boost::system::error_code error;
+    LOG_INFO("Trying to connect to ", _addr, ":", _port, "...");
+    connectionAttemptCount.increment();
+
+    boost::asio::ip::tcp::resolver::iterator iter = resolver.resolve(query, error);
+    if (!error) {
+        error = boost::asio::error::host_not_found;
+    }
 
     // As the resolver may return more than one result, we try to connect to
     // every end point until one of those connections succeeds
-    for (iter = resolver.resolve(query); iter != end && error; ++iter) {
+    for (; iter != end && error; ++iter) {
         _socket.connect(*iter, error);
     }
 
     if (error) {
-        LOG_ERROR("Couldn't connect to " + _addr + ":" + _port + ".");
-        LOG_ERROR("Reason: " + error.message());
+        connectionFailureCount.increment();
+        LOG_ERROR("Couldn't connect to ", _addr, ":", _port, ".", logField("connection", _addr + ":" + _port));
+        LOG_ERROR("Reason: ", error.message());
         close();
         return false;
     }
 
-    LOG_INFO("Connected.");
+    LOG_INFO("Connected.", logField("connection", _addr + ":" + _port));
     return true;
 }
 
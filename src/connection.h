@@ -27,11 +27,24 @@
 #include <array>
 #include <boost/asio.hpp>
 #include <functional>
+#include <memory>
 #include <string>
+#include <string_view>
 
 namespace geecxx {
 
-typedef std::function<void (const std::string&)> ReadHandler;
+/**
+ * Handler of the lines received, without their "\r\n". The line is only
+ * valid during the call.
+ */
+typedef std::function<void (std::string_view)> ReadHandler;
+
+/**
+ * Handler of the lines sent, without their "\r\n", in place of the socket
+ */
+typedef std::function<void (std::string_view)> WriteHandler;
+
+class TrafficRecorder;
 
 class Connection
 {
@@ -42,12 +55,50 @@ public:
     bool open();
     void close();
 
+    /**
+     * Continue a session opened by another process
+     *
+     * @param[in] fileDescriptor connected socket, owned by the connection
+     *            from then on
+     * @param[in] pendingInput data received by the other process but not
+     *            handled yet
+     * @return true upon success, false otherwise
+     */
+    bool adopt(int fileDescriptor, const std::string& pendingInput);
+
+    /**
+     * Stop using the socket without closing the session, so that another
+     * process can continue it
+     *
+     * The io_service is stopped.
+     * @param[out] pendingInput data received but not handled yet
+     * @return the socket's file descriptor, owned by the caller, -1 upon
+     *         failure
+     */
+    int release(std::string& pendingInput);
+
     bool listen();
 
     bool isAlive() const;
 
+    boost::asio::io_service& getIoService();
+
     void setExternalReadHandler(const ReadHandler& externalReadHandler);
-    bool writeMessage(const std::string& message);
+
+    /**
+     * Pass the lines written to a handler rather than to the socket, for a
+     * connection which is never opened (e.g. to replay recorded traffic)
+     * @param[in] externalWriteHandler handler of the lines written
+     */
+    void setExternalWriteHandler(const WriteHandler& externalWriteHandler);
+
+    /**
+     * Record the lines received from then on
+     * @param[in] recorder opened recorder, nullptr to stop recording
+     */
+    void setRecorder(std::shared_ptr<TrafficRecorder> recorder);
+
+    bool writeMessage(std::string_view message);
 
     void readHandler(const boost::system::error_code& error, std::size_t);
 
@@ -65,7 +116,14 @@ private:
      * External handler to be called when data are available for reading.
      * Default handler does nothing.
      */
-    ReadHandler _externalReadHandler = [](const std::string&) {};
+    ReadHandler _externalReadHandler = [](std::string_view) {};
+
+    /**
+     * Handler the lines are written to instead of the socket, if any
+     */
+    WriteHandler _externalWriteHandler;
+
+    std::shared_ptr<TrafficRecorder> _recorder;
 
     boost::asio::streambuf _responseBuffer;
 };
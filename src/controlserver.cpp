@@ -0,0 +1,333 @@
+/*
+ * Copyright (c) 2015, Romain Létendart
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "controlserver.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <istream>
+#include <memory>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "logger.h"
+
+namespace geecxx
+{
+
+/**
+ * Connection of a client, kept alive by the pending handlers
+ */
+class ControlServer::Session : public std::enable_shared_from_this<ControlServer::Session>
+{
+public:
+    Session(boost::asio::local::stream_protocol::socket socket, const ControlHandler& handler)
+        : _socket(std::move(socket)), _input(MAX_COMMAND_SIZE), _handler(handler)
+    {
+    }
+
+    void asyncReadCommand()
+    {
+        std::shared_ptr<Session> self = shared_from_this();
+        boost::asio::async_read_until(_socket, _input, '\n',
+            [self](const boost::system::error_code& error, std::size_t) {
+                if (boost::asio::error::not_found == error) {
+                    self->_response = "ERROR Command too long\n";
+                    self->asyncWriteResponse(false);
+                } else if (!error) {
+                    self->executeCommand();
+                } // else closed by the client
+            });
+    }
+
+private:
+    void executeCommand()
+    {
+        std::istream inputStream(&_input);
+        std::string command;
+        std::getline(inputStream, command);
+        if (!command.empty() && '\r' == command.back()) {
+            command.pop_back();
+        }
+
+        std::string output;
+        int fileDescriptor = -1;
+        if (_handler(command, output, fileDescriptor)) {
+            if (!output.empty() && '\n' != output.back()) {
+                output.push_back('\n');
+            }
+            size_t lineCount = 0;
+            for (const char c : output) {
+                lineCount += '\n' == c ? 1 : 0;
+            }
+            _response = "OK " + std::to_string(lineCount) + "\n" + output;
+        } else {
+            // A single line, whatever the handler wrote
+            const size_t lineEnd = output.find('\n');
+            _response = "ERROR " + output.substr(0, lineEnd) + "\n";
+        }
+        if (0 <= fileDescriptor) {
+            writeResponse(fileDescriptor);
+            asyncReadCommand();
+        } else {
+            asyncWriteResponse(true);
+        }
+    }
+
+    /**
+     * Write the response with a file descriptor attached, which asio can't
+     * do, synchronously as responses are short
+     */
+    void writeResponse(int fileDescriptor)
+    {
+        boost::system::error_code error;
+        _socket.native_non_blocking(false, error);
+
+        iovec buffer = {&_response[0], _response.size()};
+        union {
+            cmsghdr header;
+            char bytes[CMSG_SPACE(sizeof(int))];
+        } control;
+        std::memset(&control, 0, sizeof(control));
+        msghdr message;
+        std::memset(&message, 0, sizeof(message));
+        message.msg_iov = &buffer;
+        message.msg_iovlen = 1;
+        message.msg_control = control.bytes;
+        message.msg_controllen = sizeof(control.bytes);
+        cmsghdr* controlHeader = CMSG_FIRSTHDR(&message);
+        controlHeader->cmsg_level = SOL_SOCKET;
+        controlHeader->cmsg_type = SCM_RIGHTS;
+        controlHeader->cmsg_len = CMSG_LEN(sizeof(int));
+        std::memcpy(CMSG_DATA(controlHeader), &fileDescriptor, sizeof(int));
+
+        const ssize_t size = ::sendmsg(_socket.native_handle(), &message, MSG_NOSIGNAL);
+        if (0 > size) {
+            error = boost::system::error_code(errno, boost::system::system_category());
+        } else if (size_t(size) < _response.size()) {
+            boost::asio::write(_socket, boost::asio::buffer(_response.data() + size, _response.size() - size),
+                               error);
+        }
+        if (error) {
+            LOG_ERROR("Couldn't pass file descriptor to control client: ", error.message());
+        }
+        ::close(fileDescriptor);
+    }
+
+    void asyncWriteResponse(bool keepReading)
+    {
+        std::shared_ptr<Session> self = shared_from_this();
+        boost::asio::async_write(_socket, boost::asio::buffer(_response),
+            [self, keepReading](const boost::system::error_code& error, std::size_t) {
+                if (!error && keepReading) {
+                    self->asyncReadCommand();
+                }
+            });
+    }
+
+    boost::asio::local::stream_protocol::socket _socket;
+    boost::asio::streambuf _input;
+    std::string _response;
+    ControlHandler _handler;
+};
+
+ControlServer::ControlServer(boost::asio::io_service& ioService, ControlHandler handler)
+    : _acceptor(ioService), _socket(ioService), _handler(std::move(handler))
+{
+}
+
+ControlServer::~ControlServer()
+{
+    close();
+}
+
+bool ControlServer::open(const std::string& socketPath)
+{
+    const boost::asio::local::stream_protocol::endpoint endpoint(socketPath);
+    boost::system::error_code error;
+
+    // A file left at socketPath is only replaced when nobody answers there,
+    // i.e. after a run that didn't shut down properly: a running instance
+    // keeps its socket
+    const int probe = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (-1 == probe) {
+        LOG_ERROR("Couldn't open control socket ", socketPath, ": ", std::strerror(errno));
+        return false;
+    }
+    const int probeResult = ::connect(probe, endpoint.data(), endpoint.size());
+    const int probeError = errno;
+    ::close(probe);
+    if (0 == probeResult) {
+        LOG_ERROR("Couldn't open control socket ", socketPath, ": another instance is already running");
+        return false;
+    }
+    if (ECONNREFUSED == probeError) {
+        std::remove(socketPath.c_str());
+    } else if (ENOENT != probeError) {
+        LOG_ERROR("Couldn't open control socket ", socketPath, ": ", std::strerror(probeError));
+        return false;
+    }
+
+    _acceptor.open(endpoint.protocol(), error);
+    if (!error) {
+        // The socket hands out the IRC session, only its owner may connect,
+        // from the moment it is created
+        const mode_t previousMask = ::umask(S_IRWXG | S_IRWXO | S_IXUSR);
+        _acceptor.bind(endpoint, error);
+        ::umask(previousMask);
+    }
+    if (!error) {
+        // From now on, the file is ours to remove
+        _socketPath = socketPath;
+        _acceptor.listen(boost::asio::socket_base::max_connections, error);
+    }
+    if (error) {
+        LOG_ERROR("Couldn't open control socket ", socketPath, ": ", error.message());
+        close();
+        return false;
+    }
+
+    LOG_INFO("Accepting commands on ", socketPath);
+    asyncAccept();
+    return true;
+}
+
+void ControlServer::close(bool removeSocketFile)
+{
+    boost::system::error_code ignoredError;
+    _acceptor.close(ignoredError);
+    if (removeSocketFile && !_socketPath.empty()) {
+        std::remove(_socketPath.c_str());
+    }
+    _socketPath.clear();
+}
+
+bool ControlServer::isOpen() const
+{
+    return _acceptor.is_open();
+}
+
+bool ControlServer::sendCommand(const std::string& socketPath, const std::string& command,
+                                std::string& output, int& fileDescriptor)
+{
+    output.clear();
+    fileDescriptor = -1;
+
+    boost::asio::io_service ioService;
+    boost::asio::local::stream_protocol::socket socket(ioService);
+    boost::system::error_code error;
+    socket.connect(boost::asio::local::stream_protocol::endpoint(socketPath), error);
+    if (!error) {
+        boost::asio::write(socket, boost::asio::buffer(command + "\n"), error);
+    }
+    if (error) {
+        output = "Couldn't send command to " + socketPath + ": " + error.message();
+        return false;
+    }
+
+    // Read with recvmsg() to get the file descriptor which may come with
+    // the response, until the status line and the lines it announces came
+    std::string response;
+    size_t statusLineSize = 0;
+    size_t expectedLineCount = 1;
+    size_t lineCount = 0;
+    while (lineCount < expectedLineCount) {
+        char data[4096];
+        iovec buffer = {data, sizeof(data)};
+        union {
+            cmsghdr header;
+            char bytes[CMSG_SPACE(sizeof(int))];
+        } control;
+        msghdr message;
+        std::memset(&message, 0, sizeof(message));
+        message.msg_iov = &buffer;
+        message.msg_iovlen = 1;
+        message.msg_control = control.bytes;
+        message.msg_controllen = sizeof(control.bytes);
+
+        const ssize_t size = ::recvmsg(socket.native_handle(), &message, 0);
+        if (0 >= size) {
+            output = "Control server closed the connection";
+            break;
+        }
+        for (cmsghdr* controlHeader = CMSG_FIRSTHDR(&message); nullptr != controlHeader;
+             controlHeader = CMSG_NXTHDR(&message, controlHeader)) {
+            if (SOL_SOCKET == controlHeader->cmsg_level && SCM_RIGHTS == controlHeader->cmsg_type
+                && 0 > fileDescriptor) {
+                std::memcpy(&fileDescriptor, CMSG_DATA(controlHeader), sizeof(int));
+            }
+        }
+
+        const size_t previousSize = response.size();
+        response.append(data, size);
+        for (size_t i = previousSize; i < response.size() && lineCount < expectedLineCount; ++i) {
+            if ('\n' != response[i]) {
+                continue;
+            }
+            if (0 == lineCount) {
+                statusLineSize = i;
+                if (0 == response.compare(0, 3, "OK ")) {
+                    expectedLineCount += std::strtoul(response.c_str() + 3, nullptr, 10);
+                }
+            }
+            ++lineCount;
+        }
+    }
+
+    const bool success = lineCount == expectedLineCount && 0 == response.compare(0, 3, "OK ");
+    if (success) {
+        output = response.substr(statusLineSize + 1);
+    } else if (lineCount == expectedLineCount) {
+        output = response.substr(0, statusLineSize);
+        if (0 == output.compare(0, 6, "ERROR ")) {
+            output.erase(0, 6);
+        }
+    }
+    if (!success && 0 <= fileDescriptor) {
+        ::close(fileDescriptor);
+        fileDescriptor = -1;
+    }
+    return success;
+}
+
+void ControlServer::asyncAccept()
+{
+    _acceptor.async_accept(_socket, [this](const boost::system::error_code& error) {
+        if (boost::asio::error::operation_aborted == error) {
+            // Closed, the server may be gone already
+            return;
+        }
+        if (error) {
+            LOG_WARNING("Couldn't accept control client: ", error.message());
+        } else {
+            std::make_shared<Session>(std::move(_socket), _handler)->asyncReadCommand();
+        }
+        asyncAccept();
+    });
+}
+
+}
@@ -0,0 +1,125 @@
+/*
+ * Copyright (c) 2015, Romain Létendart
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#pragma once
+
+#include <boost/asio.hpp>
+#include <functional>
+#include <string>
+
+namespace geecxx
+{
+
+/**
+ * Execute a control command
+ *
+ * @param[in] command command line, without its line feed
+ * @param[out] output text answered to the client, one or more lines, or
+ *             a one-line description of the error
+ * @param[out] fileDescriptor set to a file descriptor to be passed to the
+ *             client with the answer, which the server then closes, left to
+ *             -1 otherwise
+ * @return true upon success, false otherwise
+ */
+typedef std::function<bool (const std::string& command, std::string& output,
+                            int& fileDescriptor)> ControlHandler;
+
+/**
+ * The ControlServer class accepts administration commands on a Unix domain
+ * socket.
+ *
+ * Clients send one command per line and get, for each of them, either
+ * "OK <n>" followed by n lines of output, or "ERROR <description>". It runs
+ * on the io_service it is given (the connection's), so commands are
+ * executed by the same thread as IRC messages, one at a time.
+ *
+ * The socket is only accessible to the user running the bot.
+ */
+class ControlServer
+{
+public:
+    /**
+     * Constructor
+     * @param[in] ioService io_service commands are served by
+     * @param[in] handler executes commands
+     */
+    ControlServer(boost::asio::io_service& ioService, ControlHandler handler);
+
+    ControlServer(const ControlServer&) = delete;
+    ControlServer& operator=(const ControlServer&) = delete;
+
+    ~ControlServer();
+
+    /**
+     * Start accepting clients
+     *
+     * A file left at socketPath by a previous run is replaced, unless a
+     * server still accepts connections on it. Only the owner of the process
+     * can connect to the socket.
+     * @param[in] socketPath path to the socket
+     * @return true upon success, false otherwise
+     */
+    bool open(const std::string& socketPath);
+
+    /**
+     * Stop accepting clients, clients already connected are still served
+     *
+     * @param[in] removeSocketFile false when another server is about to
+     *            replace the socket file
+     */
+    void close(bool removeSocketFile = true);
+
+    bool isOpen() const;
+
+    /**
+     * Send a command to a control server and wait for its answer
+     *
+     * @param[in] socketPath path to the server's socket
+     * @param[in] command command line, without its line feed
+     * @param[out] output lines answered upon success, description of the
+     *             error otherwise
+     * @param[out] fileDescriptor file descriptor passed with the answer,
+     *             -1 if there is none
+     * @return true if the command succeeded, false otherwise
+     */
+    static bool sendCommand(const std::string& socketPath, const std::string& command,
+                            std::string& output, int& fileDescriptor);
+
+private:
+    class Session;
+
+    /**
+     * Longest command accepted
+     */
+    static const size_t MAX_COMMAND_SIZE = 4096;
+
+    void asyncAccept();
+
+    boost::asio::local::stream_protocol::acceptor _acceptor;
+    boost::asio::local::stream_protocol::socket _socket;
+    ControlHandler _handler;
+    std::string _socketPath;
+};
+
+}
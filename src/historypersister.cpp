@@ -0,0 +1,190 @@
+/*
+ * Copyright (c) 2015, Romain Létendart
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#define GEECXX_LOG_MODULE geecxx::LogModule::HISTORY
+
+#include "historypersister.h"
+
+#include <algorithm>
+
+#include "logger.h"
+
+namespace geecxx
+{
+
+HistoryPersister::HistoryPersister(std::string historyFilePath, size_t maxBacklogDepth)
+    : _historyFilePath(std::move(historyFilePath)),
+      _maxBacklogDepth(std::max<size_t>(maxBacklogDepth, 1))
+{
+}
+
+HistoryPersister::~HistoryPersister()
+{
+    stop();
+}
+
+void HistoryPersister::setArchive(std::shared_ptr<UrlArchive> archive)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _archive = std::move(archive);
+}
+
+void HistoryPersister::start()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_running || _stopped) {
+        return;
+    }
+    _running = true;
+    _worker = std::thread([this]() {
+        run();
+    });
+}
+
+void HistoryPersister::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (_stopped) {
+            return;
+        }
+        _stopped = true;
+    }
+    _workAvailable.notify_all();
+
+    if (_worker.joinable()) {
+        // The worker drains the backlog before exiting
+        _worker.join();
+    } else {
+        flush();
+    }
+}
+
+bool HistoryPersister::submit(std::shared_ptr<const UrlHistorySnapshot> snapshot)
+{
+    if (!snapshot) {
+        return false;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (_stopped) {
+            LOG_WARNING("History persister is stopped, snapshot ignored");
+            return false;
+        }
+        if (_backlog.size() >= _maxBacklogDepth) {
+            // The new snapshot supersedes the oldest pending one
+            _backlog.pop_front();
+            ++_stats._droppedSnapshotCount;
+        }
+        _backlog.push_back(PendingSnapshot{++_submittedCount, std::move(snapshot)});
+        _stats._backlogDepth = _backlog.size();
+        _stats._maxBacklogDepth = std::max(_stats._maxBacklogDepth, _backlog.size());
+    }
+    _workAvailable.notify_one();
+
+    return true;
+}
+
+bool HistoryPersister::flush()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    if (_worker.joinable()) {
+        const std::uint64_t target = _submittedCount;
+        _workDone.wait(lock, [this, target]() {
+            return _writtenCount >= target;
+        });
+    } else {
+        while (!_backlog.empty()) {
+            PendingSnapshot pending = std::move(_backlog.front());
+            _backlog.pop_front();
+            _stats._backlogDepth = _backlog.size();
+            lock.unlock();
+            write(*pending._snapshot);
+            lock.lock();
+            _writtenCount = pending._sequenceNumber;
+        }
+    }
+
+    return _lastFlushSucceeded;
+}
+
+HistoryPersisterStats HistoryPersister::getStats() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _stats;
+}
+
+void HistoryPersister::run()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    while (true) {
+        _workAvailable.wait(lock, [this]() {
+            return !_backlog.empty() || _stopped;
+        });
+        if (_backlog.empty()) {
+            // Stopped and nothing left to be written
+            break;
+        }
+
+        PendingSnapshot pending = std::move(_backlog.front());
+        _backlog.pop_front();
+        _stats._backlogDepth = _backlog.size();
+
+        lock.unlock();
+        write(*pending._snapshot);
+        pending._snapshot.reset();
+        lock.lock();
+
+        // Snapshots dropped before this one are covered by it as well
+        _writtenCount = pending._sequenceNumber;
+        _workDone.notify_all();
+    }
+    _running = false;
+}
+
+void HistoryPersister::write(const UrlHistorySnapshot& snapshot)
+{
+    const auto start = std::chrono::steady_clock::now();
+    // Entries evicted from the snapshot are archived first, so that a failure
+    // in between leaves them in both places rather than nowhere
+    bool success = !_archive || _archive->flush();
+    if (!UrlHistoryManager::saveSnapshotToFile(snapshot, _historyFilePath)) {
+        success = false;
+    }
+    const auto latency = std::chrono::duration_cast<std::chrono::microseconds>(
+                                std::chrono::steady_clock::now() - start);
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    _lastFlushSucceeded = success;
+    ++_stats._flushCount;
+    if (!success) {
+        ++_stats._failedFlushCount;
+    }
+    _stats._lastFlushLatency = latency;
+    _stats._maxFlushLatency = std::max(_stats._maxFlushLatency, latency);
+    _stats._totalFlushLatency += latency;
+}
+
+}
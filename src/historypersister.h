@@ -0,0 +1,211 @@
+/*
+ * Copyright (c) 2015, Romain Létendart
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "urlarchive.h"
+#include "urlhistorymanager.h"
+
+namespace geecxx
+{
+
+/**
+ * Statistics about history persistence
+ */
+struct HistoryPersisterStats
+{
+    /**
+     * Number of snapshots waiting to be written
+     */
+    size_t _backlogDepth = 0;
+
+    /**
+     * Highest number of snapshots that have been waiting at the same time
+     */
+    size_t _maxBacklogDepth = 0;
+
+    /**
+     * Number of snapshots written to the disk (successfully or not)
+     */
+    std::uint64_t _flushCount = 0;
+
+    /**
+     * Number of snapshots that couldn't be written to the disk
+     */
+    std::uint64_t _failedFlushCount = 0;
+
+    /**
+     * Number of snapshots discarded because a newer one superseded them
+     * while the backlog was full
+     */
+    std::uint64_t _droppedSnapshotCount = 0;
+
+    /**
+     * Time spent writing the last snapshot
+     */
+    std::chrono::microseconds _lastFlushLatency{0};
+
+    /**
+     * Longest time spent writing a snapshot
+     */
+    std::chrono::microseconds _maxFlushLatency{0};
+
+    /**
+     * Time spent writing all snapshots
+     */
+    std::chrono::microseconds _totalFlushLatency{0};
+};
+
+/**
+ * The HistoryPersister class writes URL history snapshots to the disk from a
+ * dedicated thread, so that disk latency never delays the IRC read thread.
+ *
+ * Submitted snapshots are queued in a bounded backlog. As every snapshot holds
+ * the whole history, the oldest pending one is simply discarded when the
+ * backlog is full: the newer snapshot supersedes it.
+ */
+class HistoryPersister
+{
+public:
+    /**
+     * Constructor
+     *
+     * @param[in] historyFilePath path to the file snapshots are written into
+     * @param[in] maxBacklogDepth maximum number of pending snapshots (>= 1)
+     */
+    HistoryPersister(std::string historyFilePath, size_t maxBacklogDepth = 2);
+
+    HistoryPersister(const HistoryPersister&) = delete;
+    HistoryPersister& operator=(const HistoryPersister&) = delete;
+
+    /**
+     * Destructor
+     *
+     * Pending snapshots are written before the worker thread is stopped.
+     */
+    ~HistoryPersister();
+
+    /**
+     * Flush an archive after each written snapshot
+     *
+     * Must be called before start().
+     * @param[in] archive archive to be flushed, null to disable it
+     */
+    void setArchive(std::shared_ptr<UrlArchive> archive);
+
+    /**
+     * Start the worker thread
+     *
+     * Snapshots submitted before this call are kept until it happens.
+     */
+    void start();
+
+    /**
+     * Write pending snapshots and stop the worker thread
+     *
+     * Further submitted snapshots are ignored.
+     */
+    void stop();
+
+    /**
+     * Queue a snapshot to be written to the disk
+     *
+     * @param[in] snapshot history snapshot to be written
+     * @return false if the persister has been stopped or snapshot is null
+     */
+    bool submit(std::shared_ptr<const UrlHistorySnapshot> snapshot);
+
+    /**
+     * Wait until every snapshot submitted so far has been written
+     *
+     * If the worker thread is not running, pending snapshots are written
+     * from the calling thread instead.
+     * @return true if the last written snapshot was successfully saved
+     */
+    bool flush();
+
+    /**
+     * Get persistence statistics
+     * @return copy of the current statistics
+     */
+    HistoryPersisterStats getStats() const;
+
+private:
+    /**
+     * Worker thread main loop
+     */
+    void run();
+
+    /**
+     * Write a snapshot to the disk and update statistics
+     *
+     * Must be called without holding _mutex.
+     * @param[in] snapshot history snapshot to be written
+     */
+    void write(const UrlHistorySnapshot& snapshot);
+
+    struct PendingSnapshot
+    {
+        std::uint64_t _sequenceNumber;
+        std::shared_ptr<const UrlHistorySnapshot> _snapshot;
+    };
+
+    const std::string _historyFilePath;
+    const size_t _maxBacklogDepth;
+    std::shared_ptr<UrlArchive> _archive;
+
+    mutable std::mutex _mutex;
+    std::condition_variable _workAvailable;
+    std::condition_variable _workDone;
+    std::deque<PendingSnapshot> _backlog;
+
+    /**
+     * Number of snapshots submitted so far, also used as the sequence number
+     * of the last submitted snapshot
+     */
+    std::uint64_t _submittedCount = 0;
+
+    /**
+     * Sequence number of the last written snapshot, used by flush() to know
+     * when everything it waits for has been written
+     */
+    std::uint64_t _writtenCount = 0;
+
+    bool _lastFlushSucceeded = true;
+    bool _running = false;
+    bool _stopped = false;
+    HistoryPersisterStats _stats;
+    std::thread _worker;
+};
+
+}
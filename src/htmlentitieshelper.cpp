@@ -22,6 +22,8 @@
  * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
  * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
+#define GEECXX_LOG_MODULE geecxx::LogModule::HTML
+
 #include "htmlentitieshelper.h"
 
 #include <boost/locale.hpp>
@@ -2227,7 +2229,7 @@ std::string HTMLEntitiesHelper::fromCode(std::string code)
         std::wstring utfCode = {static_cast<wchar_t>(numCode)};
         decodedBytes = boost::locale::conv::from_utf(utfCode, "UTF-8", boost::locale::conv::stop);
     } catch (boost::locale::conv::conversion_error&) {
-        LOG_WARNING("Could not decode HTML entity: " + code);
+        LOG_WARNING("Could not decode HTML entity: ", code);
         decodedBytes = "";
     }
     return decodedBytes;
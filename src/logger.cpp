@@ -24,16 +24,21 @@
  */
 #include "logger.h"
 
+#include <boost/algorithm/string.hpp>
 #include <chrono>
-#include <ctime>
 #include <iostream>
-#include <sstream>
+#include <vector>
 
 namespace geecxx
 {
 
+std::atomic<LogLevel> Logger::_thresholds[LOG_MODULE_COUNT];
+
 Logger::~Logger()
 {
+    _running.store(false);
+    wakeWriter();
+    _writer.join();
 }
 
 Logger& Logger::getInstance()
@@ -43,50 +48,215 @@ Logger& Logger::getInstance()
     return logger;
 }
 
-void Logger::log(const LogLevel& logLevel, const std::string& message)
+void Logger::flush()
 {
-    if (logLevel < _logLevelThreshold) {
-        return;
+    const std::uint64_t pushedCount = _pushedCount.load();
+    while (_writtenCount.load() < pushedCount) {
+        wakeWriter();
+        std::this_thread::yield();
     }
+}
 
-    std::lock_guard<std::mutex> lock(_mutex);
-    std::time_t now = std::chrono::system_clock::to_time_t(
-                                std::chrono::system_clock::now());
-    char formattedTime[20];
+void Logger::setOverflowPolicy(LogOverflowPolicy overflowPolicy)
+{
+    _overflowPolicy.store(overflowPolicy);
+}
+
+void Logger::setOutput(std::ostream& output)
+{
+    flush();
+    std::lock_guard<std::mutex> lock(_sinksMutex);
+    _sinks[0] = std::make_shared<LogSink>(LogFormat::TEXT, output);
+}
 
-    if (0 == strftime(formattedTime, 20, "%F %T", localtime(&now))) {
-        // Be sure to display an empty string instead of undefined content
-        formattedTime[0] = '\0';
+void Logger::addSink(std::shared_ptr<LogSink> sink)
+{
+    std::lock_guard<std::mutex> lock(_sinksMutex);
+    _sinks.push_back(std::move(sink));
+}
+
+void Logger::removeSink(const std::shared_ptr<LogSink>& sink)
+{
+    flush();
+    std::lock_guard<std::mutex> lock(_sinksMutex);
+    for (auto it = _sinks.begin() + 1; it != _sinks.end(); ++it) {
+        if (*it == sink) {
+            _sinks.erase(it);
+            break;
+        }
     }
+}
 
-    std::istringstream stream(message);
-    std::string messageChunk;
-    while (std::getline(stream, messageChunk)) {
-        std::cout << "[" << formattedTime << "][" << logLevelToStr(logLevel) << "]: "
-                  << messageChunk << std::endl;
+void Logger::setThreshold(LogModule logModule, LogLevel logLevel)
+{
+    _thresholds[static_cast<size_t>(logModule)].store(logLevel, std::memory_order_relaxed);
+}
+
+LogLevel Logger::getThreshold(LogModule logModule)
+{
+    const LogLevel logLevel = _thresholds[static_cast<size_t>(logModule)].load(std::memory_order_relaxed);
+    return isCompiledIn(logLevel) ? logLevel : LOG_LEVEL_THRESHOLD;
+}
+
+bool Logger::setThresholds(const std::string& specification)
+{
+    std::vector<std::string> assignments;
+    boost::split(assignments, specification, boost::is_any_of(","));
+
+    // Validate everything first, thresholds are applied all at once
+    std::vector<std::pair<size_t, LogLevel>> thresholds;
+    for (const std::string& assignment : assignments) {
+        const size_t separator = assignment.find('=');
+        if (std::string::npos == separator) {
+            LOG_ERROR("Invalid log level specification \"", assignment, "\", expected module=level");
+            return false;
+        }
+        const std::string moduleName = boost::to_lower_copy(boost::trim_copy(assignment.substr(0, separator)));
+        const std::string levelName = boost::to_upper_copy(boost::trim_copy(assignment.substr(separator + 1)));
+
+        size_t level = 0;
+        while (level <= static_cast<size_t>(LogLevel::ERROR)
+               && levelName != LogSink::logLevelToStr(static_cast<LogLevel>(level))) {
+            ++level;
+        }
+        if (level > static_cast<size_t>(LogLevel::ERROR)) {
+            LOG_ERROR("Unknown log level \"", levelName, "\"");
+            return false;
+        }
+
+        const bool allModules = "all" == moduleName;
+        bool found = false;
+        for (size_t module = 0; module < LOG_MODULE_COUNT; ++module) {
+            if (allModules || moduleName == LogSink::logModuleToStr(static_cast<LogModule>(module))) {
+                thresholds.emplace_back(module, static_cast<LogLevel>(level));
+                found = true;
+            }
+        }
+        if (!found) {
+            LOG_ERROR("Unknown log module \"", moduleName, "\"");
+            return false;
+        }
     }
+
+    for (const std::pair<size_t, LogLevel>& threshold : thresholds) {
+        setThreshold(static_cast<LogModule>(threshold.first), threshold.second);
+    }
+    return true;
+}
+
+std::string Logger::getThresholds()
+{
+    std::string specification;
+    for (size_t module = 0; module < LOG_MODULE_COUNT; ++module) {
+        const LogModule logModule = static_cast<LogModule>(module);
+        if (!specification.empty()) {
+            specification.push_back(',');
+        }
+        specification.append(LogSink::logModuleToStr(logModule)).push_back('=');
+        specification.append(boost::to_lower_copy(std::string(LogSink::logLevelToStr(getThreshold(logModule)))));
+    }
+    return specification;
+}
+
+std::uint64_t Logger::getDroppedCount() const
+{
+    return _droppedCount.load(std::memory_order_relaxed);
+}
+
+std::uint64_t Logger::getQueueDepth() const
+{
+    // The writer may count a message before its producer does
+    const std::uint64_t writtenCount = _writtenCount.load(std::memory_order_relaxed);
+    const std::uint64_t pushedCount = _pushedCount.load(std::memory_order_relaxed);
+    return pushedCount > writtenCount ? pushedCount - writtenCount : 0;
 }
 
 Logger::Logger()
+    : _queue(QUEUE_CAPACITY), _sinks{std::make_shared<LogSink>(LogFormat::TEXT, std::cout)}
+{
+    _writer = std::thread([this]() {
+        runWriter();
+    });
+}
+
+void Logger::push(LogRecord& record)
 {
+    while (!_queue.push(record)) {
+        if (LogOverflowPolicy::DROP == _overflowPolicy.load(std::memory_order_relaxed)) {
+            _droppedCount.fetch_add(1, std::memory_order_relaxed);
+            _unreportedDroppedCount.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        wakeWriter();
+        std::this_thread::yield();
+    }
+    _pushedCount.fetch_add(1);
+
+    // Pairs with the fence of the writer: either it sees the new record, or
+    // we see it is about to sleep
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (_writerWaiting.load(std::memory_order_relaxed)) {
+        wakeWriter();
+    }
+}
+
+void Logger::wakeWriter()
+{
+    std::lock_guard<std::mutex> lock(_writerMutex);
+    _writerCondition.notify_one();
 }
 
-std::string Logger::logLevelToStr(const LogLevel& logLevel)
+void Logger::runWriter()
 {
-    switch (logLevel) {
-    case LogLevel::DEBUG:
-        return "DEBUG";
-    case LogLevel::INFO:
-        return "INFO";
-    case LogLevel::WARNING:
-        return "WARNING";
-    case LogLevel::ERROR:
-        return "ERROR";
-    default:
-        return "UNKNOWN";
+    LogRecord record;
+    while (true) {
+        size_t recordCount = 0;
+        {
+            std::lock_guard<std::mutex> lock(_sinksMutex);
+            const std::uint64_t droppedCount = _unreportedDroppedCount.exchange(0, std::memory_order_relaxed);
+            if (0 != droppedCount) {
+                record.reset(LogLevel::WARNING, std::time(nullptr));
+                record.add(droppedCount);
+                record.add(" log message(s) dropped");
+                writeRecord(record);
+            }
+            while (recordCount < BATCH_SIZE && _queue.pop(record)) {
+                writeRecord(record);
+                ++recordCount;
+            }
+            if (0 != droppedCount || 0 != recordCount) {
+                for (const std::shared_ptr<LogSink>& sink : _sinks) {
+                    sink->flush();
+                }
+            }
+        }
+
+        if (0 != recordCount) {
+            _writtenCount.fetch_add(recordCount);
+            continue;
+        }
+
+        if (!_running.load()) {
+            // Queue drained, nothing more will come
+            break;
+        }
+
+        std::unique_lock<std::mutex> lock(_writerMutex);
+        _writerWaiting.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (_queue.isEmpty()) {
+            // The timeout covers messages dropped while the queue was full
+            _writerCondition.wait_for(lock, std::chrono::milliseconds(100));
+        } // else, arrived in the meantime, don't sleep on it
+        _writerWaiting.store(false, std::memory_order_relaxed);
     }
+}
 
-    return "";
+void Logger::writeRecord(const LogRecord& record)
+{
+    for (const std::shared_ptr<LogSink>& sink : _sinks) {
+        sink->write(record);
+    }
 }
 
 }
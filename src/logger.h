@@ -24,22 +24,58 @@
  */
 #pragma once
 
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <ctime>
+#include <memory>
 #include <mutex>
+#include <ostream>
 #include <string>
+#include <thread>
+#include <vector>
 
 #include "loggerconfig.h"
+#include "logrecord.h"
+#include "logsink.h"
+#include "mpscqueue.h"
 
 namespace geecxx
 {
 
-enum class LogLevel : std::uint8_t
+/**
+ * What to do with a log message when the queue is full
+ */
+enum class LogOverflowPolicy : std::uint8_t
 {
-    DEBUG,
-    INFO,
-    WARNING,
-    ERROR
+    /**
+     * Wait for the writer to make room (default)
+     */
+    BLOCK,
+    /**
+     * Discard the message, the writer reports how many were lost
+     */
+    DROP
 };
 
+/**
+ * The Logger class writes log messages on a background thread.
+ *
+ * The calling thread only copies the arguments of a message into a
+ * LogRecord and pushes it to a bounded lock-free queue. The writer thread
+ * drains the queue in batches: each sink formats the messages of a batch,
+ * then writes them with a single call, so logging never waits for the
+ * output unless the queue is full and the overflow policy is BLOCK.
+ *
+ * Messages go to a text sink writing to std::cout, and to any sink added
+ * with addSink() (e.g. a structured log file).
+ *
+ * Each message comes from a module, whose threshold can be raised at run
+ * time on top of the one chosen at build time.
+ *
+ * Messages are meant to be logged through the LOG_* macros, which don't
+ * evaluate their arguments when the level is disabled.
+ */
 class Logger
 {
 public:
@@ -50,18 +86,213 @@ public:
     ~Logger();
     static Logger& getInstance();
 
-    void log(const LogLevel& logLevel, const std::string& message);
+    /**
+     * Tell whether messages of a level are logged at all
+     *
+     * Levels below the threshold chosen at build time (WITH_LOG_LEVEL) are
+     * compiled out by the LOG_* macros.
+     * @param[in] logLevel level to check
+     * @return true if messages of this level are logged, false otherwise
+     */
+    static constexpr bool isCompiledIn(LogLevel logLevel)
+    {
+        return logLevel >= LOG_LEVEL_THRESHOLD;
+    }
+
+    /**
+     * Tell whether messages of a level are currently logged for a module
+     * @param[in] logModule module to check
+     * @param[in] logLevel level to check
+     * @return true if messages of this level are logged, false otherwise
+     */
+    static bool isEnabled(LogModule logModule, LogLevel logLevel)
+    {
+        return isCompiledIn(logLevel)
+               && logLevel >= _thresholds[static_cast<size_t>(logModule)].load(std::memory_order_relaxed);
+    }
+
+    /**
+     * Change the lowest level logged for a module
+     *
+     * Levels compiled out can't be enabled back.
+     * @param[in] logModule module
+     * @param[in] logLevel new threshold
+     */
+    static void setThreshold(LogModule logModule, LogLevel logLevel);
+
+    /**
+     * Get the lowest level logged for a module
+     * @param[in] logModule module
+     * @return current threshold, never below the one chosen at build time
+     */
+    static LogLevel getThreshold(LogModule logModule);
+
+    /**
+     * Change thresholds from a specification such as
+     * "connection=debug,history=warning", where "all" stands for every module
+     *
+     * Nothing is changed if the specification is invalid.
+     * @param[in] specification comma separated module=level pairs
+     * @return true upon success, false otherwise
+     */
+    static bool setThresholds(const std::string& specification);
+
+    /**
+     * Get current thresholds
+     * @return specification of the threshold of every module
+     */
+    static std::string getThresholds();
+
+    /**
+     * Log a message made of the concatenation of the given arguments
+     *
+     * Arguments are copied as is, they are only converted to text by the
+     * writer thread.
+     * @param[in] logModule module the message comes from
+     * @param[in] logLevel level of the message
+     * @param[in] args strings, characters, booleans or numbers
+     */
+    template<typename... Args>
+    void log(LogModule logModule, LogLevel logLevel, const Args&... args)
+    {
+        if (!isEnabled(logModule, logLevel)) {
+            return;
+        }
+
+        LogRecord record;
+        record.reset(logLevel, std::time(nullptr));
+        record.setModule(logModule);
+        addArguments(record, args...);
+        push(record);
+    }
+
+    /**
+     * Wait until every message logged so far has been written
+     */
+    void flush();
+
+    /**
+     * Change what happens to log messages when the queue is full
+     * @param[in] overflowPolicy new policy
+     */
+    void setOverflowPolicy(LogOverflowPolicy overflowPolicy);
+
+    /**
+     * Write text log messages to another stream than std::cout
+     *
+     * Messages already logged are written to the previous stream first.
+     * @param[in] output stream to write to, must outlive its use by the logger
+     */
+    void setOutput(std::ostream& output);
+
+    /**
+     * Write log messages to an additional sink, from now on
+     * @param[in] sink opened sink
+     */
+    void addSink(std::shared_ptr<LogSink> sink);
+
+    /**
+     * Stop writing to a sink added with addSink()
+     *
+     * Messages already logged are written to it first.
+     * @param[in] sink sink to be removed
+     */
+    void removeSink(const std::shared_ptr<LogSink>& sink);
+
+    /**
+     * Get number of messages discarded because the queue was full
+     * @return number of dropped messages since the logger was created
+     */
+    std::uint64_t getDroppedCount() const;
+
+    /**
+     * Get number of messages waiting to be written
+     * @return number of queued messages
+     */
+    std::uint64_t getQueueDepth() const;
 private:
+    static const size_t QUEUE_CAPACITY = 8192;
+    /**
+     * Maximum number of messages written at once
+     */
+    static const size_t BATCH_SIZE = 256;
+
     Logger();
-    std::string logLevelToStr(const LogLevel& logLevel);
 
-    std::mutex _mutex;
-    const LogLevel _logLevelThreshold = LOG_LEVEL_THRESHOLD;
+    static void addArguments(LogRecord&)
+    {
+    }
+
+    template<typename Arg, typename... Args>
+    static void addArguments(LogRecord& record, const Arg& arg, const Args&... args)
+    {
+        record.add(arg);
+        addArguments(record, args...);
+    }
+
+    void push(LogRecord& record);
+    void wakeWriter();
+    void runWriter();
+    void writeRecord(const LogRecord& record);
+
+    /**
+     * Runtime threshold of each module, zero-initialized (i.e. DEBUG) before
+     * any message can be logged
+     */
+    static std::atomic<LogLevel> _thresholds[LOG_MODULE_COUNT];
+
+    std::atomic<LogOverflowPolicy> _overflowPolicy{LogOverflowPolicy::BLOCK};
+
+    /**
+     * Messages waiting to be written, only popped by the writer thread
+     */
+    MpscQueue<LogRecord> _queue;
+    std::atomic<std::uint64_t> _pushedCount{0};
+    std::atomic<std::uint64_t> _writtenCount{0};
+    std::atomic<std::uint64_t> _droppedCount{0};
+    std::atomic<std::uint64_t> _unreportedDroppedCount{0};
+
+    /**
+     * Guards the sinks, taken by the writer while writing a batch. The
+     * first sink is the text output.
+     */
+    std::mutex _sinksMutex;
+    std::vector<std::shared_ptr<LogSink>> _sinks;
+
+    /**
+     * The writer sleeps on _writerCondition when the queue is empty and
+     * raises _writerWaiting so that producers know they must wake it up
+     */
+    std::mutex _writerMutex;
+    std::condition_variable _writerCondition;
+    std::atomic<bool> _writerWaiting{false};
+    std::atomic<bool> _running{true};
+    std::thread _writer;
 };
 
 }
 
-#define LOG_DEBUG(message)   geecxx::Logger::getInstance().log(geecxx::LogLevel::DEBUG, message)
-#define LOG_INFO(message)    geecxx::Logger::getInstance().log(geecxx::LogLevel::INFO, message)
-#define LOG_WARNING(message) geecxx::Logger::getInstance().log(geecxx::LogLevel::WARNING, message)
-#define LOG_ERROR(message)   geecxx::Logger::getInstance().log(geecxx::LogLevel::ERROR, message)
+/**
+ * Module of the messages logged from a source file, to be defined before
+ * any include, e.g. #define GEECXX_LOG_MODULE geecxx::LogModule::BOT
+ */
+#ifndef GEECXX_LOG_MODULE
+    #define GEECXX_LOG_MODULE geecxx::LogModule::GENERAL
+#endif
+
+/**
+ * Arguments are only evaluated when the level is enabled, e.g.
+ * LOG_DEBUG("Reading: ", message) costs nothing with WITH_LOG_LEVEL=1, and
+ * a single relaxed load when the module's threshold is above DEBUG
+ */
+#define GEECXX_LOG(logLevel, ...)                                                        \
+    do {                                                                                 \
+        if (geecxx::Logger::isEnabled(GEECXX_LOG_MODULE, logLevel)) {                    \
+            geecxx::Logger::getInstance().log(GEECXX_LOG_MODULE, logLevel, __VA_ARGS__); \
+        }                                                                                \
+    } while (false)
+
+#define LOG_DEBUG(...)   GEECXX_LOG(geecxx::LogLevel::DEBUG, __VA_ARGS__)
+#define LOG_INFO(...)    GEECXX_LOG(geecxx::LogLevel::INFO, __VA_ARGS__)
+#define LOG_WARNING(...) GEECXX_LOG(geecxx::LogLevel::WARNING, __VA_ARGS__)
+#define LOG_ERROR(...)   GEECXX_LOG(geecxx::LogLevel::ERROR, __VA_ARGS__)
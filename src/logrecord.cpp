@@ -0,0 +1,288 @@
+/*
+ * Copyright (c) 2015, Romain Létendart
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "logrecord.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+namespace geecxx
+{
+
+LogRecord& LogRecord::operator=(LogRecord&& other)
+{
+    _module = other._module;
+    _level = other._level;
+    _time = other._time;
+    _size = other._size;
+    _spilled = other._spilled;
+    if (_spilled) {
+        _overflow = std::move(other._overflow);
+    } else {
+        std::memcpy(_inline, other._inline, _size);
+    }
+    return *this;
+}
+
+void LogRecord::reset(LogLevel level, std::time_t time)
+{
+    _module = LogModule::GENERAL;
+    _level = level;
+    _time = time;
+    _size = 0;
+    _spilled = false;
+    _overflow.clear();
+}
+
+void LogRecord::assign(LogLevel level, std::time_t time, const char* data, size_t size)
+{
+    reset(level, time);
+    append(data, size);
+}
+
+void LogRecord::setModule(LogModule module)
+{
+    _module = module;
+}
+
+LogModule LogRecord::getModule() const
+{
+    return _module;
+}
+
+LogLevel LogRecord::getLevel() const
+{
+    return _level;
+}
+
+std::time_t LogRecord::getTime() const
+{
+    return _time;
+}
+
+void LogRecord::add(std::string_view value)
+{
+    addString(value.data(), value.size());
+}
+
+void LogRecord::add(const char* value)
+{
+    if (nullptr == value) {
+        value = "(null)";
+    }
+    addString(value, std::strlen(value));
+}
+
+void LogRecord::add(char value)
+{
+    const Tag tag = Tag::CHAR;
+    append(&tag, sizeof(tag));
+    append(&value, sizeof(value));
+}
+
+void LogRecord::add(bool value)
+{
+    add(value ? "true" : "false");
+}
+
+void LogRecord::add(double value)
+{
+    const Tag tag = Tag::DOUBLE;
+    append(&tag, sizeof(tag));
+    append(&value, sizeof(value));
+}
+
+const char* LogRecord::getData() const
+{
+    return _spilled ? _overflow.data() : _inline;
+}
+
+size_t LogRecord::getSize() const
+{
+    return _size;
+}
+
+bool LogRecord::forEachValue(const std::function<void(const LogValue&)>& visitor) const
+{
+    const char* data = getData();
+    const char* const end = data + _size;
+    LogValue value;
+    value._name.clear();
+    while (data < end) {
+        std::memcpy(&value._type, data, sizeof(value._type));
+        data += sizeof(value._type);
+        const size_t remainingSize = end - data;
+        switch (value._type) {
+        case Tag::STRING: {
+            std::uint32_t size;
+            if (remainingSize < sizeof(size)) {
+                return false;
+            }
+            std::memcpy(&size, data, sizeof(size));
+            if (remainingSize - sizeof(size) < size) {
+                return false;
+            }
+            value._data = data + sizeof(size);
+            value._size = size;
+            data += sizeof(size) + size;
+            break;
+        }
+        case Tag::SIGNED:
+            if (remainingSize < sizeof(value._signed)) {
+                return false;
+            }
+            std::memcpy(&value._signed, data, sizeof(value._signed));
+            data += sizeof(value._signed);
+            break;
+        case Tag::UNSIGNED:
+            if (remainingSize < sizeof(value._unsigned)) {
+                return false;
+            }
+            std::memcpy(&value._unsigned, data, sizeof(value._unsigned));
+            data += sizeof(value._unsigned);
+            break;
+        case Tag::DOUBLE:
+            if (remainingSize < sizeof(value._double)) {
+                return false;
+            }
+            std::memcpy(&value._double, data, sizeof(value._double));
+            data += sizeof(value._double);
+            break;
+        case Tag::CHAR:
+            if (remainingSize < 1) {
+                return false;
+            }
+            value._data = data;
+            value._size = 1;
+            data += 1;
+            break;
+        case Tag::FIELD: {
+            if (remainingSize < 1) {
+                return false;
+            }
+            const size_t nameSize = static_cast<unsigned char>(*data);
+            if (remainingSize - 1 < nameSize) {
+                return false;
+            }
+            value._name.assign(data + 1, nameSize);
+            data += 1 + nameSize;
+            // The value comes next
+            continue;
+        }
+        default:
+            return false;
+        }
+        visitor(value);
+        value._name.clear();
+    }
+    return true;
+}
+
+void LogRecord::format(std::string& text) const
+{
+    forEachValue([&text](const LogValue& value) {
+        if (!value._name.empty()) {
+            if (!text.empty() && ' ' != text.back() && '\n' != text.back()) {
+                text.push_back(' ');
+            }
+            text.append(value._name).push_back('=');
+        }
+        formatValue(value, text);
+    });
+}
+
+void LogRecord::formatValue(const LogValue& value, std::string& text)
+{
+    char number[32];
+    switch (value._type) {
+    case Tag::STRING:
+    case Tag::CHAR:
+        text.append(value._data, value._size);
+        break;
+    case Tag::SIGNED:
+        text.append(number, std::snprintf(number, sizeof(number), "%lld",
+                                          static_cast<long long>(value._signed)));
+        break;
+    case Tag::UNSIGNED:
+        text.append(number, std::snprintf(number, sizeof(number), "%llu",
+                                          static_cast<unsigned long long>(value._unsigned)));
+        break;
+    case Tag::DOUBLE:
+        text.append(number, std::snprintf(number, sizeof(number), "%g", value._double));
+        break;
+    case Tag::FIELD:
+        break;
+    }
+}
+
+void LogRecord::addFieldName(const char* name)
+{
+    const Tag tag = Tag::FIELD;
+    const unsigned char nameSize = static_cast<unsigned char>(std::min<size_t>(std::strlen(name), 255));
+    append(&tag, sizeof(tag));
+    append(&nameSize, sizeof(nameSize));
+    append(name, nameSize);
+}
+
+void LogRecord::addSigned(std::int64_t value)
+{
+    const Tag tag = Tag::SIGNED;
+    append(&tag, sizeof(tag));
+    append(&value, sizeof(value));
+}
+
+void LogRecord::addUnsigned(std::uint64_t value)
+{
+    const Tag tag = Tag::UNSIGNED;
+    append(&tag, sizeof(tag));
+    append(&value, sizeof(value));
+}
+
+void LogRecord::addString(const char* data, size_t size)
+{
+    const Tag tag = Tag::STRING;
+    const std::uint32_t encodedSize = static_cast<std::uint32_t>(size);
+    append(&tag, sizeof(tag));
+    append(&encodedSize, sizeof(encodedSize));
+    append(data, encodedSize);
+}
+
+void LogRecord::append(const void* data, size_t size)
+{
+    if (!_spilled && _size + size > INLINE_SIZE) {
+        // Too large for the inline storage, everything moves to the heap
+        _overflow.assign(_inline, _size);
+        _spilled = true;
+    }
+
+    if (_spilled) {
+        _overflow.append(static_cast<const char*>(data), size);
+    } else {
+        std::memcpy(_inline + _size, data, size);
+    }
+    _size += size;
+}
+
+}
@@ -0,0 +1,247 @@
+/*
+ * Copyright (c) 2015, Romain Létendart
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+namespace geecxx
+{
+
+enum class LogLevel : std::uint8_t
+{
+    DEBUG,
+    INFO,
+    WARNING,
+    ERROR
+};
+
+/**
+ * Part of the bot a log message comes from, each one has its own threshold
+ */
+enum class LogModule : std::uint8_t
+{
+    GENERAL,
+    CONNECTION,
+    BOT,
+    FETCH,
+    HISTORY,
+    HTML
+};
+
+const size_t LOG_MODULE_COUNT = 6;
+
+/**
+ * Named argument of a log message, e.g. logField("latency_us", latency)
+ *
+ * Text output shows it as name=value (preceded by a space if needed),
+ * structured outputs keep it as a typed field of its own.
+ */
+template<typename T>
+struct LogField
+{
+    const char* _name;
+    const T& _value;
+};
+
+template<typename T>
+LogField<T> logField(const char* name, const T& value)
+{
+    return LogField<T>{name, value};
+}
+
+/**
+ * Decoded argument of a log message
+ */
+struct LogValue
+{
+    enum class Type : char
+    {
+        STRING,
+        SIGNED,
+        UNSIGNED,
+        DOUBLE,
+        CHAR,
+        /**
+         * Not a value: name of the field the next value belongs to
+         */
+        FIELD
+    };
+
+    Type _type;
+    /**
+     * Name of the field, empty for plain arguments
+     */
+    std::string _name;
+    /**
+     * Contents of strings and characters
+     */
+    const char* _data;
+    size_t _size;
+    std::int64_t _signed;
+    std::uint64_t _unsigned;
+    double _double;
+};
+
+/**
+ * The LogRecord class holds the arguments of a log message until they get
+ * formatted by the logger's writer thread.
+ *
+ * Arguments are copied in a compact tagged encoding: strings as their size
+ * followed by their bytes, numbers and characters in binary. Only strings,
+ * characters, booleans, arithmetic types and LogField of those are
+ * accepted, anything else doesn't compile. Records up to INLINE_SIZE bytes
+ * don't allocate.
+ *
+ * The encoding is also the payload of binary log files: it is made of a
+ * tag byte (LogValue::Type) per argument, followed by
+ *  - STRING: 32-bit size and bytes,
+ *  - SIGNED, UNSIGNED and DOUBLE: 8 bytes,
+ *  - CHAR: 1 byte,
+ *  - FIELD: 8-bit name size and name, then the tagged value,
+ * numbers being stored in host byte order.
+ */
+class LogRecord
+{
+public:
+    static const size_t INLINE_SIZE = 192;
+
+    LogRecord() = default;
+    LogRecord(const LogRecord&) = delete;
+    /**
+     * Only the used part of the inline storage is copied
+     */
+    LogRecord& operator=(LogRecord&& other);
+
+    /**
+     * Drop previous arguments and start a new message, from LogModule::GENERAL
+     * @param[in] level level of the message
+     * @param[in] time time the message was logged at
+     */
+    void reset(LogLevel level, std::time_t time);
+
+    /**
+     * Replace the record with an already encoded one
+     * @param[in] level level of the message
+     * @param[in] time time the message was logged at
+     * @param[in] data encoded arguments
+     * @param[in] size size of the encoded arguments
+     */
+    void assign(LogLevel level, std::time_t time, const char* data, size_t size);
+
+    void setModule(LogModule module);
+
+    LogModule getModule() const;
+    LogLevel getLevel() const;
+    std::time_t getTime() const;
+
+    /**
+     * Get encoded arguments
+     * @return pointer to the first byte of the encoded arguments
+     */
+    const char* getData() const;
+
+    /**
+     * Get size of encoded arguments
+     * @return size of the encoded arguments, in bytes
+     */
+    size_t getSize() const;
+
+    void add(std::string_view value);
+    void add(const char* value);
+    void add(char value);
+    void add(bool value);
+    void add(double value);
+
+    template<typename T>
+    typename std::enable_if<std::is_integral<T>::value && std::is_signed<T>::value>::type add(T value)
+    {
+        addSigned(value);
+    }
+
+    template<typename T>
+    typename std::enable_if<std::is_integral<T>::value && std::is_unsigned<T>::value>::type add(T value)
+    {
+        addUnsigned(value);
+    }
+
+    template<typename T>
+    void add(const LogField<T>& field)
+    {
+        addFieldName(field._name);
+        add(field._value);
+    }
+
+    /**
+     * Decode arguments one at a time
+     *
+     * Values of fields are passed with their name set, FIELD markers aren't
+     * passed on.
+     * @param[in] visitor called with each argument, in order
+     * @return true upon success, false if the encoding is invalid
+     */
+    bool forEachValue(const std::function<void(const LogValue&)>& visitor) const;
+
+    /**
+     * Append the formatted arguments to a string, fields as name=value
+     * separated from the previous argument by a space
+     * @param[in,out] text string the arguments are appended to
+     */
+    void format(std::string& text) const;
+
+    /**
+     * Append a value as text
+     * @param[in] value value to be formatted
+     * @param[in,out] text string the value is appended to
+     */
+    static void formatValue(const LogValue& value, std::string& text);
+
+private:
+    typedef LogValue::Type Tag;
+
+    void addFieldName(const char* name);
+    void addSigned(std::int64_t value);
+    void addUnsigned(std::uint64_t value);
+    void addString(const char* data, size_t size);
+    void append(const void* data, size_t size);
+
+    LogModule _module = LogModule::GENERAL;
+    LogLevel _level = LogLevel::DEBUG;
+    std::time_t _time = 0;
+    size_t _size = 0;
+    /**
+     * Set when arguments didn't fit in _inline and were moved to _overflow
+     */
+    bool _spilled = false;
+    char _inline[INLINE_SIZE];
+    std::string _overflow;
+};
+
+}
@@ -0,0 +1,285 @@
+/*
+ * Copyright (c) 2015, Romain Létendart
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "logsink.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+namespace geecxx
+{
+
+const char LogSink::BINARY_HEADER[8] = {'G', 'X', 'L', 'O', 'G', '\0', '\0', '\2'};
+
+LogSink::LogSink(LogFormat format, std::ostream& output)
+    : _format(format), _output(&output)
+{
+}
+
+LogSink::LogSink(LogFormat format, std::string filePath, std::uint64_t maxFileSize, size_t maxFileCount)
+    : _format(format), _output(nullptr), _filePath(std::move(filePath)),
+      _maxFileSize(maxFileSize), _maxFileCount(maxFileCount)
+{
+}
+
+bool LogSink::open()
+{
+    if (_filePath.empty()) {
+        return true;
+    }
+
+    _file.open(_filePath, std::ios::out | std::ios::app | std::ios::binary);
+    if (!_file) {
+        return false;
+    }
+    _fileSize = _file.tellp();
+    // New files get their own binary header
+    _headerWritten = 0 != _fileSize;
+    _output = &_file;
+    return true;
+}
+
+void LogSink::write(const LogRecord& record)
+{
+    switch (_format) {
+    case LogFormat::TEXT:
+        formatText(record);
+        break;
+    case LogFormat::JSON:
+        formatJson(record);
+        break;
+    case LogFormat::BINARY:
+        formatBinary(record);
+        break;
+    }
+}
+
+void LogSink::flush()
+{
+    if (_buffer.empty() || nullptr == _output) {
+        return;
+    }
+
+    if (!_filePath.empty() && 0 != _fileSize && _fileSize + _buffer.size() > _maxFileSize) {
+        if (!rotate()) {
+            // Nowhere left to write, the logger can't be used from here
+            std::cerr << "Couldn't rotate log file " << _filePath << std::endl;
+            _buffer.clear();
+            return;
+        }
+    }
+    if (LogFormat::BINARY == _format && !_headerWritten) {
+        _output->write(BINARY_HEADER, sizeof(BINARY_HEADER));
+        _fileSize += sizeof(BINARY_HEADER);
+        _headerWritten = true;
+    }
+    _output->write(_buffer.data(), _buffer.size());
+    _output->flush();
+    _fileSize += _buffer.size();
+    _buffer.clear();
+}
+
+LogFormat LogSink::getFormat() const
+{
+    return _format;
+}
+
+const char* LogSink::logLevelToStr(LogLevel logLevel)
+{
+    switch (logLevel) {
+    case LogLevel::DEBUG:
+        return "DEBUG";
+    case LogLevel::INFO:
+        return "INFO";
+    case LogLevel::WARNING:
+        return "WARNING";
+    case LogLevel::ERROR:
+        return "ERROR";
+    default:
+        return "UNKNOWN";
+    }
+
+    return "";
+}
+
+const char* LogSink::logModuleToStr(LogModule logModule)
+{
+    switch (logModule) {
+    case LogModule::GENERAL:
+        return "general";
+    case LogModule::CONNECTION:
+        return "connection";
+    case LogModule::BOT:
+        return "bot";
+    case LogModule::FETCH:
+        return "fetch";
+    case LogModule::HISTORY:
+        return "history";
+    case LogModule::HTML:
+        return "html";
+    default:
+        return "unknown";
+    }
+
+    return "";
+}
+
+void LogSink::formatText(const LogRecord& record)
+{
+    _text.clear();
+    record.format(_text);
+
+    const char* const time = formatTime(record.getTime());
+    const char* const level = logLevelToStr(record.getLevel());
+    size_t chunkBegin = 0;
+    while (chunkBegin < _text.size()) {
+        size_t chunkEnd = _text.find('\n', chunkBegin);
+        if (std::string::npos == chunkEnd) {
+            chunkEnd = _text.size();
+        }
+        _buffer.append("[").append(time).append("][").append(level).append("]: ");
+        _buffer.append(_text, chunkBegin, chunkEnd - chunkBegin).append("\n");
+        chunkBegin = chunkEnd + 1;
+    }
+}
+
+void LogSink::formatJson(const LogRecord& record)
+{
+    // Fields go after the message, which is only known at the end
+    std::string& fields = _text;
+    fields.clear();
+    _buffer.append("{\"time\":").append(std::to_string(static_cast<long long>(record.getTime())));
+    _buffer.append(",\"level\":\"").append(logLevelToStr(record.getLevel()));
+    _buffer.append("\",\"module\":\"").append(logModuleToStr(record.getModule())).append("\",\"message\":\"");
+    record.forEachValue([this, &fields](const LogValue& value) {
+        std::string& json = value._name.empty() ? _buffer : fields;
+        if (!value._name.empty()) {
+            fields.append(",\"");
+            appendJsonString(value._name.data(), value._name.size(), fields);
+            fields.append("\":");
+        }
+
+        const bool quoted = !value._name.empty()
+                            && (LogValue::Type::STRING == value._type || LogValue::Type::CHAR == value._type);
+        if (quoted) {
+            json.push_back('"');
+        }
+        if (LogValue::Type::STRING == value._type || LogValue::Type::CHAR == value._type) {
+            appendJsonString(value._data, value._size, json);
+        } else if (LogValue::Type::DOUBLE == value._type && !value._name.empty()
+                   && !std::isfinite(value._double)) {
+            // Not representable as a JSON number
+            json.append("null");
+        } else {
+            LogRecord::formatValue(value, json);
+        }
+        if (quoted) {
+            json.push_back('"');
+        }
+    });
+    _buffer.append("\"").append(fields).append("}\n");
+}
+
+void LogSink::formatBinary(const LogRecord& record)
+{
+    const std::uint32_t size = static_cast<std::uint32_t>(record.getSize());
+    const std::uint8_t level = static_cast<std::uint8_t>(record.getLevel());
+    const std::uint8_t module = static_cast<std::uint8_t>(record.getModule());
+    const std::int64_t time = record.getTime();
+    _buffer.append(reinterpret_cast<const char*>(&size), sizeof(size));
+    _buffer.append(reinterpret_cast<const char*>(&level), sizeof(level));
+    _buffer.append(reinterpret_cast<const char*>(&module), sizeof(module));
+    _buffer.append(reinterpret_cast<const char*>(&time), sizeof(time));
+    _buffer.append(record.getData(), record.getSize());
+}
+
+void LogSink::appendJsonString(const char* data, size_t size, std::string& json)
+{
+    for (size_t i = 0; i < size; ++i) {
+        const char c = data[i];
+        switch (c) {
+        case '"':
+            json.append("\\\"");
+            break;
+        case '\\':
+            json.append("\\\\");
+            break;
+        case '\n':
+            json.append("\\n");
+            break;
+        case '\r':
+            json.append("\\r");
+            break;
+        case '\t':
+            json.append("\\t");
+            break;
+        default:
+            if (static_cast<unsigned char>(c) < 0x20) {
+                char escaped[8];
+                std::snprintf(escaped, sizeof(escaped), "\\u%04x", static_cast<unsigned int>(c));
+                json.append(escaped);
+            } else {
+                json.push_back(c);
+            }
+        }
+    }
+}
+
+bool LogSink::rotate()
+{
+    _file.close();
+    if (0 == _maxFileCount) {
+        std::remove(_filePath.c_str());
+    } else {
+        // Failures are expected for files that don't exist yet
+        for (size_t i = _maxFileCount - 1; i > 0; --i) {
+            std::rename((_filePath + "." + std::to_string(i)).c_str(),
+                        (_filePath + "." + std::to_string(i + 1)).c_str());
+        }
+        std::rename(_filePath.c_str(), (_filePath + ".1").c_str());
+    }
+
+    _file.open(_filePath, std::ios::out | std::ios::trunc | std::ios::binary);
+    _fileSize = 0;
+    _headerWritten = false;
+    return _file.good();
+}
+
+const char* LogSink::formatTime(std::time_t time)
+{
+    if (time != _formattedTime) {
+        std::tm localTime;
+        if (nullptr == localtime_r(&time, &localTime)
+            || 0 == std::strftime(_formattedTimeText, sizeof(_formattedTimeText), "%F %T", &localTime)) {
+            // Be sure to display an empty string instead of undefined content
+            _formattedTimeText[0] = '\0';
+        }
+        _formattedTime = time;
+    }
+    return _formattedTimeText;
+}
+
+}
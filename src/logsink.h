@@ -0,0 +1,171 @@
+/*
+ * Copyright (c) 2015, Romain Létendart
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#pragma once
+
+#include <cstdint>
+#include <ctime>
+#include <fstream>
+#include <ostream>
+#include <string>
+
+#include "logrecord.h"
+
+namespace geecxx
+{
+
+enum class LogFormat : std::uint8_t
+{
+    /**
+     * [YYYY-MM-DD HH:MM:SS][LEVEL]: message, one line per line of message
+     */
+    TEXT,
+    /**
+     * One JSON object per message: time (seconds since the epoch), level,
+     * module, message (concatenation of plain arguments) and one member per
+     * field
+     */
+    JSON,
+    /**
+     * BINARY_HEADER, then per message: 32-bit payload size, 8-bit level,
+     * 8-bit module (since version 2), 64-bit time and the LogRecord payload,
+     * in host byte order
+     */
+    BINARY
+};
+
+/**
+ * The LogSink class writes log records in a given format, either to a
+ * stream or to a file rotated once it reaches a given size.
+ *
+ * Records are formatted into a buffer by write() and only reach the output
+ * on flush(), which is also where files get rotated: sinks are meant to be
+ * used by the logger's writer thread only.
+ */
+class LogSink
+{
+public:
+    /**
+     * Magic string and version at the beginning of binary logs
+     */
+    static const char BINARY_HEADER[8];
+
+    /**
+     * Constructor, for a sink writing to a stream
+     * @param[in] format format of the records
+     * @param[in] output stream to write to, must outlive the sink
+     */
+    LogSink(LogFormat format, std::ostream& output);
+
+    /**
+     * Constructor, for a sink writing to rotated files
+     *
+     * Once filePath reaches maxFileSize, it is renamed filePath.1 (and
+     * filePath.1 filePath.2, etc., up to maxFileCount) and a new one is
+     * started.
+     * @param[in] format format of the records
+     * @param[in] filePath path to the current log file
+     * @param[in] maxFileSize size in bytes after which the file is rotated
+     * @param[in] maxFileCount number of rotated files to keep
+     */
+    LogSink(LogFormat format, std::string filePath, std::uint64_t maxFileSize, size_t maxFileCount);
+
+    LogSink(const LogSink&) = delete;
+    LogSink& operator=(const LogSink&) = delete;
+
+    /**
+     * Open the log file, if any
+     * @return true upon success, false otherwise
+     */
+    bool open();
+
+    /**
+     * Format a record
+     * @param[in] record record to be written
+     */
+    void write(const LogRecord& record);
+
+    /**
+     * Write formatted records, rotating the file beforehand if needed
+     */
+    void flush();
+
+    LogFormat getFormat() const;
+
+    /**
+     * Get name of a level, as written in logs
+     * @param[in] logLevel level
+     * @return name of the level
+     */
+    static const char* logLevelToStr(LogLevel logLevel);
+
+    /**
+     * Get name of a module, as written in logs and log level specifications
+     * @param[in] logModule module
+     * @return name of the module
+     */
+    static const char* logModuleToStr(LogModule logModule);
+
+    /**
+     * Append text to a JSON string, escaping what needs to be
+     * @param[in] data text to be appended
+     * @param[in] size size of the text
+     * @param[in,out] json JSON text, without the quotes around the string
+     */
+    static void appendJsonString(const char* data, size_t size, std::string& json);
+
+private:
+    void formatText(const LogRecord& record);
+    void formatJson(const LogRecord& record);
+    void formatBinary(const LogRecord& record);
+    bool rotate();
+
+    /**
+     * Get text of a time
+     * @param[in] time time to be formatted
+     * @return formatted time, valid until the next call
+     */
+    const char* formatTime(std::time_t time);
+
+    const LogFormat _format;
+    std::ostream* _output;
+
+    const std::string _filePath;
+    const std::uint64_t _maxFileSize = 0;
+    const size_t _maxFileCount = 0;
+    std::ofstream _file;
+    std::uint64_t _fileSize = 0;
+
+    /**
+     * Set once the binary header has been written to the stream
+     */
+    bool _headerWritten = false;
+
+    std::string _buffer;
+    std::string _text;
+    std::time_t _formattedTime = -1;
+    char _formattedTimeText[20];
+};
+
+}
@@ -31,6 +31,7 @@
 #include "bot.h"
 #include "configurationprovider.h"
 #include "logger.h"
+#include "trace.h"
 
 int main(int argc, char *argv[])
 {
@@ -48,6 +49,28 @@ int main(int argc, char *argv[])
         return 0;
     }
 
+    if (!configurationProvider->getLogLevels().empty()
+        && !geecxx::Logger::setThresholds(configurationProvider->getLogLevels())) {
+        return -1;
+    }
+    geecxx::Logger::getInstance().setOverflowPolicy(configurationProvider->getLogOverflowPolicy());
+    if (!configurationProvider->getLogFilePath().empty()) {
+        std::shared_ptr<geecxx::LogSink> logSink = std::make_shared<geecxx::LogSink>(
+                configurationProvider->getLogFileFormat(), configurationProvider->getLogFilePath(),
+                configurationProvider->getLogFileMaxSize(), configurationProvider->getLogFileMaxCount());
+        if (!logSink->open()) {
+            std::cerr << "Couldn't open log file " << configurationProvider->getLogFilePath() << std::endl;
+            return -1;
+        }
+        geecxx::Logger::getInstance().addSink(logSink);
+    }
+    geecxx::Tracer& tracer = geecxx::Tracer::getInstance();
+    tracer.setThreshold(std::uint64_t(configurationProvider->getTraceThresholdMs()) * 1000);
+    tracer.setSampleRate(configurationProvider->getTraceSampleRate());
+    if (!configurationProvider->getTraceFilePath().empty()
+        && !tracer.openTraceFile(configurationProvider->getTraceFilePath())) {
+        return -1;
+    }
     if (!bot.init(std::move(configurationProvider))) {
         return -1;
     }
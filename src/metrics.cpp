@@ -0,0 +1,282 @@
+/*
+ * Copyright (c) 2015, Romain Létendart
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "metrics.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <limits>
+
+#include "logger.h"
+
+namespace geecxx
+{
+
+namespace
+{
+
+const char* metricTypeToStr(MetricType type)
+{
+    switch (type) {
+    case MetricType::COUNTER:
+        return "counter";
+    case MetricType::GAUGE:
+        return "gauge";
+    case MetricType::HISTOGRAM:
+        return "histogram";
+    default:
+        return "untyped";
+    }
+
+    return "";
+}
+
+void appendDouble(double value, std::string& output)
+{
+    if (std::isnan(value)) {
+        output.append("NaN");
+    } else if (std::isinf(value)) {
+        output.append(value > 0 ? "+Inf" : "-Inf");
+    } else {
+        char buffer[32];
+        std::snprintf(buffer, sizeof(buffer), "%.15g", value);
+        output.append(buffer);
+    }
+}
+
+void appendHelp(const std::string& help, std::string& output)
+{
+    // Backslashes and line feeds are the only characters to escape
+    for (const char c : help) {
+        if ('\\' == c) {
+            output.append("\\\\");
+        } else if ('\n' == c) {
+            output.append("\\n");
+        } else {
+            output.push_back(c);
+        }
+    }
+}
+
+}
+
+Histogram::Histogram()
+    : _buckets(new std::atomic<std::uint64_t>[BUCKET_COUNT])
+{
+    for (size_t i = 0; i < BUCKET_COUNT; ++i) {
+        _buckets[i].store(0, std::memory_order_relaxed);
+    }
+}
+
+std::uint64_t Histogram::getCount() const
+{
+    std::uint64_t count = 0;
+    for (size_t i = 0; i < BUCKET_COUNT; ++i) {
+        count += _buckets[i].load(std::memory_order_relaxed);
+    }
+    return count;
+}
+
+std::uint64_t Histogram::getSum() const
+{
+    return _sum.load(std::memory_order_relaxed);
+}
+
+std::uint64_t Histogram::getCountUpTo(unsigned int exponent) const
+{
+    const size_t lastBucket = exponent >= 64 ? BUCKET_COUNT - 1 : getBucket(std::uint64_t(1) << exponent);
+    std::uint64_t count = 0;
+    for (size_t i = 0; i <= lastBucket; ++i) {
+        count += _buckets[i].load(std::memory_order_relaxed);
+    }
+    return count;
+}
+
+std::uint64_t Histogram::getValueAtQuantile(double quantile) const
+{
+    std::uint64_t counts[BUCKET_COUNT];
+    std::uint64_t count = 0;
+    for (size_t i = 0; i < BUCKET_COUNT; ++i) {
+        counts[i] = _buckets[i].load(std::memory_order_relaxed);
+        count += counts[i];
+    }
+    if (0 == count) {
+        return 0;
+    }
+
+    quantile = std::min(std::max(quantile, 0.0), 1.0);
+    const std::uint64_t rank = std::max<std::uint64_t>(1, static_cast<std::uint64_t>(std::ceil(quantile * count)));
+    std::uint64_t seenCount = 0;
+    for (size_t i = 0; i < BUCKET_COUNT; ++i) {
+        seenCount += counts[i];
+        if (seenCount >= rank) {
+            return getBucketUpperBound(i);
+        }
+    }
+    return std::numeric_limits<std::uint64_t>::max();
+}
+
+std::uint64_t Histogram::getBucketUpperBound(size_t bucket)
+{
+    // Bounds of the shifted values first, see getBucket()
+    std::uint64_t upperBound;
+    if (bucket < SUB_BUCKET_COUNT) {
+        upperBound = bucket;
+    } else {
+        const unsigned int shift = static_cast<unsigned int>(bucket / SUB_BUCKET_COUNT) - 1;
+        const std::uint64_t lowerBound = (SUB_BUCKET_COUNT + bucket % SUB_BUCKET_COUNT) << shift;
+        upperBound = lowerBound + ((std::uint64_t(1) << shift) - 1);
+    }
+    return std::numeric_limits<std::uint64_t>::max() == upperBound ? upperBound : upperBound + 1;
+}
+
+MetricsRegistry& MetricsRegistry::getInstance()
+{
+    // Static variable initialization ensures threadsafety in C++11 standard
+    static MetricsRegistry metricsRegistry;
+    return metricsRegistry;
+}
+
+Counter& MetricsRegistry::getCounter(const std::string& name, const std::string& help)
+{
+    return *findOrCreate(name, help, MetricType::COUNTER)._counter;
+}
+
+Gauge& MetricsRegistry::getGauge(const std::string& name, const std::string& help)
+{
+    return *findOrCreate(name, help, MetricType::GAUGE)._gauge;
+}
+
+Histogram& MetricsRegistry::getHistogram(const std::string& name, const std::string& help)
+{
+    return *findOrCreate(name, help, MetricType::HISTOGRAM)._histogram;
+}
+
+bool MetricsRegistry::setCallback(const std::string& name, const std::string& help, MetricType type,
+                                  std::function<double()> callback)
+{
+    if (MetricType::HISTOGRAM == type || !callback) {
+        LOG_ERROR("Invalid callback for metric ", name);
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto it = _metrics.find(name);
+    if (_metrics.end() != it && !it->second._callback) {
+        LOG_ERROR("Metric ", name, " is already updated directly");
+        return false;
+    }
+
+    Metric& metric = _metrics[name];
+    metric._type = type;
+    metric._help = help;
+    metric._callback = std::move(callback);
+    return true;
+}
+
+void MetricsRegistry::removeCallback(const std::string& name)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto it = _metrics.find(name);
+    if (_metrics.end() != it && it->second._callback) {
+        _metrics.erase(it);
+    }
+}
+
+void MetricsRegistry::write(std::string& output) const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    for (const auto& namedMetric : _metrics) {
+        const std::string& name = namedMetric.first;
+        const Metric& metric = namedMetric.second;
+        output.append("# HELP ").append(name).push_back(' ');
+        appendHelp(metric._help, output);
+        output.append("\n# TYPE ").append(name).push_back(' ');
+        output.append(metricTypeToStr(metric._type)).push_back('\n');
+
+        if (metric._callback) {
+            output.append(name).push_back(' ');
+            appendDouble(metric._callback(), output);
+        } else if (metric._counter) {
+            output.append(name).push_back(' ');
+            output.append(std::to_string(metric._counter->getValue()));
+        } else if (metric._gauge) {
+            output.append(name).push_back(' ');
+            output.append(std::to_string(metric._gauge->getValue()));
+        } else if (metric._histogram) {
+            // Buckets are read one after the other while values may still be
+            // recorded: the total count is the last bucket, so that it is
+            // never lower than any of them
+            std::uint64_t count = 0;
+            for (unsigned int exponent = 0; exponent < EXPOSED_BUCKET_COUNT; ++exponent) {
+                count = std::max(count, metric._histogram->getCountUpTo(exponent));
+                output.append(name).append("_bucket{le=\"");
+                output.append(std::to_string(std::uint64_t(1) << exponent)).append("\"} ");
+                output.append(std::to_string(count)).push_back('\n');
+            }
+            count = std::max(count, metric._histogram->getCount());
+            output.append(name).append("_bucket{le=\"+Inf\"} ").append(std::to_string(count)).push_back('\n');
+            output.append(name).append("_sum ").append(std::to_string(metric._histogram->getSum())).push_back('\n');
+            output.append(name).append("_count ").append(std::to_string(count));
+        }
+        output.push_back('\n');
+    }
+}
+
+const MetricsRegistry::Metric& MetricsRegistry::findOrCreate(const std::string& name, const std::string& help,
+                                                             MetricType type)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto it = _metrics.find(name);
+    Metric* metric;
+    if (_metrics.end() == it) {
+        metric = &_metrics[name];
+        metric->_help = help;
+    } else if (type == it->second._type && !it->second._callback) {
+        return it->second;
+    } else {
+        LOG_ERROR("Metric ", name, " is already registered with another type");
+        _unexposedMetrics.emplace_back();
+        metric = &_unexposedMetrics.back();
+    }
+
+    // Created once and for all, write() may read them as soon as the lock
+    // is released
+    metric->_type = type;
+    switch (type) {
+    case MetricType::COUNTER:
+        metric->_counter.reset(new Counter());
+        break;
+    case MetricType::GAUGE:
+        metric->_gauge.reset(new Gauge());
+        break;
+    case MetricType::HISTOGRAM:
+        metric->_histogram.reset(new Histogram());
+        break;
+    }
+    return *metric;
+}
+
+}
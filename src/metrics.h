@@ -0,0 +1,293 @@
+/*
+ * Copyright (c) 2015, Romain Létendart
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace geecxx
+{
+
+/**
+ * Monotonic count of events, e.g. lines received
+ *
+ * Updates are a single relaxed atomic operation.
+ */
+class Counter
+{
+public:
+    void increment(std::uint64_t count = 1)
+    {
+        _value.fetch_add(count, std::memory_order_relaxed);
+    }
+
+    std::uint64_t getValue() const
+    {
+        return _value.load(std::memory_order_relaxed);
+    }
+
+private:
+    std::atomic<std::uint64_t> _value{0};
+};
+
+/**
+ * Value that goes up and down, e.g. a queue depth
+ */
+class Gauge
+{
+public:
+    void set(std::int64_t value)
+    {
+        _value.store(value, std::memory_order_relaxed);
+    }
+
+    void add(std::int64_t delta)
+    {
+        _value.fetch_add(delta, std::memory_order_relaxed);
+    }
+
+    std::int64_t getValue() const
+    {
+        return _value.load(std::memory_order_relaxed);
+    }
+
+private:
+    std::atomic<std::int64_t> _value{0};
+};
+
+/**
+ * Distribution of values, e.g. latencies in microseconds
+ *
+ * Like an HDR histogram, each power of two is split in SUB_BUCKET_COUNT
+ * buckets of equal width, so that any value is known within 1/16th (6.25%)
+ * of its magnitude while covering the whole 64-bit range with a fixed set of
+ * counters. Values are shifted by one before being bucketed, so that each
+ * power of two is the upper bound of a bucket: values up to 2^n are counted
+ * exactly, which is what the Prometheus "le" buckets need.
+ *
+ * Recording a value is two relaxed atomic additions.
+ */
+class Histogram
+{
+public:
+    static const unsigned int SUB_BUCKET_BITS = 4;
+    static const size_t SUB_BUCKET_COUNT = 1 << SUB_BUCKET_BITS;
+    static const size_t BUCKET_COUNT = (64 - SUB_BUCKET_BITS + 1) * SUB_BUCKET_COUNT;
+
+    Histogram();
+
+    Histogram(const Histogram&) = delete;
+    Histogram& operator=(const Histogram&) = delete;
+
+    void record(std::uint64_t value)
+    {
+        _buckets[getBucket(value)].fetch_add(1, std::memory_order_relaxed);
+        _sum.fetch_add(value, std::memory_order_relaxed);
+    }
+
+    /**
+     * Get number of recorded values
+     * @return number of recorded values
+     */
+    std::uint64_t getCount() const;
+
+    /**
+     * Get sum of recorded values
+     * @return sum of recorded values, modulo 2^64
+     */
+    std::uint64_t getSum() const;
+
+    /**
+     * Get number of recorded values lower than or equal to a power of two
+     * @param[in] exponent n, for values up to 2^n
+     * @return number of recorded values up to 2^exponent
+     */
+    std::uint64_t getCountUpTo(unsigned int exponent) const;
+
+    /**
+     * Get the value below which a given fraction of the values fall
+     * @param[in] quantile fraction of the values, between 0 and 1
+     * @return upper bound of the bucket holding the quantile, 0 if no value
+     *         has been recorded
+     */
+    std::uint64_t getValueAtQuantile(double quantile) const;
+
+private:
+    static size_t getBucket(std::uint64_t value)
+    {
+        const std::uint64_t shiftedValue = 0 == value ? 0 : value - 1;
+        if (shiftedValue < SUB_BUCKET_COUNT) {
+            return static_cast<size_t>(shiftedValue);
+        }
+        const unsigned int magnitude = 63 - __builtin_clzll(shiftedValue);
+        const unsigned int shift = magnitude - SUB_BUCKET_BITS;
+        return (magnitude - SUB_BUCKET_BITS + 1) * SUB_BUCKET_COUNT
+               + static_cast<size_t>((shiftedValue >> shift) - SUB_BUCKET_COUNT);
+    }
+
+    /**
+     * Get the highest value counted in a bucket
+     * @param[in] bucket index of the bucket
+     * @return upper bound of the bucket
+     */
+    static std::uint64_t getBucketUpperBound(size_t bucket);
+
+    std::unique_ptr<std::atomic<std::uint64_t>[]> _buckets;
+    std::atomic<std::uint64_t> _sum{0};
+};
+
+enum class MetricType : std::uint8_t
+{
+    COUNTER,
+    GAUGE,
+    HISTOGRAM
+};
+
+/**
+ * The MetricsRegistry class names metrics and writes them in the Prometheus
+ * text exposition format.
+ *
+ * Metrics are created on first use and live as long as the registry, so
+ * that modules can keep references to them and update them without any
+ * lookup. Values owned by other objects (e.g. statistics structures) are
+ * exposed through callbacks evaluated when metrics are written.
+ *
+ * Registration and writing take a lock, updating a metric doesn't.
+ */
+class MetricsRegistry
+{
+public:
+    MetricsRegistry() = default;
+
+    MetricsRegistry(const MetricsRegistry&) = delete;
+    MetricsRegistry& operator=(const MetricsRegistry&) = delete;
+
+    /**
+     * Get the registry metrics of the bot are registered in
+     * @return singleton instance
+     */
+    static MetricsRegistry& getInstance();
+
+    /**
+     * Get a counter, creating it if needed
+     *
+     * Names are expected to follow Prometheus conventions, e.g.
+     * geecxx_connection_received_lines_total. A name already used by a
+     * metric of another type gets an unexposed metric and an error is logged.
+     * @param[in] name name of the counter
+     * @param[in] help description of the counter
+     * @return counter
+     */
+    Counter& getCounter(const std::string& name, const std::string& help);
+
+    /**
+     * Get a gauge, creating it if needed (see getCounter())
+     * @param[in] name name of the gauge
+     * @param[in] help description of the gauge
+     * @return gauge
+     */
+    Gauge& getGauge(const std::string& name, const std::string& help);
+
+    /**
+     * Get a histogram, creating it if needed (see getCounter())
+     * @param[in] name name of the histogram, with its unit, e.g.
+     *            geecxx_fetch_duration_microseconds
+     * @param[in] help description of the histogram
+     * @return histogram
+     */
+    Histogram& getHistogram(const std::string& name, const std::string& help);
+
+    /**
+     * Expose a counter or a gauge whose value is read from a callback
+     *
+     * Replaces any previous callback of the same name.
+     * @param[in] name name of the metric
+     * @param[in] help description of the metric
+     * @param[in] type COUNTER or GAUGE
+     * @param[in] callback returns the current value, called from write()
+     * @return true upon success, false if the name is already used by a
+     *         metric updated directly
+     */
+    bool setCallback(const std::string& name, const std::string& help, MetricType type,
+                     std::function<double()> callback);
+
+    /**
+     * Stop exposing a metric set with setCallback()
+     * @param[in] name name of the metric
+     */
+    void removeCallback(const std::string& name);
+
+    /**
+     * Write every metric in the Prometheus text exposition format (0.0.4)
+     *
+     * Histograms are written with one bucket per power of two up to
+     * 2^(EXPOSED_BUCKET_COUNT - 1).
+     * @param[out] output text the metrics are appended to
+     */
+    void write(std::string& output) const;
+
+    static const unsigned int EXPOSED_BUCKET_COUNT = 27;
+
+private:
+    struct Metric
+    {
+        MetricType _type;
+        std::string _help;
+        std::unique_ptr<Counter> _counter;
+        std::unique_ptr<Gauge> _gauge;
+        std::unique_ptr<Histogram> _histogram;
+        std::function<double()> _callback;
+    };
+
+    /**
+     * Find a metric of a given type, creating it if needed
+     * @param[in] name name of the metric
+     * @param[in] help description of the metric
+     * @param[in] type type of the metric
+     * @return metric, an unexposed one if the name is used by another type
+     */
+    const Metric& findOrCreate(const std::string& name, const std::string& help, MetricType type);
+
+    mutable std::mutex _mutex;
+
+    /**
+     * Sorted by name, so that the output is stable
+     */
+    std::map<std::string, Metric> _metrics;
+
+    /**
+     * Metrics handed out on name conflicts, updated but never written
+     */
+    std::deque<Metric> _unexposedMetrics;
+};
+
+}
@@ -0,0 +1,163 @@
+/*
+ * Copyright (c) 2015, Romain Létendart
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "metricsserver.h"
+
+#include <istream>
+#include <memory>
+#include <string>
+
+#include "logger.h"
+
+namespace geecxx
+{
+
+/**
+ * One request and its response, kept alive by the pending handlers
+ */
+class MetricsServer::Session : public std::enable_shared_from_this<MetricsServer::Session>
+{
+public:
+    Session(boost::asio::ip::tcp::socket socket, const MetricsRegistry& registry)
+        : _socket(std::move(socket)), _request(MAX_REQUEST_SIZE), _registry(registry)
+    {
+    }
+
+    void start()
+    {
+        std::shared_ptr<Session> self = shared_from_this();
+        boost::asio::async_read_until(_socket, _request, "\r\n\r\n",
+            [self](const boost::system::error_code& error, std::size_t) {
+                if (error) {
+                    // Closed early or request too large, nobody to answer to
+                    LOG_DEBUG("Dropping metrics request: ", error.message());
+                    return;
+                }
+                self->respond();
+            });
+    }
+
+private:
+    void respond()
+    {
+        std::istream requestStream(&_request);
+        std::string method;
+        std::string target;
+        requestStream >> method >> target;
+
+        std::string body;
+        const char* status = "200 OK";
+        if ("GET" != method) {
+            status = "405 Method Not Allowed";
+        } else if ("/metrics" != target && "/" != target) {
+            status = "404 Not Found";
+        } else {
+            _registry.write(body);
+        }
+
+        _response.append("HTTP/1.0 ").append(status).append("\r\n");
+        _response.append("Content-Type: text/plain; version=0.0.4\r\n");
+        _response.append("Content-Length: ").append(std::to_string(body.size())).append("\r\n");
+        _response.append("Connection: close\r\n\r\n").append(body);
+
+        std::shared_ptr<Session> self = shared_from_this();
+        boost::asio::async_write(_socket, boost::asio::buffer(_response),
+            [self](const boost::system::error_code&, std::size_t) {
+                boost::system::error_code ignoredError;
+                self->_socket.shutdown(boost::asio::socket_base::shutdown_both, ignoredError);
+                self->_socket.close(ignoredError);
+            });
+    }
+
+    boost::asio::ip::tcp::socket _socket;
+    boost::asio::streambuf _request;
+    std::string _response;
+    const MetricsRegistry& _registry;
+};
+
+MetricsServer::MetricsServer(boost::asio::io_service& ioService, MetricsRegistry& registry)
+    : _acceptor(ioService), _socket(ioService), _registry(registry)
+{
+}
+
+MetricsServer::~MetricsServer()
+{
+    close();
+}
+
+bool MetricsServer::open(std::uint16_t port)
+{
+    const boost::asio::ip::tcp::endpoint endpoint(boost::asio::ip::address_v4::loopback(), port);
+    boost::system::error_code error;
+    _acceptor.open(endpoint.protocol(), error);
+    if (!error) {
+        _acceptor.set_option(boost::asio::ip::tcp::acceptor::reuse_address(true), error);
+    }
+    if (!error) {
+        _acceptor.bind(endpoint, error);
+    }
+    if (!error) {
+        _acceptor.listen(boost::asio::socket_base::max_connections, error);
+    }
+    if (error) {
+        LOG_ERROR("Couldn't serve metrics on 127.0.0.1:", port, ": ", error.message());
+        close();
+        return false;
+    }
+
+    LOG_INFO("Serving metrics on http://127.0.0.1:", getPort(), "/metrics");
+    asyncAccept();
+    return true;
+}
+
+void MetricsServer::close()
+{
+    boost::system::error_code ignoredError;
+    _acceptor.close(ignoredError);
+}
+
+std::uint16_t MetricsServer::getPort() const
+{
+    boost::system::error_code error;
+    const boost::asio::ip::tcp::endpoint endpoint = _acceptor.local_endpoint(error);
+    return error ? 0 : endpoint.port();
+}
+
+void MetricsServer::asyncAccept()
+{
+    _acceptor.async_accept(_socket, [this](const boost::system::error_code& error) {
+        if (boost::asio::error::operation_aborted == error) {
+            // Closed, the server may be gone already
+            return;
+        }
+        if (error) {
+            LOG_WARNING("Couldn't accept metrics request: ", error.message());
+        } else {
+            std::make_shared<Session>(std::move(_socket), _registry)->start();
+        }
+        asyncAccept();
+    });
+}
+
+}
@@ -0,0 +1,92 @@
+/*
+ * Copyright (c) 2015, Romain Létendart
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#pragma once
+
+#include <boost/asio.hpp>
+#include <cstdint>
+
+#include "metrics.h"
+
+namespace geecxx
+{
+
+/**
+ * The MetricsServer class answers HTTP requests for /metrics with the
+ * content of a metrics registry, in the Prometheus text format.
+ *
+ * It only listens on the loopback interface, and runs on the io_service it
+ * is given (the connection's), so serving metrics needs no thread of its
+ * own. Each request gets a single response, then the connection is closed.
+ */
+class MetricsServer
+{
+public:
+    /**
+     * Constructor
+     * @param[in] ioService io_service requests are served by
+     * @param[in] registry metrics to be served, must outlive the server
+     */
+    explicit MetricsServer(boost::asio::io_service& ioService,
+                           MetricsRegistry& registry = MetricsRegistry::getInstance());
+
+    MetricsServer(const MetricsServer&) = delete;
+    MetricsServer& operator=(const MetricsServer&) = delete;
+
+    ~MetricsServer();
+
+    /**
+     * Start accepting requests on 127.0.0.1
+     * @param[in] port port to listen on, 0 to let the system pick one
+     * @return true upon success, false otherwise
+     */
+    bool open(std::uint16_t port);
+
+    /**
+     * Stop accepting requests, requests being served are completed
+     */
+    void close();
+
+    /**
+     * Get the port the server listens on
+     * @return port, 0 if the server isn't open
+     */
+    std::uint16_t getPort() const;
+
+private:
+    class Session;
+
+    /**
+     * Largest request accepted, headers included
+     */
+    static const size_t MAX_REQUEST_SIZE = 8192;
+
+    void asyncAccept();
+
+    boost::asio::ip::tcp::acceptor _acceptor;
+    boost::asio::ip::tcp::socket _socket;
+    MetricsRegistry& _registry;
+};
+
+}
@@ -0,0 +1,164 @@
+/*
+ * Copyright (c) 2015, Romain Létendart
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+
+namespace geecxx
+{
+
+/**
+ * The MpscQueue class is a bounded lock-free multi-producer single-consumer
+ * queue.
+ *
+ * Each cell of the ring carries a sequence number telling whether it is
+ * ready to be written by the producer owning position N (sequence == N) or
+ * read by the consumer (sequence == N + 1). Producers claim positions with a
+ * compare-and-swap on the enqueue position, the consumer owns the dequeue
+ * position.
+ *
+ * push() may be called from any thread, pop() from a single one at a time.
+ */
+template<typename T>
+class MpscQueue
+{
+public:
+    /**
+     * Constructor
+     * @param[in] capacity maximum number of queued elements, rounded up to
+     *            a power of two
+     */
+    explicit MpscQueue(size_t capacity)
+        : _mask(roundUpToPowerOfTwo(capacity) - 1), _cells(new Cell[_mask + 1])
+    {
+        for (size_t i = 0; i <= _mask; ++i) {
+            _cells[i]._sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    MpscQueue(const MpscQueue&) = delete;
+    MpscQueue& operator=(const MpscQueue&) = delete;
+
+    /**
+     * Add an element at the end of the queue
+     * @param[in,out] value element to be added, moved from on success
+     * @return true upon success, false if the queue is full
+     */
+    bool push(T& value)
+    {
+        size_t position = _enqueuePosition.load(std::memory_order_relaxed);
+        Cell* cell;
+        while (true) {
+            cell = &_cells[position & _mask];
+            const size_t sequence = cell->_sequence.load(std::memory_order_acquire);
+            const std::ptrdiff_t difference = static_cast<std::ptrdiff_t>(sequence)
+                                              - static_cast<std::ptrdiff_t>(position);
+            if (0 == difference) {
+                if (_enqueuePosition.compare_exchange_weak(position, position + 1,
+                                                           std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (difference < 0) {
+                // The consumer hasn't released this cell yet
+                return false;
+            } else {
+                // Another producer claimed this position
+                position = _enqueuePosition.load(std::memory_order_relaxed);
+            }
+        }
+
+        cell->_value = std::move(value);
+        cell->_sequence.store(position + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * Remove the element at the beginning of the queue
+     * @param[out] value removed element
+     * @return true upon success, false if the queue is empty (or its first
+     *         element is still being written)
+     */
+    bool pop(T& value)
+    {
+        Cell& cell = _cells[_dequeuePosition & _mask];
+        if (cell._sequence.load(std::memory_order_acquire) != _dequeuePosition + 1) {
+            return false;
+        }
+
+        value = std::move(cell._value);
+        cell._sequence.store(_dequeuePosition + _mask + 1, std::memory_order_release);
+        ++_dequeuePosition;
+        return true;
+    }
+
+    /**
+     * Tell whether pop() would fail, only meant for the consumer
+     * @return true if the queue is empty, false otherwise
+     */
+    bool isEmpty() const
+    {
+        return _cells[_dequeuePosition & _mask]._sequence.load(std::memory_order_acquire)
+               != _dequeuePosition + 1;
+    }
+
+    /**
+     * Get maximum number of queued elements
+     * @return capacity of the queue
+     */
+    size_t getCapacity() const
+    {
+        return _mask + 1;
+    }
+
+private:
+    struct Cell
+    {
+        std::atomic<size_t> _sequence;
+        T _value;
+    };
+
+    static size_t roundUpToPowerOfTwo(size_t value)
+    {
+        size_t result = 2;
+        while (result < value) {
+            result <<= 1;
+        }
+        return result;
+    }
+
+    const size_t _mask;
+    const std::unique_ptr<Cell[]> _cells;
+
+    /**
+     * Both positions are kept on their own cache line, producers and the
+     * consumer would otherwise keep stealing it from each other
+     */
+    alignas(64) std::atomic<size_t> _enqueuePosition{0};
+    alignas(64) size_t _dequeuePosition = 0;
+};
+
+}
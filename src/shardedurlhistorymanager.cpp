@@ -0,0 +1,187 @@
+/*
+ * Copyright (c) 2015, Romain Létendart
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#define GEECXX_LOG_MODULE geecxx::LogModule::HISTORY
+
+#include "shardedurlhistorymanager.h"
+
+#include <algorithm>
+#include <functional>
+
+#include "logger.h"
+#include "stringutils.h"
+#include "urlrewriter.h"
+
+namespace geecxx
+{
+
+ShardedUrlHistoryManager::ShardedUrlHistoryManager(size_t maxSize, size_t shardCount, std::string historyFilePath)
+    : _maxSize(std::max<size_t>(maxSize, 1)), _historyFilePath(std::move(historyFilePath))
+{
+    size_t actualShardCount = 1;
+    while (actualShardCount < shardCount) {
+        actualShardCount <<= 1;
+    }
+    _shardMask = actualShardCount - 1;
+
+    const size_t shardMaxSize = (_maxSize + actualShardCount - 1) / actualShardCount;
+    _shards.reserve(actualShardCount);
+    for (size_t i = 0; i < actualShardCount; ++i) {
+        _shards.emplace_back(new Shard(shardMaxSize, _historyFilePath));
+        _shards.back()->_history.enableRecencyEviction();
+        _shards.back()->_history.setIdAllocator([this]() {
+            return getNextId();
+        });
+    }
+}
+
+size_t ShardedUrlHistoryManager::getMaxSize() const
+{
+    return _shards.front()->_history.getMaxSize() * _shards.size();
+}
+
+size_t ShardedUrlHistoryManager::getSize() const
+{
+    size_t size = 0;
+    for (const std::unique_ptr<Shard>& shard : _shards) {
+        std::lock_guard<std::mutex> lock(shard->_mutex);
+        size += shard->_history.getSize();
+    }
+    return size;
+}
+
+size_t ShardedUrlHistoryManager::getShardCount() const
+{
+    return _shards.size();
+}
+
+void ShardedUrlHistoryManager::setRewriter(std::shared_ptr<const UrlRewriter> rewriter)
+{
+    for (const std::unique_ptr<Shard>& shard : _shards) {
+        std::lock_guard<std::mutex> lock(shard->_mutex);
+        shard->_history.setRewriter(rewriter);
+    }
+    _rewriter = std::move(rewriter);
+}
+
+bool ShardedUrlHistoryManager::insert(const std::string& url, std::string title, std::string messageAuthor)
+{
+    Shard& shard = getShard(url);
+    std::lock_guard<std::mutex> lock(shard._mutex);
+    return shard._history.insert(url, std::move(title), std::move(messageAuthor));
+}
+
+bool ShardedUrlHistoryManager::find(const std::string& url, UrlHistoryEntry& entry)
+{
+    Shard& shard = getShard(url);
+    std::lock_guard<std::mutex> lock(shard._mutex);
+    return shard._history.find(url, entry);
+}
+
+bool ShardedUrlHistoryManager::findById(std::uint64_t id, UrlHistoryRecord& record) const
+{
+    for (const std::unique_ptr<Shard>& shard : _shards) {
+        std::lock_guard<std::mutex> lock(shard->_mutex);
+        if (shard->_history.findById(id, record)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void ShardedUrlHistoryManager::clear()
+{
+    for (const std::unique_ptr<Shard>& shard : _shards) {
+        std::lock_guard<std::mutex> lock(shard->_mutex);
+        shard->_history.clear();
+    }
+    _idCounter = 0;
+}
+
+bool ShardedUrlHistoryManager::initFromFile()
+{
+    // Records are loaded oldest first right into their shard, each shard
+    // only keeping as many of them as it can hold
+    UrlHistorySnapshot snapshot;
+    if (!UrlHistoryManager::loadSnapshotFromFile(_historyFilePath, snapshot)) {
+        return false;
+    }
+
+    std::uint64_t lastId = _idCounter;
+    for (const UrlHistoryRecord& record : snapshot) {
+        Shard& shard = getShard(record._url);
+        std::lock_guard<std::mutex> lock(shard._mutex);
+        if (!shard._history.loadRecord(record)) {
+            LOG_ERROR("Unable to insert into history URL: ", record._url);
+            return false;
+        }
+        lastId = std::max(lastId, record._entry._id);
+    }
+    // New ids follow the ones read from the file
+    _idCounter = lastId;
+
+    return true;
+}
+
+bool ShardedUrlHistoryManager::saveToFile() const
+{
+    return UrlHistoryManager::saveSnapshotToFile(*takeSnapshot(), _historyFilePath);
+}
+
+std::shared_ptr<const UrlHistorySnapshot> ShardedUrlHistoryManager::takeSnapshot() const
+{
+    std::shared_ptr<UrlHistorySnapshot> snapshot = std::make_shared<UrlHistorySnapshot>();
+    for (const std::unique_ptr<Shard>& shard : _shards) {
+        std::shared_ptr<const UrlHistorySnapshot> shardSnapshot;
+        {
+            std::lock_guard<std::mutex> lock(shard->_mutex);
+            shardSnapshot = shard->_history.takeSnapshot();
+        }
+        snapshot->insert(snapshot->end(), shardSnapshot->begin(), shardSnapshot->end());
+    }
+    // Shards keep recently used entries last, the file is in id order
+    std::sort(snapshot->begin(), snapshot->end(), [](const UrlHistoryRecord& lhs, const UrlHistoryRecord& rhs) {
+        return lhs._entry._id < rhs._entry._id;
+    });
+    return snapshot;
+}
+
+ShardedUrlHistoryManager::Shard& ShardedUrlHistoryManager::getShard(const std::string& url)
+{
+    // Similar URLs must end up in the same shard, hence the formatting
+    thread_local std::string formattedUrl;
+    thread_local std::string rewrittenUrl;
+    stringutils::canonicalizeUrl(url, formattedUrl);
+    const bool rewritten = _rewriter && _rewriter->rewrite(formattedUrl, rewrittenUrl);
+    const size_t hash = std::hash<std::string>()(rewritten ? rewrittenUrl : formattedUrl);
+    // Mix high bits in, std::hash might be the identity for small inputs
+    return *_shards[(hash ^ (hash >> 17) ^ (hash >> 31)) & _shardMask];
+}
+
+std::uint64_t ShardedUrlHistoryManager::getNextId()
+{
+    return _idCounter.fetch_add(1, std::memory_order_relaxed) + 1;
+}
+
+}
@@ -0,0 +1,197 @@
+/*
+ * Copyright (c) 2015, Romain Létendart
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "globalconfig.h"
+
+#include "urlhistorymanager.h"
+
+namespace geecxx
+{
+
+/**
+ * The ShardedUrlHistoryManager class is a thread-safe URL history meant to be
+ * shared between concurrent producers.
+ *
+ * Entries are spread over several shards according to the hash of their
+ * formatted URL, each shard being a UrlHistoryManager protected by its own
+ * mutex (lock striping). Operations on URLs from different shards therefore
+ * never contend with each other.
+ *
+ * Every shard holds an equal part of the maximum size and evicts its own
+ * least recently used entry when full, approximately: entries found since
+ * eviction last went past them are given a second chance (see
+ * UrlHistoryManager::enableRecencyEviction()). As URLs are evenly spread by
+ * the hash function, the global eviction order stays close to a least
+ * recently used one. Recency isn't saved, entries are read back in id
+ * order. Ids are allocated from a single sequence shared by all shards.
+ */
+class ShardedUrlHistoryManager
+{
+public:
+    /**
+     * Constructor
+     *
+     * @param maxSize maximum number of elements in the history
+     * @param shardCount number of shards, rounded up to a power of 2
+     * @param historyFilePath path to the file used for data persistence
+     */
+    ShardedUrlHistoryManager(size_t maxSize = 512,
+                             size_t shardCount = 16,
+                             std::string historyFilePath = GEECXX_LOCAL_DATA_DIR
+                                                           "url-history.txt");
+
+    ShardedUrlHistoryManager(const ShardedUrlHistoryManager&) = delete;
+    ShardedUrlHistoryManager& operator=(const ShardedUrlHistoryManager&) = delete;
+
+    /**
+     * Get maximum size of the history
+     *
+     * As every shard holds an equal part of it, this might be slightly
+     * greater than the maximum size given at construction.
+     * @return maximum size of the history
+     */
+    size_t getMaxSize() const;
+
+    /**
+     * Get current size of the history
+     * @return current size of the history
+     */
+    size_t getSize() const;
+
+    /**
+     * Get number of shards
+     * @return number of shards
+     */
+    size_t getShardCount() const;
+
+    /**
+     * @see UrlHistoryManager::setRewriter
+     */
+    void setRewriter(std::shared_ptr<const UrlRewriter> rewriter);
+
+    /**
+     * @see UrlHistoryManager::insert
+     */
+    bool insert(const std::string& url, std::string title, std::string messageAuthor);
+
+    /**
+     * Not const, hits mark the entry as recently used in its shard
+     * @see UrlHistoryManager::find
+     */
+    bool find(const std::string& url, UrlHistoryEntry& entry);
+
+    /**
+     * @see UrlHistoryManager::findById
+     *
+     * Ids don't tell which shard holds an entry, every shard is searched.
+     */
+    bool findById(std::uint64_t id, UrlHistoryRecord& record) const;
+
+    /**
+     * Remove every single entry of the history
+     */
+    void clear();
+
+    /**
+     * Read history data from the disk into our current history
+     *
+     * @return true upon successful reading of the file
+     */
+    bool initFromFile();
+
+    /**
+     * Save current history data into a file
+     *
+     * @return true upon successful writing of history data
+     */
+    bool saveToFile() const;
+
+    /**
+     * Copy current history data into an immutable snapshot
+     *
+     * Shards are copied one after the other, their entries are then sorted
+     * by id, i.e. from the oldest to the newest insertion.
+     * @return snapshot of the history
+     */
+    std::shared_ptr<const UrlHistorySnapshot> takeSnapshot() const;
+
+private:
+    struct Shard
+    {
+        Shard(size_t maxSize, const std::string& historyFilePath)
+            : _history(maxSize, historyFilePath)
+        {
+        }
+
+        mutable std::mutex _mutex;
+        UrlHistoryManager _history;
+    };
+
+    /**
+     * Get the shard a URL belongs to
+     * @param[in] url url (formatted or not)
+     * @return shard in charge of the given URL
+     */
+    Shard& getShard(const std::string& url);
+
+    /**
+     * Return id not yet used by any element
+     *
+     * Same sequence as UrlHistoryManager's, shared among all shards.
+     * @return id not yet used by any element
+     */
+    std::uint64_t getNextId();
+
+    const size_t _maxSize;
+    const std::string _historyFilePath;
+
+    /**
+     * Shard count minus one, used to map hashes onto shards
+     */
+    size_t _shardMask;
+
+    std::vector<std::unique_ptr<Shard>> _shards;
+
+    /**
+     * Rewriter of the shards, URLs are spread according to their rewritten
+     * form
+     */
+    std::shared_ptr<const UrlRewriter> _rewriter;
+
+    /**
+     * Number of ids allocated so far
+     */
+    std::atomic<std::uint64_t> _idCounter{0};
+};
+
+}
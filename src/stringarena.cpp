@@ -0,0 +1,164 @@
+/*
+ * Copyright (c) 2015, Romain Létendart
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "stringarena.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace geecxx
+{
+
+const size_t StringArena::SLOT_GRANULARITY;
+const size_t StringArena::SMALL_SLOT_MAX_SIZE;
+const size_t StringArena::LARGE_SLOT_MAX_SIZE;
+const size_t StringArena::SIZE_CLASS_COUNT;
+
+StringArena::StringArena(size_t slabSize)
+    : _slabSize(std::max(slabSize, LARGE_SLOT_MAX_SIZE))
+{
+    _freeLists.fill(nullptr);
+}
+
+StringArena::~StringArena()
+{
+    clear();
+}
+
+ArenaString StringArena::store(const std::string& s)
+{
+    return store(s, std::string());
+}
+
+ArenaString StringArena::store(const std::string& prefix, const std::string& suffix)
+{
+    ArenaString stored;
+    const size_t size = prefix.size() + suffix.size();
+    if (0 == size) {
+        return stored;
+    }
+
+    char* data = nullptr;
+    if (size > LARGE_SLOT_MAX_SIZE) {
+        // Too big to be worth a slot, the string gets its own allocation
+        data = new char[size];
+        _largeStrings.emplace(data, std::unique_ptr<char[]>(data));
+        _reservedBytes += size;
+        _usedBytes += size;
+    } else {
+        size_t slotSize = 0;
+        const size_t sizeClass = getSizeClass(size, slotSize);
+        if (nullptr != _freeLists[sizeClass]) {
+            // Recycle a released slot
+            data = _freeLists[sizeClass];
+            std::memcpy(&_freeLists[sizeClass], data, sizeof(char*));
+        } else {
+            data = allocateSlot(slotSize);
+        }
+        _usedBytes += slotSize;
+    }
+
+    std::memcpy(data, prefix.data(), prefix.size());
+    std::memcpy(data + prefix.size(), suffix.data(), suffix.size());
+    stored._data = data;
+    stored._size = static_cast<std::uint32_t>(size);
+    return stored;
+}
+
+void StringArena::release(const ArenaString& s)
+{
+    if (0 == s._size) {
+        return;
+    }
+
+    char* data = const_cast<char*>(s._data);
+    if (s._size > LARGE_SLOT_MAX_SIZE) {
+        _largeStrings.erase(data);
+        _reservedBytes -= s._size;
+        _usedBytes -= s._size;
+        return;
+    }
+
+    size_t slotSize = 0;
+    const size_t sizeClass = getSizeClass(s._size, slotSize);
+    std::memcpy(data, &_freeLists[sizeClass], sizeof(char*));
+    _freeLists[sizeClass] = data;
+    _usedBytes -= slotSize;
+}
+
+void StringArena::clear()
+{
+    _slabs.clear();
+    _largeStrings.clear();
+    _slabCursor = nullptr;
+    _slabRemaining = 0;
+    _freeLists.fill(nullptr);
+    _reservedBytes = 0;
+    _usedBytes = 0;
+}
+
+size_t StringArena::getReservedBytes() const
+{
+    return _reservedBytes;
+}
+
+size_t StringArena::getUsedBytes() const
+{
+    return _usedBytes;
+}
+
+size_t StringArena::getSizeClass(size_t size, size_t& slotSize)
+{
+    if (size <= SMALL_SLOT_MAX_SIZE) {
+        slotSize = (size + SLOT_GRANULARITY - 1) & ~(SLOT_GRANULARITY - 1);
+        return slotSize / SLOT_GRANULARITY - 1;
+    }
+
+    size_t sizeClass = SMALL_SLOT_MAX_SIZE / SLOT_GRANULARITY;
+    slotSize = 2 * SMALL_SLOT_MAX_SIZE;
+    while (slotSize < size) {
+        slotSize *= 2;
+        ++sizeClass;
+    }
+    return sizeClass;
+}
+
+char* StringArena::allocateSlot(size_t slotSize)
+{
+    if (_slabRemaining < slotSize) {
+        // What is left of the current slab is too small for this class, it
+        // is simply given up (at most LARGE_SLOT_MAX_SIZE per slab)
+        _slabs.emplace_back(new char[_slabSize]);
+        _slabCursor = _slabs.back().get();
+        _slabRemaining = _slabSize;
+        _reservedBytes += _slabSize;
+    }
+
+    char* slot = _slabCursor;
+    _slabCursor += slotSize;
+    _slabRemaining -= slotSize;
+    return slot;
+}
+
+}
@@ -0,0 +1,171 @@
+/*
+ * Copyright (c) 2015, Romain Létendart
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace geecxx
+{
+
+/**
+ * Reference to a string stored in a StringArena
+ *
+ * The referenced characters are not null-terminated. An empty string doesn't
+ * reference any storage at all.
+ */
+struct ArenaString
+{
+    const char* _data = nullptr;
+    std::uint32_t _size = 0;
+
+    /**
+     * Copy referenced characters into a regular string
+     * @return copy of the referenced string
+     */
+    std::string str() const
+    {
+        return std::string(_data, _size);
+    }
+};
+
+/**
+ * The StringArena class stores many small strings in large slabs of memory
+ * instead of allocating each of them separately.
+ *
+ * Strings are rounded up to a size class. Released strings are kept in a
+ * free list per size class so that their slot is recycled by the next string
+ * of the same class. Strings larger than the biggest class are allocated on
+ * their own.
+ */
+class StringArena
+{
+public:
+    /**
+     * Constructor
+     *
+     * @param[in] slabSize size of each slab of memory, in bytes
+     */
+    explicit StringArena(size_t slabSize = 64 * 1024);
+
+    StringArena(const StringArena&) = delete;
+    StringArena& operator=(const StringArena&) = delete;
+
+    ~StringArena();
+
+    /**
+     * Copy a string into the arena
+     *
+     * @param[in] s string to be stored
+     * @return reference to the stored copy, valid until released
+     */
+    ArenaString store(const std::string& s);
+
+    /**
+     * Copy the concatenation of two strings into the arena
+     *
+     * Storing related strings together saves a slot and its rounding.
+     * @param[in] prefix first part of the string to be stored
+     * @param[in] suffix second part of the string to be stored
+     * @return reference to the stored copy, valid until released
+     */
+    ArenaString store(const std::string& prefix, const std::string& suffix);
+
+    /**
+     * Give the storage of a string back to the arena
+     *
+     * @param[in] s reference previously returned by store()
+     */
+    void release(const ArenaString& s);
+
+    /**
+     * Release every string and free all slabs
+     */
+    void clear();
+
+    /**
+     * Get the amount of memory reserved from the system
+     * @return reserved memory, in bytes
+     */
+    size_t getReservedBytes() const;
+
+    /**
+     * Get the amount of memory currently used by stored strings, including
+     * size class rounding
+     * @return used memory, in bytes
+     */
+    size_t getUsedBytes() const;
+
+private:
+    /**
+     * Slots are multiples of SLOT_GRANULARITY up to SMALL_SLOT_MAX_SIZE,
+     * then powers of 2 up to LARGE_SLOT_MAX_SIZE
+     */
+    static const size_t SLOT_GRANULARITY = 16;
+    static const size_t SMALL_SLOT_MAX_SIZE = 256;
+    static const size_t LARGE_SLOT_MAX_SIZE = 4096;
+    static const size_t SIZE_CLASS_COUNT = SMALL_SLOT_MAX_SIZE / SLOT_GRANULARITY + 4;
+
+    /**
+     * Get size class and slot size of a string
+     * @param[in] size string size, in bytes, must be <= LARGE_SLOT_MAX_SIZE
+     * @param[out] slotSize size of the slots of the class
+     * @return size class index
+     */
+    static size_t getSizeClass(size_t size, size_t& slotSize);
+
+    /**
+     * Carve a slot out of the current slab, allocating a new one if needed
+     * @param[in] slotSize size of the slot, in bytes
+     * @return beginning of the slot
+     */
+    char* allocateSlot(size_t slotSize);
+
+    const size_t _slabSize;
+
+    std::vector<std::unique_ptr<char[]>> _slabs;
+    char* _slabCursor = nullptr;
+    size_t _slabRemaining = 0;
+
+    /**
+     * Intrusive free lists, the address of the next free slot is written at
+     * the beginning of each free slot
+     */
+    std::array<char*, SIZE_CLASS_COUNT> _freeLists;
+
+    /**
+     * Strings too large for any size class, keyed by their address
+     */
+    std::unordered_map<const char*, std::unique_ptr<char[]>> _largeStrings;
+
+    size_t _reservedBytes = 0;
+    size_t _usedBytes = 0;
+};
+
+}
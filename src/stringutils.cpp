@@ -25,132 +25,832 @@
 #include "stringutils.h"
 
 #include <algorithm>
+#include <cctype>
+#include <cstdint>
 #include <cstring>
-#include <functional>
-#include <iterator>
 #include <sstream>
+#include <strings.h>
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#include <immintrin.h>
+#define GEECXX_HAS_X86_SIMD
+#endif
 
 namespace geecxx
 {
 namespace stringutils
 {
 
-size_t findNoCase(const std::string& haystack, const std::string& needle)
+namespace
+{
+
+bool isUnreserved(unsigned char c)
 {
-    size_t needleIndex = std::string::npos;
-    auto it = std::search(
-      haystack.begin(), haystack.end(),
-      needle.begin(),   needle.end(),
-      [](char c1, char c2) { return std::toupper(c1) == std::toupper(c2); }
-    );
+    return std::isalnum(c) || '-' == c || '.' == c || '_' == c || '~' == c;
+}
 
-    if (it != haystack.end()) {
-        needleIndex = std::distance(haystack.begin(), it);
+int getHexValue(char c)
+{
+    if ('0' <= c && c <= '9') {
+        return c - '0';
+    }
+    if ('a' <= c && c <= 'f') {
+        return c - 'a' + 10;
+    }
+    if ('A' <= c && c <= 'F') {
+        return c - 'A' + 10;
     }
+    return -1;
+}
 
-    return needleIndex;
+void appendPercentEncoded(unsigned char c, std::string& output)
+{
+    static const char digits[] = "0123456789ABCDEF";
+    output.push_back('%');
+    output.push_back(digits[c >> 4]);
+    output.push_back(digits[c & 0xf]);
 }
 
-void formatInline(std::string& s)
+/**
+ * Append a path, query or userinfo, with unreserved characters decoded,
+ * other escapes in uppercase and bytes that can't appear in URLs escaped
+ */
+void appendNormalizedComponent(const char* begin, const char* end, std::string& output)
 {
-    char titleCopy[s.size() + 1];
+    for (const char* c = begin; c != end; ++c) {
+        // Most characters are kept as they are, copy them at once
+        const char* runEnd = c;
+        while (runEnd != end && '%' != *runEnd && ' ' < *runEnd && 0x7f != *runEnd) {
+            ++runEnd;
+        }
+        output.append(c, runEnd);
+        if (runEnd == end) {
+            break;
+        }
+        c = runEnd;
 
-    // strtok needs to be able to modify the string, hence the copy
-    memcpy(titleCopy, s.c_str(), s.size() + 1);
+        const unsigned char byte = static_cast<unsigned char>(*c);
+        int high, low;
+        if ('%' == byte && end - c >= 3 && 0 <= (high = getHexValue(c[1])) && 0 <= (low = getHexValue(c[2]))) {
+            const unsigned char decoded = static_cast<unsigned char>(high << 4 | low);
+            if (isUnreserved(decoded)) {
+                output.push_back(static_cast<char>(decoded));
+            } else {
+                appendPercentEncoded(decoded, output);
+            }
+            c += 2;
+        } else if (byte <= ' ' || 0x7f <= byte) {
+            appendPercentEncoded(byte, output);
+        } else {
+            output.push_back(static_cast<char>(byte));
+        }
+    }
+}
 
-    char *word = nullptr;
-    char *strtokContext = nullptr;
-    const char delim[] = "\n\r\t\v\f ";
-    std::stringstream outputStream;
+/**
+ * Resolve "." and ".." segments of the path starting at pathBegin and
+ * running to the end of the output, in place (RFC 3986, section 5.2.4)
+ */
+void removeDotSegments(std::string& output, size_t pathBegin)
+{
+    if (std::string::npos == output.find("/.", pathBegin)) {
+        // Nothing to resolve, the usual case
+        return;
+    }
+    const size_t pathEnd = output.size();
+    size_t read = pathBegin;
+    size_t write = pathBegin;
+    while (read < pathEnd) {
+        // output[read] is always a '/'
+        size_t segmentEnd = output.find('/', read + 1);
+        if (std::string::npos == segmentEnd) {
+            segmentEnd = pathEnd;
+        }
+        const size_t segmentSize = segmentEnd - read - 1;
+        const bool isLast = segmentEnd == pathEnd;
+        if (1 == segmentSize && '.' == output[read + 1]) {
+            if (isLast) {
+                output[write++] = '/';
+            }
+        } else if (2 == segmentSize && '.' == output[read + 1] && '.' == output[read + 2]) {
+            while (write > pathBegin && '/' != output[--write]) {
+            }
+            if (isLast) {
+                output[write++] = '/';
+            }
+        } else {
+            for (size_t i = read; i < segmentEnd; ++i) {
+                output[write++] = output[i];
+            }
+        }
+        read = segmentEnd;
+    }
+    if (write == pathBegin) {
+        output[write++] = '/';
+    }
+    output.resize(write);
+}
 
-    // We only need to pass titleCopy on the first call to strtok
-    word = strtok_r(titleCopy, delim, &strtokContext);
-    while (nullptr != word) {
-        outputStream << word;
-        word = strtok_r(nullptr, delim, &strtokContext);
-        if (nullptr != word) {
-            // Separate two consecutive words with a space
-            outputStream << " ";
+/**
+ * Convert Unicode code points to punycode (RFC 3492)
+ *
+ * @return false if the code points can't be encoded
+ */
+bool appendPunycode(const std::uint32_t* codePoints, size_t count, std::string& output)
+{
+    static const std::uint32_t base = 36, tMin = 1, tMax = 26, skew = 38, damp = 700;
+    const auto appendDigit = [&output](std::uint32_t digit) {
+        output.push_back(static_cast<char>(digit < 26 ? 'a' + digit : '0' + digit - 26));
+    };
+    const auto adapt = [](std::uint32_t delta, std::uint32_t pointCount, bool isFirst) {
+        delta = isFirst ? delta / damp : delta / 2;
+        delta += delta / pointCount;
+        std::uint32_t k = 0;
+        while (delta > ((base - tMin) * tMax) / 2) {
+            delta /= base - tMin;
+            k += base;
         }
+        return k + (base - tMin + 1) * delta / (delta + skew);
+    };
+
+    output.append("xn--");
+    std::uint32_t basicCount = 0;
+    for (size_t i = 0; i < count; ++i) {
+        if (codePoints[i] < 0x80) {
+            output.push_back(static_cast<char>(codePoints[i]));
+            ++basicCount;
+        }
+    }
+    if (0 != basicCount) {
+        output.push_back('-');
     }
 
-    s = outputStream.str();
+    std::uint32_t n = 0x80, delta = 0, bias = 72;
+    for (std::uint32_t handledCount = basicCount; handledCount < count; ++delta, ++n) {
+        std::uint32_t m = UINT32_MAX;
+        for (size_t i = 0; i < count; ++i) {
+            if (n <= codePoints[i] && codePoints[i] < m) {
+                m = codePoints[i];
+            }
+        }
+        if ((m - n) > (UINT32_MAX - delta) / (handledCount + 1)) {
+            return false;
+        }
+        delta += (m - n) * (handledCount + 1);
+        n = m;
+        for (size_t i = 0; i < count; ++i) {
+            if (codePoints[i] < n) {
+                ++delta;
+            } else if (codePoints[i] == n) {
+                std::uint32_t q = delta;
+                for (std::uint32_t k = base;; k += base) {
+                    const std::uint32_t t = k <= bias ? tMin : (k >= bias + tMax ? tMax : k - bias);
+                    if (q < t) {
+                        break;
+                    }
+                    appendDigit(t + (q - t) % (base - t));
+                    q = (q - t) / (base - t);
+                }
+                appendDigit(q);
+                bias = adapt(delta, handledCount + 1, handledCount == basicCount);
+                delta = 0;
+                ++handledCount;
+            }
+        }
+    }
+    return true;
 }
 
-std::string formatUrl(const std::string& url)
+/**
+ * Append a host label in lowercase, in punycode if it isn't ASCII
+ */
+void appendHostLabel(const char* begin, const char* end, std::string& output)
 {
-    size_t startIndex = url.find("//");
-    if (std::string::npos != startIndex) {
-        // Protocol has been found, skip it
-        startIndex += 2;
-    } else {
-        // Protocol not found, stay at the begining
-        startIndex = 0;
+    const size_t labelBegin = output.size();
+    bool isAscii = true;
+    for (const char* c = begin; c != end; ++c) {
+        // ASCII only, whatever the locale
+        output.push_back('A' <= *c && *c <= 'Z' ? static_cast<char>(*c - 'A' + 'a') : *c);
+        isAscii = isAscii && 0 == (*c & 0x80);
+    }
+    if (isAscii) {
+        return;
     }
 
-    // Try to find any fragment at the end of the URL.
-    // As we want to modify the string after that point,
-    // we need a copy of the current substring.
-    size_t endIndex = url.rfind("#");
-    std::string formattedUrl;
-    if (std::string::npos == endIndex) {
-        formattedUrl = url.substr(startIndex);
-    } else {
-        formattedUrl = url.substr(startIndex, endIndex - startIndex);
+    // Labels are 63 bytes at most, longer ones are kept as they are
+    std::uint32_t codePoints[64];
+    size_t count = 0;
+    for (size_t i = labelBegin; i < output.size(); ++count) {
+        const unsigned char lead = static_cast<unsigned char>(output[i]);
+        const size_t size = lead < 0x80 ? 1 : (lead >> 5) == 0x6 ? 2 : (lead >> 4) == 0xe ? 3 : (lead >> 3) == 0x1e ? 4 : 0;
+        if (0 == size || output.size() - i < size || count == sizeof(codePoints) / sizeof(codePoints[0])) {
+            return;
+        }
+        std::uint32_t codePoint = 1 == size ? lead : lead & (0xff >> (size + 1));
+        for (size_t j = 1; j < size; ++j) {
+            const unsigned char continuation = static_cast<unsigned char>(output[i + j]);
+            if ((continuation >> 6) != 0x2) {
+                return;
+            }
+            codePoint = codePoint << 6 | (continuation & 0x3f);
+        }
+        // Lowercase letters of the most common alphabets only, rather than
+        // the whole Unicode mapping of IDNA
+        if ((0xc0 <= codePoint && codePoint <= 0xde && 0xd7 != codePoint)
+            || (0x410 <= codePoint && codePoint <= 0x42f)) {
+            codePoint += 0x20;
+        }
+        codePoints[count] = codePoint;
+        i += size;
     }
+    output.resize(labelBegin);
+    if (!appendPunycode(codePoints, count, output)) {
+        output.resize(labelBegin);
+        output.append(begin, end);
+    }
+}
+
+/**
+ * Append a host without its leading "www." labels nor its trailing dot
+ */
+void appendHost(const char* begin, const char* end, std::string& output)
+{
+    if (begin != end && '.' == end[-1]) {
+        --end;
+    }
+    // Unless what follows is a top-level domain, e.g. "www.com"
+    while (end - begin > 4 && 0 == strncasecmp(begin, "www.", 4) && end != std::find(begin + 4, end, '.')) {
+        begin += 4;
+    }
+    const char* labelBegin = begin;
+    while (true) {
+        const char* labelEnd = std::find(labelBegin, end, '.');
+        appendHostLabel(labelBegin, labelEnd, output);
+        if (labelEnd == end) {
+            break;
+        }
+        output.push_back('.');
+        labelBegin = labelEnd + 1;
+    }
+}
+
+bool isContinuationByte(char c)
+{
+    return 0x80 == (static_cast<unsigned char>(c) & 0xc0);
+}
 
-    // Set domain name to lower case
-    endIndex = formattedUrl.find("/");
-    if (std::string::npos != endIndex) {
-        std::transform(formattedUrl.begin(), formattedUrl.begin() + endIndex,
-                       formattedUrl.begin(), tolower);
+/**
+ * Decode the UTF-8 sequence starting at a given index, invalid sequences
+ * are decoded byte per byte as U+FFFD
+ */
+std::uint32_t decodeCodePoint(const char* s, size_t size, size_t index)
+{
+    const unsigned char lead = s[index];
+    size_t length;
+    std::uint32_t codePoint;
+    if (lead < 0x80) {
+        return lead;
+    } else if (0xc0 == (lead & 0xe0)) {
+        length = 2;
+        codePoint = lead & 0x1f;
+    } else if (0xe0 == (lead & 0xf0)) {
+        length = 3;
+        codePoint = lead & 0x0f;
+    } else if (0xf0 == (lead & 0xf8)) {
+        length = 4;
+        codePoint = lead & 0x07;
     } else {
-        std::transform(formattedUrl.begin(), formattedUrl.end(),
-                       formattedUrl.begin(), tolower);
+        return 0xfffd;
+    }
+    if (index + length > size) {
+        return 0xfffd;
+    }
+    for (size_t i = 1; i < length; ++i) {
+        if (!isContinuationByte(s[index + i])) {
+            return 0xfffd;
+        }
+        codePoint = (codePoint << 6) | (s[index + i] & 0x3f);
+    }
+    return codePoint;
+}
+
+const std::uint32_t ZERO_WIDTH_JOINER = 0x200d;
+
+/**
+ * Whether a code point extends the preceding character rather than
+ * starting one, from the most common Grapheme_Extend ranges
+ */
+bool isCharacterExtension(std::uint32_t codePoint)
+{
+    return (0x0300 <= codePoint && codePoint <= 0x036f)     // Combining diacritical marks
+           || (0x1ab0 <= codePoint && codePoint <= 0x1aff)  // and their extensions
+           || (0x1dc0 <= codePoint && codePoint <= 0x1dff)
+           || (0x20d0 <= codePoint && codePoint <= 0x20ff)
+           || (0xfe20 <= codePoint && codePoint <= 0xfe2f)
+           || (0xfe00 <= codePoint && codePoint <= 0xfe0f)  // Variation selectors
+           || (0x1f3fb <= codePoint && codePoint <= 0x1f3ff) // Emoji skin tones
+           || (0xe0020 <= codePoint && codePoint <= 0xe007f) // Emoji tags
+           || ZERO_WIDTH_JOINER == codePoint;
+}
+
+/**
+ * Whether a string may be cut at a given index, i.e. whether the index is
+ * the beginning of a user-perceived character
+ */
+bool isCharacterBoundary(const char* s, size_t size, size_t index)
+{
+    if (0 == index || index >= size) {
+        return true;
+    }
+    if (isContinuationByte(s[index]) || isCharacterExtension(decodeCodePoint(s, size, index))) {
+        return false;
+    }
+    // Characters joined by a zero width joiner, e.g. in family emojis
+    size_t previous = index - 1;
+    while (0 != previous && isContinuationByte(s[previous]) && index - previous < 4) {
+        --previous;
+    }
+    return ZERO_WIDTH_JOINER != decodeCodePoint(s, size, previous);
+}
+
+size_t findCharacterBoundaryBefore(const char* s, size_t size, size_t index)
+{
+    while (!isCharacterBoundary(s, size, index)) {
+        --index;
+    }
+    return index;
+}
+
+size_t findCharacterBoundaryAfter(const char* s, size_t size, size_t index)
+{
+    while (!isCharacterBoundary(s, size, index)) {
+        ++index;
+    }
+    return index;
+}
+
+/**
+ * Size of the space character at the beginning of a buffer, 0 if it doesn't
+ * start with one
+ *
+ * Besides ASCII spaces, UTF-8 encoded Unicode spaces are recognized:
+ * U+0085, U+00A0, U+1680, U+2000 to U+200A, U+2028, U+2029, U+202F, U+205F
+ * and U+3000.
+ */
+size_t getSpaceSize(const char* begin, const char* end)
+{
+    const unsigned char* c = reinterpret_cast<const unsigned char*>(begin);
+    const size_t size = end - begin;
+    if (' ' == c[0] || ('\t' <= c[0] && c[0] <= '\r')) {
+        return 1;
+    }
+    if (0xc2 == c[0]) {
+        return size >= 2 && (0x85 == c[1] || 0xa0 == c[1]) ? 2 : 0;
+    }
+    if (size < 3) {
+        return 0;
+    }
+    switch (c[0]) {
+    case 0xe1:
+        return 0x9a == c[1] && 0x80 == c[2] ? 3 : 0;
+    case 0xe2:
+        if (0x80 == c[1]) {
+            return c[2] <= 0x8a || 0xa8 == c[2] || 0xa9 == c[2] || 0xaf == c[2] ? 3 : 0;
+        }
+        return 0x81 == c[1] && 0x9f == c[2] ? 3 : 0;
+    case 0xe3:
+        return 0x80 == c[1] && 0x80 == c[2] ? 3 : 0;
+    default:
+        return 0;
+    }
+}
+
+/**
+ * Whether a byte may start a space character
+ */
+bool maybeSpace(unsigned char c)
+{
+    return c <= ' ' || 0xc2 == c || (0xe1 <= c && c <= 0xe3);
+}
+
+/**
+ * Size of the prefix of a buffer made of bytes that can't start a space
+ * character, checked 16 bytes at a time with SSE2
+ */
+size_t getPlainPrefixSize(const char* data, size_t size)
+{
+    size_t i = 0;
+#ifdef GEECXX_HAS_X86_SIMD
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i c2 = _mm_set1_epi8(static_cast<char>(0xc2));
+    const __m128i e1 = _mm_set1_epi8(static_cast<char>(0xe1));
+    const __m128i two = _mm_set1_epi8(2);
+    for (; i + sizeof(__m128i) <= size; i += sizeof(__m128i)) {
+        const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        // Unsigned comparisons: x <= y if max(x, y) == y
+        const __m128i controlOrSpace = _mm_cmpeq_epi8(_mm_max_epu8(block, space), space);
+        const __m128i leadE1ToE3 = _mm_cmpeq_epi8(_mm_max_epu8(_mm_sub_epi8(block, e1), two), two);
+        const __m128i leadC2 = _mm_cmpeq_epi8(block, c2);
+        const std::uint32_t mask = _mm_movemask_epi8(_mm_or_si128(controlOrSpace, _mm_or_si128(leadE1ToE3, leadC2)));
+        if (0 != mask) {
+            return i + __builtin_ctz(mask);
+        }
+    }
+#endif
+    while (i < size && !maybeSpace(data[i])) {
+        ++i;
+    }
+    return i;
+}
+
+char toLowerAscii(char c)
+{
+    return 'A' <= c && c <= 'Z' ? c + ('a' - 'A') : c;
+}
+
+char toUpperAscii(char c)
+{
+    return 'a' <= c && c <= 'z' ? c - ('a' - 'A') : c;
+}
+
+/**
+ * Compare a buffer with a lowercase string, ignoring case
+ */
+bool equalsNoCase(const char* s, const char* lowercase, size_t size)
+{
+    for (size_t i = 0; i < size; ++i) {
+        if (toLowerAscii(s[i]) != lowercase[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Search a lowercase needle, of at least one character, from a position of
+ * the haystack, one position at a time
+ */
+size_t findNoCaseScalar(const char* haystack, size_t haystackSize, const std::string& needle, size_t position)
+{
+    const size_t needleSize = needle.size();
+    const char first = needle[0];
+    for (size_t i = position; i + needleSize <= haystackSize; ++i) {
+        if (toLowerAscii(haystack[i]) == first && equalsNoCase(haystack + i + 1, needle.data() + 1, needleSize - 1)) {
+            return i;
+        }
+    }
+    return std::string::npos;
+}
+
+size_t findNoCaseScalar(const char* haystack, size_t haystackSize, const std::string& needle)
+{
+    return findNoCaseScalar(haystack, haystackSize, needle, 0);
+}
+
+#ifdef GEECXX_HAS_X86_SIMD
+
+/**
+ * Compare the candidates of a block, i.e. the positions where both the first
+ * and the last characters of the needle match
+ */
+size_t findCandidate(const char* block, std::uint32_t candidates, const std::string& needle)
+{
+    // The first and last characters are already known to match
+    const size_t middleSize = needle.size() < 2 ? 0 : needle.size() - 2;
+    while (0 != candidates) {
+        const unsigned int offset = __builtin_ctz(candidates);
+        if (equalsNoCase(block + offset + 1, needle.data() + 1, middleSize)) {
+            return offset;
+        }
+        candidates &= candidates - 1;
+    }
+    return std::string::npos;
+}
+
+size_t findNoCaseSse2(const char* haystack, size_t haystackSize, const std::string& needle)
+{
+    const size_t lastOffset = needle.size() - 1;
+    const __m128i firstLower = _mm_set1_epi8(needle.front());
+    const __m128i firstUpper = _mm_set1_epi8(toUpperAscii(needle.front()));
+    const __m128i lastLower = _mm_set1_epi8(needle.back());
+    const __m128i lastUpper = _mm_set1_epi8(toUpperAscii(needle.back()));
+    size_t i = 0;
+    for (; i + lastOffset + sizeof(__m128i) <= haystackSize; i += sizeof(__m128i)) {
+        const __m128i firstBlock = _mm_loadu_si128(reinterpret_cast<const __m128i*>(haystack + i));
+        const __m128i lastBlock = _mm_loadu_si128(reinterpret_cast<const __m128i*>(haystack + i + lastOffset));
+        const __m128i firstMatches = _mm_or_si128(_mm_cmpeq_epi8(firstBlock, firstLower),
+                                                  _mm_cmpeq_epi8(firstBlock, firstUpper));
+        const __m128i lastMatches = _mm_or_si128(_mm_cmpeq_epi8(lastBlock, lastLower),
+                                                 _mm_cmpeq_epi8(lastBlock, lastUpper));
+        const std::uint32_t candidates = _mm_movemask_epi8(_mm_and_si128(firstMatches, lastMatches));
+        if (0 != candidates) {
+            const size_t offset = findCandidate(haystack + i, candidates, needle);
+            if (std::string::npos != offset) {
+                return i + offset;
+            }
+        }
+    }
+    return findNoCaseScalar(haystack, haystackSize, needle, i);
+}
+
+__attribute__((target("avx2")))
+size_t findNoCaseAvx2(const char* haystack, size_t haystackSize, const std::string& needle)
+{
+    const size_t lastOffset = needle.size() - 1;
+    const __m256i firstLower = _mm256_set1_epi8(needle.front());
+    const __m256i firstUpper = _mm256_set1_epi8(toUpperAscii(needle.front()));
+    const __m256i lastLower = _mm256_set1_epi8(needle.back());
+    const __m256i lastUpper = _mm256_set1_epi8(toUpperAscii(needle.back()));
+    size_t i = 0;
+    for (; i + lastOffset + sizeof(__m256i) <= haystackSize; i += sizeof(__m256i)) {
+        const __m256i firstBlock = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(haystack + i));
+        const __m256i lastBlock = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(haystack + i + lastOffset));
+        const __m256i firstMatches = _mm256_or_si256(_mm256_cmpeq_epi8(firstBlock, firstLower),
+                                                     _mm256_cmpeq_epi8(firstBlock, firstUpper));
+        const __m256i lastMatches = _mm256_or_si256(_mm256_cmpeq_epi8(lastBlock, lastLower),
+                                                    _mm256_cmpeq_epi8(lastBlock, lastUpper));
+        const std::uint32_t candidates = _mm256_movemask_epi8(_mm256_and_si256(firstMatches, lastMatches));
+        if (0 != candidates) {
+            const size_t offset = findCandidate(haystack + i, candidates, needle);
+            if (std::string::npos != offset) {
+                return i + offset;
+            }
+        }
+    }
+    return findNoCaseScalar(haystack, haystackSize, needle, i);
+}
+
+#endif
+
+}
+
+size_t findNoCase(std::string_view haystack, std::string_view needle)
+{
+    return NoCaseSearcher(needle).find(haystack);
+}
+
+NoCaseSearcher::NoCaseSearcher(std::string_view needle, Implementation implementation)
+    : _needle(needle), _implementation(implementation), _find(findNoCaseScalar)
+{
+    std::transform(_needle.begin(), _needle.end(), _needle.begin(), toLowerAscii);
+    if (Implementation::BEST == _implementation || !isSupported(_implementation)) {
+        _implementation = isSupported(Implementation::AVX2) ? Implementation::AVX2
+                        : isSupported(Implementation::SSE2) ? Implementation::SSE2
+                        : Implementation::SCALAR;
+    }
+#ifdef GEECXX_HAS_X86_SIMD
+    if (Implementation::AVX2 == _implementation) {
+        _find = findNoCaseAvx2;
+    } else if (Implementation::SSE2 == _implementation) {
+        _find = findNoCaseSse2;
+    }
+#endif
+}
+
+bool NoCaseSearcher::isSupported(Implementation implementation)
+{
+#ifdef GEECXX_HAS_X86_SIMD
+    // SSE2 is part of x86-64
+    static const bool avx2Supported = []() {
+        __builtin_cpu_init();
+        return 0 != __builtin_cpu_supports("avx2");
+    }();
+    return Implementation::AVX2 != implementation || avx2Supported;
+#else
+    return Implementation::SSE2 != implementation && Implementation::AVX2 != implementation;
+#endif
+}
+
+size_t NoCaseSearcher::find(std::string_view haystack, size_t position) const
+{
+    if (position > haystack.size()) {
+        return std::string::npos;
+    }
+    if (_needle.empty()) {
+        return position;
+    }
+    if (_needle.size() > haystack.size() - position) {
+        return std::string::npos;
+    }
+    const size_t index = _find(haystack.data() + position, haystack.size() - position, _needle);
+    return std::string::npos == index ? index : position + index;
+}
+
+size_t NoCaseSearcher::getSize() const
+{
+    return _needle.size();
+}
+
+NoCaseSearcher::Implementation NoCaseSearcher::getImplementation() const
+{
+    return _implementation;
+}
+
+void formatInline(std::string& s)
+{
+    char* const data = &s[0];
+    const size_t size = s.size();
+    size_t readIndex = 0;
+    size_t writeIndex = 0;
+    // Spaces are only written before the next word, so that the trailing
+    // ones are dropped
+    bool pendingSpace = false;
+    while (readIndex < size) {
+        // Words are moved in blocks until a byte that may start a space
+        const size_t wordSize = getPlainPrefixSize(data + readIndex, size - readIndex);
+        if (0 != wordSize) {
+            if (pendingSpace) {
+                data[writeIndex++] = ' ';
+                pendingSpace = false;
+            }
+            if (writeIndex != readIndex) {
+                memmove(data + writeIndex, data + readIndex, wordSize);
+            }
+            writeIndex += wordSize;
+            readIndex += wordSize;
+            continue;
+        }
+        const size_t spaceSize = getSpaceSize(data + readIndex, data + size);
+        if (0 != spaceSize) {
+            pendingSpace = 0 != writeIndex;
+            readIndex += spaceSize;
+        } else {
+            if (pendingSpace) {
+                data[writeIndex++] = ' ';
+                pendingSpace = false;
+            }
+            data[writeIndex++] = data[readIndex++];
+        }
     }
+    s.resize(writeIndex);
+}
+
+void canonicalizeUrl(std::string_view url, std::string& output)
+{
+    output.clear();
+    const char* position = url.data();
+    const char* const end = url.data() + url.size();
+
+    // Scheme, only used to know its default port
+    const char* schemeEnd = position;
+    if (schemeEnd != end && std::isalpha(static_cast<unsigned char>(*schemeEnd))) {
+        while (schemeEnd != end && (std::isalnum(static_cast<unsigned char>(*schemeEnd))
+                                    || '+' == *schemeEnd || '-' == *schemeEnd || '.' == *schemeEnd)) {
+            ++schemeEnd;
+        }
+    }
+    const char* defaultPort = nullptr;
+    if (3 <= end - schemeEnd && 0 == std::strncmp(schemeEnd, "://", 3)) {
+        const size_t schemeSize = schemeEnd - position;
+        if (4 == schemeSize && 0 == strncasecmp(position, "http", 4)) {
+            defaultPort = "80";
+        } else if (5 == schemeSize && 0 == strncasecmp(position, "https", 5)) {
+            defaultPort = "443";
+        }
+        position = schemeEnd + 3;
+    } // else no scheme, ports are all kept
 
-    startIndex = formattedUrl.find("www.");
-    if (std::string::npos != startIndex) {
-        // "www." has been found, skip it
-        startIndex += 4;
+    // Authority: [userinfo@]host[:port]
+    const char* authorityEnd = position;
+    while (authorityEnd != end && '/' != *authorityEnd && '?' != *authorityEnd && '#' != *authorityEnd) {
+        ++authorityEnd;
+    }
+    const char* hostBegin = position;
+    for (const char* c = position; c != authorityEnd; ++c) {
+        if ('@' == *c) {
+            hostBegin = c + 1;
+        }
+    }
+    if (hostBegin != position) {
+        appendNormalizedComponent(position, hostBegin, output);
+    }
+    const char* hostEnd = hostBegin;
+    if (hostEnd != authorityEnd && '[' == *hostEnd) {
+        // IPv6 address, may contain ':'
+        while (hostEnd != authorityEnd && ']' != *hostEnd) {
+            ++hostEnd;
+        }
+        hostEnd += hostEnd != authorityEnd ? 1 : 0;
     } else {
-        startIndex = 0;
+        while (hostEnd != authorityEnd && ':' != *hostEnd) {
+            ++hostEnd;
+        }
+    }
+    appendHost(hostBegin, hostEnd, output);
+
+    const char* portBegin = hostEnd != authorityEnd ? hostEnd + 1 : authorityEnd;
+    while (authorityEnd - portBegin > 1 && '0' == *portBegin) {
+        ++portBegin;
+    }
+    const size_t portSize = authorityEnd - portBegin;
+    if (0 != portSize && !(nullptr != defaultPort && portSize == std::strlen(defaultPort)
+                           && 0 == std::strncmp(portBegin, defaultPort, portSize))) {
+        output.push_back(':');
+        output.append(portBegin, portSize);
     }
 
-    return formattedUrl.substr(startIndex);
+    // Path, dot segments are resolved once percent-encoding is normalized
+    position = authorityEnd;
+    const char* pathEnd = position;
+    while (pathEnd != end && '?' != *pathEnd && '#' != *pathEnd) {
+        ++pathEnd;
+    }
+    const size_t pathBegin = output.size();
+    if (position == pathEnd || '/' != *position) {
+        output.push_back('/');
+    }
+    appendNormalizedComponent(position, pathEnd, output);
+    removeDotSegments(output, pathBegin);
+
+    // Query, the fragment is left out
+    position = pathEnd;
+    if (position != end && '?' == *position) {
+        const char* queryEnd = position;
+        while (queryEnd != end && '#' != *queryEnd) {
+            ++queryEnd;
+        }
+        output.push_back('?');
+        appendNormalizedComponent(position + 1, queryEnd, output);
+    }
 }
 
-std::string shorten(const std::string &s, size_t maxSize)
+std::string formatUrl(std::string_view url)
 {
-    if (maxSize >= s.size()) {
+    std::string formattedUrl;
+    canonicalizeUrl(url, formattedUrl);
+    return formattedUrl;
+}
+
+std::string shorten(std::string_view s, size_t maxSize)
+{
+    std::string output(std::min(s.size(), maxSize), '\0');
+    output.resize(shorten(s, maxSize, &output[0]));
+    return output;
+}
+
+size_t shorten(std::string_view string, size_t maxSize, char* output)
+{
+    const char* const s = string.data();
+    const size_t size = string.size();
+    if (maxSize >= size) {
         // String already short enough, nothing to be done
-        return s;
+        memcpy(output, s, size);
+        return size;
     }
 
-    const std::string middle{"[..]"};
-    if (maxSize < (middle.size() + 2)) {
-        return s.substr(0, maxSize);
+    static const char middle[] = "[..]";
+    const size_t middleSize = sizeof(middle) - 1;
+    if (maxSize < (middleSize + 2)) {
+        const size_t prefixSize = findCharacterBoundaryBefore(s, size, maxSize);
+        memcpy(output, s, prefixSize);
+        return prefixSize;
     }
 
-    std::stringstream outputStream;
-    maxSize -= middle.size();
-    size_t firstSectionSize = (maxSize + 1) / 2;
-    size_t secondSectionSize = (maxSize - firstSectionSize);
-    outputStream << s.substr(0, firstSectionSize);
-    outputStream << middle;
-    outputStream << s.substr(s.size() - secondSectionSize, secondSectionSize);
+    maxSize -= middleSize;
+    // Bytes the first section loses to its boundary go to the second one
+    const size_t firstSectionSize = findCharacterBoundaryBefore(s, size, (maxSize + 1) / 2);
+    const size_t secondSectionBegin = findCharacterBoundaryAfter(s, size, size - (maxSize - firstSectionSize));
+    const size_t secondSectionSize = size - secondSectionBegin;
+    memcpy(output, s, firstSectionSize);
+    memcpy(output + firstSectionSize, middle, middleSize);
+    memcpy(output + firstSectionSize + middleSize, s + secondSectionBegin, secondSectionSize);
+    return firstSectionSize + middleSize + secondSectionSize;
+}
+
+std::string formatElapsedTime(std::time_t seconds)
+{
+    static const struct
+    {
+        std::time_t _seconds;
+        const char* _name;
+    } units[] = {
+        {365 * 24 * 3600, "year"},
+        {30 * 24 * 3600, "month"},
+        {7 * 24 * 3600, "week"},
+        {24 * 3600, "day"},
+        {3600, "hour"},
+        {60, "minute"},
+        {1, "second"}
+    };
 
-    return outputStream.str();
+    seconds = std::max<std::time_t>(seconds, 0);
+    for (const auto& unit : units) {
+        const std::time_t count = seconds / unit._seconds;
+        if (0 != count || 1 == unit._seconds) {
+            return std::to_string(count) + " " + unit._name + (1 == count ? "" : "s");
+        }
+    }
+    return std::string();
 }
 
 void trimLeft(std::string& s)
 {
-    s.erase(s.begin(), std::find_if(s.begin(), s.end(), std::not1(std::ptr_fun<int, int>(std::isspace))));
+    s.erase(0, s.size() - trimmedLeft(s).size());
 }
 
 void trimRight(std::string& s)
 {
-    s.erase(std::find_if(s.rbegin(), s.rend(), std::not1(std::ptr_fun<int, int>(std::isspace))).base(), s.end());
+    s.resize(trimmedRight(s).size());
 }
 
 void trim(std::string& s)
@@ -159,5 +859,40 @@ void trim(std::string& s)
     trimRight(s);
 }
 
+std::string_view trimmedLeft(std::string_view s)
+{
+    size_t begin = 0;
+    while (begin < s.size() && std::isspace(static_cast<unsigned char>(s[begin]))) {
+        ++begin;
+    }
+    return s.substr(begin);
+}
+
+std::string_view trimmedRight(std::string_view s)
+{
+    size_t end = s.size();
+    while (0 != end && std::isspace(static_cast<unsigned char>(s[end - 1]))) {
+        --end;
+    }
+    return s.substr(0, end);
+}
+
+std::string_view trimmed(std::string_view s)
+{
+    return trimmedRight(trimmedLeft(s));
+}
+
+std::string_view nextWord(std::string_view& s)
+{
+    s = trimmedLeft(s);
+    size_t wordEnd = 0;
+    while (wordEnd < s.size() && !std::isspace(static_cast<unsigned char>(s[wordEnd]))) {
+        ++wordEnd;
+    }
+    const std::string_view word = s.substr(0, wordEnd);
+    s.remove_prefix(wordEnd);
+    return word;
+}
+
 }
 }
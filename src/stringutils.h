@@ -24,7 +24,9 @@
  */
 #pragma once
 
+#include <ctime>
 #include <string>
+#include <string_view>
 
 namespace geecxx
 {
@@ -40,43 +42,136 @@ namespace stringutils
  * @return position of the first character of the first match or
  *         std::string::npos if the pattern couldn't be found
  */
-size_t findNoCase(const std::string& haystack, const std::string& needle);
+size_t findNoCase(std::string_view haystack, std::string_view needle);
+
+/**
+ * Case-insensitive search of a pattern known in advance, e.g. searched for
+ * in many strings
+ *
+ * Only ASCII letters are folded, as with std::toupper in the "C" locale.
+ * Candidate positions, where both the first and the last characters of the
+ * pattern match, are found 16 or 32 bytes at a time with SSE2 or AVX2,
+ * depending on the CPU, and only those are compared in full.
+ */
+class NoCaseSearcher
+{
+public:
+    enum class Implementation
+    {
+        BEST, // Fastest implementation supported by the CPU
+        SCALAR,
+        SSE2,
+        AVX2
+    };
+
+    /**
+     * @param[in] needle string to search for
+     * @param[in] implementation implementation to be used, the best one
+     *            supported by the CPU if it isn't
+     */
+    explicit NoCaseSearcher(std::string_view needle, Implementation implementation = Implementation::BEST);
+
+    /**
+     * @return whether the CPU supports an implementation
+     */
+    static bool isSupported(Implementation implementation);
+
+    /**
+     * @param[in] position position at which the search starts
+     * @see stringutils::findNoCase
+     */
+    size_t find(std::string_view haystack, size_t position = 0) const;
+
+    size_t getSize() const;
+
+    Implementation getImplementation() const;
+
+private:
+    typedef size_t (*FindFunction)(const char* haystack, size_t haystackSize, const std::string& needle);
+
+    /**
+     * Lowercase needle
+     */
+    std::string _needle;
+    Implementation _implementation;
+    FindFunction _find;
+};
 
 /**
  * Make a string displayable on a single line
  *
- * Replace any space character such like '\n', '\r', '\t', '\v', '\f' or ' '
- * with a ' ' and remove extra spaces (more than one space between 2
- * consecutive words).
+ * Replace any run of space characters, such like '\n', '\r', '\t', '\v',
+ * '\f' or ' ' as well as UTF-8 encoded Unicode spaces (e.g. the no-break
+ * space decoded from "&nbsp;"), with a single ' ', and remove the ones
+ * at both ends. The string is modified in place, no memory is allocated.
  * @param s string to be modified
  */
 void formatInline(std::string& s);
 
+/**
+ * Write the canonical form of a URL, shared by every URL leading to the
+ * same page
+ *
+ * The URL is normalized as described by RFC 3986: the host is lowercased,
+ * its non-ASCII labels are converted to punycode ("xn--"), the scheme's
+ * default port is removed, percent-encoding is normalized (unreserved
+ * characters decoded, other escapes uppercased, non-ASCII bytes escaped),
+ * dot segments are resolved and an empty path becomes "/". The scheme, the
+ * fragment and leading "www." labels are then removed, so that
+ * "HTTP://www.Example.com:80/a/../b?x=%7e#top" becomes "example.com/b?x=~".
+ * Canonical forms are canonical URLs themselves.
+ * @param[in] url URL, with or without scheme
+ * @param[out] output canonical form, no memory is allocated once it is large
+ *             enough, e.g. when it is reused
+ */
+void canonicalizeUrl(std::string_view url, std::string& output);
+
 /**
  * Return formatted and minimized URL
  *
- * The idea behind this function is to minimize URLs by removing
- * protocol information (http(s)://), "www" and fragments (#fragment-id)
- * from them. It also sets the URL to lowercase (only for domain name
- * part).
+ * @see stringutils::canonicalizeUrl
  * @param[in] url url that will be formatted
  * @return formatted and minimized URL
  */
-std::string formatUrl(const std::string& url);
+std::string formatUrl(std::string_view url);
 
 /**
  * Return a shorter representation of the string
  *
- * This function creates a new string out of s which fits the given maxSize.
- * To do so, it replaces the necessary amount of characters in the middle of
- * the string with "[..]". If the string is already short enough, it is
- * returned as is. If it doesn't contain enough characters to cover "[..]",
- * the substring [s[0], s[maxSize - 1]] is returned.
+ * @see stringutils::shorten(std::string_view, size_t, char*)
  * @param[in] s string out of which a short representation has to be created
- * @param[in] maxSize maximum size of the shorter representation
+ * @param[in] maxSize maximum size of the shorter representation, in bytes
  * @return shorter representation of the input string
  */
-std::string shorten(const std::string& s, size_t maxSize);
+std::string shorten(std::string_view s, size_t maxSize);
+
+/**
+ * Write a shorter representation of a UTF-8 string into a buffer
+ *
+ * The representation fits the given maxSize: the necessary amount of
+ * characters in the middle of the string is replaced with "[..]". If the
+ * string is already short enough, it is copied as is. If maxSize can't
+ * cover "[..]" and a character on each side, only the beginning of the
+ * string is kept. The string is only cut between user-perceived
+ * characters: never inside a multi-byte sequence, nor before a combining
+ * mark, a variation selector or an emoji modifier, nor around a zero
+ * width joiner. The result may thus be a few bytes shorter than maxSize.
+ * @param[in] s string out of which a short representation has to be created
+ * @param[in] maxSize maximum size of the shorter representation, in bytes
+ * @param[out] output buffer of at least maxSize bytes, not null-terminated
+ * @return size of the shorter representation
+ */
+size_t shorten(std::string_view s, size_t maxSize, char* output);
+
+/**
+ * Return a human readable representation of a duration
+ *
+ * Only the largest unit is kept, e.g. "3 days" or "1 minute". Durations
+ * under a minute are given in seconds.
+ * @param[in] seconds duration in seconds, negative values are taken as 0
+ * @return human readable duration
+ */
+std::string formatElapsedTime(std::time_t seconds);
 
 /**
  * Remove any space characters from the beginning of a string
@@ -102,5 +197,43 @@ void trimRight(std::string& s);
  */
 void trim(std::string& s);
 
+/**
+ * Return a string without the space characters at its beginning
+ *
+ * @see stringutils::trimLeft
+ * @param[in] s string to be trimmed
+ * @return view of s, without its leading space characters
+ */
+std::string_view trimmedLeft(std::string_view s);
+
+/**
+ * Return a string without the space characters at its end
+ *
+ * @see stringutils::trimRight
+ * @param[in] s string to be trimmed
+ * @return view of s, without its trailing space characters
+ */
+std::string_view trimmedRight(std::string_view s);
+
+/**
+ * Return a string without the space characters at both its ends
+ *
+ * @see stringutils::trim
+ * @param[in] s string to be trimmed
+ * @return view of s, without its leading and trailing space characters
+ */
+std::string_view trimmed(std::string_view s);
+
+/**
+ * Split the first word off a string
+ *
+ * Words are separated by space characters, as with operator>> on a
+ * std::istream.
+ * @param[in,out] s string the word is taken from, left with what follows
+ *                the word
+ * @return first word of s, empty if there is none
+ */
+std::string_view nextWord(std::string_view& s);
+
 }
 }
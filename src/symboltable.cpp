@@ -0,0 +1,93 @@
+/*
+ * Copyright (c) 2015, Romain Létendart
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "symboltable.h"
+
+namespace geecxx
+{
+
+SymbolTable::Symbol SymbolTable::intern(const std::string& s)
+{
+    auto iterator = _symbols.find(s);
+    if (_symbols.end() != iterator) {
+        ++_entries[iterator->second]._referenceCount;
+        return iterator->second;
+    }
+
+    Symbol symbol;
+    if (!_freeSymbols.empty()) {
+        symbol = _freeSymbols.back();
+        _freeSymbols.pop_back();
+    } else {
+        symbol = static_cast<Symbol>(_entries.size());
+        _entries.push_back(Entry{nullptr, 0});
+    }
+
+    // Keys of an unordered_map never move, we can safely point to them
+    iterator = _symbols.emplace(s, symbol).first;
+    _entries[symbol] = Entry{&iterator->first, 1};
+    return symbol;
+}
+
+void SymbolTable::release(Symbol symbol)
+{
+    Entry& entry = _entries[symbol];
+    if (0 != --entry._referenceCount) {
+        return;
+    }
+
+    // Erasing by key would compare against the key being destroyed
+    _symbols.erase(_symbols.find(*entry._string));
+    entry._string = nullptr;
+    _freeSymbols.push_back(symbol);
+}
+
+bool SymbolTable::find(const std::string& s, Symbol& symbol) const
+{
+    const auto iterator = _symbols.find(s);
+    if (_symbols.end() == iterator) {
+        return false;
+    }
+    symbol = iterator->second;
+    return true;
+}
+
+const std::string& SymbolTable::resolve(Symbol symbol) const
+{
+    return *_entries[symbol]._string;
+}
+
+size_t SymbolTable::getSize() const
+{
+    return _symbols.size();
+}
+
+void SymbolTable::clear()
+{
+    _symbols.clear();
+    _entries.clear();
+    _freeSymbols.clear();
+}
+
+}
@@ -0,0 +1,104 @@
+/*
+ * Copyright (c) 2015, Romain Létendart
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace geecxx
+{
+
+/**
+ * The SymbolTable class interns strings: every distinct string is stored
+ * once and referred to by a small integer symbol.
+ *
+ * Symbols are reference counted. Once a symbol is not referenced anymore its
+ * string is dropped and the symbol is recycled for the next new string.
+ */
+class SymbolTable
+{
+public:
+    typedef std::uint32_t Symbol;
+
+    /**
+     * Get the symbol of a string, adding it to the table if needed
+     *
+     * Every call increments the reference count of the returned symbol.
+     * @param[in] s string to be interned
+     * @return symbol of the string
+     */
+    Symbol intern(const std::string& s);
+
+    /**
+     * Drop a reference to a symbol
+     * @param[in] symbol symbol previously returned by intern()
+     */
+    void release(Symbol symbol);
+
+    /**
+     * Get the symbol of a string without adding it to the table
+     *
+     * @param[in] s string to be looked for
+     * @param[out] symbol symbol of the string, if found
+     * @return true if the string is currently interned, false otherwise
+     */
+    bool find(const std::string& s, Symbol& symbol) const;
+
+    /**
+     * Get the string of a symbol
+     * @param[in] symbol symbol previously returned by intern()
+     * @return interned string
+     */
+    const std::string& resolve(Symbol symbol) const;
+
+    /**
+     * Get number of distinct strings currently interned
+     * @return number of interned strings
+     */
+    size_t getSize() const;
+
+    /**
+     * Drop every symbol
+     */
+    void clear();
+
+private:
+    struct Entry
+    {
+        /**
+         * Interned string (key of _symbols), null for recycled symbols
+         */
+        const std::string* _string;
+        std::uint32_t _referenceCount;
+    };
+
+    std::unordered_map<std::string, Symbol> _symbols;
+    std::vector<Entry> _entries;
+    std::vector<Symbol> _freeSymbols;
+};
+
+}
@@ -0,0 +1,112 @@
+/*
+ * Copyright (c) 2015, Romain Létendart
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "timerwheel.h"
+
+#include <algorithm>
+
+namespace geecxx
+{
+
+TimerWheel::TimerWheel(Tick currentTick)
+    : _currentTick(currentTick)
+{
+}
+
+void TimerWheel::schedule(std::uint64_t key, Tick expiryTick)
+{
+    place(Timer{key, std::max(expiryTick, _currentTick + 1)});
+    ++_size;
+}
+
+void TimerWheel::advance(Tick tick, const std::function<void(std::uint64_t)>& expire)
+{
+    std::vector<Timer> timers;
+    while (_currentTick < tick) {
+        if (0 == _size) {
+            // Nothing to expire on the way
+            _currentTick = tick;
+            break;
+        }
+        ++_currentTick;
+
+        // Higher levels move down when the lower one wraps around
+        for (size_t level = 1; level < LEVEL_COUNT; ++level) {
+            if (0 != (_currentTick & ((Tick(1) << (level * SLOT_BITS)) - 1))) {
+                break;
+            }
+            std::vector<Timer>& slot = _levels[level][(_currentTick >> (level * SLOT_BITS)) & (SLOT_COUNT - 1)];
+            timers.clear();
+            timers.swap(slot);
+            for (const Timer& timer : timers) {
+                place(timer);
+            }
+        }
+
+        std::vector<Timer>& slot = _levels[0][_currentTick & (SLOT_COUNT - 1)];
+        if (slot.empty()) {
+            continue;
+        }
+        // The slot is emptied first, expired timers might be scheduled again
+        timers.clear();
+        timers.swap(slot);
+        for (const Timer& timer : timers) {
+            --_size;
+            expire(timer._key);
+        }
+    }
+}
+
+void TimerWheel::reset(Tick currentTick)
+{
+    for (Level& level : _levels) {
+        for (std::vector<Timer>& slot : level) {
+            std::vector<Timer>().swap(slot);
+        }
+    }
+    _currentTick = currentTick;
+    _size = 0;
+}
+
+size_t TimerWheel::getSize() const
+{
+    return _size;
+}
+
+TimerWheel::Tick TimerWheel::getCurrentTick() const
+{
+    return _currentTick;
+}
+
+void TimerWheel::place(const Timer& timer)
+{
+    const Tick delta = timer._expiryTick - _currentTick;
+    size_t level = 0;
+    while (level + 1 < LEVEL_COUNT && delta >= (Tick(1) << ((level + 1) * SLOT_BITS))) {
+        ++level;
+    }
+    _levels[level][(timer._expiryTick >> (level * SLOT_BITS)) & (SLOT_COUNT - 1)].push_back(timer);
+}
+
+}
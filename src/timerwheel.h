@@ -0,0 +1,122 @@
+/*
+ * Copyright (c) 2015, Romain Létendart
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace geecxx
+{
+
+/**
+ * The TimerWheel class is a hierarchical timer wheel.
+ *
+ * Timers are identified by a key and expire at a given tick. Level 0 has one
+ * slot per tick, each following level has slots 64 times as wide: a timer is
+ * filed in the level matching its distance to the current tick, and moves
+ * down a level each time the lower level wraps around. Scheduling is O(1),
+ * advancing is O(1) per elapsed tick plus the work on expired timers.
+ *
+ * Timers can't be cancelled: owners are expected to check whether a timer is
+ * still relevant when it expires, and schedule it again if needed.
+ */
+class TimerWheel
+{
+public:
+    typedef std::uint64_t Tick;
+
+    /**
+     * Constructor
+     * @param[in] currentTick tick the wheel starts at
+     */
+    explicit TimerWheel(Tick currentTick = 0);
+
+    /**
+     * Add a timer
+     *
+     * Timers scheduled at or before the current tick expire on the next one.
+     * @param[in] key identifier of the timer, passed back on expiry
+     * @param[in] expiryTick tick the timer expires at
+     */
+    void schedule(std::uint64_t key, Tick expiryTick);
+
+    /**
+     * Move the wheel forward, expiring timers on the way
+     *
+     * Timers may be scheduled from the callback.
+     * @param[in] tick new current tick, ignored if not after the current one
+     * @param[in] expire called with the key of each expired timer
+     */
+    void advance(Tick tick, const std::function<void(std::uint64_t)>& expire);
+
+    /**
+     * Remove every timer and move the wheel to the given tick
+     * @param[in] currentTick new current tick
+     */
+    void reset(Tick currentTick);
+
+    /**
+     * Get number of pending timers
+     * @return number of pending timers
+     */
+    size_t getSize() const;
+
+    /**
+     * Get the current tick
+     * @return current tick
+     */
+    Tick getCurrentTick() const;
+
+private:
+    static const unsigned int SLOT_BITS = 6;
+    static const size_t SLOT_COUNT = 1 << SLOT_BITS;
+    /**
+     * 6 levels of 64 slots cover 2^36 ticks (more than 2000 years of seconds)
+     */
+    static const size_t LEVEL_COUNT = 6;
+
+    struct Timer
+    {
+        std::uint64_t _key;
+        Tick _expiryTick;
+    };
+
+    typedef std::array<std::vector<Timer>, SLOT_COUNT> Level;
+
+    /**
+     * File a timer in the slot matching its distance to the current tick
+     * @param[in] timer timer to be filed
+     */
+    void place(const Timer& timer);
+
+    std::array<Level, LEVEL_COUNT> _levels;
+    Tick _currentTick;
+    size_t _size = 0;
+};
+
+}
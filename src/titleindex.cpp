@@ -0,0 +1,304 @@
+/*
+ * Copyright (c) 2015, Romain Létendart
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "titleindex.h"
+
+#include <algorithm>
+#include <cmath>
+#include <queue>
+
+namespace
+{
+
+bool isTermCharacter(unsigned char c)
+{
+    return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c >= 0x80;
+}
+
+/**
+ * Get size of the UTF-8 punctuation sequence at the given position, if any
+ *
+ * Only Latin-1 symbols (U+0080 to U+00BF: no-break space, guillemets...) and
+ * general punctuation (U+2000 to U+203F: dashes, quotes, ellipsis...) are
+ * recognized, other non-ASCII characters are considered as letters.
+ */
+size_t getPunctuationSize(const std::string& text, size_t position)
+{
+    const unsigned char c = text[position];
+    if (position + 1 >= text.size()) {
+        return 0;
+    }
+    const unsigned char next = text[position + 1];
+    if (0xC2 == c && next >= 0x80 && next <= 0xBF) {
+        return 2;
+    }
+    if (0xE2 == c && 0x80 == next && position + 2 < text.size()) {
+        return 3;
+    }
+    return 0;
+}
+
+}
+
+namespace geecxx
+{
+
+void TitleIndex::tokenize(const std::string& text, std::vector<std::string>& terms)
+{
+    terms.clear();
+
+    std::string term;
+    for (size_t i = 0; i <= text.size(); ++i) {
+        const unsigned char c = i < text.size() ? text[i] : ' ';
+        const size_t punctuationSize = i < text.size() ? getPunctuationSize(text, i) : 0;
+        if (0 == punctuationSize && isTermCharacter(c)) {
+            if (c >= 'A' && c <= 'Z') {
+                term += static_cast<char>(c + ('a' - 'A'));
+            } else if (0xC3 == c && i + 1 < text.size()
+                       && static_cast<unsigned char>(text[i + 1]) >= 0x80
+                       && static_cast<unsigned char>(text[i + 1]) <= 0x9E
+                       && static_cast<unsigned char>(text[i + 1]) != 0x97) {
+                // Latin-1 uppercase letter (U+00C0 to U+00DE but U+00D7)
+                term += static_cast<char>(c);
+                term += static_cast<char>(text[++i] + 0x20);
+            } else {
+                term += static_cast<char>(c);
+            }
+            continue;
+        }
+
+        if (term.size() >= 2 && terms.end() == std::find(terms.begin(), terms.end(), term)) {
+            terms.push_back(term);
+        }
+        term.clear();
+        if (punctuationSize > 0) {
+            i += punctuationSize - 1;
+        }
+    }
+}
+
+void TitleIndex::add(std::uint64_t id, const std::string& title)
+{
+    std::vector<std::string> terms;
+    tokenize(title, terms);
+
+    for (const std::string& term : terms) {
+        const SymbolTable::Symbol symbol = _terms.intern(term);
+        if (symbol >= _postings.size()) {
+            _postings.resize(symbol + 1);
+        }
+
+        std::vector<std::uint64_t>& ids = _postings[symbol]._ids;
+        if (ids.empty() || ids.back() < id) {
+            ids.push_back(id);
+        } else {
+            // Titles added out of order, e.g. read back from the disk
+            ids.insert(std::upper_bound(ids.begin() + _postings[symbol]._head, ids.end(), id), id);
+        }
+    }
+    _postingCount += terms.size();
+    ++_documentCount;
+}
+
+void TitleIndex::remove(std::uint64_t id, const std::string& title)
+{
+    std::vector<std::string> terms;
+    tokenize(title, terms);
+
+    for (const std::string& term : terms) {
+        SymbolTable::Symbol symbol;
+        if (!_terms.find(term, symbol)) {
+            continue;
+        }
+
+        PostingList& postingList = _postings[symbol];
+        std::vector<std::uint64_t>& ids = postingList._ids;
+        if (postingList._head < ids.size() && ids[postingList._head] == id) {
+            // Common case: the oldest title goes first
+            ++postingList._head;
+        } else {
+            const auto position = std::lower_bound(ids.begin() + postingList._head, ids.end(), id);
+            if (ids.end() == position || *position != id) {
+                continue;
+            }
+            ids.erase(position);
+        }
+        --_postingCount;
+
+        if (postingList._head == ids.size()) {
+            // Give the memory back, the symbol might be recycled for a
+            // completely different term
+            std::vector<std::uint64_t>().swap(ids);
+            postingList._head = 0;
+        } else if (2 * postingList._head >= ids.size()) {
+            ids.erase(ids.begin(), ids.begin() + postingList._head);
+            postingList._head = 0;
+        }
+        _terms.release(symbol);
+    }
+    --_documentCount;
+}
+
+std::vector<TitleSearchResult> TitleIndex::search(const std::string& query, size_t maxResultCount) const
+{
+    std::vector<TitleSearchResult> results;
+    std::vector<std::string> terms;
+    tokenize(query, terms);
+    if (terms.size() > MAX_QUERY_TERM_COUNT) {
+        terms.resize(MAX_QUERY_TERM_COUNT);
+    }
+    if (0 == maxResultCount) {
+        return results;
+    }
+
+    // Posting lists are walked backwards, from the newest id to the oldest:
+    // ties are settled in favor of the first scored title
+    struct Cursor
+    {
+        const std::uint64_t* _begin;
+        /**
+         * One past the next id to be scored
+         */
+        const std::uint64_t* _end;
+        double _idf;
+        /**
+         * Highest score of a title only containing this term and the ones
+         * before it (lower idfs)
+         */
+        double _maxScore;
+    };
+    std::vector<Cursor> cursors;
+    for (const std::string& term : terms) {
+        SymbolTable::Symbol symbol;
+        if (!_terms.find(term, symbol)) {
+            continue;
+        }
+        const PostingList& postingList = _postings[symbol];
+        const double documentFrequency = static_cast<double>(postingList._ids.size() - postingList._head);
+        // BM25 inverse document frequency, always positive
+        const double idf = std::log(1.0 + (_documentCount - documentFrequency + 0.5) / (documentFrequency + 0.5));
+        cursors.push_back(Cursor{postingList._ids.data() + postingList._head,
+                                 postingList._ids.data() + postingList._ids.size(), idf, 0});
+    }
+    std::sort(cursors.begin(), cursors.end(), [](const Cursor& a, const Cursor& b) {
+        return a._idf < b._idf;
+    });
+    double maxScore = 0;
+    for (Cursor& cursor : cursors) {
+        maxScore += cursor._idf;
+        cursor._maxScore = maxScore;
+    }
+
+    // Best results so far, the worst one on top
+    const auto isBetter = [](const TitleSearchResult& a, const TitleSearchResult& b) {
+        return a._score > b._score || (a._score == b._score && a._id > b._id);
+    };
+    std::priority_queue<TitleSearchResult, std::vector<TitleSearchResult>, decltype(isBetter)> best(isBetter);
+
+    // MaxScore: once the results are full, titles only made of the first
+    // (non-essential) terms can't compete anymore. Candidates are then only
+    // taken from the essential terms' lists, the other lists being searched
+    // for them.
+    size_t firstEssential = 0;
+    while (firstEssential < cursors.size()) {
+        std::uint64_t id = 0;
+        bool found = false;
+        for (size_t i = firstEssential; i < cursors.size(); ++i) {
+            if (cursors[i]._end != cursors[i]._begin && (!found || *(cursors[i]._end - 1) > id)) {
+                id = *(cursors[i]._end - 1);
+                found = true;
+            }
+        }
+        if (!found) {
+            break;
+        }
+
+        double score = 0;
+        for (size_t i = firstEssential; i < cursors.size(); ++i) {
+            Cursor& cursor = cursors[i];
+            if (cursor._end != cursor._begin && *(cursor._end - 1) == id) {
+                score += cursor._idf;
+                --cursor._end;
+            }
+        }
+        for (size_t i = firstEssential; i > 0; --i) {
+            Cursor& cursor = cursors[i - 1];
+            if (best.size() == maxResultCount && score + cursor._maxScore <= best.top()._score) {
+                break;
+            }
+            cursor._end = std::upper_bound(cursor._begin, cursor._end, id);
+            if (cursor._end != cursor._begin && *(cursor._end - 1) == id) {
+                score += cursor._idf;
+                --cursor._end;
+            }
+        }
+
+        if (best.size() < maxResultCount) {
+            best.push(TitleSearchResult{id, score});
+        } else if (score > best.top()._score) {
+            best.pop();
+            best.push(TitleSearchResult{id, score});
+        } else {
+            continue;
+        }
+        if (best.size() == maxResultCount) {
+            while (firstEssential < cursors.size()
+                   && cursors[firstEssential]._maxScore <= best.top()._score) {
+                ++firstEssential;
+            }
+        }
+    }
+
+    results.resize(best.size());
+    for (auto iterator = results.rbegin(); iterator != results.rend(); ++iterator) {
+        *iterator = best.top();
+        best.pop();
+    }
+    return results;
+}
+
+void TitleIndex::clear()
+{
+    _terms.clear();
+    _postings.clear();
+    _documentCount = 0;
+    _postingCount = 0;
+}
+
+size_t TitleIndex::getDocumentCount() const
+{
+    return _documentCount;
+}
+
+size_t TitleIndex::getTermCount() const
+{
+    return _terms.getSize();
+}
+
+size_t TitleIndex::getPostingCount() const
+{
+    return _postingCount;
+}
+
+}
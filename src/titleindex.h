@@ -0,0 +1,152 @@
+/*
+ * Copyright (c) 2015, Romain Létendart
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "symboltable.h"
+
+namespace geecxx
+{
+
+/**
+ * Search result: id of a matching title and its relevance
+ */
+struct TitleSearchResult
+{
+    std::uint64_t _id;
+    double _score;
+};
+
+/**
+ * The TitleIndex class is an incremental inverted index of page titles.
+ *
+ * Titles are split into normalized terms (see tokenize()). Each term maps to
+ * the sorted list of ids of the titles containing it. As ids only ever
+ * increase and the oldest titles are the first ones to be removed, adding
+ * and removing a title are (amortized) constant time operations per term.
+ *
+ * Searches return the titles containing any of the query terms. Titles are
+ * ranked by the sum of the inverse document frequencies of the terms they
+ * contain, so that rare terms weigh more than common ones, then newest
+ * first.
+ */
+class TitleIndex
+{
+public:
+    /**
+     * Split a text into normalized terms
+     *
+     * Terms are made of letters, digits and non-ASCII characters. ASCII and
+     * Latin-1 letters are case-folded. Terms shorter than 2 bytes are
+     * skipped, duplicates are only returned once.
+     * @param[in] text text to be split
+     * @param[out] terms normalized terms of the text
+     */
+    static void tokenize(const std::string& text, std::vector<std::string>& terms);
+
+    /**
+     * Add a title to the index
+     *
+     * @param[in] id id of the title, unique
+     * @param[in] title title to be indexed
+     */
+    void add(std::uint64_t id, const std::string& title);
+
+    /**
+     * Remove a title from the index
+     *
+     * @param[in] id id of the title
+     * @param[in] title title as it was given to add()
+     */
+    void remove(std::uint64_t id, const std::string& title);
+
+    /**
+     * Look for titles matching a query
+     *
+     * @param[in] query free text query, normalized like titles
+     * @param[in] maxResultCount maximum number of results
+     * @return matching titles, most relevant first
+     */
+    std::vector<TitleSearchResult> search(const std::string& query, size_t maxResultCount) const;
+
+    /**
+     * Remove every title from the index
+     */
+    void clear();
+
+    /**
+     * Get number of indexed titles
+     * @return number of titles
+     */
+    size_t getDocumentCount() const;
+
+    /**
+     * Get number of distinct terms
+     * @return number of terms
+     */
+    size_t getTermCount() const;
+
+    /**
+     * Get number of (term, title) pairs
+     * @return number of postings
+     */
+    size_t getPostingCount() const;
+
+private:
+    /**
+     * Maximum number of terms of a query, extra ones are ignored
+     */
+    static const size_t MAX_QUERY_TERM_COUNT = 8;
+
+    /**
+     * Ids of the titles containing a term, in increasing order
+     *
+     * Ids before _head have been removed, they are only erased once they
+     * make up half of the list.
+     */
+    struct PostingList
+    {
+        std::vector<std::uint64_t> _ids;
+        size_t _head = 0;
+    };
+
+    /**
+     * Terms, reference counts being document frequencies
+     */
+    SymbolTable _terms;
+
+    /**
+     * Posting lists, indexed by term symbol
+     */
+    std::vector<PostingList> _postings;
+
+    size_t _documentCount = 0;
+    size_t _postingCount = 0;
+};
+
+}
@@ -0,0 +1,215 @@
+/*
+ * Copyright (c) 2015, Romain Létendart
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "trace.h"
+
+#include <algorithm>
+#include <vector>
+
+#include "logger.h"
+#include "logsink.h"
+
+namespace geecxx
+{
+
+thread_local Trace* Trace::_current = nullptr;
+
+Trace::Trace(const char* name, Clock::time_point start)
+    : _name(name), _start(start)
+{
+}
+
+void Trace::addSpan(const char* name, Clock::time_point start, Clock::time_point end)
+{
+    if (_spanCount == MAX_SPAN_COUNT) {
+        ++_droppedSpanCount;
+        return;
+    }
+    const std::uint64_t startUs = toUs(start);
+    _spans[_spanCount++] = TraceSpan{name, startUs, std::max(toUs(end), startUs) - startUs, _depth};
+}
+
+void Trace::addLabel(const std::string& label)
+{
+    if (!_label.empty()) {
+        _label.push_back(' ');
+    }
+    _label.append(label);
+}
+
+void Trace::finish(Clock::time_point end)
+{
+    _durationUs = toUs(end);
+}
+
+const char* Trace::getName() const
+{
+    return _name;
+}
+
+const std::string& Trace::getLabel() const
+{
+    return _label;
+}
+
+Trace::Clock::time_point Trace::getStart() const
+{
+    return _start;
+}
+
+std::uint64_t Trace::getDurationUs() const
+{
+    return _durationUs;
+}
+
+size_t Trace::getSpanCount() const
+{
+    return _spanCount;
+}
+
+const TraceSpan& Trace::getSpan(size_t index) const
+{
+    return _spans[index];
+}
+
+size_t Trace::getDroppedSpanCount() const
+{
+    return _droppedSpanCount;
+}
+
+std::uint64_t Trace::toUs(Clock::time_point time) const
+{
+    if (time <= _start) {
+        return 0;
+    }
+    return std::chrono::duration_cast<std::chrono::microseconds>(time - _start).count();
+}
+
+Tracer& Tracer::getInstance()
+{
+    // Static variable initialization ensures threadsafety in C++11 standard
+    static Tracer tracer;
+    return tracer;
+}
+
+void Tracer::setThreshold(std::uint64_t thresholdUs)
+{
+    _thresholdUs.store(thresholdUs, std::memory_order_relaxed);
+}
+
+void Tracer::setSampleRate(std::uint64_t sampleRate)
+{
+    _sampleRate.store(std::max<std::uint64_t>(sampleRate, 1), std::memory_order_relaxed);
+}
+
+bool Tracer::openTraceFile(const std::string& filePath)
+{
+    std::lock_guard<std::mutex> lock(_fileMutex);
+    _file.close();
+    _file.clear();
+    _file.open(filePath, std::ios::out | std::ios::trunc);
+    if (!_file) {
+        LOG_ERROR("Couldn't open trace file ", filePath);
+        return false;
+    }
+    // The closing bracket is optional in the trace event format, which
+    // allows appending events until the end
+    _file << "[\n";
+    _file.flush();
+    return true;
+}
+
+bool Tracer::submit(const Trace& trace)
+{
+    const std::uint64_t thresholdUs = _thresholdUs.load(std::memory_order_relaxed);
+    if (0 == thresholdUs || trace.getDurationUs() < thresholdUs) {
+        return false;
+    }
+    const std::uint64_t slowTraceCount = _slowTraceCount.fetch_add(1, std::memory_order_relaxed);
+    if (0 != slowTraceCount % _sampleRate.load(std::memory_order_relaxed)) {
+        return false;
+    }
+
+    // Spans are added as they end, list them as they start, each under the
+    // path of the spans it is nested in, e.g. process_url/fetch/dns=12us
+    std::vector<size_t> order(trace.getSpanCount());
+    for (size_t i = 0; i < order.size(); ++i) {
+        order[i] = i;
+    }
+    std::stable_sort(order.begin(), order.end(), [&trace](size_t a, size_t b) {
+        const TraceSpan& spanA = trace.getSpan(a);
+        const TraceSpan& spanB = trace.getSpan(b);
+        return spanA._startUs < spanB._startUs
+               || (spanA._startUs == spanB._startUs && spanA._depth < spanB._depth);
+    });
+    std::string breakdown;
+    std::vector<const char*> path;
+    for (const size_t index : order) {
+        const TraceSpan& span = trace.getSpan(index);
+        path.resize(std::min<size_t>(span._depth, path.size()));
+        path.push_back(span._name);
+        if (!breakdown.empty()) {
+            breakdown.push_back(' ');
+        }
+        for (size_t i = 0; i < path.size(); ++i) {
+            breakdown.append(0 == i ? "" : "/").append(path[i]);
+        }
+        breakdown.append("=").append(std::to_string(span._durationUs)).append("us");
+    }
+    LOG_WARNING("Slow ", trace.getName(), ": ", breakdown, logField("trace_us", trace.getDurationUs()),
+                logField("urls", trace.getLabel()));
+
+    std::lock_guard<std::mutex> lock(_fileMutex);
+    if (_file.is_open()) {
+        std::string json;
+        appendChromeEvents(trace, json);
+        _file << json;
+        _file.flush();
+    }
+    return true;
+}
+
+void Tracer::appendChromeEvents(const Trace& trace, std::string& json)
+{
+    const std::uint64_t startUs = std::chrono::duration_cast<std::chrono::microseconds>(
+            trace.getStart().time_since_epoch()).count();
+    const auto appendEvent = [&json](const char* name, std::uint64_t timestampUs, std::uint64_t durationUs) {
+        json.append("{\"name\":\"");
+        LogSink::appendJsonString(name, std::char_traits<char>::length(name), json);
+        json.append("\",\"cat\":\"geecxx\",\"ph\":\"X\",\"ts\":").append(std::to_string(timestampUs));
+        json.append(",\"dur\":").append(std::to_string(durationUs)).append(",\"pid\":1,\"tid\":1");
+    };
+
+    appendEvent(trace.getName(), startUs, trace.getDurationUs());
+    json.append(",\"args\":{\"urls\":\"");
+    LogSink::appendJsonString(trace.getLabel().data(), trace.getLabel().size(), json);
+    json.append("\"}},\n");
+    for (size_t i = 0; i < trace.getSpanCount(); ++i) {
+        const TraceSpan& span = trace.getSpan(i);
+        appendEvent(span._name, startUs + span._startUs, span._durationUs);
+        json.append("},\n");
+    }
+}
+
+}
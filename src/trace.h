@@ -0,0 +1,264 @@
+/*
+ * Copyright (c) 2015, Romain Létendart
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+
+namespace geecxx
+{
+
+/**
+ * Timed step of a trace, relative to the beginning of the trace
+ */
+struct TraceSpan
+{
+    /**
+     * Name of the step, must be a string literal
+     */
+    const char* _name;
+    std::uint64_t _startUs;
+    std::uint64_t _durationUs;
+    /**
+     * Number of spans the span is nested in
+     */
+    unsigned int _depth;
+};
+
+/**
+ * The Trace class records how long each step of handling a line took, from
+ * its receipt to the reply.
+ *
+ * Spans are kept in a fixed array so that tracing a line doesn't allocate,
+ * spans beyond MAX_SPAN_COUNT are counted but dropped. A trace is meant to
+ * be used by a single thread, which makes it current so that the code
+ * handling the line can add spans without having it passed along (see
+ * ScopedSpan).
+ */
+class Trace
+{
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    static const size_t MAX_SPAN_COUNT = 32;
+
+    /**
+     * Constructor, starts the trace
+     * @param[in] name name of the whole trace, must be a string literal
+     * @param[in] start time the traced operation started at
+     */
+    explicit Trace(const char* name, Clock::time_point start = Clock::now());
+
+    Trace(const Trace&) = delete;
+    Trace& operator=(const Trace&) = delete;
+
+    /**
+     * Get the trace of the current thread
+     * @return current trace, nullptr if none
+     */
+    static Trace* getCurrent()
+    {
+        return _current;
+    }
+
+    /**
+     * Make a trace the current one of the calling thread
+     * @param[in] trace trace, nullptr for none
+     */
+    static void setCurrent(Trace* trace)
+    {
+        _current = trace;
+    }
+
+    /**
+     * Add a span nested in the spans currently open
+     * @param[in] name name of the step, must be a string literal
+     * @param[in] start time the step started at
+     * @param[in] end time the step ended at
+     */
+    void addSpan(const char* name, Clock::time_point start, Clock::time_point end);
+
+    /**
+     * Open a span, spans added until it is closed are nested in it
+     */
+    void openSpan()
+    {
+        ++_depth;
+    }
+
+    /**
+     * Close the span opened last, then add it
+     * @param[in] name name of the step, must be a string literal
+     * @param[in] start time the step started at
+     * @param[in] end time the step ended at
+     */
+    void closeSpan(const char* name, Clock::time_point start, Clock::time_point end)
+    {
+        --_depth;
+        addSpan(name, start, end);
+    }
+
+    /**
+     * Describe what is being traced (e.g. the URLs of a line)
+     * @param[in] label text appended to the current label, separated by a space
+     */
+    void addLabel(const std::string& label);
+
+    /**
+     * End the trace
+     * @param[in] end time the traced operation ended at
+     */
+    void finish(Clock::time_point end = Clock::now());
+
+    const char* getName() const;
+    const std::string& getLabel() const;
+    Clock::time_point getStart() const;
+    std::uint64_t getDurationUs() const;
+    size_t getSpanCount() const;
+    const TraceSpan& getSpan(size_t index) const;
+    size_t getDroppedSpanCount() const;
+
+private:
+    std::uint64_t toUs(Clock::time_point time) const;
+
+    static thread_local Trace* _current;
+
+    const char* _name;
+    std::string _label;
+    Clock::time_point _start;
+    std::uint64_t _durationUs = 0;
+    unsigned int _depth = 0;
+    std::array<TraceSpan, MAX_SPAN_COUNT> _spans;
+    size_t _spanCount = 0;
+    size_t _droppedSpanCount = 0;
+};
+
+/**
+ * Time the enclosing scope as a span of the current trace, if any
+ */
+class ScopedSpan
+{
+public:
+    explicit ScopedSpan(const char* name)
+        : _name(name), _trace(Trace::getCurrent())
+    {
+        if (nullptr != _trace) {
+            _trace->openSpan();
+            _start = Trace::Clock::now();
+        }
+    }
+
+    ScopedSpan(const ScopedSpan&) = delete;
+    ScopedSpan& operator=(const ScopedSpan&) = delete;
+
+    ~ScopedSpan()
+    {
+        if (nullptr != _trace) {
+            _trace->closeSpan(_name, _start, Trace::Clock::now());
+        }
+    }
+
+private:
+    const char* _name;
+    Trace* _trace;
+    Trace::Clock::time_point _start;
+};
+
+/**
+ * The Tracer class decides which traces are worth reporting.
+ *
+ * Traces longer than a threshold are slow, one in every N of them is logged
+ * as a warning with the duration of each span and, if a trace file is
+ * open, written to it in the Chrome trace event format (to be loaded in
+ * chrome://tracing or Perfetto). Tracing is disabled until a threshold is
+ * set, traces are then only started when isEnabled() says so.
+ */
+class Tracer
+{
+public:
+    Tracer(const Tracer&) = delete;
+    Tracer& operator=(const Tracer&) = delete;
+
+    static Tracer& getInstance();
+
+    bool isEnabled() const
+    {
+        return 0 != _thresholdUs.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * Set the duration above which traces are reported
+     * @param[in] thresholdUs threshold in microseconds, 0 to disable tracing
+     */
+    void setThreshold(std::uint64_t thresholdUs);
+
+    /**
+     * Report one slow trace out of sampleRate
+     * @param[in] sampleRate N, to report one slow trace in N (at least 1)
+     */
+    void setSampleRate(std::uint64_t sampleRate);
+
+    /**
+     * Also write reported traces to a file, in the Chrome trace event format
+     * @param[in] filePath path to the trace file, truncated
+     * @return true upon success, false otherwise
+     */
+    bool openTraceFile(const std::string& filePath);
+
+    /**
+     * Report a finished trace if it is slow and sampled
+     * @param[in] trace finished trace
+     * @return true if the trace has been reported, false otherwise
+     */
+    bool submit(const Trace& trace);
+
+    /**
+     * Append the events of a trace in the Chrome trace event format, each
+     * followed by ",\n"
+     * @param[in] trace finished trace
+     * @param[out] json text the events are appended to
+     */
+    static void appendChromeEvents(const Trace& trace, std::string& json);
+
+private:
+    Tracer() = default;
+
+    std::atomic<std::uint64_t> _thresholdUs{0};
+    std::atomic<std::uint64_t> _sampleRate{1};
+    std::atomic<std::uint64_t> _slowTraceCount{0};
+
+    /**
+     * Guards the trace file
+     */
+    std::mutex _fileMutex;
+    std::ofstream _file;
+};
+
+}
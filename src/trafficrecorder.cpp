@@ -0,0 +1,183 @@
+/*
+ * Copyright (c) 2015, Romain Létendart
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#define GEECXX_LOG_MODULE geecxx::LogModule::CONNECTION
+
+#include "trafficrecorder.h"
+
+#include <cstring>
+
+#include "logger.h"
+
+namespace geecxx
+{
+
+const char TrafficRecorder::HEADER[8] = {'G', 'X', 'T', 'R', 'A', 'F', '\0', '\1'};
+
+TrafficRecorder::TrafficRecorder(std::string filePath)
+    : _filePath(std::move(filePath))
+{
+}
+
+TrafficRecorder::~TrafficRecorder()
+{
+    flush();
+}
+
+bool TrafficRecorder::open()
+{
+    _file.open(_filePath, std::ios::binary | std::ios::trunc);
+    if (!_file) {
+        LOG_ERROR("Couldn't open traffic file ", _filePath);
+        return false;
+    }
+    _file.write(HEADER, sizeof(HEADER));
+    _start = Clock::now();
+    _unflushedCount = 0;
+    return true;
+}
+
+void TrafficRecorder::recordLine(std::string_view line)
+{
+    writeRecord(RecordKind::LINE, std::string_view(), line);
+}
+
+void TrafficRecorder::recordTitle(std::string_view url, bool found, std::string_view title)
+{
+    if (!found) {
+        writeRecord(RecordKind::MISSING_TITLE, std::string_view(), url);
+        return;
+    }
+    const std::uint32_t urlSize = static_cast<std::uint32_t>(url.size());
+    char prefix[sizeof(urlSize)];
+    std::memcpy(prefix, &urlSize, sizeof(urlSize));
+    std::string payload;
+    payload.reserve(url.size() + title.size());
+    payload.append(url).append(title);
+    writeRecord(RecordKind::TITLE, std::string_view(prefix, sizeof(prefix)), payload);
+}
+
+void TrafficRecorder::flush()
+{
+    if (_file.is_open()) {
+        _file.flush();
+    }
+    _unflushedCount = 0;
+}
+
+void TrafficRecorder::writeRecord(RecordKind kind, std::string_view prefix, std::string_view payload)
+{
+    if (!_file.is_open()) {
+        return;
+    }
+    const std::uint8_t kindByte = static_cast<std::uint8_t>(kind);
+    const std::uint64_t timeUs = std::chrono::duration_cast<std::chrono::microseconds>(
+                                     Clock::now() - _start).count();
+    const std::uint32_t size = static_cast<std::uint32_t>(prefix.size() + payload.size());
+    _file.write(reinterpret_cast<const char*>(&kindByte), sizeof(kindByte));
+    _file.write(reinterpret_cast<const char*>(&timeUs), sizeof(timeUs));
+    _file.write(reinterpret_cast<const char*>(&size), sizeof(size));
+    _file.write(prefix.data(), prefix.size());
+    _file.write(payload.data(), payload.size());
+    if (!_file) {
+        LOG_ERROR("Couldn't write to traffic file ", _filePath, ", recording stopped");
+        _file.close();
+    } else if (++_unflushedCount >= FLUSH_INTERVAL) {
+        flush();
+    }
+}
+
+bool TrafficRecording::load(const std::string& filePath)
+{
+    _lines.clear();
+    _titles = std::make_shared<TitleFixtures>();
+
+    std::ifstream file(filePath, std::ios::binary);
+    if (!file) {
+        LOG_ERROR("Couldn't open traffic file ", filePath);
+        return false;
+    }
+    char header[sizeof(TrafficRecorder::HEADER)];
+    if (!file.read(header, sizeof(header)) || 0 != std::memcmp(header, TrafficRecorder::HEADER, sizeof(header))) {
+        LOG_ERROR(filePath, " is not a traffic file");
+        return false;
+    }
+
+    std::string payload;
+    std::uint8_t kind;
+    while (file.read(reinterpret_cast<char*>(&kind), sizeof(kind))) {
+        std::uint64_t timeUs;
+        std::uint32_t size;
+        if (!file.read(reinterpret_cast<char*>(&timeUs), sizeof(timeUs))
+            || !file.read(reinterpret_cast<char*>(&size), sizeof(size))) {
+            LOG_ERROR(filePath, ": truncated record after ", _lines.size(), " line(s)");
+            return false;
+        }
+        payload.resize(size);
+        if (!file.read(&payload[0], size)) {
+            LOG_ERROR(filePath, ": truncated record after ", _lines.size(), " line(s)");
+            return false;
+        }
+
+        switch (static_cast<TrafficRecorder::RecordKind>(kind)) {
+        case TrafficRecorder::RecordKind::LINE:
+            _lines.push_back(RecordedLine{timeUs, payload});
+            break;
+        case TrafficRecorder::RecordKind::TITLE: {
+            std::uint32_t urlSize;
+            if (payload.size() < sizeof(urlSize)) {
+                LOG_ERROR(filePath, ": invalid title record after ", _lines.size(), " line(s)");
+                return false;
+            }
+            std::memcpy(&urlSize, payload.data(), sizeof(urlSize));
+            if (payload.size() - sizeof(urlSize) < urlSize) {
+                LOG_ERROR(filePath, ": invalid title record after ", _lines.size(), " line(s)");
+                return false;
+            }
+            (*_titles)[payload.substr(sizeof(urlSize), urlSize)] =
+                    RecordedTitle{true, payload.substr(sizeof(urlSize) + urlSize)};
+            break;
+        }
+        case TrafficRecorder::RecordKind::MISSING_TITLE:
+            (*_titles)[payload] = RecordedTitle{false, std::string()};
+            break;
+        default:
+            LOG_ERROR(filePath, ": unknown record kind ", static_cast<unsigned int>(kind));
+            return false;
+        }
+    }
+    return true;
+}
+
+const std::vector<RecordedLine>& TrafficRecording::getLines() const
+{
+    return _lines;
+}
+
+std::shared_ptr<const TitleFixtures> TrafficRecording::getTitles() const
+{
+    return _titles;
+}
+
+}
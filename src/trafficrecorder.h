@@ -0,0 +1,183 @@
+/*
+ * Copyright (c) 2015, Romain Létendart
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace geecxx
+{
+
+/**
+ * Line received from the IRC server, as recorded
+ */
+struct RecordedLine
+{
+    /**
+     * Time the line was received at, in microseconds since the recording
+     * started
+     */
+    std::uint64_t _timeUs;
+    std::string _line;
+};
+
+/**
+ * Result of a page title retrieval, as recorded
+ */
+struct RecordedTitle
+{
+    /**
+     * Whether the retrieval succeeded, the title being meaningless otherwise
+     */
+    bool _found;
+    std::string _title;
+};
+
+/**
+ * Recorded page titles, by URL
+ */
+typedef std::unordered_map<std::string, RecordedTitle> TitleFixtures;
+
+/**
+ * The TrafficRecorder class writes the lines received from the IRC server,
+ * and the titles retrieved for the URLs they contain, to a file from which
+ * the session can be replayed (see TrafficRecording and geecxx-replay).
+ *
+ * The file starts with HEADER, then each record is made of an 8-bit kind
+ * (RecordKind), a 64-bit time in microseconds since the recording started,
+ * a 32-bit payload size and the payload, in host byte order. The payload of
+ * a line is the line without "\r\n", that of a title is the 32-bit size of
+ * the URL, the URL and the title.
+ *
+ * Records are buffered by the file stream, a recorder is meant to be used
+ * by the connection's thread only.
+ */
+class TrafficRecorder
+{
+public:
+    /**
+     * Magic string and version at the beginning of traffic files
+     */
+    static const char HEADER[8];
+
+    enum class RecordKind : std::uint8_t
+    {
+        LINE,
+        TITLE,
+        /**
+         * Title retrieval which failed, the payload is the URL only
+         */
+        MISSING_TITLE
+    };
+
+    typedef std::chrono::steady_clock Clock;
+
+    /**
+     * Constructor
+     * @param[in] filePath path to the traffic file, truncated on open()
+     */
+    explicit TrafficRecorder(std::string filePath);
+
+    TrafficRecorder(const TrafficRecorder&) = delete;
+    TrafficRecorder& operator=(const TrafficRecorder&) = delete;
+
+    ~TrafficRecorder();
+
+    /**
+     * Open the traffic file and start the recording
+     * @return true upon success, false otherwise
+     */
+    bool open();
+
+    /**
+     * Record a line received from the IRC server
+     * @param[in] line the line, without "\r\n"
+     */
+    void recordLine(std::string_view line);
+
+    /**
+     * Record the result of a page title retrieval
+     * @param[in] url URL of the page
+     * @param[in] found whether the retrieval succeeded
+     * @param[in] title title of the page, ignored if it wasn't found
+     */
+    void recordTitle(std::string_view url, bool found, std::string_view title);
+
+    /**
+     * Write buffered records to the file
+     */
+    void flush();
+
+private:
+    void writeRecord(RecordKind kind, std::string_view prefix, std::string_view payload);
+
+    /**
+     * Records written between two flushes
+     */
+    static const size_t FLUSH_INTERVAL = 64;
+
+    const std::string _filePath;
+    std::ofstream _file;
+    Clock::time_point _start;
+    size_t _unflushedCount = 0;
+};
+
+/**
+ * The TrafficRecording class reads a file written by a TrafficRecorder.
+ */
+class TrafficRecording
+{
+public:
+    /**
+     * Read a traffic file
+     * @param[in] filePath path to the traffic file
+     * @return true upon success, false if the file is missing or invalid
+     */
+    bool load(const std::string& filePath);
+
+    /**
+     * Get the lines received, in order
+     * @return recorded lines
+     */
+    const std::vector<RecordedLine>& getLines() const;
+
+    /**
+     * Get the titles retrieved, the last one of a URL winning
+     * @return recorded titles
+     */
+    std::shared_ptr<const TitleFixtures> getTitles() const;
+
+private:
+    std::vector<RecordedLine> _lines;
+    std::shared_ptr<TitleFixtures> _titles = std::make_shared<TitleFixtures>();
+};
+
+}
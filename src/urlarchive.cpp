@@ -0,0 +1,358 @@
+/*
+ * Copyright (c) 2015, Romain Létendart
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#define GEECXX_LOG_MODULE geecxx::LogModule::HISTORY
+
+#include "urlarchive.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <sys/stat.h>
+
+#include "logger.h"
+
+namespace
+{
+
+std::uint64_t hashUrl(const std::string& url)
+{
+    // FNV-1a: bucket files are persistent, the hash must never change
+    std::uint64_t hash = 14695981039346656037ull;
+    for (const char c : url) {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+// Record locations keep the upper bits of the URL hash as a fingerprint, and
+// the record position in the remaining bits: 1 TiB per bucket file
+const unsigned RECORD_OFFSET_BITS = 40;
+const std::uint64_t RECORD_OFFSET_MASK = (std::uint64_t(1) << RECORD_OFFSET_BITS) - 1;
+
+std::uint64_t getFingerprint(std::uint64_t hash)
+{
+    return hash >> RECORD_OFFSET_BITS;
+}
+
+}
+
+namespace geecxx
+{
+
+UrlArchive::UrlArchive(std::string directoryPath, size_t expectedUrlCount,
+                       double falsePositiveRate, size_t bucketCount)
+    : _directoryPath(std::move(directoryPath)), _filterFilePath(_directoryPath + "/filter.bin"),
+      _bucketCount(std::max<size_t>(bucketCount, 1)), _filter(expectedUrlCount, falsePositiveRate),
+      _recordLocations(_bucketCount)
+{
+}
+
+bool UrlArchive::init()
+{
+    if (0 != mkdir(_directoryPath.c_str(), 0755) && EEXIST != errno) {
+        LOG_ERROR("Couldn't create URL archive directory ", _directoryPath, ": ", std::strerror(errno));
+        return false;
+    }
+
+    std::lock_guard<std::mutex> fileLock(_fileMutex);
+    BloomFilter filter(_filter.getExpectedItemCount(), _filter.getTargetFalsePositiveRate());
+    const bool rebuildFilter = !filter.loadFromFile(_filterFilePath)
+        || filter.getExpectedItemCount() != _filter.getExpectedItemCount()
+        || filter.getTargetFalsePositiveRate() != _filter.getTargetFalsePositiveRate();
+    if (rebuildFilter) {
+        // The filter is missing or has been sized differently: every archived
+        // URL has to be added again
+        LOG_INFO("Rebuilding URL archive filter from ", _directoryPath);
+        filter = BloomFilter(_filter.getExpectedItemCount(), _filter.getTargetFalsePositiveRate());
+    }
+
+    std::vector<std::vector<std::uint64_t>> recordLocations(_bucketCount);
+    for (size_t bucket = 0; bucket < _bucketCount; ++bucket) {
+        const bool success = readBucketFile(getBucketFilePath(bucket),
+                                            [this, rebuildFilter, &filter, &recordLocations]
+                                            (const UrlHistoryRecord& record, std::uint64_t offset) {
+            if (rebuildFilter) {
+                filter.add(record._url);
+            }
+            indexRecord(record._url, offset, recordLocations);
+            return true;
+        });
+        if (!success) {
+            return false;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    _filter = std::move(filter);
+    _filterChanged = rebuildFilter;
+    _recordLocations = std::move(recordLocations);
+    return true;
+}
+
+void UrlArchive::add(const std::string& formattedUrl)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    // URLs of the history are added again on every start
+    if (_filter.add(formattedUrl)) {
+        _filterChanged = true;
+    }
+}
+
+bool UrlArchive::mightContain(const std::string& formattedUrl)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    ++_stats._lookupCount;
+    if (!_filter.mightContain(formattedUrl)) {
+        ++_stats._avoidedLookupCount;
+        return false;
+    }
+    return true;
+}
+
+void UrlArchive::archive(const std::string& formattedUrl, const UrlHistoryEntry& entry)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _pendingRecords.push_back(UrlHistoryRecord{formattedUrl, entry});
+    ++_stats._archivedUrlCount;
+}
+
+bool UrlArchive::find(const std::string& formattedUrl, UrlHistoryEntry& entry)
+{
+    const std::uint64_t hash = hashUrl(formattedUrl);
+    const size_t bucket = static_cast<size_t>(hash % _bucketCount);
+    std::vector<std::uint64_t> offsets;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        // Records leave these lists only once they are on the disk and indexed
+        if (findRecord(_flushedRecords, formattedUrl, entry)
+            || findRecord(_pendingRecords, formattedUrl, entry)) {
+            ++_stats._coldHitCount;
+            return true;
+        }
+
+        for (const std::uint64_t location : _recordLocations[bucket]) {
+            if (getFingerprint(location) == getFingerprint(hash)) {
+                offsets.push_back(location & RECORD_OFFSET_MASK);
+            }
+        }
+    }
+
+    // Only records sharing the fingerprint of the URL are read, a false
+    // positive of the filter most likely doesn't read anything
+    bool found = false;
+    if (!offsets.empty()) {
+        std::lock_guard<std::mutex> fileLock(_fileMutex);
+        std::ifstream bucketFile(getBucketFilePath(bucket));
+        UrlHistoryRecord record;
+        for (const std::uint64_t offset : offsets) {
+            bucketFile.clear();
+            bucketFile.seekg(static_cast<std::streamoff>(offset));
+            if (readRecord(bucketFile, record) && record._url == formattedUrl) {
+                entry = record._entry;
+                found = true;
+                break;
+            }
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (found) {
+        ++_stats._coldHitCount;
+    } else {
+        ++_stats._falsePositiveCount;
+    }
+    return found;
+}
+
+bool UrlArchive::flush()
+{
+    std::lock_guard<std::mutex> fileLock(_fileMutex);
+
+    std::unique_ptr<BloomFilter> filter;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _flushedRecords.swap(_pendingRecords);
+        if (_filterChanged) {
+            filter.reset(new BloomFilter(_filter));
+            _filterChanged = false;
+        }
+    }
+
+    // The filter goes first: as every archived URL has been added to it
+    // beforehand, a failure in between leaves false positives behind, never
+    // false negatives
+    bool success = true;
+    if (filter && !filter->saveToFile(_filterFilePath)) {
+        success = false;
+    }
+
+    // Written records are only indexed once their file has been closed
+    std::vector<std::vector<std::uint64_t>> recordLocations(_bucketCount);
+    if (success && !_flushedRecords.empty()) {
+        std::map<size_t, std::vector<const UrlHistoryRecord*>> recordsByBucket;
+        for (const UrlHistoryRecord& record : _flushedRecords) {
+            recordsByBucket[static_cast<size_t>(hashUrl(record._url) % _bucketCount)].push_back(&record);
+        }
+
+        for (const auto& bucket : recordsByBucket) {
+            const std::string bucketFilePath = getBucketFilePath(bucket.first);
+            struct stat bucketFileStat;
+            std::uint64_t offset = 0 == stat(bucketFilePath.c_str(), &bucketFileStat) ? bucketFileStat.st_size : 0;
+            std::vector<std::uint64_t> bucketRecordLocations;
+            std::ofstream bucketFile(bucketFilePath, std::ios_base::app);
+            for (const UrlHistoryRecord* record : bucket.second) {
+                std::ostringstream recordText;
+                recordText << record->_url << '\n';
+                recordText << record->_entry._id << ' ' << record->_entry._insertionTime << ' '
+                           << record->_entry._lastSeenTime << '\n';
+                recordText << record->_entry._title << '\n';
+                recordText << record->_entry._messageAuthor << '\n';
+                const std::string text = recordText.str();
+                bucketFile << text;
+                indexRecord(record->_url, offset, recordLocations);
+                offset += text.size();
+            }
+            bucketFile.close();
+            if (!bucketFile) {
+                LOG_ERROR("Couldn't write URL archive file: ", bucketFilePath);
+                recordLocations[bucket.first].clear();
+                success = false;
+            }
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    for (size_t bucket = 0; bucket < _bucketCount; ++bucket) {
+        _recordLocations[bucket].insert(_recordLocations[bucket].end(), recordLocations[bucket].begin(),
+                                        recordLocations[bucket].end());
+    }
+    if (success) {
+        _flushedRecords.clear();
+    } else {
+        // Keep everything for the next attempt
+        _pendingRecords.insert(_pendingRecords.begin(), _flushedRecords.begin(), _flushedRecords.end());
+        _flushedRecords.clear();
+        _filterChanged = _filterChanged || filter;
+    }
+    return success;
+}
+
+UrlArchiveStats UrlArchive::getStats() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    UrlArchiveStats stats = _stats;
+    stats._filterBitCount = _filter.getBitCount();
+    stats._filterHashCount = _filter.getHashCount();
+    stats._filterItemCount = _filter.getItemCount();
+    stats._targetFalsePositiveRate = _filter.getTargetFalsePositiveRate();
+    stats._estimatedFalsePositiveRate = _filter.getEstimatedFalsePositiveRate();
+    return stats;
+}
+
+std::string UrlArchive::getBucketFilePath(const std::string& formattedUrl) const
+{
+    return getBucketFilePath(static_cast<size_t>(hashUrl(formattedUrl) % _bucketCount));
+}
+
+std::string UrlArchive::getBucketFilePath(size_t bucket) const
+{
+    char bucketFileName[48];
+    std::snprintf(bucketFileName, sizeof(bucketFileName), "/bucket-%03zu.txt", bucket);
+    return _directoryPath + bucketFileName;
+}
+
+bool UrlArchive::findRecord(const std::vector<UrlHistoryRecord>& records,
+                            const std::string& formattedUrl, UrlHistoryEntry& entry)
+{
+    // Oldest record first, that's who posted the URL in the first place
+    for (const UrlHistoryRecord& record : records) {
+        if (record._url == formattedUrl) {
+            entry = record._entry;
+            return true;
+        }
+    }
+    return false;
+}
+
+void UrlArchive::indexRecord(const std::string& formattedUrl, std::uint64_t offset,
+                             std::vector<std::vector<std::uint64_t>>& recordLocations) const
+{
+    if (offset > RECORD_OFFSET_MASK) {
+        LOG_ERROR("URL archive file too large to be indexed: ", getBucketFilePath(formattedUrl));
+        return;
+    }
+    const std::uint64_t hash = hashUrl(formattedUrl);
+    recordLocations[static_cast<size_t>(hash % _bucketCount)].push_back(
+        (getFingerprint(hash) << RECORD_OFFSET_BITS) | offset);
+}
+
+bool UrlArchive::readBucketFile(const std::string& bucketFilePath,
+                                const std::function<bool(const UrlHistoryRecord&, std::uint64_t)>& visitor)
+{
+    std::ifstream bucketFile(bucketFilePath);
+    if (!bucketFile) {
+        // Nothing archived in this bucket yet
+        return true;
+    }
+
+    UrlHistoryRecord record;
+    while (bucketFile.peek() != std::ifstream::traits_type::eof()) {
+        const std::uint64_t offset = static_cast<std::uint64_t>(bucketFile.tellg());
+        if (!readRecord(bucketFile, record)) {
+            LOG_ERROR("Truncated URL archive file: ", bucketFilePath);
+            return false;
+        }
+        if (!visitor(record, offset)) {
+            break;
+        }
+    }
+    return true;
+}
+
+bool UrlArchive::readRecord(std::istream& bucketFile, UrlHistoryRecord& record)
+{
+    std::string id;
+    if (!std::getline(bucketFile, record._url)
+        || !std::getline(bucketFile, id)
+        || !std::getline(bucketFile, record._entry._title)
+        || !std::getline(bucketFile, record._entry._messageAuthor)) {
+        return false;
+    }
+    // Times were added after ids, they may be missing
+    std::istringstream idLine(id);
+    record._entry._id = 0;
+    record._entry._insertionTime = 0;
+    record._entry._lastSeenTime = 0;
+    idLine >> record._entry._id >> record._entry._insertionTime >> record._entry._lastSeenTime;
+    return true;
+}
+
+}
@@ -0,0 +1,292 @@
+/*
+ * Copyright (c) 2015, Romain Létendart
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <istream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "globalconfig.h"
+
+#include "bloomfilter.h"
+#include "urlhistorymanager.h"
+
+namespace geecxx
+{
+
+/**
+ * Statistics about the URL archive and its membership filter
+ */
+struct UrlArchiveStats
+{
+    /**
+     * Size of the membership filter, in bits
+     */
+    size_t _filterBitCount = 0;
+
+    /**
+     * Number of bits set in the filter for every URL
+     */
+    size_t _filterHashCount = 0;
+
+    /**
+     * Number of URLs added to the filter
+     */
+    std::uint64_t _filterItemCount = 0;
+
+    /**
+     * False positive rate the filter has been sized for
+     */
+    double _targetFalsePositiveRate = 0;
+
+    /**
+     * False positive rate estimated from the number of URLs in the filter
+     */
+    double _estimatedFalsePositiveRate = 0;
+
+    /**
+     * Number of lookups that went through the filter
+     */
+    std::uint64_t _lookupCount = 0;
+
+    /**
+     * Number of lookups answered by the filter alone ("never seen")
+     */
+    std::uint64_t _avoidedLookupCount = 0;
+
+    /**
+     * Number of lookups answered by the cold store
+     */
+    std::uint64_t _coldHitCount = 0;
+
+    /**
+     * Number of lookups the filter let through for URLs that were found
+     * nowhere
+     */
+    std::uint64_t _falsePositiveCount = 0;
+
+    /**
+     * Number of URLs handed over to the cold store since startup
+     */
+    std::uint64_t _archivedUrlCount = 0;
+};
+
+/**
+ * The UrlArchive class keeps track of every URL ever posted, well beyond what
+ * the in-memory history holds.
+ *
+ * It is made of two parts:
+ *  - a membership filter of every URL ever added, which answers most "never
+ *    seen" lookups without touching the in-memory history nor the disk,
+ *  - a cold on-disk store of entries evicted from the in-memory history,
+ *    spread over bucket files by URL hash. The location of every record is
+ *    indexed in memory, so that a lookup reads that record only, and the
+ *    false positives of the filter don't touch the disk at all.
+ *
+ * Both are kept in a dedicated directory. Archived entries are kept in memory
+ * until flush() writes them, which is meant to happen on the history
+ * persister's thread. Every method is thread-safe.
+ */
+class UrlArchive
+{
+public:
+    /**
+     * Constructor
+     *
+     * @param[in] directoryPath directory holding the filter and cold store
+     * @param[in] expectedUrlCount number of URLs the filter is sized for
+     * @param[in] falsePositiveRate wanted false positive rate of the filter
+     * @param[in] bucketCount number of cold store files
+     */
+    UrlArchive(std::string directoryPath = GEECXX_LOCAL_DATA_DIR "url-archive",
+               size_t expectedUrlCount = 1000000, double falsePositiveRate = 0.01,
+               size_t bucketCount = 256);
+
+    UrlArchive(const UrlArchive&) = delete;
+    UrlArchive& operator=(const UrlArchive&) = delete;
+
+    /**
+     * Read the filter from the disk and index the cold store
+     *
+     * The directory is created if needed. The filter is rebuilt out of the
+     * cold store if its file is missing, invalid or has been sized for other
+     * parameters.
+     * @return true upon successful initialization
+     */
+    bool init();
+
+    /**
+     * Add a URL to the filter
+     * @param[in] formattedUrl URL, as formatted by stringutils::formatUrl()
+     */
+    void add(const std::string& formattedUrl);
+
+    /**
+     * Check whether a URL might have already been added
+     *
+     * @param[in] formattedUrl URL, as formatted by stringutils::formatUrl()
+     * @return false if the URL has never been added, true if it probably has
+     *         been
+     */
+    bool mightContain(const std::string& formattedUrl);
+
+    /**
+     * Hand an entry over to the cold store
+     *
+     * The entry is kept in memory until the next flush().
+     * @param[in] formattedUrl URL, as formatted by stringutils::formatUrl()
+     * @param[in] entry entry associated to the URL
+     */
+    void archive(const std::string& formattedUrl, const UrlHistoryEntry& entry);
+
+    /**
+     * Find an entry in the cold store
+     *
+     * Only meant to be called once the filter has let the URL through and the
+     * in-memory history doesn't know about it: a miss is counted as a false
+     * positive of the filter.
+     * @param[in] formattedUrl URL, as formatted by stringutils::formatUrl()
+     * @param[out] entry
+     * @return true if the entry has been found, false otherwise
+     */
+    bool find(const std::string& formattedUrl, UrlHistoryEntry& entry);
+
+    /**
+     * Write the filter and pending archived entries to the disk
+     *
+     * @return true upon successful writing
+     */
+    bool flush();
+
+    /**
+     * Get archive statistics
+     * @return copy of the current statistics
+     */
+    UrlArchiveStats getStats() const;
+
+private:
+    /**
+     * Get path to the cold store file holding the given URL
+     *
+     * @param[in] formattedUrl URL, as formatted by stringutils::formatUrl()
+     * @return path to the bucket file
+     */
+    std::string getBucketFilePath(const std::string& formattedUrl) const;
+
+    /**
+     * Get path to a cold store file
+     *
+     * @param[in] bucket index of the bucket, lower than _bucketCount
+     * @return path to the bucket file
+     */
+    std::string getBucketFilePath(size_t bucket) const;
+
+    /**
+     * Look for a URL in a list of records
+     *
+     * @param[in] records records to be searched
+     * @param[in] formattedUrl URL, as formatted by stringutils::formatUrl()
+     * @param[out] entry
+     * @return true if the URL has been found, false otherwise
+     */
+    static bool findRecord(const std::vector<UrlHistoryRecord>& records,
+                           const std::string& formattedUrl, UrlHistoryEntry& entry);
+
+    /**
+     * Index the location of a record
+     *
+     * @param[in] formattedUrl URL of the record
+     * @param[in] offset position of the record in its bucket file
+     * @param[in,out] recordLocations locations of the records, by bucket
+     */
+    void indexRecord(const std::string& formattedUrl, std::uint64_t offset,
+                     std::vector<std::vector<std::uint64_t>>& recordLocations) const;
+
+    /**
+     * Read a bucket file, one record at a time
+     *
+     * @param[in] bucketFilePath path to the bucket file
+     * @param[in] visitor called for each record along with its position in
+     *            the file, stops reading when it returns false
+     * @return false if the file couldn't be read entirely
+     */
+    static bool readBucketFile(const std::string& bucketFilePath,
+                               const std::function<bool(const UrlHistoryRecord&, std::uint64_t)>& visitor);
+
+    /**
+     * Read the record found at the current position of a bucket file
+     *
+     * @param[in,out] bucketFile bucket file
+     * @param[out] record
+     * @return false if there is no complete record there
+     */
+    static bool readRecord(std::istream& bucketFile, UrlHistoryRecord& record);
+
+    const std::string _directoryPath;
+    const std::string _filterFilePath;
+    const size_t _bucketCount;
+
+    /**
+     * Protects everything but files
+     */
+    mutable std::mutex _mutex;
+
+    /**
+     * Protects filter and bucket files
+     */
+    std::mutex _fileMutex;
+
+    BloomFilter _filter;
+
+    /**
+     * Whether the filter changed since it was last written
+     */
+    bool _filterChanged = false;
+
+    /**
+     * Records of every bucket file, in file order
+     *
+     * Each location packs a fingerprint of the URL hash in its upper bits and
+     * the position of the record in its lower bits.
+     */
+    std::vector<std::vector<std::uint64_t>> _recordLocations;
+
+    /**
+     * Archived entries waiting for the next flush
+     */
+    std::vector<UrlHistoryRecord> _pendingRecords;
+
+    /**
+     * Archived entries being written by flush()
+     */
+    std::vector<UrlHistoryRecord> _flushedRecords;
+
+    UrlArchiveStats _stats;
+};
+
+}
@@ -22,18 +22,62 @@
  * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
  * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
+#define GEECXX_LOG_MODULE geecxx::LogModule::HISTORY
+
 #include "urlhistorymanager.h"
 
 #include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <fstream>
+#include <sstream>
+#include <string_view>
 
+#include "metrics.h"
 #include "stringutils.h"
+#include "urlarchive.h"
+#include "urlrewriter.h"
 
 namespace geecxx
 {
 
+namespace
+{
+
+Counter& lookupCount = MetricsRegistry::getInstance().getCounter(
+        "geecxx_history_lookups_total", "URLs looked up in the history");
+Counter& hitCount = MetricsRegistry::getInstance().getCounter(
+        "geecxx_history_hits_total", "Lookups answered by the in-memory history");
+Counter& archiveHitCount = MetricsRegistry::getInstance().getCounter(
+        "geecxx_history_archive_hits_total", "Lookups answered by the URL archive");
+Counter& insertionCount = MetricsRegistry::getInstance().getCounter(
+        "geecxx_history_insertions_total", "URLs added to the history");
+Counter& evictionCount = MetricsRegistry::getInstance().getCounter(
+        "geecxx_history_evictions_total", "URLs evicted from the history to make room for new ones");
+Counter& expirationCount = MetricsRegistry::getInstance().getCounter(
+        "geecxx_history_expirations_total", "URLs removed from the history for not being posted again");
+
+unsigned getBitWidth(size_t value)
+{
+    unsigned bitWidth = 1;
+    while (bitWidth < 32 && (value >> bitWidth) != 0) {
+        ++bitWidth;
+    }
+    return bitWidth;
+}
+
+}
+
+const char* const UrlHistoryManager::HISTORY_FILE_HEADER = "#geecxx-url-history 3";
+
 UrlHistoryManager::UrlHistoryManager(size_t maxSize, std::string historyFilePath)
-    : _maxSize(maxSize), _historyFilePath(historyFilePath)
+    : _maxSize(maxSize), _positionBits(getBitWidth(maxSize)),
+      _positionMask(static_cast<IndexBucket>((std::uint64_t(1) << _positionBits) - 1)),
+      _historyFilePath(historyFilePath), _index(INITIAL_INDEX_SIZE, 0), _idIndex(INITIAL_INDEX_SIZE, 0),
+      _clock([]() {
+          return std::time(nullptr);
+      })
 {
 }
 
@@ -44,122 +88,670 @@ size_t UrlHistoryManager::getMaxSize()
 
 size_t UrlHistoryManager::getSize()
 {
-    return _entries.size();
+    return _entries.size() - _removedEntryCount;
 }
 
 bool UrlHistoryManager::insert(const std::string& url, std::string title, std::string messageAuthor)
 {
-    std::string formattedUrl = stringutils::formatUrl(url);
-    if (_entries.end() != _entries.find(formattedUrl)) {
+    UrlHistoryEntry entry;
+    return insert(url, std::move(title), std::move(messageAuthor), entry);
+}
+
+bool UrlHistoryManager::insert(const std::string& url, std::string title, std::string messageAuthor,
+                               UrlHistoryEntry& entry)
+{
+    const std::time_t currentTime = now();
+    return insertEntry(url, title, messageAuthor, 0, currentTime, currentTime, entry);
+}
+
+bool UrlHistoryManager::insertRecord(const UrlHistoryRecord& record)
+{
+    if (0 == record._entry._id) {
+        return false;
+    }
+
+    // Unknown times are considered as being now
+    const std::time_t currentTime = now();
+    const std::time_t insertionTime = 0 != record._entry._insertionTime ?
+                                      record._entry._insertionTime : currentTime;
+    const std::time_t lastSeenTime = 0 != record._entry._lastSeenTime ?
+                                     record._entry._lastSeenTime : insertionTime;
+    UrlHistoryEntry entry;
+    if (!insertEntry(record._url, record._entry._title, record._entry._messageAuthor,
+                     record._entry._id, insertionTime, lastSeenTime, entry)) {
+        return false;
+    }
+    _nextId = std::max(_nextId, record._entry._id + 1);
+    return true;
+}
+
+bool UrlHistoryManager::loadRecord(const UrlHistoryRecord& record)
+{
+    if (insertRecord(record)) {
+        return true;
+    }
+    if (0 == record._entry._id) {
+        return false;
+    }
+
+    const std::string& formattedUrl = formatUrl(record._url);
+    const std::uint32_t hash = hashUrl(formattedUrl.data(), formattedUrl.size());
+    const IndexBucket bucket = _index[findBucket(formattedUrl.data(), formattedUrl.size(), hash)];
+    if (0 == bucket) {
+        return false;
+    }
+
+    StoredEntry& storedEntry = _entries[getEntryPosition(bucket)];
+    LOG_WARNING("Merging URL#", record._entry._id, " into URL#", storedEntry._id,
+                ", both being the same URL: ", record._url);
+    if (0 != record._entry._insertionTime) {
+        storedEntry._insertionTime = std::min(storedEntry._insertionTime,
+                                              static_cast<std::uint32_t>(record._entry._insertionTime));
+    }
+    storedEntry._lastSeenTime = std::max(storedEntry._lastSeenTime,
+                                         static_cast<std::uint32_t>(record._entry._lastSeenTime));
+    // The id of the merged entry is never reused
+    _nextId = std::max(_nextId, record._entry._id + 1);
+    return true;
+}
+
+bool UrlHistoryManager::insertEntry(const std::string& url, const std::string& title,
+                                    const std::string& messageAuthor, std::uint64_t id,
+                                    std::time_t insertionTime, std::time_t lastSeenTime,
+                                    UrlHistoryEntry& entry)
+{
+    const std::string& formattedUrl = formatUrl(url);
+    const std::uint32_t hash = hashUrl(formattedUrl.data(), formattedUrl.size());
+    if (0 != _index[findBucket(formattedUrl.data(), formattedUrl.size(), hash)]) {
         // Entry already exists for given URL, that's an error
         return false;
     }
+    const std::uint64_t newId = 0 != id ? id : getNextId();
+    if (newId > UINT32_MAX) {
+        LOG_ERROR("URL#", newId, " can't be stored, ids are limited to 32 bits");
+        return false;
+    }
 
-    if (getSize() == getMaxSize()) {
-        // Retrieve oldest entry and remove it from our history
-        _entries.erase(_history.front());
-        _history.pop_front();
+    const ArenaString strings = _strings.store(formattedUrl, title);
+    const StoredEntry newEntry{strings._data, strings._size,
+                               static_cast<std::uint32_t>(formattedUrl.size()), false,
+                               _authors.intern(messageAuthor), static_cast<std::uint32_t>(newId),
+                               static_cast<std::uint32_t>(insertionTime),
+                               static_cast<std::uint32_t>(lastSeenTime)};
+    if (_entries.size() == _maxSize && 4 * _removedEntryCount >= _maxSize && _removedEntryCount > 0) {
+        compact();
+    }
+    size_t position;
+    if (_entries.size() == _maxSize) {
+        // Remove oldest entry from our history and reuse its place
+        position = _oldestEntry;
+        if (_recencyEviction) {
+            // Used entries move to the newest end instead, the loop ends
+            // once every bit has been cleared at worst
+            while (_entries[position]._referenced) {
+                _entries[position]._referenced = false;
+                position = (position + 1) % _entries.size();
+            }
+        }
+        if (0 != _entries[position]._id) {
+            releaseEntry(position);
+            evictionCount.increment();
+        } else {
+            --_removedEntryCount;
+        }
+        _entries[position] = newEntry;
+        _oldestEntry = (position + 1) % _entries.size();
+    } else {
+        if (_entries.size() == _entries.capacity()) {
+            // Never more room than the maximum size
+            _entries.reserve(std::min(std::max<size_t>(2 * _entries.size(), 1), _maxSize));
+        }
+        position = _entries.size();
+        _entries.push_back(newEntry);
     }
 
-    UrlHistoryEntry newEntry{getNextId(), std::move(title), std::move(messageAuthor)};
-    _history.push_back(formattedUrl);
-    _entries.emplace(std::move(formattedUrl), std::move(newEntry));
+    if (2 * _entries.size() > _index.size()) {
+        growIndex(_index, &UrlHistoryManager::hashUrlBucket);
+        growIndex(_idIndex, &UrlHistoryManager::hashIdBucket);
+    }
+    _index[findBucket(formattedUrl.data(), formattedUrl.size(), hash)] = makeUrlBucket(hash, position);
+    _idIndex[findIdBucket(newEntry._id, hashId(newEntry._id))] = static_cast<IndexBucket>(position + 1);
 
+    if (_archive) {
+        _archive->add(formattedUrl);
+    }
+    if (_titleIndex) {
+        _titleIndex->add(newEntry._id, title);
+    }
+    if (0 != _maxAge) {
+        _expiryWheel.schedule(newEntry._id, lastSeenTime + _maxAge);
+    }
+
+    insertionCount.increment();
+    entry = toEntry(newEntry);
     return true;
 }
 
 bool UrlHistoryManager::find(const std::string& url, UrlHistoryEntry& entry)
 {
-    std::string formattedUrl = stringutils::formatUrl(url);
-    auto iterator = _entries.find(formattedUrl);
-    if (_entries.end() == iterator) {
+    lookupCount.increment();
+    const std::string& formattedUrl = formatUrl(url);
+    if (_archive && !_archive->mightContain(formattedUrl)) {
+        // Never seen, no need to look any further
+        return false;
+    }
+
+    const std::uint32_t hash = hashUrl(formattedUrl.data(), formattedUrl.size());
+    const IndexBucket bucket = _index[findBucket(formattedUrl.data(), formattedUrl.size(), hash)];
+    if (0 == bucket) {
+        if (_archive && _archive->find(formattedUrl, entry)) {
+            archiveHitCount.increment();
+            return true;
+        }
         return false;
     }
 
-    entry = iterator->second;
+    hitCount.increment();
+    StoredEntry& storedEntry = _entries[getEntryPosition(bucket)];
+    storedEntry._referenced = _recencyEviction;
+    entry = toEntry(storedEntry);
     return true;
 }
 
+bool UrlHistoryManager::markSeen(const std::string& url)
+{
+    const std::string& formattedUrl = formatUrl(url);
+    const std::uint32_t hash = hashUrl(formattedUrl.data(), formattedUrl.size());
+    const IndexBucket bucket = _index[findBucket(formattedUrl.data(), formattedUrl.size(), hash)];
+    if (0 == bucket) {
+        return false;
+    }
+
+    // The expiry timer will notice it when it expires
+    StoredEntry& storedEntry = _entries[getEntryPosition(bucket)];
+    storedEntry._lastSeenTime = static_cast<std::uint32_t>(now());
+    storedEntry._referenced = _recencyEviction;
+    return true;
+}
+
+bool UrlHistoryManager::findById(std::uint64_t id, UrlHistoryRecord& record) const
+{
+    const IndexBucket bucket = _idIndex[findIdBucket(id, hashId(id))];
+    if (0 == bucket) {
+        return false;
+    }
+
+    const StoredEntry& storedEntry = _entries[getEntryPosition(bucket)];
+    record._url.assign(storedEntry._stringsData, storedEntry._urlSize);
+    record._entry = toEntry(storedEntry);
+    return true;
+}
+
+std::vector<UrlHistoryRecord> UrlHistoryManager::search(const std::string& query,
+                                                        size_t maxResultCount) const
+{
+    std::vector<UrlHistoryRecord> records;
+    if (!_titleIndex) {
+        return records;
+    }
+
+    for (const TitleSearchResult& result : _titleIndex->search(query, maxResultCount)) {
+        UrlHistoryRecord record;
+        if (findById(result._id, record)) {
+            records.push_back(std::move(record));
+        }
+    }
+    return records;
+}
+
 void UrlHistoryManager::clear()
 {
     _entries.clear();
-    _history.clear();
+    _oldestEntry = 0;
+    _removedEntryCount = 0;
+    _expiryWheel.reset(now());
+    _index.assign(INITIAL_INDEX_SIZE, 0);
+    _idIndex.assign(INITIAL_INDEX_SIZE, 0);
+    _strings.clear();
+    _authors.clear();
+    if (_titleIndex) {
+        _titleIndex->clear();
+    }
     _nextId = 1;
 }
 
 bool UrlHistoryManager::initFromFile()
 {
-    std::ifstream historyFile(_historyFilePath);
+    UrlHistorySnapshot snapshot;
+    if (!loadSnapshotFromFile(_historyFilePath, snapshot)) {
+        return false;
+    }
+
+    for (const UrlHistoryRecord& record : snapshot) {
+        if (!loadRecord(record)) {
+            LOG_ERROR("Unable to insert into history URL: ", record._url);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool UrlHistoryManager::saveToFile()
+{
+    return saveSnapshotToFile(*takeSnapshot(), _historyFilePath);
+}
+
+std::shared_ptr<const UrlHistorySnapshot> UrlHistoryManager::takeSnapshot()
+{
+    std::shared_ptr<UrlHistorySnapshot> snapshot = std::make_shared<UrlHistorySnapshot>();
+    snapshot->reserve(_entries.size());
+
+    for (size_t i = 0; i < _entries.size(); ++i) {
+        const StoredEntry& storedEntry = _entries[(_oldestEntry + i) % _entries.size()];
+        if (0 == storedEntry._id) {
+            continue;
+        }
+        snapshot->push_back(UrlHistoryRecord{std::string(storedEntry._stringsData, storedEntry._urlSize),
+                                             toEntry(storedEntry)});
+    }
+
+    return snapshot;
+}
+
+const std::string& UrlHistoryManager::getHistoryFilePath() const
+{
+    return _historyFilePath;
+}
+
+bool UrlHistoryManager::saveSnapshotToFile(const UrlHistorySnapshot& snapshot,
+                                           const std::string& historyFilePath)
+{
+    const std::string tmpFilePath = historyFilePath + ".tmp";
+    std::ofstream historyFile(tmpFilePath, std::ios_base::trunc);
+
+    if (!historyFile) {
+        LOG_ERROR("Couldn't open URL history file for writing.");
+        return false;
+    }
+
+    // Flushing on every line is useless here, the file is closed right after
+    historyFile << HISTORY_FILE_HEADER << '\n';
+    for (const UrlHistoryRecord& record : snapshot) {
+        historyFile << record._entry._id << ' ' << record._entry._insertionTime << ' '
+                    << record._entry._lastSeenTime << '\n';
+        historyFile << record._url << '\n';
+        historyFile << record._entry._title << '\n';
+        historyFile << record._entry._messageAuthor << '\n';
+    }
+
+    historyFile.close();
+    if (!historyFile) {
+        LOG_ERROR("Couldn't write URL history file: ", tmpFilePath);
+        std::remove(tmpFilePath.c_str());
+        return false;
+    }
+
+    if (0 != std::rename(tmpFilePath.c_str(), historyFilePath.c_str())) {
+        LOG_ERROR("Couldn't replace URL history file: ", historyFilePath);
+        std::remove(tmpFilePath.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+bool UrlHistoryManager::loadSnapshotFromFile(const std::string& historyFilePath,
+                                             UrlHistorySnapshot& snapshot)
+{
+    snapshot.clear();
+    std::ifstream historyFile(historyFilePath);
 
     if (!historyFile || !historyFile.peek()) {
         // File doesn't exist or is empty
         return true;
     }
 
-    while (historyFile.good()) {
-        std::string url;
-        std::string title;
-        std::string messageAuthor;
+    std::string line;
+    if (!std::getline(historyFile, line)) {
+        // Empty file
+        return true;
+    }
+    // Files without header have no id lines, version 2 files have no times
+    const bool withIds = (0 == line.compare(0, std::strlen(HISTORY_FILE_HEADER) - 1,
+                                            HISTORY_FILE_HEADER, std::strlen(HISTORY_FILE_HEADER) - 1));
+    if (withIds && !std::getline(historyFile, line)) {
+        // Header only, the history is empty
+        return true;
+    }
 
-        if (!std::getline(historyFile, url)) {
-            LOG_ERROR("Unable to read url from history file");
-            return false;
+    // line holds the first line of each entry
+    std::uint64_t lastId = 0;
+    do {
+        UrlHistoryRecord record;
+
+        record._entry._insertionTime = 0;
+        record._entry._lastSeenTime = 0;
+        if (withIds) {
+            std::istringstream idLine(line);
+            idLine >> record._entry._id >> record._entry._insertionTime >> record._entry._lastSeenTime;
+            if (0 == record._entry._id) {
+                LOG_ERROR("Unable to read id from history file");
+                return false;
+            }
+            if (!std::getline(historyFile, record._url)) {
+                LOG_ERROR("Unable to read url from history file");
+                return false;
+            }
+        } else {
+            record._entry._id = lastId + 1;
+            record._url = line;
         }
-        if (!std::getline(historyFile, title)) {
+        if (!std::getline(historyFile, record._entry._title)) {
             LOG_ERROR("Unable to read title from history file");
             return false;
         }
-        if (!std::getline(historyFile, messageAuthor)) {
+        if (!std::getline(historyFile, record._entry._messageAuthor)) {
             LOG_ERROR("Unable to read message author from history file");
             return false;
         }
-        if (!insert(url, title, messageAuthor)) {
-            LOG_ERROR("Unable to insert into history URL: " + url);
-            return false;
+        lastId = record._entry._id;
+        snapshot.push_back(std::move(record));
+    } while (std::getline(historyFile, line));
+
+    // Older sharded histories didn't save their entries in order
+    std::stable_sort(snapshot.begin(), snapshot.end(),
+                     [](const UrlHistoryRecord& left, const UrlHistoryRecord& right) {
+                         return left._entry._id < right._entry._id;
+                     });
+    return true;
+}
+
+size_t UrlHistoryManager::getStringStorageBytes() const
+{
+    return _strings.getReservedBytes();
+}
+
+void UrlHistoryManager::setIdAllocator(std::function<std::uint64_t()> idAllocator)
+{
+    _idAllocator = std::move(idAllocator);
+}
+
+void UrlHistoryManager::setArchive(std::shared_ptr<UrlArchive> archive)
+{
+    _archive = std::move(archive);
+}
+
+void UrlHistoryManager::setRewriter(std::shared_ptr<const UrlRewriter> rewriter)
+{
+    _rewriter = std::move(rewriter);
+}
+
+void UrlHistoryManager::enableTitleIndex()
+{
+    if (!_titleIndex) {
+        _titleIndex.reset(new TitleIndex());
+    }
+}
+
+const TitleIndex* UrlHistoryManager::getTitleIndex() const
+{
+    return _titleIndex.get();
+}
+
+void UrlHistoryManager::enableRecencyEviction()
+{
+    _recencyEviction = true;
+}
+
+void UrlHistoryManager::setMaxAge(std::time_t maxAge)
+{
+    _maxAge = std::max<std::time_t>(maxAge, 0);
+    _expiryWheel.reset(now());
+    if (0 == _maxAge) {
+        return;
+    }
+
+    for (const StoredEntry& storedEntry : _entries) {
+        if (0 != storedEntry._id) {
+            _expiryWheel.schedule(storedEntry._id, storedEntry._lastSeenTime + _maxAge);
         }
-        if (!historyFile.peek()) {
-            // We reached eof
-            break;
+    }
+}
+
+std::time_t UrlHistoryManager::getMaxAge() const
+{
+    return _maxAge;
+}
+
+size_t UrlHistoryManager::expire()
+{
+    if (0 == _maxAge) {
+        return 0;
+    }
+
+    const std::time_t currentTime = now();
+    size_t expiredCount = 0;
+    _expiryWheel.advance(currentTime, [this, currentTime, &expiredCount](std::uint64_t id) {
+        const IndexBucket bucket = _idIndex[findIdBucket(id, hashId(id))];
+        if (0 == bucket) {
+            // Already evicted
+            return;
+        }
+
+        const size_t position = getEntryPosition(bucket);
+        const std::time_t expiryTime = _entries[position]._lastSeenTime + _maxAge;
+        if (expiryTime > currentTime) {
+            // Posted again since it was scheduled
+            _expiryWheel.schedule(id, expiryTime);
+            return;
         }
+        removeEntry(position);
+        ++expiredCount;
+    });
+    expirationCount.increment(expiredCount);
+    return expiredCount;
+}
+
+void UrlHistoryManager::setClock(std::function<std::time_t()> clock)
+{
+    _clock = std::move(clock);
+    // Expiry dates are rescheduled against the new clock
+    setMaxAge(_maxAge);
+}
+
+std::uint64_t UrlHistoryManager::getNextId()
+{
+    if (_idAllocator) {
+        return _idAllocator();
     }
 
-    return true;
+    return _nextId++;
 }
 
-bool UrlHistoryManager::saveToFile()
+std::uint32_t UrlHistoryManager::hashUrl(const char* url, size_t size)
 {
-    std::ofstream historyFile(_historyFilePath, std::ios_base::trunc);
+    // Keys are re-hashed when index buckets are shifted or moved, so this
+    // needs to hash a word at a time rather than a byte at a time
+    const std::uint64_t hash = std::hash<std::string_view>()(std::string_view(url, size));
+    return static_cast<std::uint32_t>(hash ^ (hash >> 32));
+}
 
-    if (!historyFile) {
-        LOG_ERROR("Couldn't open URL history file for writing.");
-        return false;
+const std::string& UrlHistoryManager::formatUrl(const std::string& url)
+{
+    stringutils::canonicalizeUrl(url, _formattedUrl);
+    if (_rewriter && _rewriter->rewrite(_formattedUrl, _rewrittenUrl)) {
+        return _rewrittenUrl;
+    }
+    return _formattedUrl;
+}
+
+size_t UrlHistoryManager::findBucket(const char* url, size_t size, std::uint32_t hash) const
+{
+    const size_t mask = _index.size() - 1;
+    const IndexBucket tag = makeUrlBucket(hash, 0) & ~_positionMask;
+    size_t position = hash & mask;
+    while (true) {
+        const IndexBucket bucket = _index[position];
+        if (0 == bucket) {
+            return position;
+        }
+        if ((bucket & ~_positionMask) == tag) {
+            const StoredEntry& storedEntry = _entries[getEntryPosition(bucket)];
+            if (storedEntry._urlSize == size
+                && (0 == size || 0 == std::memcmp(storedEntry._stringsData, url, size))) {
+                return position;
+            }
+        }
+        position = (position + 1) & mask;
+    }
+}
+
+std::uint32_t UrlHistoryManager::hashId(std::uint64_t id)
+{
+    // Fibonacci hashing, consecutive ids end up far from each other
+    return static_cast<std::uint32_t>((id * 0x9E3779B97F4A7C15ull) >> 32);
+}
+
+size_t UrlHistoryManager::findIdBucket(std::uint64_t id, std::uint32_t hash) const
+{
+    const size_t mask = _idIndex.size() - 1;
+    size_t position = hash & mask;
+    while (true) {
+        const IndexBucket bucket = _idIndex[position];
+        if (0 == bucket || _entries[getEntryPosition(bucket)]._id == id) {
+            return position;
+        }
+        position = (position + 1) & mask;
+    }
+}
+
+UrlHistoryManager::IndexBucket UrlHistoryManager::makeUrlBucket(std::uint32_t hash, size_t position) const
+{
+    // Shifted as 64-bit integers, no bit is left for the hash when positions
+    // take all of them
+    return static_cast<IndexBucket>((std::uint64_t(hash) >> _positionBits << _positionBits) | (position + 1));
+}
+
+size_t UrlHistoryManager::getEntryPosition(IndexBucket bucket) const
+{
+    return (bucket & _positionMask) - 1;
+}
+
+std::uint32_t UrlHistoryManager::hashUrlBucket(IndexBucket bucket) const
+{
+    const StoredEntry& storedEntry = _entries[getEntryPosition(bucket)];
+    return hashUrl(storedEntry._stringsData, storedEntry._urlSize);
+}
+
+std::uint32_t UrlHistoryManager::hashIdBucket(IndexBucket bucket) const
+{
+    return hashId(_entries[getEntryPosition(bucket)]._id);
+}
+
+void UrlHistoryManager::eraseBucket(std::vector<IndexBucket>& index, size_t position, BucketHasher hashBucket) const
+{
+    // Backward shift deletion: move following buckets of the same cluster
+    // back so that lookups never stop on a hole
+    const size_t mask = index.size() - 1;
+    size_t next = (position + 1) & mask;
+    while (0 != index[next]) {
+        const size_t ideal = (this->*hashBucket)(index[next]) & mask;
+        // Distance from the ideal position, modulo the index size
+        if (((next - ideal) & mask) >= ((next - position) & mask)) {
+            index[position] = index[next];
+            position = next;
+        }
+        next = (next + 1) & mask;
     }
+    index[position] = 0;
+}
+
+void UrlHistoryManager::growIndex(std::vector<IndexBucket>& index, BucketHasher hashBucket) const
+{
+    std::vector<IndexBucket> oldIndex(2 * index.size(), 0);
+    oldIndex.swap(index);
 
-    for (const std::string& url : _history) {
-        UrlHistoryEntry entry;
-        if (!find(url, entry)) {
-            LOG_ERROR("Couldn't find history entry for URL: " + url);
+    // Buckets don't hold whole hashes, keys are hashed again
+    const size_t mask = index.size() - 1;
+    for (const IndexBucket bucket : oldIndex) {
+        if (0 == bucket) {
             continue;
         }
-        historyFile << url << std::endl;
-        historyFile << entry._title << std::endl;
-        historyFile << entry._messageAuthor << std::endl;
+        size_t position = (this->*hashBucket)(bucket) & mask;
+        while (0 != index[position]) {
+            position = (position + 1) & mask;
+        }
+        index[position] = bucket;
     }
+}
 
-    return true;
+UrlHistoryEntry UrlHistoryManager::toEntry(const StoredEntry& storedEntry) const
+{
+    return UrlHistoryEntry{storedEntry._id,
+                           std::string(storedEntry._stringsData + storedEntry._urlSize,
+                                       storedEntry._stringsSize - storedEntry._urlSize),
+                           _authors.resolve(storedEntry._messageAuthor),
+                           storedEntry._insertionTime, storedEntry._lastSeenTime};
 }
 
-size_t UrlHistoryManager::getNextId()
+void UrlHistoryManager::releaseEntry(size_t position)
 {
-    size_t id = _nextId;
+    const StoredEntry& storedEntry = _entries[position];
+    if (_archive) {
+        _archive->archive(std::string(storedEntry._stringsData, storedEntry._urlSize),
+                          toEntry(storedEntry));
+    }
+    if (_titleIndex) {
+        _titleIndex->remove(storedEntry._id,
+                            std::string(storedEntry._stringsData + storedEntry._urlSize,
+                                        storedEntry._stringsSize - storedEntry._urlSize));
+    }
 
-    if (_nextId < _maxSize) {
-        ++_nextId;
-    } else {
-        _nextId = 1;
+    const std::uint32_t hash = hashUrl(storedEntry._stringsData, storedEntry._urlSize);
+    eraseBucket(_index, findBucket(storedEntry._stringsData, storedEntry._urlSize, hash),
+                &UrlHistoryManager::hashUrlBucket);
+    eraseBucket(_idIndex, findIdBucket(storedEntry._id, hashId(storedEntry._id)), &UrlHistoryManager::hashIdBucket);
+    _strings.release(storedEntry.getStrings());
+    _authors.release(storedEntry._messageAuthor);
+}
+
+void UrlHistoryManager::removeEntry(size_t position)
+{
+    releaseEntry(position);
+    _entries[position]._id = 0;
+    _entries[position]._referenced = false;
+    ++_removedEntryCount;
+}
+
+void UrlHistoryManager::compact()
+{
+    std::vector<StoredEntry> entries;
+    entries.reserve(_maxSize);
+    for (size_t i = 0; i < _entries.size(); ++i) {
+        const StoredEntry& storedEntry = _entries[(_oldestEntry + i) % _entries.size()];
+        if (0 != storedEntry._id) {
+            entries.push_back(storedEntry);
+        }
     }
+    _entries.swap(entries);
+    _oldestEntry = 0;
+    _removedEntryCount = 0;
 
-    return id;
+    // Positions changed, both indexes are rebuilt
+    std::fill(_index.begin(), _index.end(), 0);
+    std::fill(_idIndex.begin(), _idIndex.end(), 0);
+    for (size_t position = 0; position < _entries.size(); ++position) {
+        const StoredEntry& storedEntry = _entries[position];
+        const std::uint32_t hash = hashUrl(storedEntry._stringsData, storedEntry._urlSize);
+        _index[findBucket(storedEntry._stringsData, storedEntry._urlSize, hash)] = makeUrlBucket(hash, position);
+        _idIndex[findIdBucket(storedEntry._id, hashId(storedEntry._id))] = static_cast<IndexBucket>(position + 1);
+    }
+}
+
+std::time_t UrlHistoryManager::now() const
+{
+    return _clock();
 }
 
 }
@@ -24,25 +24,63 @@
  */
 #pragma once
 
+#include <cstdint>
+#include <ctime>
 #include <fstream>
-#include <list>
-#include <map>
+#include <functional>
+#include <memory>
 #include <string>
+#include <vector>
 
 #include "globalconfig.h"
 
 #include "logger.h"
+#include "stringarena.h"
+#include "symboltable.h"
+#include "timerwheel.h"
+#include "titleindex.h"
 
 namespace geecxx
 {
 
+class UrlArchive;
+class UrlRewriter;
+
 struct UrlHistoryEntry
 {
-    size_t _id;
+    /**
+     * Unique id, ids only ever increase and are never reused
+     */
+    std::uint64_t _id;
     std::string _title;
     std::string _messageAuthor;
+    /**
+     * Time the URL was first posted at, 0 if unknown
+     */
+    std::time_t _insertionTime;
+    /**
+     * Time the URL was last posted at, 0 if unknown
+     */
+    std::time_t _lastSeenTime;
 };
 
+/**
+ * Self-contained copy of a history entry alongside its URL
+ */
+struct UrlHistoryRecord
+{
+    std::string _url;
+    UrlHistoryEntry _entry;
+};
+
+/**
+ * Immutable copy of the whole history, oldest entry first
+ *
+ * Snapshots can safely be handed over to another thread, e.g. to be written
+ * to the disk while the history itself keeps being modified.
+ */
+typedef std::vector<UrlHistoryRecord> UrlHistorySnapshot;
+
 class UrlHistoryManager
 {
 public:
@@ -79,15 +117,81 @@ public:
      */
     bool insert(const std::string& url, std::string title, std::string messageAuthor);
 
+    /**
+     * Insert a new entry in the history and retrieve it
+     *
+     * @param[in] url url to be used as the key of the new element
+     * @param[in] title title associated to the given url
+     * @param[in] messageAuthor author of the message that contains the given url
+     * @param[out] entry the inserted entry
+     * @return true upon successful insertion, false otherwise
+     */
+    bool insert(const std::string& url, std::string title, std::string messageAuthor,
+                UrlHistoryEntry& entry);
+
     /**
      * Find an entry in the history
      *
+     * When an archive is set, URLs it has never seen are rejected before
+     * looking into the history, and URLs missing from the history are then
+     * looked for in the archive's cold store.
      * @param[in] url url to be used as the key to retrieve the element
      * @param[out] entry
      * @return true if the element has been found, false otherwise
      */
     bool find(const std::string& url, UrlHistoryEntry& entry);
 
+    /**
+     * Record that a URL of the history has just been posted again
+     *
+     * @param[in] url url of the element
+     * @return true if the element has been found, false otherwise
+     */
+    bool markSeen(const std::string& url);
+
+    /**
+     * Find an entry of the history from its id
+     *
+     * Only entries still in the history can be found.
+     * @param[in] id id of the element
+     * @param[out] record the element alongside its URL
+     * @return true if the element has been found, false otherwise
+     */
+    bool findById(std::uint64_t id, UrlHistoryRecord& record) const;
+
+    /**
+     * Insert an entry that keeps its own id, e.g. read back from the disk
+     *
+     * Ids allocated afterwards follow the given one.
+     * @param[in] record element to be inserted, alongside its URL
+     * @return true upon successful insertion, false otherwise
+     */
+    bool insertRecord(const UrlHistoryRecord& record);
+
+    /**
+     * Insert an entry read back from the disk, merging it into the entry of
+     * its URL if there is one already
+     *
+     * Files written before URLs were canonicalized, or before a rewrite rule
+     * was added, can hold several spellings of a same URL. The entry already
+     * in the history keeps its id, title and message author; it is given
+     * the oldest insertion time and the latest last seen time of both.
+     * @param[in] record element to be inserted, alongside its URL
+     * @return true upon successful insertion or merge, false otherwise
+     */
+    bool loadRecord(const UrlHistoryRecord& record);
+
+    /**
+     * Look for entries whose title matches a query
+     *
+     * Requires the title index to be enabled, no entry is ever found
+     * otherwise.
+     * @param[in] query free text query
+     * @param[in] maxResultCount maximum number of entries to be returned
+     * @return matching entries alongside their URL, most relevant first
+     */
+    std::vector<UrlHistoryRecord> search(const std::string& query, size_t maxResultCount) const;
+
     /**
      * Remove every single entry of the history
      */
@@ -96,6 +200,8 @@ public:
     /**
      * Read history data from the disk into our current history
      *
+     * Entries whose URL is already in the history are merged (see
+     * loadRecord()).
      * @return true upon successful reading of the file
      */
     bool initFromFile();
@@ -107,20 +213,372 @@ public:
      */
     bool saveToFile();
 
+    /**
+     * Copy current history data into an immutable snapshot
+     *
+     * @return snapshot of the history, oldest entry first
+     */
+    std::shared_ptr<const UrlHistorySnapshot> takeSnapshot();
+
+    /**
+     * Get path to the file used for history data persistence
+     * @return path to the history file
+     */
+    const std::string& getHistoryFilePath() const;
+
+    /**
+     * Get the amount of memory reserved to store URLs and titles
+     * @return reserved memory, in bytes
+     */
+    size_t getStringStorageBytes() const;
+
+    /**
+     * Use an external id allocator instead of the history's own sequence
+     *
+     * This is meant for several histories sharing a single id sequence. The
+     * allocator is only called once an entry is known to be insertable.
+     * @param[in] idAllocator function returning a new id on each call
+     */
+    void setIdAllocator(std::function<std::uint64_t()> idAllocator);
+
+    /**
+     * Keep track of every inserted URL in an archive
+     *
+     * Inserted URLs are added to the archive's filter and evicted entries are
+     * handed over to its cold store. Must be set before the history is
+     * filled.
+     * @param[in] archive archive to be used, null to disable archiving
+     */
+    void setArchive(std::shared_ptr<UrlArchive> archive);
+
+    /**
+     * Rewrite URLs once formatted, e.g. to drop tracking parameters
+     *
+     * Must be set before the history is filled, URLs read back by
+     * initFromFile() are rewritten as well.
+     * @param[in] rewriter rewriter to be used, null to disable rewriting
+     */
+    void setRewriter(std::shared_ptr<const UrlRewriter> rewriter);
+
+    /**
+     * Maintain a full-text index of titles, used by search()
+     *
+     * Must be enabled before the history is filled. The index isn't saved,
+     * it is rebuilt as entries are read back by initFromFile().
+     */
+    void enableTitleIndex();
+
+    /**
+     * Get the title index
+     * @return title index, null unless enabled
+     */
+    const TitleIndex* getTitleIndex() const;
+
+    /**
+     * Give entries used since the last eviction a second chance
+     *
+     * Entries found by find() or marked seen are skipped once by eviction,
+     * as if they had just been inserted (CLOCK algorithm), which
+     * approximates a least recently used eviction order. Entries are then no
+     * longer kept in id order.
+     */
+    void enableRecencyEviction();
+
+    /**
+     * Forget entries that haven't been posted for a while
+     *
+     * Entries are only removed by expire(), which is meant to be called
+     * periodically. Removed entries are handed over to the archive, if any,
+     * like evicted ones.
+     * @param[in] maxAge maximum time since an entry was last posted, in
+     *            seconds, 0 to keep entries until they are evicted
+     */
+    void setMaxAge(std::time_t maxAge);
+
+    /**
+     * Get maximum time since an entry was last posted
+     * @return maximum age in seconds, 0 if entries don't expire
+     */
+    std::time_t getMaxAge() const;
+
+    /**
+     * Remove entries older than the maximum age
+     *
+     * Expiry dates are kept in a timer wheel: the cost only depends on the
+     * time elapsed since the previous call and the number of expired
+     * entries, not on the size of the history.
+     * @return number of removed entries
+     */
+    size_t expire();
+
+    /**
+     * Use another clock than the system one
+     *
+     * @param[in] clock function returning the current time, in seconds since
+     *            the epoch
+     */
+    void setClock(std::function<std::time_t()> clock);
+
+    /**
+     * Get the current time, as seen by the history
+     *
+     * Ages of entries must be computed against this time rather than the
+     * system one, insertion and last seen times come from this clock.
+     * @return current time, in seconds since the epoch
+     */
+    std::time_t now() const;
+
+    /**
+     * Save a snapshot of the history into a file
+     *
+     * Data are first written into a temporary file which then replaces the
+     * actual history file, so that a failure while writing never leaves a
+     * truncated history behind.
+     * @param[in] snapshot history data to be saved
+     * @param[in] historyFilePath path to the history file
+     * @return true upon successful writing of history data
+     */
+    static bool saveSnapshotToFile(const UrlHistorySnapshot& snapshot,
+                                   const std::string& historyFilePath);
+
+    /**
+     * Read a history file into a snapshot
+     *
+     * Files written before ids were persisted are still supported, their
+     * entries are given ids in order. Records are sorted by id, i.e. oldest
+     * first, whatever their order in the file.
+     * @param[in] historyFilePath path to the history file
+     * @param[out] snapshot history data read from the file, empty if the
+     *             file doesn't exist
+     * @return true upon successful reading of the file
+     */
+    static bool loadSnapshotFromFile(const std::string& historyFilePath,
+                                     UrlHistorySnapshot& snapshot);
+
 private:
+    /**
+     * Initial number of buckets of the URL index, must be a power of 2
+     */
+    static const size_t INITIAL_INDEX_SIZE = 16;
+
+    /**
+     * First line of history files, followed by 4 lines per entry: id,
+     * insertion and last seen times (space separated), URL, title and
+     * message author. Version 2 files only have the id on the first line,
+     * older files have no header and no id line.
+     */
+    static const char* const HISTORY_FILE_HEADER;
+
+    /**
+     * Compact storage of an entry, 32 bytes
+     *
+     * The formatted URL and the title are stored next to each other in a
+     * single arena string, whose fields are inlined to avoid its padding.
+     * Message authors (a few distinct nicknames) are interned in _authors.
+     * Ids are stored on 32 bits, times as 32-bit seconds since the epoch.
+     * Removed entries have a null id.
+     */
+    struct StoredEntry
+    {
+        const char* _stringsData;
+        std::uint32_t _stringsSize;
+        std::uint32_t _urlSize : 31;
+        /**
+         * Whether the entry has been used since eviction last went past it
+         */
+        std::uint32_t _referenced : 1;
+        SymbolTable::Symbol _messageAuthor;
+        std::uint32_t _id;
+        std::uint32_t _insertionTime;
+        std::uint32_t _lastSeenTime;
+
+        /**
+         * Get the arena string holding the URL and the title
+         * @return reference to the stored strings
+         */
+        ArenaString getStrings() const
+        {
+            ArenaString strings;
+            strings._data = _stringsData;
+            strings._size = _stringsSize;
+            return strings;
+        }
+    };
+    static_assert(sizeof(StoredEntry) <= 32, "Stored entries outgrew 32 bytes");
+
+    /**
+     * Bucket of the open addressing indexes: position of the entry in
+     * _entries plus one, 0 for empty buckets
+     *
+     * Buckets of _index also keep the upper bits of the URL hash above the
+     * _positionBits bits of the position, so that most URLs that don't
+     * match are told apart without being compared.
+     */
+    typedef std::uint32_t IndexBucket;
+
+    /**
+     * Insert a new entry
+     *
+     * @param[in] url url to be used as the key of the new element
+     * @param[in] title title associated to the given url
+     * @param[in] messageAuthor author of the message that contains the given url
+     * @param[in] id id of the new element, 0 to allocate a new one
+     * @param[in] insertionTime time the URL was first posted at
+     * @param[in] lastSeenTime time the URL was last posted at
+     * @param[out] entry the inserted entry
+     * @return true upon successful insertion, false otherwise
+     */
+    bool insertEntry(const std::string& url, const std::string& title,
+                     const std::string& messageAuthor, std::uint64_t id,
+                     std::time_t insertionTime, std::time_t lastSeenTime,
+                     UrlHistoryEntry& entry);
+
+    /**
+     * Hash a formatted URL
+     * @param[in] url formatted URL
+     * @param[in] size URL size, in bytes
+     * @return hash of the URL
+     */
+    static std::uint32_t hashUrl(const char* url, size_t size);
+
+    /**
+     * Format a URL and rewrite it, if a rewriter is set
+     * @param[in] url URL to be formatted
+     * @return formatted URL, valid until the next call
+     */
+    const std::string& formatUrl(const std::string& url);
+
+    /**
+     * Look for a formatted URL in the index
+     *
+     * @param[in] url formatted URL
+     * @param[in] size URL size, in bytes
+     * @param[in] hash hash of the URL
+     * @return position of the URL's bucket if found, otherwise position of
+     *         the empty bucket where it would be inserted
+     */
+    size_t findBucket(const char* url, size_t size, std::uint32_t hash) const;
+
+    /**
+     * Hash an id
+     * @param[in] id id of an entry
+     * @return hash of the id
+     */
+    static std::uint32_t hashId(std::uint64_t id);
+
+    /**
+     * Look for an id in the id index
+     *
+     * @param[in] id id of the entry
+     * @param[in] hash hash of the id
+     * @return position of the id's bucket if found, otherwise position of
+     *         the empty bucket where it would be inserted
+     */
+    size_t findIdBucket(std::uint64_t id, std::uint32_t hash) const;
+
+    /**
+     * Build a bucket of the URL index
+     * @param[in] hash hash of the URL
+     * @param[in] position position of the entry in _entries
+     * @return bucket of the entry
+     */
+    IndexBucket makeUrlBucket(std::uint32_t hash, size_t position) const;
+
+    /**
+     * Get the position of the entry a bucket of any index points to
+     * @param[in] bucket non-empty bucket
+     * @return position of the entry in _entries
+     */
+    size_t getEntryPosition(IndexBucket bucket) const;
+
+    /**
+     * Hash the URL of the entry a bucket of _index points to
+     * @param[in] bucket non-empty bucket
+     * @return hash of the URL
+     */
+    std::uint32_t hashUrlBucket(IndexBucket bucket) const;
+
+    /**
+     * Hash the id of the entry a bucket of _idIndex points to
+     * @param[in] bucket non-empty bucket
+     * @return hash of the id
+     */
+    std::uint32_t hashIdBucket(IndexBucket bucket) const;
+
+    /**
+     * Hash of the key of the entry a bucket points to, buckets only hold
+     * part of it
+     */
+    typedef std::uint32_t (UrlHistoryManager::*BucketHasher)(IndexBucket bucket) const;
+
+    /**
+     * Remove the bucket at the given position from an index
+     * @param[in,out] index index of _entries (URL or id)
+     * @param[in] position position of the bucket
+     * @param[in] hashBucket hash of the keys of the index
+     */
+    void eraseBucket(std::vector<IndexBucket>& index, size_t position, BucketHasher hashBucket) const;
+
+    /**
+     * Double the capacity of an index
+     * @param[in,out] index index of _entries (URL or id)
+     * @param[in] hashBucket hash of the keys of the index
+     */
+    void growIndex(std::vector<IndexBucket>& index, BucketHasher hashBucket) const;
+
+    /**
+     * Build a self-contained entry out of a stored one
+     *
+     * @param[in] storedEntry stored entry
+     * @return self-contained copy of the entry
+     */
+    UrlHistoryEntry toEntry(const StoredEntry& storedEntry) const;
+
+    /**
+     * Drop an entry from every index and give its storage back
+     *
+     * The entry is handed over to the archive beforehand. Its place in
+     * _entries is left as is, to be overwritten or marked as removed.
+     * @param[in] position position of the entry in _entries
+     */
+    void releaseEntry(size_t position);
+
+    /**
+     * Remove an entry from the middle of the history
+     *
+     * Its place is marked as removed, to be reused once the oldest entry
+     * reaches it or when _entries gets compacted.
+     * @param[in] position position of the entry in _entries
+     */
+    void removeEntry(size_t position);
+
+    /**
+     * Move entries to the beginning of _entries, oldest first, dropping the
+     * places of removed ones
+     */
+    void compact();
+
     /**
      * Return id not yet used by any element
      *
-     * Also increases internal id for successive calls.
+     * Also increases internal id for successive calls, unless an external
+     * id allocator is set.
      * @return id not yet used by any element
      */
-    size_t getNextId();
+    std::uint64_t getNextId();
 
     /**
      * Maximum size of the history
      */
     const size_t _maxSize;
 
+    /**
+     * Number of bits of index buckets holding positions, enough for
+     * _maxSize, and their mask
+     */
+    const unsigned _positionBits;
+    const IndexBucket _positionMask;
+
     /**
      * Path to the file that is used for url history data persistence
      */
@@ -129,18 +587,101 @@ private:
     /**
      * Id to be used for new element to be inserted
      */
-    size_t _nextId = 1;
+    std::uint64_t _nextId = 1;
+
+    /**
+     * External id allocator, if any
+     */
+    std::function<std::uint64_t()> _idAllocator;
+
+    /**
+     * Archive of every URL ever inserted, if any
+     */
+    std::shared_ptr<UrlArchive> _archive;
+
+    /**
+     * Rewriter applied to formatted URLs, if any
+     */
+    std::shared_ptr<const UrlRewriter> _rewriter;
+
+    /**
+     * Full-text index of titles, if enabled
+     */
+    std::unique_ptr<TitleIndex> _titleIndex;
+
+    /**
+     * Whether used entries get a second chance before being evicted
+     */
+    bool _recencyEviction = false;
+
+    /**
+     * Storage of formatted URLs and titles
+     */
+    StringArena _strings;
+
+    /**
+     * Interned message authors
+     */
+    SymbolTable _authors;
 
     /**
      * Proper storage of the history's entries
+     *
+     * Entries are kept in insertion order in this circular buffer, the oldest
+     * one being at _oldestEntry. It grows up to _maxSize entries. With
+     * recency eviction, entries given a second chance count as newly
+     * inserted.
+     */
+    std::vector<StoredEntry> _entries;
+    size_t _oldestEntry = 0;
+
+    /**
+     * Number of places of _entries marked as removed
+     *
+     * Once _entries is full, they are only reclaimed by compact() when they
+     * amount to a quarter of the history: until then, the oldest entry is
+     * evicted even though the history holds slightly fewer entries than its
+     * maximum size.
+     */
+    size_t _removedEntryCount = 0;
+
+    /**
+     * Open addressing (linear probing) index of _entries
      * key = URL
      */
-    std::map<std::string, UrlHistoryEntry> _entries;
+    std::vector<IndexBucket> _index;
+
+    /**
+     * Open addressing (linear probing) index of _entries, same size as _index
+     * key = id
+     *
+     * Ids of live entries may span more than _maxSize values (entries
+     * removed from the middle of the history, ids shared with other
+     * histories), they are indexed as a whole.
+     */
+    std::vector<IndexBucket> _idIndex;
+
+    /**
+     * Maximum time since an entry was last posted, 0 for no limit
+     */
+    std::time_t _maxAge = 0;
+
+    /**
+     * Expiry dates of entries (key = id), in seconds since the epoch
+     *
+     * Entries posted again aren't rescheduled right away: when their timer
+     * expires, it is rescheduled from their last seen time.
+     */
+    TimerWheel _expiryWheel;
+
+    std::function<std::time_t()> _clock;
 
     /**
-     * Keeps track of the order in which entries were inserted
+     * Canonical form of the URL being looked up or inserted, and its
+     * rewritten form, kept so that their memory is reused
      */
-    std::list<std::string> _history;
+    std::string _formattedUrl;
+    std::string _rewrittenUrl;
 };
 
 }
@@ -0,0 +1,450 @@
+/*
+ * Copyright (c) 2015, Romain Létendart
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#define GEECXX_LOG_MODULE geecxx::LogModule::HISTORY
+
+#include "urlrewriter.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+#include "logger.h"
+#include "stringutils.h"
+
+namespace geecxx
+{
+
+/**
+ * Buffers are kept from one URL to the next, one set per thread
+ */
+struct UrlRewriter::Components
+{
+    std::string _userInfo; // With its '@'
+    std::string _host;
+    std::string _port; // With its ':'
+    std::string _path; // With its leading '/'
+    std::string _query; // Without its '?'
+    std::string _originalHost;
+    std::string _sub;
+    std::string _url;
+    std::string _scratch;
+};
+
+namespace
+{
+
+bool matchesName(const char* name, size_t nameSize, const std::vector<std::string>& patterns)
+{
+    for (const std::string& pattern : patterns) {
+        if ('*' == pattern.back()) {
+            if (nameSize >= pattern.size() - 1 && 0 == pattern.compare(0, pattern.size() - 1, name, pattern.size() - 1)) {
+                return true;
+            }
+        } else if (0 == pattern.compare(0, std::string::npos, name, nameSize)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Find the nth segment of a path (n starting at 1)
+ *
+ * @return false if the path has fewer segments
+ */
+bool findPathSegment(const std::string& path, size_t n, size_t& begin, size_t& end)
+{
+    end = 0;
+    for (size_t i = 0; i < n; ++i) {
+        if (end >= path.size()) {
+            return false;
+        }
+        begin = end + 1;
+        end = std::min(path.find('/', begin), path.size());
+    }
+    return true;
+}
+
+}
+
+UrlRewriter::UrlRewriter()
+    : _nodes(1)
+{
+}
+
+bool UrlRewriter::loadFromFile(const std::string& filePath)
+{
+    std::ifstream file(filePath);
+    if (!file) {
+        LOG_ERROR("Couldn't open URL rewrite rules file ", filePath);
+        return false;
+    }
+    if (!load(file, filePath)) {
+        return false;
+    }
+    LOG_INFO("Loaded ", _rules.size(), " URL rewrite rule(s) from ", filePath);
+    return true;
+}
+
+bool UrlRewriter::load(std::istream& input, const std::string& sourceName)
+{
+    std::vector<Node> nodes(1);
+    std::vector<Rule> rules;
+    std::string line;
+    for (size_t lineNumber = 1; std::getline(input, line); ++lineNumber) {
+        stringutils::trim(line);
+        if (line.empty() || '#' == line[0]) {
+            continue;
+        }
+
+        std::vector<std::string> hostLabels;
+        bool matchesSubdomains;
+        Rule rule;
+        std::string error;
+        if (!parseRule(line, hostLabels, matchesSubdomains, rule, error)) {
+            LOG_ERROR(sourceName, ":", lineNumber, ": ", error);
+            return false;
+        }
+
+        // Labels are stored from the top-level domain down
+        std::uint32_t node = 0;
+        for (auto label = hostLabels.rbegin(); label != hostLabels.rend(); ++label) {
+            auto& children = nodes[node]._children;
+            auto child = std::lower_bound(children.begin(), children.end(), *label,
+                                          [](const std::pair<std::string, std::uint32_t>& child,
+                                             const std::string& label) {
+                return child.first < label;
+            });
+            if (children.end() != child && child->first == *label) {
+                node = child->second;
+            } else {
+                children.emplace(child, *label, static_cast<std::uint32_t>(nodes.size()));
+                node = static_cast<std::uint32_t>(nodes.size());
+                // Invalidates children
+                nodes.emplace_back();
+            }
+        }
+        (matchesSubdomains ? nodes[node]._subdomainRules : nodes[node]._hostRules)
+                .push_back(static_cast<std::uint32_t>(rules.size()));
+        rules.push_back(std::move(rule));
+    }
+
+    _nodes.swap(nodes);
+    _rules.swap(rules);
+    return true;
+}
+
+size_t UrlRewriter::getRuleCount() const
+{
+    return _rules.size();
+}
+
+bool UrlRewriter::rewrite(const std::string& formattedUrl, std::string& output) const
+{
+    if (_rules.empty()) {
+        return false;
+    }
+
+    // A URL moved to another host gets the rules of that host as well, e.g.
+    // "m.youtube.com" renamed to "youtube.com"
+    thread_local std::string previousOutput;
+    bool hostChanged;
+    if (!rewriteOnce(formattedUrl, output, hostChanged)) {
+        return false;
+    }
+    for (size_t i = 1; hostChanged && i < MAX_PASS_COUNT; ++i) {
+        previousOutput.swap(output);
+        if (!rewriteOnce(previousOutput, output, hostChanged)) {
+            output.swap(previousOutput);
+            break;
+        }
+    }
+    return true;
+}
+
+bool UrlRewriter::rewriteOnce(const std::string& formattedUrl, std::string& output, bool& hostChanged) const
+{
+    thread_local Components components;
+    split(formattedUrl, components);
+    const std::string& host = components._host;
+
+    // Walk down the trie from the top-level domain, gathering the rules of
+    // the host and of the domains it belongs to
+    Match matches[MAX_MATCH_COUNT];
+    size_t matchCount = 0;
+    const auto addMatches = [&matches, &matchCount](const std::vector<std::uint32_t>& rules, size_t subSize) {
+        for (size_t i = 0; i < rules.size() && matchCount < MAX_MATCH_COUNT; ++i) {
+            matches[matchCount++] = Match{rules[i], subSize};
+        }
+    };
+    const Node* node = &_nodes[0];
+    size_t remainingSize = host.size();
+    while (0 != remainingSize) {
+        addMatches(node->_subdomainRules, remainingSize);
+
+        const size_t separator = host.rfind('.', remainingSize - 1);
+        const size_t labelBegin = std::string::npos == separator ? 0 : separator + 1;
+        const char* const label = host.data() + labelBegin;
+        const size_t labelSize = remainingSize - labelBegin;
+        const auto child = std::lower_bound(node->_children.begin(), node->_children.end(), 0,
+                                            [label, labelSize](const std::pair<std::string, std::uint32_t>& child, int) {
+            return child.first.compare(0, std::string::npos, label, labelSize) < 0;
+        });
+        if (node->_children.end() == child || 0 != child->first.compare(0, std::string::npos, label, labelSize)) {
+            break;
+        }
+        node = &_nodes[child->second];
+        remainingSize = std::string::npos == separator ? 0 : separator;
+        if (0 == remainingSize) {
+            addMatches(node->_hostRules, 0);
+        }
+    }
+    if (0 == matchCount) {
+        return false;
+    }
+
+    // Rules apply in the order of the file
+    std::sort(matches, matches + matchCount, [](const Match& a, const Match& b) {
+        return a._rule < b._rule;
+    });
+    components._originalHost = host;
+    bool needsFormatting = false;
+    for (size_t i = 0; i < matchCount; ++i) {
+        const Rule& rule = _rules[matches[i]._rule];
+        components._sub.assign(components._originalHost, 0, matches[i]._subSize);
+        apply(rule, components._sub, components);
+        needsFormatting = needsFormatting || Action::HOST == rule._action || Action::PATH == rule._action
+                          || Action::URL == rule._action;
+    }
+
+    hostChanged = components._host != components._originalHost;
+
+    // Templates may not produce formatted URLs
+    std::string& url = needsFormatting ? components._url : output;
+    url.clear();
+    url.append(components._userInfo).append(components._host).append(components._port).append(components._path);
+    if (!components._query.empty()) {
+        url.append(1, '?').append(components._query);
+    }
+    if (needsFormatting) {
+        stringutils::canonicalizeUrl(url, output);
+    }
+    return true;
+}
+
+bool UrlRewriter::parseRule(const std::string& line, std::vector<std::string>& hostLabels,
+                            bool& matchesSubdomains, Rule& rule, std::string& error)
+{
+    std::istringstream lineStream(line);
+    std::string pattern, action;
+    lineStream >> pattern >> action;
+    std::string argument;
+    while (lineStream >> argument) {
+        rule._arguments.push_back(argument);
+    }
+
+    matchesSubdomains = false;
+    const bool matchesAnyHost = pattern == "*";
+    if (matchesAnyHost) {
+        matchesSubdomains = true;
+        pattern.clear();
+    } else if (0 == pattern.compare(0, 2, "*.")) {
+        matchesSubdomains = true;
+        pattern.erase(0, 2);
+    }
+    std::transform(pattern.begin(), pattern.end(), pattern.begin(), ::tolower);
+    std::istringstream patternStream(pattern);
+    std::string label;
+    while (std::getline(patternStream, label, '.')) {
+        if (label.empty() || std::string::npos != label.find('*')) {
+            error = "Invalid host pattern \"" + pattern + "\"";
+            return false;
+        }
+        hostLabels.push_back(label);
+    }
+    if (hostLabels.empty() && !matchesAnyHost) {
+        error = "Invalid host pattern \"" + pattern + "\"";
+        return false;
+    }
+
+    size_t argumentCount = 1;
+    if (action == "strip-params") {
+        rule._action = Action::STRIP_PARAMS;
+        argumentCount = 0;
+    } else if (action == "keep-params") {
+        rule._action = Action::KEEP_PARAMS;
+        argumentCount = 0;
+    } else if (action == "strip-path-segments") {
+        rule._action = Action::STRIP_PATH_SEGMENTS;
+        argumentCount = 0;
+    } else if (action == "host") {
+        rule._action = Action::HOST;
+    } else if (action == "path") {
+        rule._action = Action::PATH;
+    } else if (action == "url") {
+        rule._action = Action::URL;
+    } else if (action.empty()) {
+        error = "Missing action";
+        return false;
+    } else {
+        error = "Unknown action \"" + action + "\"";
+        return false;
+    }
+    if (0 == argumentCount ? rule._arguments.empty() : argumentCount != rule._arguments.size()) {
+        error = "Wrong number of arguments for " + action;
+        return false;
+    }
+    return true;
+}
+
+void UrlRewriter::split(const std::string& url, Components& components)
+{
+    const size_t pathBegin = std::min(url.find_first_of("/?"), url.size());
+    const size_t queryBegin = std::min(url.find('?', pathBegin), url.size());
+    const size_t at = url.rfind('@', pathBegin);
+    const size_t hostBegin = std::string::npos == at ? 0 : at + 1;
+    size_t hostEnd = hostBegin < pathBegin && '[' == url[hostBegin] ? url.find(']', hostBegin) : hostBegin;
+    hostEnd = std::min(url.find(':', std::min(hostEnd, pathBegin)), pathBegin);
+
+    components._userInfo.assign(url, 0, hostBegin);
+    components._host.assign(url, hostBegin, hostEnd - hostBegin);
+    components._port.assign(url, hostEnd, pathBegin - hostEnd);
+    components._path.assign(url, pathBegin, queryBegin - pathBegin);
+    if (components._path.empty()) {
+        components._path.assign(1, '/');
+    }
+    components._query.assign(url, std::min(queryBegin + 1, url.size()), std::string::npos);
+}
+
+void UrlRewriter::apply(const Rule& rule, const std::string& sub, Components& components)
+{
+    std::string& scratch = components._scratch;
+    scratch.clear();
+    switch (rule._action) {
+    case Action::STRIP_PARAMS:
+    case Action::KEEP_PARAMS: {
+        const std::string& query = components._query;
+        for (size_t begin = 0; begin < query.size();) {
+            const size_t end = std::min(query.find('&', begin), query.size());
+            const size_t nameEnd = std::min(query.find('=', begin), end);
+            const bool matches = matchesName(query.data() + begin, nameEnd - begin, rule._arguments);
+            if (matches == (Action::KEEP_PARAMS == rule._action)) {
+                scratch.append(scratch.empty() ? "" : "&").append(query, begin, end - begin);
+            }
+            begin = end + 1;
+        }
+        components._query.swap(scratch);
+        break;
+    }
+    case Action::STRIP_PATH_SEGMENTS: {
+        const std::string& path = components._path;
+        for (size_t begin = 1; begin <= path.size();) {
+            const size_t end = std::min(path.find('/', begin), path.size());
+            if (!matchesName(path.data() + begin, end - begin, rule._arguments) || end == begin) {
+                scratch.append(1, '/').append(path, begin, end - begin);
+            }
+            begin = end + 1;
+        }
+        if (scratch.empty()) {
+            scratch.assign(1, '/');
+        }
+        components._path.swap(scratch);
+        break;
+    }
+    case Action::HOST:
+        expand(rule._arguments[0], sub, components, scratch);
+        components._host.swap(scratch);
+        break;
+    case Action::PATH:
+        scratch.assign(1, '/');
+        expand(rule._arguments[0], sub, components, scratch);
+        components._path.swap(scratch);
+        break;
+    case Action::URL:
+        expand(rule._arguments[0], sub, components, scratch);
+        stringutils::canonicalizeUrl(scratch, components._url);
+        split(components._url, components);
+        break;
+    }
+}
+
+void UrlRewriter::expand(const std::string& pattern, const std::string& sub, const Components& components,
+                         std::string& output)
+{
+    for (size_t position = 0; position < pattern.size();) {
+        const size_t begin = pattern.find('{', position);
+        const size_t end = std::string::npos == begin ? std::string::npos : pattern.find('}', begin);
+        if (std::string::npos == end) {
+            output.append(pattern, position, std::string::npos);
+            break;
+        }
+        output.append(pattern, position, begin - position);
+        position = end + 1;
+
+        const char* const name = pattern.data() + begin + 1;
+        const size_t nameSize = end - begin - 1;
+        const auto is = [name, nameSize](const char* expectedName) {
+            return std::strlen(expectedName) == nameSize && 0 == std::strncmp(expectedName, name, nameSize);
+        };
+        const std::string& path = components._path;
+        if (is("host")) {
+            output.append(components._host);
+        } else if (is("sub")) {
+            output.append(sub);
+        } else if (is("path")) {
+            output.append(path, 1, std::string::npos);
+        } else if (is("query")) {
+            output.append(components._query);
+        } else if (nameSize > 6 && 0 == pattern.compare(begin + 1, 6, "param:")) {
+            const std::string& query = components._query;
+            for (size_t paramBegin = 0; paramBegin < query.size();) {
+                const size_t paramEnd = std::min(query.find('&', paramBegin), query.size());
+                const size_t nameEnd = std::min(query.find('=', paramBegin), paramEnd);
+                if (nameEnd - paramBegin == nameSize - 6
+                    && 0 == query.compare(paramBegin, nameSize - 6, name + 6, nameSize - 6)) {
+                    output.append(query, std::min(nameEnd + 1, paramEnd), paramEnd - std::min(nameEnd + 1, paramEnd));
+                    break;
+                }
+                paramBegin = paramEnd + 1;
+            }
+        } else if (nameSize > 4 && 0 == pattern.compare(begin + 1, 4, "path")
+                   && std::isdigit(static_cast<unsigned char>(name[4]))) {
+            const size_t n = std::strtoul(name + 4, nullptr, 10);
+            const bool isRest = '+' == name[nameSize - 1];
+            size_t segmentBegin = 0, segmentEnd = 0;
+            if (findPathSegment(path, n, segmentBegin, segmentEnd)) {
+                output.append(path, segmentBegin, (isRest ? path.size() : segmentEnd) - segmentBegin);
+            }
+        } else {
+            // Not a placeholder
+            output.append(pattern, begin, end + 1 - begin);
+        }
+    }
+}
+
+}
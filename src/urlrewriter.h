@@ -0,0 +1,180 @@
+/*
+ * Copyright (c) 2015, Romain Létendart
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#pragma once
+
+#include <cstdint>
+#include <istream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace geecxx
+{
+
+/**
+ * The UrlRewriter class maps URLs leading to the same content onto a single
+ * one, according to rules read from a file, e.g. "youtu.be/<id>" onto
+ * "youtube.com/watch?v=<id>".
+ *
+ * Each line of the file is a rule: a host pattern, an action and its
+ * arguments, separated with spaces. Patterns are either a host
+ * ("youtu.be"), a host and its subdomains ("*.wikipedia.org", not matching
+ * "wikipedia.org" itself) or "*" for every host. Actions are:
+ * - strip-params <name>...: remove query parameters, names ending with '*'
+ *   being prefixes (e.g. "utm_*")
+ * - keep-params <name>...: remove every other query parameter
+ * - strip-path-segments <segment>...: remove path segments, e.g. "amp"
+ * - host <template>: replace the host
+ * - path <template>: replace the path
+ * - url <template>: replace the whole URL
+ * Templates may refer to the URL being rewritten: {host}, {sub} (the labels
+ * matched by '*'), {path} (without its leading '/'), {pathN} (its Nth
+ * segment), {pathN+} (its segments from the Nth on), {query} and
+ * {param:<name>}. Lines starting with '#' are comments.
+ *
+ * Every rule whose pattern matches applies, in the order of the file.
+ * Patterns are compiled into a trie of reversed host labels, so finding the
+ * rules of a URL costs one lookup per label of its host.
+ *
+ * Rewritten URLs may be saved and rewritten again when read back, rules
+ * must therefore leave their own results unchanged.
+ */
+class UrlRewriter
+{
+public:
+    UrlRewriter();
+
+    /**
+     * Replace the rules with the ones of a file
+     *
+     * @param[in] filePath path to the rules file
+     * @return true upon success, false if the file can't be read or holds
+     *         an invalid rule, the rules then being left unchanged
+     */
+    bool loadFromFile(const std::string& filePath);
+
+    /**
+     * Replace the rules with the ones of a stream
+     *
+     * @param[in] input rules, in the format of rules files
+     * @param[in] sourceName name of the input, used in error messages
+     * @return true upon success, false if the input holds an invalid rule,
+     *         the rules then being left unchanged
+     */
+    bool load(std::istream& input, const std::string& sourceName);
+
+    size_t getRuleCount() const;
+
+    /**
+     * Rewrite a URL according to the rules matching its host
+     *
+     * @param[in] formattedUrl URL, as formatted by stringutils::formatUrl()
+     * @param[out] output rewritten URL, in the same format, only set if a
+     *             rule matched. No memory is allocated once it is large
+     *             enough, e.g. when it is reused.
+     * @return true if a rule matched, false otherwise
+     */
+    bool rewrite(const std::string& formattedUrl, std::string& output) const;
+
+private:
+    enum class Action
+    {
+        STRIP_PARAMS,
+        KEEP_PARAMS,
+        STRIP_PATH_SEGMENTS,
+        HOST,
+        PATH,
+        URL
+    };
+
+    struct Rule
+    {
+        Action _action;
+        std::vector<std::string> _arguments;
+    };
+
+    struct Node
+    {
+        /**
+         * Children by label, sorted
+         */
+        std::vector<std::pair<std::string, std::uint32_t>> _children;
+
+        /**
+         * Rules of the host made of the labels leading to this node
+         */
+        std::vector<std::uint32_t> _hostRules;
+
+        /**
+         * Rules of its subdomains
+         */
+        std::vector<std::uint32_t> _subdomainRules;
+    };
+
+    /**
+     * Rule matching a URL, with the part of its host matched by '*'
+     */
+    struct Match
+    {
+        std::uint32_t _rule;
+        size_t _subSize;
+    };
+
+    /**
+     * Most rules applied to a single URL, others are ignored
+     */
+    static const size_t MAX_MATCH_COUNT = 16;
+
+    /**
+     * Most times the rules of a URL are looked up again after its host
+     * changed, in case rules send it back and forth
+     */
+    static const size_t MAX_PASS_COUNT = 4;
+
+    /**
+     * URL being rewritten, split into its components
+     */
+    struct Components;
+
+    /**
+     * Apply the rules of the host of a URL
+     *
+     * @param[out] hostChanged whether rules changed the host
+     * @see rewrite
+     */
+    bool rewriteOnce(const std::string& formattedUrl, std::string& output, bool& hostChanged) const;
+
+    static bool parseRule(const std::string& line, std::vector<std::string>& hostLabels,
+                          bool& matchesSubdomains, Rule& rule, std::string& error);
+    static void split(const std::string& url, Components& components);
+    static void apply(const Rule& rule, const std::string& sub, Components& components);
+    static void expand(const std::string& pattern, const std::string& sub, const Components& components,
+                       std::string& output);
+
+    std::vector<Node> _nodes;
+    std::vector<Rule> _rules;
+};
+
+}
@@ -22,18 +22,32 @@
  * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
  * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
+#define GEECXX_LOG_MODULE geecxx::LogModule::FETCH
+
 #include "webinforetriever.h"
 
+#include <chrono>
 #include <curl/curl.h>
 #include <sstream>
 #include <string>
 
 #include "logger.h"
+#include "metrics.h"
 #include "stringutils.h"
+#include "trace.h"
 
 namespace
 {
 
+geecxx::Counter& requestCount = geecxx::MetricsRegistry::getInstance().getCounter(
+        "geecxx_fetch_requests_total", "HTTP requests sent to retrieve page titles");
+geecxx::Counter& failedRequestCount = geecxx::MetricsRegistry::getInstance().getCounter(
+        "geecxx_fetch_failures_total", "HTTP requests that failed");
+geecxx::Counter& receivedByteCount = geecxx::MetricsRegistry::getInstance().getCounter(
+        "geecxx_fetch_received_bytes_total", "Bytes of headers and bodies downloaded");
+geecxx::Histogram& requestDuration = geecxx::MetricsRegistry::getInstance().getHistogram(
+        "geecxx_fetch_duration_microseconds", "Time spent on each HTTP request");
+
 static size_t curlWriteCallBack(void *contents, size_t size, size_t nmemb, void *userp)
 {
     ((std::stringstream*)userp)->write((char*)contents, size * nmemb);
@@ -59,6 +73,44 @@ WebInfoRetriever& WebInfoRetriever::getInstance()
 }
 
 bool WebInfoRetriever::retrievePageTitle(const std::string& url, std::string &pageTitle)
+{
+    if (_titleFixtures) {
+        const TitleFixtures::const_iterator fixture = _titleFixtures->find(url);
+        if (_titleFixtures->end() == fixture || !fixture->second._found) {
+            return false;
+        }
+        pageTitle = fixture->second._title;
+        return true;
+    }
+
+    const bool found = fetchPageTitle(url, pageTitle);
+    if (_recorder) {
+        _recorder->recordTitle(url, found, pageTitle);
+    }
+    return found;
+}
+
+void WebInfoRetriever::setRecorder(std::shared_ptr<TrafficRecorder> recorder)
+{
+    _recorder = std::move(recorder);
+}
+
+void WebInfoRetriever::setTitleFixtures(std::shared_ptr<const TitleFixtures> titleFixtures)
+{
+    _titleFixtures = std::move(titleFixtures);
+}
+
+void WebInfoRetriever::setCaFilePath(const std::string& caFilePath)
+{
+    _caFilePath = caFilePath;
+}
+
+void WebInfoRetriever::setTimeout(std::chrono::milliseconds timeout)
+{
+    _timeout = timeout;
+}
+
+bool WebInfoRetriever::fetchPageTitle(const std::string& url, std::string &pageTitle)
 {
     if (!_isInitiliazed) {
         return false;
@@ -110,19 +162,23 @@ std::string WebInfoRetriever::extractTitleFromContent(const std::string &pageCon
     // The solution below only works for <title> without any attributes.
     // It also only works if the first occurence of "<title>" is the actual
     // title of the HTML document (could be a comment for instance).
-    const std::string titleBeginTag("<title>");
-    const std::string titleEndTag("</title>");
+    static const stringutils::NoCaseSearcher titleBeginTag("<title>");
+    static const stringutils::NoCaseSearcher titleEndTag("</title>");
 
-    size_t titleBegin = stringutils::findNoCase(pageContent, titleBeginTag);
-    size_t titleEnd = stringutils::findNoCase(pageContent, titleEndTag);
-    if (std::string::npos == titleBegin || std::string::npos == titleEnd) {
+    size_t titleBegin = titleBeginTag.find(pageContent);
+    if (std::string::npos == titleBegin) {
+        return "";
+    }
+    titleBegin += titleBeginTag.getSize();
+    // The title ends after it begins, no need to scan the page again
+    size_t titleEnd = titleEndTag.find(pageContent, titleBegin);
+    if (std::string::npos == titleEnd) {
         return "";
     }
-
-    titleBegin += titleBeginTag.size();
 
     std::string title = pageContent.substr(titleBegin, titleEnd - titleBegin);
 
+    ScopedSpan span("decode_title");
     title = _htmlEntitiesHelper.decode(title);
     // Inline formatting should happen after HTML entities decoding that may
     // bring extra white spaces
@@ -136,13 +192,13 @@ std::string WebInfoRetriever::getHttpHeaderField(const std::string &headers, con
     std::string value;
     std::string line;
 
-    std::string pattern = std::string(key + ": ");
+    const stringutils::NoCaseSearcher pattern(key + ": ");
 
     std::stringstream headersStream(headers);
     while (std::getline(headersStream, line)) {
-        size_t o = stringutils::findNoCase(line, pattern);
+        size_t o = pattern.find(line);
         if (o != std::string::npos) {
-            value = line.substr(o + pattern.size());
+            value = line.substr(o + pattern.getSize());
             break;
         }
     }
@@ -166,8 +222,8 @@ bool WebInfoRetriever::sendHttpRequest(const std::string &url, RequestType type,
     curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, ::curlWriteCallBack);
     curl_easy_setopt(curl, CURLOPT_WRITEDATA, &readBuffer);
     curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
-    curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT, 15L);
-    curl_easy_setopt(curl, CURLOPT_TIMEOUT, 15L);
+    curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT_MS, static_cast<long>(_timeout.count()));
+    curl_easy_setopt(curl, CURLOPT_TIMEOUT_MS, static_cast<long>(_timeout.count()));
     curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 1L);
     curl_easy_setopt(curl, CURLOPT_CAINFO, _caFilePath.c_str());
     if (RequestType::HEADER == type) {
@@ -175,12 +231,22 @@ bool WebInfoRetriever::sendHttpRequest(const std::string &url, RequestType type,
         curl_easy_setopt(curl, CURLOPT_HEADER, 1L);
     }
 
+    const auto requestStart = std::chrono::steady_clock::now();
     res = curl_easy_perform(curl);
+    const auto requestEnd = std::chrono::steady_clock::now();
+    requestDuration.record(std::chrono::duration_cast<std::chrono::microseconds>(requestEnd - requestStart).count());
+    requestCount.increment();
+    addRequestSpans(curl, RequestType::HEADER == type ? "http_head" : "http_body", requestStart, requestEnd);
     curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &statusCode);
     curl_easy_cleanup(curl);
+    const std::streamoff receivedSize = readBuffer.tellp();
+    if (receivedSize > 0) {
+        receivedByteCount.increment(static_cast<std::uint64_t>(receivedSize));
+    }
     if (res != CURLE_OK) {
-        LOG_ERROR("CURL request failed for URL: " + url);
-        LOG_ERROR("Reason: " + std::string(curl_easy_strerror(res)));
+        failedRequestCount.increment();
+        LOG_ERROR("CURL request failed for URL: ", url);
+        LOG_ERROR("Reason: ", curl_easy_strerror(res));
         return false;
     }
 
@@ -189,6 +255,46 @@ bool WebInfoRetriever::sendHttpRequest(const std::string &url, RequestType type,
     return true;
 }
 
+void WebInfoRetriever::addRequestSpans(CURL* curl, const char* name,
+                                       std::chrono::steady_clock::time_point start,
+                                       std::chrono::steady_clock::time_point end)
+{
+    Trace* const trace = Trace::getCurrent();
+    if (nullptr == trace) {
+        return;
+    }
+
+    // Each time is the total since the beginning of the request, in
+    // microseconds, 0 for steps that didn't happen (e.g. TLS for HTTP)
+    curl_off_t nameLookupTime = 0;
+    curl_off_t connectTime = 0;
+    curl_off_t appConnectTime = 0;
+    curl_off_t preTransferTime = 0;
+    curl_off_t startTransferTime = 0;
+    curl_off_t totalTime = 0;
+    curl_easy_getinfo(curl, CURLINFO_NAMELOOKUP_TIME_T, &nameLookupTime);
+    curl_easy_getinfo(curl, CURLINFO_CONNECT_TIME_T, &connectTime);
+    curl_easy_getinfo(curl, CURLINFO_APPCONNECT_TIME_T, &appConnectTime);
+    curl_easy_getinfo(curl, CURLINFO_PRETRANSFER_TIME_T, &preTransferTime);
+    curl_easy_getinfo(curl, CURLINFO_STARTTRANSFER_TIME_T, &startTransferTime);
+    curl_easy_getinfo(curl, CURLINFO_TOTAL_TIME_T, &totalTime);
+
+    const auto addStep = [trace, start](const char* stepName, curl_off_t stepStart, curl_off_t stepEnd) {
+        if (stepEnd > stepStart) {
+            trace->addSpan(stepName, start + std::chrono::microseconds(stepStart),
+                           start + std::chrono::microseconds(stepEnd));
+        }
+    };
+    trace->openSpan();
+    addStep("dns", 0, nameLookupTime);
+    addStep("connect", nameLookupTime, connectTime);
+    addStep("tls", connectTime, appConnectTime);
+    // Time to first byte, once the request is sent
+    addStep("server", preTransferTime, startTransferTime);
+    addStep("download", startTransferTime, totalTime);
+    trace->closeSpan(name, start, end);
+}
+
 std::string WebInfoRetriever::strHttpError(const long& errorCode)
 {
     std::stringstream message;
@@ -220,7 +326,7 @@ std::string WebInfoRetriever::strHttpError(const long& errorCode)
         message << "Service Unavailable";
         break;
     case 504l:
-        message << "Bad Gateway";
+        message << "Gateway Timeout";
         break;
     default:
         message << "No description available";
@@ -24,12 +24,16 @@
  */
 #pragma once
 
+#include <chrono>
+#include <curl/curl.h>
+#include <memory>
 #include <sstream>
 #include <string>
 
 #include "globalconfig.h"
 
 #include "htmlentitieshelper.h"
+#include "trafficrecorder.h"
 
 namespace geecxx
 {
@@ -88,6 +92,44 @@ public:
      */
     bool retrievePageTitle(const std::string& url, std::string& pageTitle);
 
+    /**
+     * Record the results of the title retrievals from then on
+     * @param[in] recorder opened recorder, nullptr to stop recording
+     */
+    void setRecorder(std::shared_ptr<TrafficRecorder> recorder);
+
+    /**
+     * Serve titles from recorded ones instead of the network, retrievals
+     * of URLs which weren't recorded failing
+     * @param[in] titleFixtures recorded titles, nullptr to use the network
+     */
+    void setTitleFixtures(std::shared_ptr<const TitleFixtures> titleFixtures);
+
+    /**
+     * Validate peer certificates with another Certification Authority (CA)
+     * file, e.g. a test CA
+     * @param[in] caFilePath path to the CA file
+     */
+    void setCaFilePath(const std::string& caFilePath);
+
+    /**
+     * Give up on requests taking longer than a timeout
+     * @param[in] timeout timeout of each request, connection included
+     */
+    void setTimeout(std::chrono::milliseconds timeout);
+
+    /**
+     * Extract "<title>" tag content from HTML content
+     *
+     * The main purpose of this function is to extract the title of a HTML
+     * document. If any title has been found it is then formatted. Extra white
+     * spaces and new lines are removed and HTML entities are replaced with
+     * their equivalent unicode characters.
+     * @param[in] pageContent HTML content
+     * @return formatted title (if any), otherwise an empty string
+     */
+    std::string extractTitleFromContent(const std::string &pageContent);
+
 private:
     /**
      * Constructor
@@ -103,16 +145,12 @@ private:
     };
 
     /**
-     * Extract "<title>" tag content from HTML content
-     *
-     * The main purpose of this function is to extract the title of a HTML
-     * document. If any title has been found it is then formatted. Extra white
-     * spaces and new lines are removed and HTML entities are replaced with
-     * their equivalent unicode characters.
-     * @param[in] pageContent HTML content
-     * @return formatted title (if any), otherwise an empty string
+     * Retrieve web page title from the network (see retrievePageTitle())
+     * @param[in] url URL of the web page
+     * @param[out] pageTitle web page title (might be empty)
+     * @return true upon successful title retrieval
      */
-    std::string extractTitleFromContent(const std::string &pageContent);
+    bool fetchPageTitle(const std::string& url, std::string& pageTitle);
 
     /**
      * Retrieve a specific field from HTTP headers
@@ -133,6 +171,17 @@ private:
      */
     bool sendHttpRequest(const std::string& url, RequestType type, std::string& response, long& statusCode);
 
+    /**
+     * Add the steps of a finished request (DNS, connection, TLS, server
+     * time to first byte and download) to the current trace, if any
+     * @param[in] curl handle the request has been performed with
+     * @param[in] name name of the span of the whole request
+     * @param[in] start time the request started at
+     * @param[in] end time the request ended at
+     */
+    void addRequestSpans(CURL* curl, const char* name, std::chrono::steady_clock::time_point start,
+                         std::chrono::steady_clock::time_point end);
+
     /**
      * Return a description of a HTTP status code
      * @param[in] errorCode HTTP status code
@@ -144,10 +193,14 @@ private:
      * Path to the Certification Authority (CA) file that should be used
      * to validate peer certificates
      */
-    const std::string _caFilePath;
+    std::string _caFilePath;
+
+    std::chrono::milliseconds _timeout{15000};
 
     HTMLEntitiesHelper _htmlEntitiesHelper;
     bool _isInitiliazed = false;
+    std::shared_ptr<TrafficRecorder> _recorder;
+    std::shared_ptr<const TitleFixtures> _titleFixtures;
 };
 
 }
@@ -0,0 +1,149 @@
+/*
+ * Copyright (c) 2015, Romain Létendart
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "bottest.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "allocationcounter.h"
+#include "bot.h"
+#include "webinforetriever.h"
+
+namespace geecxx
+{
+
+CPPUNIT_TEST_SUITE_REGISTRATION(BotTest);
+
+void BotTest::setUp()
+{
+}
+
+void BotTest::tearDown()
+{
+    WebInfoRetriever::getInstance().setTitleFixtures(nullptr);
+}
+
+// Actual tests
+void BotTest::testSteadyStateAllocations()
+{
+    // Lines without URLs nor commands, as most of the lines of a channel
+    const std::vector<std::string> lines = {
+        ":alice!alice@example.com PRIVMSG #channel :Hello everyone, how is it going?",
+        ":bob!~bob@192.0.2.1 PRIVMSG #channel :fine, thanks: just back from lunch",
+        ":carol!carol@example.org PRIVMSG #channel :did anyone read the release notes of v2.0 yet?",
+        ":dave!dave@example.net PRIVMSG #channel :\x01" "ACTION waves\x01",
+        ":alice!alice@example.com NOTICE #channel :server restarting in 5 minutes",
+        ":irc.example.com 372 geecxx :- Message of the day",
+        ":bob!~bob@192.0.2.1 JOIN #channel",
+        ":carol!carol@example.org PART #channel :bye",
+    };
+    Bot bot;
+    // Buffers of the bot grow while handling the first lines
+    for (const std::string& line : lines) {
+        bot.handleLine(line);
+    }
+
+    const std::uint64_t allocationCount = AllocationCounter::getThreadCount();
+    for (size_t i = 0; i < 100; ++i) {
+        for (const std::string& line : lines) {
+            bot.handleLine(line);
+        }
+    }
+    CPPUNIT_ASSERT_EQUAL(allocationCount, AllocationCounter::getThreadCount());
+}
+
+void BotTest::testOfflineReplies()
+{
+    std::shared_ptr<TitleFixtures> titles = std::make_shared<TitleFixtures>();
+    (*titles)["http://example.com/a"] = RecordedTitle{true, "Page A"};
+    (*titles)["http://example.com/b"] = RecordedTitle{false, std::string()};
+    WebInfoRetriever::getInstance().setTitleFixtures(titles);
+
+    std::vector<std::string> sentLines;
+    Bot bot;
+    bot.initOffline("geecxx", "#channel", nullptr, [&sentLines](std::string_view line) {
+        sentLines.emplace_back(line);
+    });
+
+    bot.handleLine("PING :irc.example.com");
+    bot.handleLine(":alice!alice@example.com PRIVMSG #channel :see http://example.com/a");
+    bot.handleLine(":alice!alice@example.com PRIVMSG geecxx :http://example.com/a");
+    bot.handleLine(":bob!bob@example.com PRIVMSG #channel :http://example.com/b");
+    bot.handleLine(":carol!carol@example.com PRIVMSG #channel :http://example.com/a again");
+
+    const std::vector<std::string> expectedLines = {
+        "PONG irc.example.com",
+        "PRIVMSG #channel :Page A (URL#1)",
+        // Private messages are ignored, URLs without title only recorded
+        "PRIVMSG #channel :Page A (URL#1)",
+        "PRIVMSG #channel :carol: Already posted by alice 0 seconds ago (URL#1)",
+    };
+    CPPUNIT_ASSERT(expectedLines == sentLines);
+}
+
+void BotTest::testMissingRewriteRules()
+{
+    const std::string missingRulesPath = GEECXX_TEST_DATA_DIR "missing-url-rewrite.rules";
+
+    // Not shipped, e.g. when running from the build tree: no rules
+    CPPUNIT_ASSERT_EQUAL(true, initBot(missingRulesPath, {}));
+
+    // Asked for, it must be there
+    CPPUNIT_ASSERT_EQUAL(false, initBot(GEECXX_SOURCE_CONF_DIR "url-rewrite.rules",
+                                        {"--rewrite-rules", missingRulesPath}));
+
+    // Shipped, it must be valid
+    const std::string invalidRulesPath = GEECXX_TEST_DATA_DIR "invalid-url-rewrite.rules";
+    {
+        std::ofstream rulesFile(invalidRulesPath);
+        rulesFile << "* no-such-action\n";
+    }
+    const bool initialized = initBot(invalidRulesPath, {});
+    std::remove(invalidRulesPath.c_str());
+    CPPUNIT_ASSERT_EQUAL(false, initialized);
+}
+
+bool BotTest::initBot(const std::string& defaultRewriteRulesPath, const std::vector<std::string>& extraArgs)
+{
+    std::vector<std::string> args = {"geecxx", "127.0.0.1", "6667", "#channel", "--control-socket", ""};
+    args.insert(args.end(), extraArgs.begin(), extraArgs.end());
+    std::vector<char*> argv;
+    for (std::string& arg : args) {
+        argv.push_back(&arg[0]);
+    }
+
+    std::unique_ptr<ConfigurationProvider> configurationProvider(
+            new ConfigurationProvider(defaultRewriteRulesPath));
+    CPPUNIT_ASSERT_EQUAL(true, configurationProvider->parseCommandLineArgs(static_cast<int>(argv.size()),
+                                                                           argv.data()));
+    Bot bot;
+    return bot.init(std::move(configurationProvider));
+}
+
+}
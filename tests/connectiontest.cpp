@@ -24,6 +24,13 @@
  */
 #include "connectiontest.h"
 
+#include <boost/asio.hpp>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "allocationcounter.h"
 #include "connection.h"
 
 namespace geecxx
@@ -67,4 +74,88 @@ void ConnectionTest::testWrongPort()
     CPPUNIT_ASSERT_EQUAL(false, connectionA.isAlive());
 }
 
+void ConnectionTest::testHandOver()
+{
+    boost::asio::io_service ioService;
+    boost::asio::ip::tcp::acceptor acceptor(ioService, boost::asio::ip::tcp::endpoint(
+                                                boost::asio::ip::address_v4::loopback(), 0));
+    Connection connectionA("127.0.0.1", std::to_string(acceptor.local_endpoint().port()));
+    CPPUNIT_ASSERT_EQUAL(true, connectionA.open());
+    boost::asio::ip::tcp::socket server(ioService);
+    acceptor.accept(server);
+
+    // Both lines are read at once, the second one is still pending once the
+    // first one is handled
+    boost::asio::write(server, boost::asio::buffer(std::string("PING first\r\nPING second\r\n")));
+    std::vector<std::string> messages;
+    int fileDescriptor = -1;
+    std::string pendingInput;
+    connectionA.setExternalReadHandler([&](std::string_view message) {
+        messages.emplace_back(message);
+        fileDescriptor = connectionA.release(pendingInput);
+    });
+    CPPUNIT_ASSERT_EQUAL(true, connectionA.listen());
+    CPPUNIT_ASSERT_EQUAL(size_t(1), messages.size());
+    CPPUNIT_ASSERT(0 <= fileDescriptor);
+    CPPUNIT_ASSERT_EQUAL(std::string("PING second\r\n"), pendingInput);
+    CPPUNIT_ASSERT_EQUAL(false, connectionA.isAlive());
+
+    Connection connectionB("127.0.0.1", std::to_string(acceptor.local_endpoint().port()));
+    CPPUNIT_ASSERT_EQUAL(true, connectionB.adopt(fileDescriptor, pendingInput));
+    connectionB.setExternalReadHandler([&](std::string_view message) {
+        messages.emplace_back(message);
+        if (3 == messages.size()) {
+            connectionB.close();
+        }
+    });
+    CPPUNIT_ASSERT_EQUAL(true, connectionB.writeMessage("PONG first"));
+    boost::asio::write(server, boost::asio::buffer(std::string("PING third\r\n")));
+    CPPUNIT_ASSERT_EQUAL(true, connectionB.listen());
+
+    CPPUNIT_ASSERT_EQUAL(size_t(3), messages.size());
+    CPPUNIT_ASSERT_EQUAL(std::string("PING first"), messages[0]);
+    CPPUNIT_ASSERT_EQUAL(std::string("PING second"), messages[1]);
+    CPPUNIT_ASSERT_EQUAL(std::string("PING third"), messages[2]);
+
+    // Same session as before, on the server's side
+    boost::asio::streambuf input;
+    boost::asio::read_until(server, input, "\r\n");
+    std::istream inputStream(&input);
+    std::string line;
+    std::getline(inputStream, line);
+    CPPUNIT_ASSERT_EQUAL(std::string("PONG first\r"), line);
+}
+
+void ConnectionTest::testSteadyStateAllocations()
+{
+    boost::asio::io_service ioService;
+    boost::asio::ip::tcp::acceptor acceptor(ioService, boost::asio::ip::tcp::endpoint(
+                                                boost::asio::ip::address_v4::loopback(), 0));
+    Connection connection("127.0.0.1", std::to_string(acceptor.local_endpoint().port()));
+    CPPUNIT_ASSERT_EQUAL(true, connection.open());
+    boost::asio::ip::tcp::socket server(ioService);
+    acceptor.accept(server);
+
+    const size_t lineCount = 1000;
+    std::string input;
+    for (size_t i = 0; i < lineCount; ++i) {
+        input += ":nick!user@host PRIVMSG #channel :line number " + std::to_string(i) + "\r\n";
+    }
+    boost::asio::write(server, boost::asio::buffer(input));
+
+    // Allocations made from one line to the next, by the whole read cycle
+    // of the connection, once its buffers are large enough
+    std::vector<std::uint64_t> allocationCounts;
+    allocationCounts.reserve(lineCount);
+    connection.setExternalReadHandler([&](std::string_view) {
+        allocationCounts.push_back(AllocationCounter::getThreadCount());
+        if (lineCount == allocationCounts.size()) {
+            connection.close();
+        }
+    });
+    CPPUNIT_ASSERT_EQUAL(true, connection.listen());
+    CPPUNIT_ASSERT_EQUAL(lineCount, allocationCounts.size());
+    CPPUNIT_ASSERT_EQUAL(allocationCounts[lineCount / 10], allocationCounts.back());
+}
+
 }
@@ -36,6 +36,8 @@ class ConnectionTest : public CPPUNIT_NS::TestFixture
     CPPUNIT_TEST(testObjectConstructionDestruction);
     CPPUNIT_TEST(testWriteBeforeOpen);
     CPPUNIT_TEST(testWrongPort);
+    CPPUNIT_TEST(testHandOver);
+    CPPUNIT_TEST(testSteadyStateAllocations);
     CPPUNIT_TEST_SUITE_END();
 
 public:
@@ -50,6 +52,8 @@ public:
     void testWriteBeforeOpen();
     void testExternalWriteHandler();
     void testWrongPort();
+    void testHandOver();
+    void testSteadyStateAllocations();
 };
 
 }
@@ -0,0 +1,199 @@
+/*
+ * Copyright (c) 2015, Romain Létendart
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "controlservertest.h"
+
+#include <boost/asio.hpp>
+#include <cstdio>
+#include <fstream>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+
+#include "controlserver.h"
+
+namespace geecxx
+{
+
+namespace
+{
+
+/**
+ * Send raw commands to a control socket and return everything answered
+ * until the server closes the connection or stops answering
+ */
+std::string sendCommands(const std::string& socketPath, const std::string& commands, size_t responseCount)
+{
+    boost::asio::io_service ioService;
+    boost::asio::local::stream_protocol::socket socket(ioService);
+    boost::system::error_code error;
+    socket.connect(boost::asio::local::stream_protocol::endpoint(socketPath), error);
+    if (error) {
+        return "";
+    }
+    boost::asio::write(socket, boost::asio::buffer(commands), error);
+
+    // Each response ends with its last line, read until enough of them came
+    boost::asio::streambuf input;
+    std::string response;
+    for (size_t i = 0; i < responseCount && !error; ++i) {
+        const size_t size = boost::asio::read_until(socket, input, '\n', error);
+        if (error) {
+            break;
+        }
+        std::string line(boost::asio::buffers_begin(input.data()),
+                         boost::asio::buffers_begin(input.data()) + size);
+        input.consume(size);
+        response += line;
+        if (0 == line.compare(0, 3, "OK ")) {
+            // Status lines don't count as responses, their output lines do
+            responseCount += std::stoul(line.substr(3));
+        }
+    }
+    return response;
+}
+
+bool echo(const std::string& command, std::string& output, int& fileDescriptor)
+{
+    if (command == "pipe") {
+        // Passes the writing end, the test keeps the reading end
+        int pipeFileDescriptors[2];
+        if (0 != ::pipe(pipeFileDescriptors)) {
+            output = "No pipe";
+            return false;
+        }
+        output = std::to_string(pipeFileDescriptors[0]);
+        fileDescriptor = pipeFileDescriptors[1];
+        return true;
+    }
+    if (command == "fail") {
+        output = "Failed on purpose\nsecond line isn't sent";
+        return false;
+    }
+    if (command == "two") {
+        output = "first\nsecond\n";
+        return true;
+    }
+    output = command;
+    return true;
+}
+
+}
+
+CPPUNIT_TEST_SUITE_REGISTRATION(ControlServerTest);
+
+void ControlServerTest::setUp()
+{
+}
+
+void ControlServerTest::tearDown()
+{
+    std::remove(_socketPath.c_str());
+}
+
+void ControlServerTest::testCommands()
+{
+    boost::asio::io_service ioService;
+    ControlServer server(ioService, echo);
+    CPPUNIT_ASSERT_EQUAL(true, server.open(_socketPath));
+
+    std::thread serverThread([&ioService]() {
+        ioService.run();
+    });
+
+    // Several commands on the same connection, answered in order
+    CPPUNIT_ASSERT_EQUAL(std::string("OK 1\n/j #channel\n"
+                                     "OK 2\nfirst\nsecond\n"
+                                     "ERROR Failed on purpose\n"
+                                     "OK 0\n"
+                                     "OK 1\nstill there\n"),
+                         sendCommands(_socketPath, "/j #channel\r\ntwo\nfail\n\nstill there\n", 5));
+
+    // Same thing through the client, which also receives file descriptors
+    std::string output;
+    int fileDescriptor = -1;
+    CPPUNIT_ASSERT_EQUAL(true, ControlServer::sendCommand(_socketPath, "two", output, fileDescriptor));
+    CPPUNIT_ASSERT_EQUAL(std::string("first\nsecond\n"), output);
+    CPPUNIT_ASSERT_EQUAL(-1, fileDescriptor);
+    CPPUNIT_ASSERT_EQUAL(false, ControlServer::sendCommand(_socketPath, "fail", output, fileDescriptor));
+    CPPUNIT_ASSERT_EQUAL(std::string("Failed on purpose"), output);
+
+    CPPUNIT_ASSERT_EQUAL(true, ControlServer::sendCommand(_socketPath, "pipe", output, fileDescriptor));
+    CPPUNIT_ASSERT(0 <= fileDescriptor);
+    const int readFileDescriptor = std::stoi(output);
+    CPPUNIT_ASSERT_EQUAL(ssize_t(5), ::write(fileDescriptor, "hello", 5));
+    ::close(fileDescriptor);
+    char buffer[16];
+    CPPUNIT_ASSERT_EQUAL(ssize_t(5), ::read(readFileDescriptor, buffer, sizeof(buffer)));
+    CPPUNIT_ASSERT_EQUAL(std::string("hello"), std::string(buffer, 5));
+    // Closed by the server once passed, the writing end is only open here
+    CPPUNIT_ASSERT_EQUAL(ssize_t(0), ::read(readFileDescriptor, buffer, sizeof(buffer)));
+    ::close(readFileDescriptor);
+
+    // Commands too long are refused and the connection is closed
+    CPPUNIT_ASSERT_EQUAL(std::string("ERROR Command too long\n"),
+                         sendCommands(_socketPath, std::string(10000, 'x') + "\nignored\n", 2));
+
+    ioService.post([&server]() {
+        server.close();
+    });
+    serverThread.join();
+    CPPUNIT_ASSERT_EQUAL(false, server.isOpen());
+}
+
+void ControlServerTest::testSocketFile()
+{
+    // Left by a previous run
+    std::ofstream(_socketPath).put('x');
+
+    boost::asio::io_service ioService;
+    ControlServer server(ioService, echo);
+    CPPUNIT_ASSERT_EQUAL(true, server.open(_socketPath));
+
+    struct stat status;
+    CPPUNIT_ASSERT_EQUAL(0, ::stat(_socketPath.c_str(), &status));
+    CPPUNIT_ASSERT(S_ISSOCK(status.st_mode));
+    CPPUNIT_ASSERT_EQUAL(0600, int(status.st_mode & 0777));
+
+    // Kept for the server taking over
+    server.close(false);
+    CPPUNIT_ASSERT_EQUAL(0, ::stat(_socketPath.c_str(), &status));
+    CPPUNIT_ASSERT_EQUAL(true, server.open(_socketPath));
+    server.close();
+    CPPUNIT_ASSERT_EQUAL(-1, ::stat(_socketPath.c_str(), &status));
+
+    ControlServer otherServer(ioService, echo);
+    CPPUNIT_ASSERT_EQUAL(false, otherServer.open(GEECXX_TEST_DATA_DIR "missing-directory/control.sock"));
+
+    // The socket of a running server is left alone
+    CPPUNIT_ASSERT_EQUAL(true, server.open(_socketPath));
+    CPPUNIT_ASSERT_EQUAL(false, otherServer.open(_socketPath));
+    CPPUNIT_ASSERT_EQUAL(false, otherServer.isOpen());
+    CPPUNIT_ASSERT_EQUAL(0, ::stat(_socketPath.c_str(), &status));
+    CPPUNIT_ASSERT_EQUAL(true, server.isOpen());
+    server.close();
+    CPPUNIT_ASSERT_EQUAL(-1, ::stat(_socketPath.c_str(), &status));
+}
+
+}
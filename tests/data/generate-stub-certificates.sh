@@ -0,0 +1,42 @@
+#!/bin/bash
+# Copyright (c) 2015, Romain Létendart
+# All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions are met:
+#
+# 1. Redistributions of source code must retain the above copyright notice, this
+#    list of conditions and the following disclaimer.
+# 2. Redistributions in binary form must reproduce the above copyright notice,
+#    this list of conditions and the following disclaimer in the documentation
+#    and/or other materials provided with the distribution.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+# ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+# WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+# DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+# ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+# (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+# LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+# ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+# (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+# SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+#
+#
+# Generate the certificates of the HTTPS stub server (see httpstubserver.h):
+# a test CA and a server certificate it signs, for 127.0.0.1 and localhost,
+# plus another CA which didn't sign it. They are valid for 100 years, their
+# keys aren't secret.
+set -e
+
+cd "$(dirname "$0")"
+openssl req -x509 -newkey rsa:2048 -nodes -days 36500 -subj "/CN=Geecxx test CA" \
+        -keyout stub-ca.key -out stub-ca.pem
+openssl req -newkey rsa:2048 -nodes -subj "/CN=localhost" \
+        -keyout stub-server.key -out stub-server.csr
+openssl x509 -req -in stub-server.csr -CA stub-ca.pem -CAkey stub-ca.key -CAcreateserial -days 36500 \
+        -extfile <(printf "subjectAltName=IP:127.0.0.1,DNS:localhost\nbasicConstraints=CA:FALSE\n") \
+        -out stub-server.pem
+openssl req -x509 -newkey rsa:2048 -nodes -days 36500 -subj "/CN=Geecxx other test CA" \
+        -keyout stub-other-ca.key -out stub-other-ca.pem
+rm -f stub-server.csr stub-other-ca.key stub-ca.srl stub-ca.key
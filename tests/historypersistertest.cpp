@@ -0,0 +1,128 @@
+/*
+ * Copyright (c) 2015, Romain Létendart
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "historypersistertest.h"
+
+#include <cstdio>
+#include <fstream>
+
+#include "historypersister.h"
+#include "logger.h"
+#include "urlhistorymanager.h"
+
+namespace geecxx
+{
+
+CPPUNIT_TEST_SUITE_REGISTRATION(HistoryPersisterTest);
+
+void HistoryPersisterTest::setUp()
+{
+}
+
+void HistoryPersisterTest::tearDown()
+{
+    std::ifstream historyFile(_historyFilePath);
+    if (historyFile.good()) {
+        // File exists, we need to delete it
+        historyFile.close();
+        if (0 != remove(_historyFilePath.c_str())) {
+            LOG_ERROR("Unable to remove file: ", _historyFilePath);
+        }
+    } // else, nothing to clean up
+}
+
+// Actual tests
+void HistoryPersisterTest::testFlush()
+{
+    UrlHistoryManager history(8, _historyFilePath);
+    HistoryPersister persister(_historyFilePath);
+    persister.start();
+
+    CPPUNIT_ASSERT_EQUAL(true, history.insert("http://www.websiteA.com/", "Title A", "Author A"));
+    CPPUNIT_ASSERT_EQUAL(true, persister.submit(history.takeSnapshot()));
+    CPPUNIT_ASSERT_EQUAL(true, persister.flush());
+
+    HistoryPersisterStats stats = persister.getStats();
+    CPPUNIT_ASSERT_EQUAL(size_t(0), stats._backlogDepth);
+    CPPUNIT_ASSERT(stats._flushCount >= 1);
+    CPPUNIT_ASSERT_EQUAL(std::uint64_t(0), stats._failedFlushCount);
+
+    // Snapshot should now be readable from the disk
+    UrlHistoryManager readHistory(8, _historyFilePath);
+    UrlHistoryEntry entry;
+    CPPUNIT_ASSERT_EQUAL(true, readHistory.initFromFile());
+    CPPUNIT_ASSERT_EQUAL(true, readHistory.find("http://www.websiteA.com/", entry));
+    CPPUNIT_ASSERT_EQUAL(std::string("Title A"), entry._title);
+    CPPUNIT_ASSERT_EQUAL(std::string("Author A"), entry._messageAuthor);
+}
+
+void HistoryPersisterTest::testBoundedBacklog()
+{
+    UrlHistoryManager history(8, _historyFilePath);
+    // Worker is not started, snapshots pile up in the backlog
+    HistoryPersister persister(_historyFilePath, 2);
+
+    for (size_t i = 1; i <= 5; ++i) {
+        CPPUNIT_ASSERT_EQUAL(true, history.insert("http://www.website.com/page" + std::to_string(i), "", ""));
+        CPPUNIT_ASSERT_EQUAL(true, persister.submit(history.takeSnapshot()));
+    }
+
+    HistoryPersisterStats stats = persister.getStats();
+    CPPUNIT_ASSERT_EQUAL(size_t(2), stats._backlogDepth);
+    CPPUNIT_ASSERT_EQUAL(size_t(2), stats._maxBacklogDepth);
+    CPPUNIT_ASSERT_EQUAL(std::uint64_t(3), stats._droppedSnapshotCount);
+
+    // Flushing without worker writes from the calling thread
+    CPPUNIT_ASSERT_EQUAL(true, persister.flush());
+    stats = persister.getStats();
+    CPPUNIT_ASSERT_EQUAL(size_t(0), stats._backlogDepth);
+    CPPUNIT_ASSERT_EQUAL(std::uint64_t(2), stats._flushCount);
+
+    // The most recent snapshot is the one left on the disk
+    UrlHistoryManager readHistory(8, _historyFilePath);
+    CPPUNIT_ASSERT_EQUAL(true, readHistory.initFromFile());
+    CPPUNIT_ASSERT_EQUAL(size_t(5), readHistory.getSize());
+}
+
+void HistoryPersisterTest::testStopWritesPendingSnapshots()
+{
+    UrlHistoryManager history(8, _historyFilePath);
+    {
+        HistoryPersister persister(_historyFilePath);
+        persister.start();
+        CPPUNIT_ASSERT_EQUAL(true, history.insert("http://www.websiteA.com/", "Title A", "Author A"));
+        CPPUNIT_ASSERT_EQUAL(true, history.insert("http://www.websiteB.com/", "Title B", "Author B"));
+        CPPUNIT_ASSERT_EQUAL(true, persister.submit(history.takeSnapshot()));
+        persister.stop();
+
+        // Nothing can be submitted once stopped
+        CPPUNIT_ASSERT_EQUAL(false, persister.submit(history.takeSnapshot()));
+    }
+
+    UrlHistoryManager readHistory(8, _historyFilePath);
+    CPPUNIT_ASSERT_EQUAL(true, readHistory.initFromFile());
+    CPPUNIT_ASSERT_EQUAL(size_t(2), readHistory.getSize());
+}
+
+}
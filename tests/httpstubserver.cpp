@@ -0,0 +1,312 @@
+/*
+ * Copyright (c) 2015, Romain Létendart
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "httpstubserver.h"
+
+#include <boost/asio/steady_timer.hpp>
+#include <cstdio>
+#include <functional>
+#include <vector>
+
+namespace geecxx
+{
+
+namespace
+{
+
+typedef boost::asio::ip::tcp::socket TcpStream;
+typedef boost::asio::ssl::stream<boost::asio::ip::tcp::socket> SslStream;
+typedef std::function<void (const boost::system::error_code&)> Handler;
+
+void asyncHandshake(TcpStream&, const Handler& handler)
+{
+    handler(boost::system::error_code());
+}
+
+void asyncHandshake(SslStream& stream, const Handler& handler)
+{
+    stream.async_handshake(boost::asio::ssl::stream_base::server, handler);
+}
+
+const char* getReasonPhrase(int statusCode)
+{
+    switch (statusCode) {
+    case 200: return "OK";
+    case 301: return "Moved Permanently";
+    case 302: return "Found";
+    case 307: return "Temporary Redirect";
+    case 308: return "Permanent Redirect";
+    default: return "Stub";
+    }
+}
+
+}
+
+/**
+ * A connection of the HttpStubServer, answering a single request
+ */
+template <typename Stream>
+class HttpStubSession : public std::enable_shared_from_this<HttpStubSession<Stream>>
+{
+public:
+    template <typename... StreamArgs>
+    HttpStubSession(HttpStubServer& server, StreamArgs&... streamArgs)
+        : _server(server), _stream(server._ioService, streamArgs...), _timer(server._ioService)
+    {
+    }
+
+    boost::asio::ip::tcp::socket::lowest_layer_type& getSocket()
+    {
+        return _stream.lowest_layer();
+    }
+
+    void start()
+    {
+        auto self = this->shared_from_this();
+        asyncHandshake(_stream, [self](const boost::system::error_code& error) {
+            if (!error) {
+                self->readRequest();
+            }
+        });
+    }
+
+private:
+    void readRequest()
+    {
+        auto self = this->shared_from_this();
+        boost::asio::async_read_until(_stream, _request, "\r\n\r\n",
+                                      [self](const boost::system::error_code& error, size_t) {
+            if (!error) {
+                self->answer();
+            }
+        });
+    }
+
+    void answer()
+    {
+        std::istream request(&_request);
+        std::string method, target;
+        request >> method >> target;
+        _page = _server.getPage(target.substr(0, target.find('?')));
+        if (_page._stall) {
+            // Only the client can end the connection, or the server stopping
+            auto self = this->shared_from_this();
+            boost::asio::async_read(_stream, _request, [self](const boost::system::error_code&, size_t) {});
+            return;
+        }
+
+        _response = "HTTP/1.1 " + std::to_string(_page._statusCode) + " " + getReasonPhrase(_page._statusCode) + "\r\n";
+        if (!_page._contentType.empty()) {
+            _response += "Content-Type: " + _page._contentType + "\r\n";
+        }
+        if (!_page._location.empty()) {
+            _response += "Location: " + _page._location + "\r\n";
+        }
+        if (_page._chunked) {
+            _response += "Transfer-Encoding: chunked\r\n";
+        } else {
+            _response += "Content-Length: " + std::to_string(_page._body.size()) + "\r\n";
+        }
+        _response += "Connection: close\r\n\r\n";
+
+        if ("HEAD" != method) {
+            const size_t partSize = 0 == _page._dripSize ? std::max<size_t>(_page._body.size(), 1) : _page._dripSize;
+            for (size_t position = 0; position < _page._body.size(); position += partSize) {
+                const std::string data = _page._body.substr(position, partSize);
+                if (_page._chunked) {
+                    char size[32];
+                    std::snprintf(size, sizeof(size), "%zx\r\n", data.size());
+                    _parts.push_back(size + data + "\r\n");
+                } else {
+                    _parts.push_back(data);
+                }
+            }
+            if (_page._chunked) {
+                _parts.push_back("0\r\n\r\n");
+            }
+        }
+        if (0 == _page._dripSize && !_parts.empty()) {
+            // Sent along with the headers
+            for (const std::string& part : _parts) {
+                _response += part;
+            }
+            _parts.clear();
+        }
+        write(_response);
+    }
+
+    void write(const std::string& data)
+    {
+        auto self = this->shared_from_this();
+        boost::asio::async_write(_stream, boost::asio::buffer(data),
+                                 [self](const boost::system::error_code& error, size_t) {
+            if (error) {
+                return;
+            }
+            if (self->_nextPart == self->_parts.size()) {
+                self->close();
+                return;
+            }
+            self->_timer.expires_from_now(self->_page._dripInterval);
+            self->_timer.async_wait([self](const boost::system::error_code& timerError) {
+                if (!timerError) {
+                    self->write(self->_parts[self->_nextPart++]);
+                }
+            });
+        });
+    }
+
+    void close()
+    {
+        // No TLS close_notify, the response says where it ends anyway
+        boost::system::error_code ignoredError;
+        getSocket().shutdown(boost::asio::socket_base::shutdown_both, ignoredError);
+        getSocket().close(ignoredError);
+    }
+
+    HttpStubServer& _server;
+    Stream _stream;
+    boost::asio::steady_timer _timer;
+    boost::asio::streambuf _request;
+    HttpStubPage _page;
+    std::string _response;
+    std::vector<std::string> _parts;
+    size_t _nextPart = 0;
+};
+
+HttpStubServer::HttpStubServer(const std::string& certificateDirectory)
+    : _secure(!certificateDirectory.empty()), _acceptor(_ioService),
+      _sslContext(boost::asio::ssl::context::tls_server)
+{
+    if (_secure) {
+        boost::system::error_code ignoredError;
+        _sslContext.use_certificate_chain_file(certificateDirectory + "stub-server.pem", ignoredError);
+        _sslContext.use_private_key_file(certificateDirectory + "stub-server.key",
+                                         boost::asio::ssl::context::pem, ignoredError);
+    }
+}
+
+HttpStubServer::~HttpStubServer()
+{
+    stop();
+}
+
+bool HttpStubServer::start()
+{
+    const boost::asio::ip::tcp::endpoint endpoint(boost::asio::ip::address_v4::loopback(), 0);
+    boost::system::error_code error;
+    _acceptor.open(endpoint.protocol(), error);
+    if (!error) {
+        _acceptor.bind(endpoint, error);
+    }
+    if (!error) {
+        _acceptor.listen(boost::asio::socket_base::max_connections, error);
+    }
+    if (error) {
+        return false;
+    }
+
+    asyncAccept();
+    _thread = std::thread([this]() {
+        _ioService.run();
+    });
+    return true;
+}
+
+void HttpStubServer::stop()
+{
+    _ioService.stop();
+    if (_thread.joinable()) {
+        _thread.join();
+    }
+    boost::system::error_code ignoredError;
+    _acceptor.close(ignoredError);
+}
+
+std::string HttpStubServer::getUrl(const std::string& path) const
+{
+    boost::system::error_code ignoredError;
+    return std::string(_secure ? "https" : "http") + "://127.0.0.1:"
+           + std::to_string(_acceptor.local_endpoint(ignoredError).port()) + path;
+}
+
+void HttpStubServer::setPage(const std::string& path, const HttpStubPage& page)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _pages[path] = page;
+}
+
+size_t HttpStubServer::getRequestCount() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _requestCount;
+}
+
+std::string HttpStubServer::makeHtml(const std::string& title, size_t titleOffset, size_t size)
+{
+    static const std::string filler = "<meta name=\"description\" content=\"Filler of the stub page\">\n";
+    std::string html = "<!DOCTYPE html>\n<html>\n<head>\n";
+    while (html.size() < titleOffset) {
+        html += filler;
+    }
+    html += "<title>" + title + "</title>\n</head>\n<body>\n";
+    while (html.size() + 16 < size) {
+        html += "<p>Content</p>\n";
+    }
+    html += "</body>\n</html>\n";
+    return html;
+}
+
+void HttpStubServer::asyncAccept()
+{
+    const auto accept = [this](auto session) {
+        _acceptor.async_accept(session->getSocket(), [this, session](const boost::system::error_code& error) {
+            if (error) {
+                return;
+            }
+            session->start();
+            asyncAccept();
+        });
+    };
+    if (_secure) {
+        accept(std::make_shared<HttpStubSession<SslStream>>(*this, _sslContext));
+    } else {
+        accept(std::make_shared<HttpStubSession<TcpStream>>(*this));
+    }
+}
+
+HttpStubPage HttpStubServer::getPage(const std::string& path)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    ++_requestCount;
+    const std::map<std::string, HttpStubPage>::const_iterator page = _pages.find(path);
+    if (_pages.end() == page) {
+        HttpStubPage notFound;
+        notFound._statusCode = 404;
+        return notFound;
+    }
+    return page->second;
+}
+
+}
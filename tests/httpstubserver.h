@@ -0,0 +1,158 @@
+/*
+ * Copyright (c) 2015, Romain Létendart
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#pragma once
+
+#include <boost/asio.hpp>
+#include <boost/asio/ssl.hpp>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace geecxx
+{
+
+/**
+ * What the HttpStubServer answers to the requests of a path
+ */
+struct HttpStubPage
+{
+    int _statusCode = 200;
+    std::string _contentType = "text/html; charset=utf-8";
+    std::string _body;
+    /**
+     * Target of a redirection, sent as Location with 3xx status codes
+     */
+    std::string _location;
+    /**
+     * Whether the body is sent with "Transfer-Encoding: chunked" rather
+     * than a Content-Length
+     */
+    bool _chunked = false;
+    /**
+     * Bytes of the body sent at once (and size of the chunks), 0 for all
+     */
+    size_t _dripSize = 0;
+    /**
+     * Time waited between two parts of the body
+     */
+    std::chrono::milliseconds _dripInterval{0};
+    /**
+     * Whether requests are never answered, the connection being left open
+     */
+    bool _stall = false;
+};
+
+/**
+ * The HttpStubServer class serves pages over HTTP/1.1, or HTTPS with a
+ * test CA (see tests/data/generate-stub-certificates.sh), on the loopback
+ * interface, so that page title retrieval can be tested and benchmarked
+ * without network access.
+ *
+ * The server runs on its own thread between start() and stop(). Each
+ * request gets its own connection, closed after the response. Pages may be
+ * changed at any time.
+ */
+class HttpStubServer
+{
+public:
+    /**
+     * Constructor
+     * @param[in] certificateDirectory directory of stub-server.pem and
+     *            stub-server.key, to serve HTTPS, empty to serve HTTP
+     */
+    explicit HttpStubServer(const std::string& certificateDirectory = "");
+
+    HttpStubServer(const HttpStubServer&) = delete;
+    HttpStubServer& operator=(const HttpStubServer&) = delete;
+
+    ~HttpStubServer();
+
+    /**
+     * Listen on the loopback interface and serve requests on a new thread
+     * @return true upon success, false otherwise
+     */
+    bool start();
+
+    /**
+     * Stop serving, stalled and pending requests being closed
+     */
+    void stop();
+
+    /**
+     * Get the URL of a path
+     * @param[in] path absolute path, e.g. "/page"
+     * @return URL of the path on this server
+     */
+    std::string getUrl(const std::string& path) const;
+
+    /**
+     * Set the page served for a path, other paths getting an empty 404
+     * @param[in] path absolute path, without query
+     * @param[in] page what to answer
+     */
+    void setPage(const std::string& path, const HttpStubPage& page);
+
+    /**
+     * Get the number of requests received so far
+     * @return number of requests
+     */
+    size_t getRequestCount() const;
+
+    /**
+     * Make a HTML page
+     * @param[in] title content of the <title> tag
+     * @param[in] titleOffset bytes of markup before the <title> tag, at least
+     * @param[in] size size of the page, at least
+     * @return HTML document
+     */
+    static std::string makeHtml(const std::string& title, size_t titleOffset = 0, size_t size = 0);
+
+private:
+    template <typename Stream> friend class HttpStubSession;
+
+    void asyncAccept();
+
+    /**
+     * Get the page of a request's path
+     * @param[in] path path requested, the query being ignored
+     * @return page to be served
+     */
+    HttpStubPage getPage(const std::string& path);
+
+    const bool _secure;
+    boost::asio::io_service _ioService;
+    boost::asio::ip::tcp::acceptor _acceptor;
+    boost::asio::ssl::context _sslContext;
+    std::thread _thread;
+    mutable std::mutex _mutex;
+    std::map<std::string, HttpStubPage> _pages;
+    size_t _requestCount = 0;
+};
+
+}
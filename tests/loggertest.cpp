@@ -0,0 +1,234 @@
+/*
+ * Copyright (c) 2015, Romain Létendart
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "loggertest.h"
+
+#include <condition_variable>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <streambuf>
+#include <string>
+
+#include "logger.h"
+
+namespace geecxx
+{
+
+namespace
+{
+
+/**
+ * Stream buffer stuck in its first write until released, so that the
+ * logger's queue can be filled up
+ */
+class BlockingBuffer : public std::stringbuf
+{
+public:
+    void waitUntilBlocked()
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _condition.wait(lock, [this]() { return _blocked; });
+    }
+
+    void release()
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _released = true;
+        _condition.notify_all();
+    }
+
+protected:
+    std::streamsize xsputn(const char* s, std::streamsize count) override
+    {
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _blocked = true;
+            _condition.notify_all();
+            _condition.wait(lock, [this]() { return _released; });
+        }
+        return std::stringbuf::xsputn(s, count);
+    }
+
+private:
+    std::mutex _mutex;
+    std::condition_variable _condition;
+    bool _blocked = false;
+    bool _released = false;
+};
+
+}
+
+CPPUNIT_TEST_SUITE_REGISTRATION(LoggerTest);
+
+void LoggerTest::setUp()
+{
+}
+
+void LoggerTest::tearDown()
+{
+    Logger::setThresholds("all=debug");
+    Logger::getInstance().setOverflowPolicy(LogOverflowPolicy::BLOCK);
+    Logger::getInstance().setOutput(std::cout);
+}
+
+// Actual tests
+void LoggerTest::testFormat()
+{
+    std::ostringstream output;
+    Logger::getInstance().setOutput(output);
+
+    // One line per line of the message, empty lines included
+    LOG_WARNING("first\n\nthird\n");
+    Logger::getInstance().flush();
+
+    std::istringstream lines(output.str());
+    std::string line;
+    size_t lineCount = 0;
+    const std::string expectedContents[] = {"first", "", "third"};
+    while (std::getline(lines, line)) {
+        CPPUNIT_ASSERT(lineCount < 3);
+        // [YYYY-MM-DD HH:MM:SS][WARNING]: content
+        CPPUNIT_ASSERT_EQUAL(std::string("["), line.substr(0, 1));
+        CPPUNIT_ASSERT_EQUAL(std::string("][WARNING]: ") + expectedContents[lineCount], line.substr(20));
+        ++lineCount;
+    }
+    CPPUNIT_ASSERT_EQUAL(size_t(3), lineCount);
+}
+
+void LoggerTest::testArguments()
+{
+    LogRecord record;
+    std::string text;
+    const std::string name = "geecxx";
+    const char* const nullString = nullptr;
+    record.reset(LogLevel::INFO, 0);
+    record.add(name);
+    record.add(' ');
+    record.add(-42);
+    record.add(" ");
+    record.add(std::uint64_t(18446744073709551615ull));
+    record.add(" ");
+    record.add(0.25);
+    record.add(" ");
+    record.add(true);
+    record.add(" ");
+    record.add(nullString);
+    record.format(text);
+    CPPUNIT_ASSERT_EQUAL(std::string("geecxx -42 18446744073709551615 0.25 true (null)"), text);
+
+    // Arguments larger than the inline storage move to the heap
+    const std::string longString(2 * LogRecord::INLINE_SIZE, 'x');
+    record.reset(LogLevel::INFO, 0);
+    record.add(size_t(7));
+    record.add(longString);
+    record.add('!');
+    LogRecord movedRecord;
+    movedRecord = std::move(record);
+    text.clear();
+    movedRecord.format(text);
+    CPPUNIT_ASSERT_EQUAL(std::string("7") + longString + "!", text);
+
+    // Disabled levels don't evaluate their arguments
+    size_t evaluationCount = 0;
+    const auto evaluate = [&evaluationCount]() {
+        return ++evaluationCount;
+    };
+    std::ostringstream output;
+    Logger::getInstance().setOutput(output);
+    LOG_WARNING("evaluated ", evaluate());
+    LOG_DEBUG("not evaluated ", evaluate());
+    Logger::getInstance().flush();
+    CPPUNIT_ASSERT_EQUAL(size_t(Logger::isCompiledIn(LogLevel::DEBUG) ? 2 : 1), evaluationCount);
+    CPPUNIT_ASSERT(std::string::npos != output.str().find("[WARNING]: evaluated 1\n"));
+}
+
+void LoggerTest::testDropPolicy()
+{
+    const size_t overflowCount = 10;
+    BlockingBuffer buffer;
+    std::ostream output(&buffer);
+    Logger& logger = Logger::getInstance();
+    logger.setOutput(output);
+    logger.setOverflowPolicy(LogOverflowPolicy::DROP);
+
+    // The writer takes the first message and gets stuck writing it, the
+    // following ones fill the queue
+    LOG_WARNING("first");
+    buffer.waitUntilBlocked();
+    const std::uint64_t droppedCount = logger.getDroppedCount();
+    for (size_t i = 0; i < 8192 + overflowCount; ++i) {
+        LOG_WARNING("message ", i);
+    }
+    CPPUNIT_ASSERT_EQUAL(std::uint64_t(overflowCount), logger.getDroppedCount() - droppedCount);
+
+    buffer.release();
+    logger.flush();
+    const std::string written = buffer.str();
+    CPPUNIT_ASSERT(std::string::npos != written.find("]: message 8191\n"));
+    CPPUNIT_ASSERT(std::string::npos == written.find("]: message 8192\n"));
+    CPPUNIT_ASSERT(std::string::npos != written.find("]: 10 log message(s) dropped\n"));
+}
+
+void LoggerTest::testModuleThresholds()
+{
+    // Runtime thresholds never go below the build time one
+    CPPUNIT_ASSERT(LOG_LEVEL_THRESHOLD == Logger::getThreshold(LogModule::GENERAL));
+    Logger::setThreshold(LogModule::HTML, LogLevel::DEBUG);
+    CPPUNIT_ASSERT(LOG_LEVEL_THRESHOLD == Logger::getThreshold(LogModule::HTML));
+
+    CPPUNIT_ASSERT_EQUAL(true, Logger::setThresholds("all=warning, HISTORY = Error"));
+    CPPUNIT_ASSERT(LogLevel::ERROR == Logger::getThreshold(LogModule::HISTORY));
+    CPPUNIT_ASSERT(LogLevel::WARNING == Logger::getThreshold(LogModule::CONNECTION));
+    CPPUNIT_ASSERT_EQUAL(std::string("general=warning,connection=warning,bot=warning,fetch=warning,"
+                                     "history=error,html=warning"),
+                         Logger::getThresholds());
+    CPPUNIT_ASSERT_EQUAL(false, Logger::isEnabled(LogModule::HISTORY, LogLevel::WARNING));
+    CPPUNIT_ASSERT_EQUAL(true, Logger::isEnabled(LogModule::BOT, LogLevel::WARNING));
+
+    // Invalid specifications change nothing
+    CPPUNIT_ASSERT_EQUAL(false, Logger::setThresholds("bot=info,history=loud"));
+    CPPUNIT_ASSERT_EQUAL(false, Logger::setThresholds("bot=info,network=info"));
+    CPPUNIT_ASSERT_EQUAL(false, Logger::setThresholds("bot"));
+    CPPUNIT_ASSERT(LogLevel::WARNING == Logger::getThreshold(LogModule::BOT));
+
+    // Messages of disabled modules don't evaluate their arguments
+    size_t evaluationCount = 0;
+    const auto evaluate = [&evaluationCount]() {
+        return ++evaluationCount;
+    };
+    std::ostringstream output;
+    Logger::getInstance().setOutput(output);
+    Logger::setThreshold(LogModule::GENERAL, LogLevel::ERROR);
+    LOG_WARNING("not evaluated ", evaluate());
+    LOG_ERROR("evaluated ", evaluate());
+    Logger::setThreshold(LogModule::GENERAL, LogLevel::WARNING);
+    LOG_WARNING("evaluated ", evaluate());
+    Logger::getInstance().flush();
+    CPPUNIT_ASSERT_EQUAL(size_t(2), evaluationCount);
+    CPPUNIT_ASSERT(std::string::npos != output.str().find("[ERROR]: evaluated 1\n"));
+    CPPUNIT_ASSERT(std::string::npos != output.str().find("[WARNING]: evaluated 2\n"));
+}
+
+}
@@ -0,0 +1,178 @@
+/*
+ * Copyright (c) 2015, Romain Létendart
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "logsinktest.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+#include "logsink.h"
+
+namespace geecxx
+{
+
+namespace
+{
+
+void fillRecord(LogRecord& record)
+{
+    record.reset(LogLevel::WARNING, 1500000000);
+    record.setModule(LogModule::FETCH);
+    record.add("Title of \"page\"\n");
+    record.add(logField("channel", "#geecxx"));
+    record.add(logField("latency_us", std::uint64_t(1234)));
+    record.add(logField("ratio", 0.5));
+}
+
+}
+
+CPPUNIT_TEST_SUITE_REGISTRATION(LogSinkTest);
+
+void LogSinkTest::setUp()
+{
+}
+
+void LogSinkTest::tearDown()
+{
+    std::remove(_logFilePath.c_str());
+    std::remove((_logFilePath + ".1").c_str());
+    std::remove((_logFilePath + ".2").c_str());
+    std::remove((_logFilePath + ".3").c_str());
+}
+
+// Actual tests
+void LogSinkTest::testText()
+{
+    std::ostringstream output;
+    LogSink sink(LogFormat::TEXT, output);
+    LogRecord record;
+    fillRecord(record);
+    sink.write(record);
+    // Nothing is written before flush()
+    CPPUNIT_ASSERT(output.str().empty());
+    sink.flush();
+
+    const std::string text = output.str();
+    const size_t lineEnd = text.find('\n');
+    CPPUNIT_ASSERT(std::string::npos != lineEnd);
+    CPPUNIT_ASSERT_EQUAL(std::string("][WARNING]: Title of \"page\""), text.substr(20, lineEnd - 20));
+    CPPUNIT_ASSERT_EQUAL(std::string("][WARNING]: channel=#geecxx latency_us=1234 ratio=0.5\n"),
+                         text.substr(lineEnd + 21));
+}
+
+void LogSinkTest::testJson()
+{
+    std::ostringstream output;
+    LogSink sink(LogFormat::JSON, output);
+    LogRecord record;
+    fillRecord(record);
+    sink.write(record);
+    record.reset(LogLevel::INFO, 1500000001);
+    record.add("id ");
+    record.add(-3);
+    record.add(logField("author", 'x'));
+    sink.write(record);
+    sink.flush();
+
+    CPPUNIT_ASSERT_EQUAL(std::string("{\"time\":1500000000,\"level\":\"WARNING\",\"module\":\"fetch\","
+                                     "\"message\":\"Title of \\\"page\\\"\\n\",\"channel\":\"#geecxx\","
+                                     "\"latency_us\":1234,\"ratio\":0.5}\n"
+                                     "{\"time\":1500000001,\"level\":\"INFO\",\"module\":\"general\",\"message\":\"id -3\","
+                                     "\"author\":\"x\"}\n"),
+                         output.str());
+}
+
+void LogSinkTest::testBinary()
+{
+    std::ostringstream output;
+    LogSink sink(LogFormat::BINARY, output);
+    LogRecord record;
+    fillRecord(record);
+    sink.write(record);
+    sink.write(record);
+    sink.flush();
+
+    // Header, then size, level, module, time and payload of each record
+    const std::string binary = output.str();
+    const size_t recordSize = sizeof(std::uint32_t) + 2 + sizeof(std::int64_t) + record.getSize();
+    CPPUNIT_ASSERT_EQUAL(sizeof(LogSink::BINARY_HEADER) + 2 * recordSize, binary.size());
+    CPPUNIT_ASSERT(0 == std::memcmp(LogSink::BINARY_HEADER, binary.data(), sizeof(LogSink::BINARY_HEADER)));
+
+    const char* data = binary.data() + sizeof(LogSink::BINARY_HEADER) + recordSize;
+    std::uint32_t size;
+    std::int64_t time;
+    std::memcpy(&size, data, sizeof(size));
+    std::memcpy(&time, data + sizeof(size) + 2, sizeof(time));
+    CPPUNIT_ASSERT_EQUAL(std::uint32_t(record.getSize()), size);
+    CPPUNIT_ASSERT_EQUAL(std::uint8_t(LogLevel::WARNING), std::uint8_t(data[sizeof(size)]));
+    CPPUNIT_ASSERT_EQUAL(std::uint8_t(LogModule::FETCH), std::uint8_t(data[sizeof(size) + 1]));
+    CPPUNIT_ASSERT_EQUAL(std::int64_t(1500000000), time);
+
+    LogRecord decodedRecord;
+    decodedRecord.assign(LogLevel::WARNING, time, data + sizeof(size) + 2 + sizeof(time), size);
+    std::string expectedText;
+    std::string decodedText;
+    record.format(expectedText);
+    CPPUNIT_ASSERT_EQUAL(true, decodedRecord.forEachValue([](const LogValue&) {}));
+    decodedRecord.format(decodedText);
+    CPPUNIT_ASSERT_EQUAL(expectedText, decodedText);
+
+    // Truncated payloads are detected
+    decodedRecord.assign(LogLevel::WARNING, time, data + sizeof(size) + 2 + sizeof(time), size - 1);
+    CPPUNIT_ASSERT_EQUAL(false, decodedRecord.forEachValue([](const LogValue&) {}));
+}
+
+void LogSinkTest::testRotation()
+{
+    LogRecord record;
+    fillRecord(record);
+    std::ostringstream oneRecord;
+    {
+        LogSink sink(LogFormat::JSON, oneRecord);
+        sink.write(record);
+        sink.flush();
+    }
+    const size_t recordSize = oneRecord.str().size();
+
+    // 3 records per file, 2 rotated files are kept
+    LogSink sink(LogFormat::JSON, _logFilePath, 3 * recordSize, 2);
+    CPPUNIT_ASSERT_EQUAL(true, sink.open());
+    for (size_t i = 0; i < 10; ++i) {
+        sink.write(record);
+        sink.flush();
+    }
+
+    const auto fileSize = [](const std::string& filePath) {
+        std::ifstream file(filePath, std::ios::binary | std::ios::ate);
+        return file ? static_cast<long long>(file.tellg()) : -1ll;
+    };
+    CPPUNIT_ASSERT_EQUAL(static_cast<long long>(recordSize), fileSize(_logFilePath));
+    CPPUNIT_ASSERT_EQUAL(static_cast<long long>(3 * recordSize), fileSize(_logFilePath + ".1"));
+    CPPUNIT_ASSERT_EQUAL(static_cast<long long>(3 * recordSize), fileSize(_logFilePath + ".2"));
+    CPPUNIT_ASSERT_EQUAL(-1ll, fileSize(_logFilePath + ".3"));
+}
+
+}
@@ -0,0 +1,229 @@
+/*
+ * Copyright (c) 2015, Romain Létendart
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "metricstest.h"
+
+#include <boost/asio.hpp>
+#include <string>
+#include <thread>
+
+#include "metrics.h"
+#include "metricsserver.h"
+
+namespace geecxx
+{
+
+namespace
+{
+
+/**
+ * Send a raw HTTP request to a local port and return the whole response
+ */
+std::string sendRequest(std::uint16_t port, const std::string& request)
+{
+    boost::asio::io_service ioService;
+    boost::asio::ip::tcp::socket socket(ioService);
+    boost::system::error_code error;
+    socket.connect(boost::asio::ip::tcp::endpoint(boost::asio::ip::address_v4::loopback(), port), error);
+    if (error) {
+        return "";
+    }
+    boost::asio::write(socket, boost::asio::buffer(request), error);
+
+    std::string response;
+    char buffer[4096];
+    size_t size;
+    while (0 != (size = socket.read_some(boost::asio::buffer(buffer), error))) {
+        response.append(buffer, size);
+    }
+    return response;
+}
+
+}
+
+CPPUNIT_TEST_SUITE_REGISTRATION(MetricsTest);
+
+void MetricsTest::setUp()
+{
+}
+
+void MetricsTest::tearDown()
+{
+}
+
+// Actual tests
+void MetricsTest::testRegistration()
+{
+    MetricsRegistry registry;
+    Counter& counter = registry.getCounter("test_events_total", "Events");
+    counter.increment();
+    counter.increment(2);
+    // Same name, same counter
+    CPPUNIT_ASSERT(&counter == &registry.getCounter("test_events_total", "Events"));
+    CPPUNIT_ASSERT_EQUAL(std::uint64_t(3), counter.getValue());
+
+    Gauge& gauge = registry.getGauge("test_depth", "Depth");
+    gauge.set(5);
+    gauge.add(-7);
+    CPPUNIT_ASSERT_EQUAL(std::int64_t(-2), gauge.getValue());
+
+    // Names are unique across types: the conflicting metric still works but
+    // isn't exposed
+    Gauge& conflictingGauge = registry.getGauge("test_events_total", "Events");
+    conflictingGauge.set(42);
+    CPPUNIT_ASSERT_EQUAL(false, registry.setCallback("test_depth", "Depth", MetricType::GAUGE, []() {
+        return 1.0;
+    }));
+    std::string text;
+    registry.write(text);
+    CPPUNIT_ASSERT(std::string::npos == text.find("42"));
+    CPPUNIT_ASSERT(std::string::npos != text.find("\ntest_depth -2\n"));
+
+    // Callbacks can be replaced and removed
+    double value = 1.5;
+    CPPUNIT_ASSERT_EQUAL(true, registry.setCallback("test_ratio", "Ratio", MetricType::GAUGE, [&value]() {
+        return value;
+    }));
+    value = 0.25;
+    text.clear();
+    registry.write(text);
+    CPPUNIT_ASSERT(std::string::npos != text.find("\ntest_ratio 0.25\n"));
+    registry.removeCallback("test_ratio");
+    text.clear();
+    registry.write(text);
+    CPPUNIT_ASSERT(std::string::npos == text.find("test_ratio"));
+}
+
+void MetricsTest::testHistogram()
+{
+    Histogram histogram;
+    CPPUNIT_ASSERT_EQUAL(std::uint64_t(0), histogram.getValueAtQuantile(0.5));
+
+    // Small values are exact
+    for (std::uint64_t value = 0; value <= 16; ++value) {
+        histogram.record(value);
+    }
+    CPPUNIT_ASSERT_EQUAL(std::uint64_t(17), histogram.getCount());
+    CPPUNIT_ASSERT_EQUAL(std::uint64_t(136), histogram.getSum());
+    CPPUNIT_ASSERT_EQUAL(std::uint64_t(16), histogram.getValueAtQuantile(1.0));
+    CPPUNIT_ASSERT_EQUAL(std::uint64_t(8), histogram.getValueAtQuantile(0.5));
+
+    // Powers of two are bucket bounds: 0 and 1 are up to 2^0, 2 up to 2^1,
+    // 3 and 4 up to 2^2, etc.
+    CPPUNIT_ASSERT_EQUAL(std::uint64_t(2), histogram.getCountUpTo(0));
+    CPPUNIT_ASSERT_EQUAL(std::uint64_t(3), histogram.getCountUpTo(1));
+    CPPUNIT_ASSERT_EQUAL(std::uint64_t(5), histogram.getCountUpTo(2));
+    CPPUNIT_ASSERT_EQUAL(std::uint64_t(17), histogram.getCountUpTo(4));
+
+    // Large values are known within 1/16th of their magnitude
+    Histogram latencies;
+    for (std::uint64_t value = 1; value <= 100000; ++value) {
+        latencies.record(value);
+    }
+    const std::uint64_t median = latencies.getValueAtQuantile(0.5);
+    CPPUNIT_ASSERT(median >= 50000 && median <= 50000 + 50000 / 16);
+    const std::uint64_t p99 = latencies.getValueAtQuantile(0.99);
+    CPPUNIT_ASSERT(p99 >= 99000 && p99 <= 99000 + 99000 / 16);
+    CPPUNIT_ASSERT_EQUAL(std::uint64_t(65536), latencies.getCountUpTo(16));
+    CPPUNIT_ASSERT_EQUAL(std::uint64_t(100000), latencies.getCountUpTo(17));
+
+    Histogram extremes;
+    extremes.record(UINT64_MAX);
+    CPPUNIT_ASSERT_EQUAL(std::uint64_t(UINT64_MAX), extremes.getValueAtQuantile(1.0));
+    CPPUNIT_ASSERT_EQUAL(std::uint64_t(0), extremes.getCountUpTo(63));
+    CPPUNIT_ASSERT_EQUAL(std::uint64_t(1), extremes.getCountUpTo(64));
+}
+
+void MetricsTest::testExposition()
+{
+    MetricsRegistry registry;
+    registry.getCounter("test_lines_total", "Lines\\received\nfrom the server").increment(7);
+    Histogram& histogram = registry.getHistogram("test_duration_microseconds", "Duration");
+    histogram.record(3);
+    histogram.record(1000);
+
+    std::string text;
+    registry.write(text);
+    // Sorted by name
+    const std::string expectedBeginning = "# HELP test_duration_microseconds Duration\n"
+                                          "# TYPE test_duration_microseconds histogram\n"
+                                          "test_duration_microseconds_bucket{le=\"1\"} 0\n"
+                                          "test_duration_microseconds_bucket{le=\"2\"} 0\n"
+                                          "test_duration_microseconds_bucket{le=\"4\"} 1\n";
+    CPPUNIT_ASSERT_EQUAL(expectedBeginning, text.substr(0, expectedBeginning.size()));
+    CPPUNIT_ASSERT(std::string::npos != text.find("test_duration_microseconds_bucket{le=\"512\"} 1\n"
+                                                  "test_duration_microseconds_bucket{le=\"1024\"} 2\n"));
+    const std::string expectedEnd = "test_duration_microseconds_bucket{le=\"67108864\"} 2\n"
+                                    "test_duration_microseconds_bucket{le=\"+Inf\"} 2\n"
+                                    "test_duration_microseconds_sum 1003\n"
+                                    "test_duration_microseconds_count 2\n"
+                                    "# HELP test_lines_total Lines\\\\received\\nfrom the server\n"
+                                    "# TYPE test_lines_total counter\n"
+                                    "test_lines_total 7\n";
+    CPPUNIT_ASSERT(text.size() > expectedEnd.size());
+    CPPUNIT_ASSERT_EQUAL(expectedEnd, text.substr(text.size() - expectedEnd.size()));
+}
+
+void MetricsTest::testServer()
+{
+    MetricsRegistry registry;
+    registry.getCounter("test_requests_total", "Requests").increment();
+
+    boost::asio::io_service ioService;
+    MetricsServer server(ioService, registry);
+    CPPUNIT_ASSERT_EQUAL(std::uint16_t(0), server.getPort());
+    CPPUNIT_ASSERT_EQUAL(true, server.open(0));
+    const std::uint16_t port = server.getPort();
+    CPPUNIT_ASSERT(0 != port);
+
+    std::thread serverThread([&ioService]() {
+        ioService.run();
+    });
+
+    const std::string response = sendRequest(port, "GET /metrics HTTP/1.1\r\nHost: localhost\r\n\r\n");
+    CPPUNIT_ASSERT_EQUAL(std::string("HTTP/1.0 200 OK\r\n"), response.substr(0, 17));
+    CPPUNIT_ASSERT(std::string::npos != response.find("Content-Type: text/plain; version=0.0.4\r\n"));
+    CPPUNIT_ASSERT(std::string::npos != response.find("\r\n\r\n# HELP test_requests_total Requests\n"));
+    CPPUNIT_ASSERT(std::string::npos != response.find("\ntest_requests_total 1\n"));
+
+    CPPUNIT_ASSERT_EQUAL(std::string("HTTP/1.0 404 Not Found\r\n"),
+                         sendRequest(port, "GET /other HTTP/1.1\r\n\r\n").substr(0, 24));
+    CPPUNIT_ASSERT_EQUAL(std::string("HTTP/1.0 405 Method Not Allowed\r\n"),
+                         sendRequest(port, "POST /metrics HTTP/1.1\r\n\r\n").substr(0, 33));
+
+    // Requests too large are dropped without an answer
+    CPPUNIT_ASSERT_EQUAL(std::string(), sendRequest(port, "GET /metrics HTTP/1.1\r\n" + std::string(10000, 'x')));
+
+    // The port can't be taken twice
+    MetricsServer otherServer(ioService, registry);
+    CPPUNIT_ASSERT_EQUAL(false, otherServer.open(port));
+
+    ioService.post([&server]() {
+        server.close();
+    });
+    serverThread.join();
+    CPPUNIT_ASSERT_EQUAL(std::uint16_t(0), server.getPort());
+}
+
+}
@@ -0,0 +1,125 @@
+/*
+ * Copyright (c) 2015, Romain Létendart
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <algorithm>
+#include <boost/program_options.hpp>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "mockircserver.h"
+
+namespace po = boost::program_options;
+
+namespace
+{
+
+/**
+ * Print count and percentiles of latencies
+ * @param[in] name name of the latencies
+ * @param[in,out] latenciesUs latencies in microseconds, sorted
+ */
+void printLatencies(const std::string& name, std::vector<std::uint64_t>& latenciesUs)
+{
+    std::cout << name << ": " << latenciesUs.size();
+    if (latenciesUs.empty()) {
+        std::cout << std::endl;
+        return;
+    }
+    std::sort(latenciesUs.begin(), latenciesUs.end());
+    for (const double percentile : {50.0, 90.0, 99.0, 99.9}) {
+        const size_t rank = static_cast<size_t>(percentile / 100.0 * latenciesUs.size() + 0.5);
+        std::cout << " p" << percentile << "=" << latenciesUs[std::min(std::max<size_t>(rank, 1), latenciesUs.size()) - 1]
+                  << "us";
+    }
+    std::cout << " max=" << latenciesUs.back() << "us" << std::endl;
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+    geecxx::MockIrcScript script;
+    std::uint16_t port;
+    unsigned int readDelayMs;
+    unsigned int drainTimeoutMs;
+    po::options_description options("Options");
+    options.add_options()
+        ("port", po::value<std::uint16_t>(&port)->default_value(6667), "port to listen on, on the loopback interface")
+        ("channel", po::value<std::string>(&script._channel)->default_value(script._channel), "channel the traffic is sent to, once joined")
+        ("lines", po::value<size_t>(&script._lineCount)->default_value(script._lineCount), "number of PRIVMSG lines sent")
+        ("rate", po::value<unsigned int>(&script._linesPerSecond)->default_value(script._linesPerSecond), "lines sent per second, 0 for as fast as possible")
+        ("url-density", po::value<double>(&script._urlDensity)->default_value(script._urlDensity), "share of the lines containing a URL")
+        ("repeat-ratio", po::value<double>(&script._repeatRatio)->default_value(script._repeatRatio), "share of the URLs which were posted before")
+        ("min-size", po::value<size_t>(&script._minLineSize)->default_value(script._minLineSize), "smallest content of a line, in bytes")
+        ("max-size", po::value<size_t>(&script._maxLineSize)->default_value(script._maxLineSize), "largest content of a line, in bytes")
+        ("ping-interval", po::value<size_t>(&script._pingInterval)->default_value(script._pingInterval), "lines between two PINGs, 0 for none")
+        ("disconnect-after", po::value<size_t>(&script._disconnectAfter)->default_value(0), "drop the connection after this many lines, 0 to send every line")
+        ("read-delay", po::value<unsigned int>(&readDelayMs)->default_value(0), "milliseconds waited before reading each line of the client")
+        ("flood-limit", po::value<unsigned int>(&script._maxClientLinesPerSecond)->default_value(0), "lines the client may send per second before being killed, 0 for no limit")
+        ("drain-timeout", po::value<unsigned int>(&drainTimeoutMs)->default_value(5000), "milliseconds given to the client to answer once every line is sent")
+        ("seed", po::value<std::uint32_t>(&script._seed)->default_value(script._seed), "seed of the generated traffic")
+        ("help,h", "produce help message")
+    ;
+    try {
+        po::variables_map vm;
+        po::store(po::parse_command_line(argc, argv, options), vm);
+        if (vm.count("help")) {
+            std::cout << "Usage: geecxx-mockircd [options]" << std::endl;
+            std::cout << "Play an IRC server to a single client, e.g. geecxx 127.0.0.1 6667 '#geecxx'," << std::endl;
+            std::cout << "then print its PONG and \"Already posted\" reply latencies." << std::endl;
+            std::cout << options;
+            return 0;
+        }
+        po::notify(vm);
+    } catch (std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return -1;
+    }
+    script._readDelay = std::chrono::milliseconds(readDelayMs);
+    script._drainTimeout = std::chrono::milliseconds(drainTimeoutMs);
+
+    geecxx::MockIrcServer server(script);
+    if (!server.open(port)) {
+        std::cerr << "Couldn't listen on port " << port << std::endl;
+        return -1;
+    }
+    std::cout << "Waiting for a client on 127.0.0.1:" << server.getPort() << "..." << std::endl;
+    const auto start = geecxx::MockIrcServer::Clock::now();
+    server.run();
+    const double elapsedSeconds = std::chrono::duration<double>(geecxx::MockIrcServer::Clock::now() - start).count();
+
+    geecxx::MockIrcStats stats = server.getStats();
+    std::cout << "Lines sent: " << stats._sentLineCount << " (" << stats._urlLineCount << " with URLs, "
+              << stats._repeatedUrlLineCount << " repeated), " << stats._pingCount << " PING(s)" << std::endl;
+    std::cout << "Lines received: " << stats._receivedLineCount << std::endl;
+    std::cout << "Session: " << elapsedSeconds << "s" << (stats._disconnected ? ", disconnected" : "")
+              << (stats._floodKilled ? ", client killed for flooding" : "") << std::endl;
+    printLatencies("PONG latency", stats._pongLatenciesUs);
+    printLatencies("Reply latency", stats._replyLatenciesUs);
+    const bool complete = stats._pongLatenciesUs.size() == stats._pingCount
+                          && stats._replyLatenciesUs.size() == stats._repeatedUrlLineCount;
+    return complete || stats._disconnected || stats._floodKilled ? 0 : -1;
+}
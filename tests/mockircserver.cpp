@@ -0,0 +1,362 @@
+/*
+ * Copyright (c) 2015, Romain Létendart
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "mockircserver.h"
+
+#include <algorithm>
+
+namespace geecxx
+{
+
+namespace
+{
+
+/**
+ * Words the content of the lines is made of
+ */
+const char* const WORDS[] = {"the", "bot", "link", "is", "about", "a", "new", "release", "of", "IRC",
+                             "server", "with", "faster", "startup", "and", "fewer", "bugs", "than", "before"};
+
+/**
+ * Largest amount of data queued before the traffic waits for the client
+ */
+const size_t MAX_PENDING_OUTPUT_SIZE = 64 * 1024;
+
+/**
+ * Lines sent at once when sending as fast as possible, reads of the
+ * client's lines being handled in between
+ */
+const size_t BATCH_LINE_COUNT = 64;
+
+/**
+ * Last repeated URLs are picked among those, older ones might have been
+ * forgotten by the client
+ */
+const size_t REPEATED_URL_WINDOW = 256;
+
+std::uint64_t toUs(MockIrcServer::Clock::duration duration)
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(duration).count();
+}
+
+}
+
+MockIrcServer::MockIrcServer(MockIrcScript script)
+    : _script(std::move(script)), _acceptor(_ioService), _socket(_ioService), _sendTimer(_ioService),
+      _readTimer(_ioService), _drainTimer(_ioService), _random(_script._seed)
+{
+    _script._maxLineSize = std::max(_script._maxLineSize, _script._minLineSize);
+}
+
+bool MockIrcServer::open(std::uint16_t port)
+{
+    const boost::asio::ip::tcp::endpoint endpoint(boost::asio::ip::address_v4::loopback(), port);
+    boost::system::error_code error;
+    _acceptor.open(endpoint.protocol(), error);
+    if (!error) {
+        _acceptor.set_option(boost::asio::ip::tcp::acceptor::reuse_address(true), error);
+    }
+    if (!error) {
+        _acceptor.bind(endpoint, error);
+    }
+    if (!error) {
+        _acceptor.listen(boost::asio::socket_base::max_connections, error);
+    }
+    return !error;
+}
+
+std::uint16_t MockIrcServer::getPort() const
+{
+    boost::system::error_code error;
+    return _acceptor.local_endpoint(error).port();
+}
+
+void MockIrcServer::run()
+{
+    asyncAccept();
+    _ioService.run();
+}
+
+void MockIrcServer::stop()
+{
+    _ioService.post([this]() {
+        closeSession();
+    });
+}
+
+const MockIrcStats& MockIrcServer::getStats() const
+{
+    return _stats;
+}
+
+void MockIrcServer::asyncAccept()
+{
+    _acceptor.async_accept(_socket, [this](const boost::system::error_code& error) {
+        if (error || _closed) {
+            return;
+        }
+        // A single client is served
+        boost::system::error_code ignoredError;
+        _acceptor.close(ignoredError);
+        asyncRead();
+    });
+}
+
+void MockIrcServer::asyncRead()
+{
+    if (_script._readDelay.count() > 0) {
+        _readTimer.expires_from_now(_script._readDelay);
+    } else {
+        _readTimer.expires_at(Clock::time_point());
+    }
+    _readTimer.async_wait([this](const boost::system::error_code& timerError) {
+        if (timerError || _closed) {
+            return;
+        }
+        boost::asio::async_read_until(_socket, _input, "\r\n",
+                                      [this](const boost::system::error_code& error, size_t count) {
+            if (_closed) {
+                return;
+            }
+            if (error) {
+                // The client left
+                closeSession();
+                return;
+            }
+            const char* data = boost::asio::buffer_cast<const char*>(_input.data());
+            const std::string line(data, count - 2);
+            _input.consume(count);
+            handleLine(line);
+            if (!_closed) {
+                asyncRead();
+            }
+        });
+    });
+}
+
+void MockIrcServer::handleLine(const std::string& line)
+{
+    ++_stats._receivedLineCount;
+    const Clock::time_point now = Clock::now();
+    if (0 != _script._maxClientLinesPerSecond && !_closing) {
+        if (now - _floodWindowStart >= std::chrono::seconds(1)) {
+            _floodWindowStart = now;
+            _floodWindowLineCount = 0;
+        }
+        if (++_floodWindowLineCount > _script._maxClientLinesPerSecond) {
+            _stats._floodKilled = true;
+            send("ERROR :Closing Link: " + _nickname + "[127.0.0.1] (Excess Flood)\r\n");
+            _closing = true;
+            return;
+        }
+    }
+
+    const size_t commandEnd = line.find(' ');
+    const std::string command = line.substr(0, commandEnd);
+    const std::string parameters = std::string::npos == commandEnd ? "" : line.substr(commandEnd + 1);
+    if ("NICK" == command) {
+        _nickname = parameters;
+    } else if ("USER" == command) {
+        send(":mock.test 001 " + _nickname + " :Welcome to the mock IRC network\r\n");
+    } else if ("JOIN" == command) {
+        if (_joined || parameters.compare(0, _script._channel.size(), _script._channel)) {
+            return;
+        }
+        _joined = true;
+        send(":" + _nickname + "!" + _nickname + "@127.0.0.1 JOIN " + _script._channel + "\r\n");
+        _sendStart = now;
+        sendLines();
+    } else if ("PONG" == command) {
+        const std::string token = parameters.substr(':' == parameters[0] ? 1 : 0);
+        const auto ping = _pendingPings.find(token);
+        if (_pendingPings.end() != ping) {
+            _stats._pongLatenciesUs.push_back(toUs(now - ping->second));
+            _pendingPings.erase(ping);
+            checkDrained();
+        }
+    } else if ("PRIVMSG" == command) {
+        static const std::string alreadyPosted = ": Already posted by ";
+        const size_t contentBegin = parameters.find(" :");
+        const size_t nicknameEnd = parameters.find(alreadyPosted);
+        if (std::string::npos == contentBegin || std::string::npos == nicknameEnd || nicknameEnd < contentBegin) {
+            return;
+        }
+        const auto reply = _pendingReplies.find(parameters.substr(contentBegin + 2, nicknameEnd - contentBegin - 2));
+        if (_pendingReplies.end() != reply) {
+            _stats._replyLatenciesUs.push_back(toUs(now - reply->second));
+            _pendingReplies.erase(reply);
+            checkDrained();
+        }
+    }
+}
+
+void MockIrcServer::send(const std::string& data)
+{
+    if (_closed) {
+        return;
+    }
+    _pendingOutput += data;
+    if (!_writing) {
+        asyncWrite();
+    }
+}
+
+void MockIrcServer::asyncWrite()
+{
+    _output.swap(_pendingOutput);
+    _pendingOutput.clear();
+    _writing = true;
+    boost::asio::async_write(_socket, boost::asio::buffer(_output),
+                             [this](const boost::system::error_code& error, size_t) {
+        _writing = false;
+        if (_closed) {
+            return;
+        }
+        if (error) {
+            closeSession();
+        } else if (!_pendingOutput.empty()) {
+            asyncWrite();
+        } else if (_closing) {
+            closeSession();
+        }
+    });
+}
+
+void MockIrcServer::sendLines()
+{
+    if (_closed || _closing) {
+        return;
+    }
+
+    // Lines due by now, or a batch of them
+    size_t dueLineCount = _script._lineCount;
+    if (0 != _script._linesPerSecond) {
+        dueLineCount = std::min<size_t>(dueLineCount,
+                                        toUs(Clock::now() - _sendStart) * _script._linesPerSecond / 1000000 + 1);
+    } else {
+        dueLineCount = std::min(dueLineCount, _stats._sentLineCount + BATCH_LINE_COUNT);
+    }
+    std::string lines;
+    while (_stats._sentLineCount < dueLineCount && _pendingOutput.size() + lines.size() < MAX_PENDING_OUTPUT_SIZE) {
+        if (0 != _script._disconnectAfter && _stats._sentLineCount == _script._disconnectAfter) {
+            send(lines);
+            _stats._disconnected = true;
+            closeSession();
+            return;
+        }
+        appendMessage(lines);
+    }
+    send(lines);
+
+    if (_stats._sentLineCount < _script._lineCount) {
+        // Waits for the next line to be due, or for the client to read
+        if (0 != _script._linesPerSecond && _stats._sentLineCount == dueLineCount) {
+            _sendTimer.expires_at(_sendStart + std::chrono::microseconds(
+                                      _stats._sentLineCount * 1000000 / _script._linesPerSecond));
+        } else if (_pendingOutput.size() >= MAX_PENDING_OUTPUT_SIZE) {
+            _sendTimer.expires_from_now(std::chrono::milliseconds(1));
+        } else {
+            _sendTimer.expires_at(Clock::time_point());
+        }
+        _sendTimer.async_wait([this](const boost::system::error_code& error) {
+            if (!error) {
+                sendLines();
+            }
+        });
+    } else {
+        _drainTimer.expires_from_now(_script._drainTimeout);
+        _drainTimer.async_wait([this](const boost::system::error_code& error) {
+            if (!error) {
+                closeSession();
+            }
+        });
+        checkDrained();
+    }
+}
+
+void MockIrcServer::appendMessage(std::string& output)
+{
+    const Clock::time_point now = Clock::now();
+    const size_t index = _stats._sentLineCount++;
+    if (0 != _script._pingInterval && 0 == index % _script._pingInterval) {
+        const std::string token = "mock" + std::to_string(_stats._pingCount++);
+        output += "PING :" + token + "\r\n";
+        _pendingPings[token] = now;
+    }
+
+    std::uniform_int_distribution<size_t> sizeDistribution(_script._minLineSize, _script._maxLineSize);
+    std::uniform_real_distribution<double> ratioDistribution(0.0, 1.0);
+    std::uniform_int_distribution<size_t> wordDistribution(0, sizeof(WORDS) / sizeof(WORDS[0]) - 1);
+    const size_t contentSize = sizeDistribution(_random);
+    const std::string nickname = "u" + std::to_string(index);
+    std::string content;
+    if (ratioDistribution(_random) < _script._urlDensity) {
+        ++_stats._urlLineCount;
+        size_t urlIndex = _postedUrlCount;
+        if (0 != _postedUrlCount && ratioDistribution(_random) < _script._repeatRatio) {
+            const size_t windowSize = std::min(_postedUrlCount, REPEATED_URL_WINDOW);
+            urlIndex = _postedUrlCount - 1 - std::uniform_int_distribution<size_t>(0, windowSize - 1)(_random);
+            ++_stats._repeatedUrlLineCount;
+            _pendingReplies[nickname] = now;
+        } else {
+            ++_postedUrlCount;
+        }
+        content = "see http://www.mock" + std::to_string(urlIndex) + ".test/ ";
+    }
+    // The URL is kept whole, whatever the size
+    const size_t urlEnd = content.size();
+    while (content.size() < contentSize) {
+        content += WORDS[wordDistribution(_random)];
+        content += ' ';
+    }
+    content.resize(std::max(contentSize, urlEnd));
+    output += ":" + nickname + "!" + nickname + "@mock.test PRIVMSG " + _script._channel + " :" + content + "\r\n";
+}
+
+void MockIrcServer::checkDrained()
+{
+    if (_stats._sentLineCount == _script._lineCount && _pendingPings.empty() && _pendingReplies.empty()) {
+        _closing = true;
+        if (!_writing) {
+            closeSession();
+        }
+    }
+}
+
+void MockIrcServer::closeSession()
+{
+    if (_closed) {
+        return;
+    }
+    _closed = true;
+    boost::system::error_code ignoredError;
+    _sendTimer.cancel(ignoredError);
+    _readTimer.cancel(ignoredError);
+    _drainTimer.cancel(ignoredError);
+    _acceptor.close(ignoredError);
+    _socket.shutdown(boost::asio::socket_base::shutdown_both, ignoredError);
+    _socket.close(ignoredError);
+}
+
+}
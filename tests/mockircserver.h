@@ -0,0 +1,216 @@
+/*
+ * Copyright (c) 2015, Romain Létendart
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#pragma once
+
+#include <boost/asio.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <chrono>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace geecxx
+{
+
+/**
+ * What a MockIrcServer sends to its client, and how it treats it
+ */
+struct MockIrcScript
+{
+    /**
+     * Channel the traffic is sent to, once the client has joined it
+     */
+    std::string _channel = "#geecxx";
+    /**
+     * Number of PRIVMSG lines sent
+     */
+    size_t _lineCount = 1000;
+    /**
+     * Pace of the lines, 0 to send them as fast as possible
+     */
+    unsigned int _linesPerSecond = 0;
+    /**
+     * Share of the lines containing a URL, between 0 and 1
+     */
+    double _urlDensity = 0.1;
+    /**
+     * Share of the URLs which were posted before, between 0 and 1
+     */
+    double _repeatRatio = 0.5;
+    /**
+     * Bounds of the size of the lines' content, in bytes
+     */
+    size_t _minLineSize = 10;
+    size_t _maxLineSize = 400;
+    /**
+     * Lines between two PINGs, 0 for none
+     */
+    size_t _pingInterval = 100;
+    /**
+     * Lines after which the connection is dropped, 0 to send every line
+     */
+    size_t _disconnectAfter = 0;
+    /**
+     * Time waited before each read of the client's lines, to fill its
+     * socket buffers
+     */
+    std::chrono::milliseconds _readDelay{0};
+    /**
+     * Lines the client may send per second before being killed for
+     * flooding, 0 for no limit
+     */
+    unsigned int _maxClientLinesPerSecond = 0;
+    /**
+     * Time given to the client to answer once every line has been sent
+     */
+    std::chrono::milliseconds _drainTimeout{5000};
+    std::uint32_t _seed = 1;
+};
+
+/**
+ * What happened during a MockIrcServer session
+ */
+struct MockIrcStats
+{
+    size_t _sentLineCount = 0;
+    size_t _urlLineCount = 0;
+    size_t _repeatedUrlLineCount = 0;
+    size_t _pingCount = 0;
+    size_t _receivedLineCount = 0;
+    /**
+     * Time from each PING to its PONG, in microseconds
+     */
+    std::vector<std::uint64_t> _pongLatenciesUs;
+    /**
+     * Time from each repeated URL to the "Already posted" reply, in
+     * microseconds
+     */
+    std::vector<std::uint64_t> _replyLatenciesUs;
+    bool _floodKilled = false;
+    bool _disconnected = false;
+};
+
+/**
+ * The MockIrcServer class plays an IRC server to a single client (the bot)
+ * on the loopback interface, for load and soak tests.
+ *
+ * Once the client has sent NICK, USER and joined the channel, the server
+ * sends it PRIVMSG lines of random content, some with URLs, some of these
+ * URLs repeated, and PINGs as described by a MockIrcScript. Each line comes
+ * from a different nickname, so that the "Already posted" reply to a
+ * repeated URL can be told apart from others to measure reply latencies.
+ * The server closes the connection once the client has answered every PING
+ * and repeated URL, or after a timeout.
+ */
+class MockIrcServer
+{
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    explicit MockIrcServer(MockIrcScript script);
+
+    MockIrcServer(const MockIrcServer&) = delete;
+    MockIrcServer& operator=(const MockIrcServer&) = delete;
+
+    /**
+     * Listen on the loopback interface
+     * @param[in] port port to listen on, 0 for any
+     * @return true upon success, false otherwise
+     */
+    bool open(std::uint16_t port = 0);
+
+    std::uint16_t getPort() const;
+
+    /**
+     * Accept a client and play the script, until the session is over
+     */
+    void run();
+
+    /**
+     * Interrupt run(), from any thread
+     */
+    void stop();
+
+    const MockIrcStats& getStats() const;
+
+private:
+    void asyncAccept();
+    void asyncRead();
+    void handleLine(const std::string& line);
+
+    /**
+     * Queue data to be sent, without waiting for the client to read it
+     * @param[in] data lines, with their "\r\n"
+     */
+    void send(const std::string& data);
+    void asyncWrite();
+    void sendLines();
+    void appendMessage(std::string& output);
+    void checkDrained();
+    void closeSession();
+
+    MockIrcScript _script;
+    boost::asio::io_service _ioService;
+    boost::asio::ip::tcp::acceptor _acceptor;
+    boost::asio::ip::tcp::socket _socket;
+    boost::asio::steady_timer _sendTimer;
+    boost::asio::steady_timer _readTimer;
+    boost::asio::steady_timer _drainTimer;
+    boost::asio::streambuf _input;
+    /**
+     * Data being written, and data queued meanwhile
+     */
+    std::string _output;
+    std::string _pendingOutput;
+    bool _writing = false;
+    /**
+     * Whether the session ends once queued data are written
+     */
+    bool _closing = false;
+    std::string _nickname;
+    std::mt19937 _random;
+    bool _joined = false;
+    bool _closed = false;
+    Clock::time_point _sendStart;
+    /**
+     * Number of URLs posted, URL #i being http://www.mock<i>.test/
+     */
+    size_t _postedUrlCount = 0;
+    /**
+     * Times PINGs and repeated URLs were sent at, by token / nickname
+     */
+    std::unordered_map<std::string, Clock::time_point> _pendingPings;
+    std::unordered_map<std::string, Clock::time_point> _pendingReplies;
+    /**
+     * Start of the current flood control window, and client lines in it
+     */
+    Clock::time_point _floodWindowStart;
+    unsigned int _floodWindowLineCount = 0;
+    MockIrcStats _stats;
+};
+
+}
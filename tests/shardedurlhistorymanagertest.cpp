@@ -0,0 +1,269 @@
+/*
+ * Copyright (c) 2015, Romain Létendart
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "shardedurlhistorymanagertest.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "shardedurlhistorymanager.h"
+#include "stringutils.h"
+
+namespace geecxx
+{
+
+CPPUNIT_TEST_SUITE_REGISTRATION(ShardedUrlHistoryManagerTest);
+
+void ShardedUrlHistoryManagerTest::setUp()
+{
+}
+
+void ShardedUrlHistoryManagerTest::tearDown()
+{
+    std::remove(_historyFilePath.c_str());
+}
+
+// Actual tests
+void ShardedUrlHistoryManagerTest::testSimilarUrls()
+{
+    ShardedUrlHistoryManager history(64, 8);
+    UrlHistoryEntry entry;
+
+    // Similar URLs must be routed to the same shard to be detected
+    CPPUNIT_ASSERT_EQUAL(true, history.insert("http://www.website.com/", "Title", "Author"));
+    CPPUNIT_ASSERT_EQUAL(false, history.insert("https://website.com/", "", ""));
+    CPPUNIT_ASSERT_EQUAL(false, history.insert("WWW.WEBSITE.COM/#fragment-id", "", ""));
+    CPPUNIT_ASSERT_EQUAL(true, history.find("website.com/", entry));
+    CPPUNIT_ASSERT_EQUAL(std::uint64_t(1), entry._id);
+    CPPUNIT_ASSERT_EQUAL(std::string("Title"), entry._title);
+    CPPUNIT_ASSERT_EQUAL(std::string("Author"), entry._messageAuthor);
+}
+
+void ShardedUrlHistoryManagerTest::testEviction()
+{
+    ShardedUrlHistoryManager history(64, 4);
+    const std::string urlPrefix = "http://www.website.com/page";
+
+    CPPUNIT_ASSERT_EQUAL(size_t(4), history.getShardCount());
+    CPPUNIT_ASSERT_EQUAL(size_t(64), history.getMaxSize());
+
+    for (size_t i = 1; i <= 4 * history.getMaxSize(); ++i) {
+        CPPUNIT_ASSERT_EQUAL(true, history.insert(urlPrefix + std::to_string(i), "", ""));
+    }
+    // Shards may not all be full, but none of them can go over its part
+    CPPUNIT_ASSERT(history.getSize() <= history.getMaxSize());
+
+    // Most recent entries are still there
+    UrlHistoryEntry entry;
+    CPPUNIT_ASSERT_EQUAL(true, history.find(urlPrefix + std::to_string(4 * history.getMaxSize()), entry));
+    // Oldest ones are gone
+    CPPUNIT_ASSERT_EQUAL(false, history.find(urlPrefix + "1", entry));
+
+    history.clear();
+    CPPUNIT_ASSERT_EQUAL(size_t(0), history.getSize());
+}
+
+void ShardedUrlHistoryManagerTest::testRecencyEviction()
+{
+    const std::string urlPrefix = "http://www.website.com/page";
+    {
+        ShardedUrlHistoryManager history(4, 1);
+        // Looked up through snapshots, which don't count as uses
+        const auto contains = [&history, &urlPrefix](size_t i) {
+            std::shared_ptr<const UrlHistorySnapshot> snapshot = history.takeSnapshot();
+            return snapshot->end() != std::find_if(snapshot->begin(), snapshot->end(),
+                                                   [&urlPrefix, i](const UrlHistoryRecord& record) {
+                return record._url == stringutils::formatUrl(urlPrefix + std::to_string(i));
+            });
+        };
+        for (size_t i = 1; i <= 4; ++i) {
+            CPPUNIT_ASSERT_EQUAL(true, history.insert(urlPrefix + std::to_string(i), "", ""));
+        }
+        UrlHistoryEntry entry;
+        CPPUNIT_ASSERT_EQUAL(true, history.find(urlPrefix + "1", entry));
+
+        // The entry found moves past the ones inserted after it
+        CPPUNIT_ASSERT_EQUAL(true, history.insert(urlPrefix + "5", "", ""));
+        CPPUNIT_ASSERT_EQUAL(true, history.insert(urlPrefix + "6", "", ""));
+        CPPUNIT_ASSERT_EQUAL(true, contains(1));
+        CPPUNIT_ASSERT_EQUAL(false, contains(2));
+        CPPUNIT_ASSERT_EQUAL(false, contains(3));
+
+        // Until it is evicted in turn, unless used again
+        CPPUNIT_ASSERT_EQUAL(true, history.insert(urlPrefix + "7", "", ""));
+        CPPUNIT_ASSERT_EQUAL(true, history.insert(urlPrefix + "8", "", ""));
+        CPPUNIT_ASSERT_EQUAL(false, contains(1));
+        CPPUNIT_ASSERT_EQUAL(true, contains(5));
+    }
+
+    // A URL posted again and again stays, whatever its age
+    ShardedUrlHistoryManager history(64, 4);
+    const std::string hotUrl = "http://www.otherwebsite.com/";
+    CPPUNIT_ASSERT_EQUAL(true, history.insert(hotUrl, "", ""));
+    UrlHistoryEntry entry;
+    for (size_t i = 1; i <= 4 * history.getMaxSize(); ++i) {
+        CPPUNIT_ASSERT_EQUAL(true, history.insert(urlPrefix + std::to_string(i), "", ""));
+        if (0 == i % 8) {
+            CPPUNIT_ASSERT_EQUAL(true, history.find(hotUrl, entry));
+        }
+    }
+    CPPUNIT_ASSERT_EQUAL(std::uint64_t(1), entry._id);
+}
+
+void ShardedUrlHistoryManagerTest::testConcurrentInsertions()
+{
+    const size_t threadCount = 8;
+    const size_t urlsPerThread = 256;
+    ShardedUrlHistoryManager history(threadCount * urlsPerThread * 2, 16);
+
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < threadCount; ++t) {
+        threads.emplace_back([&history, t, threadCount, urlsPerThread]() {
+            for (size_t i = 0; i < urlsPerThread; ++i) {
+                UrlHistoryEntry entry;
+                // Every thread also tries to insert URLs owned by another one
+                const std::string url = "website.com/" + std::to_string(t) + "/" + std::to_string(i);
+                const std::string otherUrl = "website.com/" + std::to_string((t + 1) % threadCount) + "/" + std::to_string(i);
+                history.insert(url, "", "");
+                history.insert(otherUrl, "", "");
+                history.find(url, entry);
+            }
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+
+    CPPUNIT_ASSERT_EQUAL(threadCount * urlsPerThread, history.getSize());
+
+    // Every entry got its own id
+    std::set<std::uint64_t> ids;
+    std::shared_ptr<const UrlHistorySnapshot> snapshot = history.takeSnapshot();
+    for (const UrlHistoryRecord& record : *snapshot) {
+        ids.insert(record._entry._id);
+    }
+    CPPUNIT_ASSERT_EQUAL(threadCount * urlsPerThread, ids.size());
+}
+
+void ShardedUrlHistoryManagerTest::testFindById()
+{
+    ShardedUrlHistoryManager history(512, 16);
+    const std::string urlPrefix = "http://www.website.com/page";
+
+    // Shards fill up unevenly, some of them evict entries
+    for (size_t i = 1; i <= history.getMaxSize(); ++i) {
+        CPPUNIT_ASSERT_EQUAL(true, history.insert(urlPrefix + std::to_string(i),
+                                                  "Title_" + std::to_string(i), "Author"));
+    }
+    std::shared_ptr<const UrlHistorySnapshot> snapshot = history.takeSnapshot();
+    CPPUNIT_ASSERT(snapshot->size() < history.getMaxSize());
+
+    // Ids come from a sequence shared by all shards, every live entry must
+    // be found from its own
+    std::set<std::uint64_t> liveIds;
+    UrlHistoryRecord record;
+    for (const UrlHistoryRecord& liveRecord : *snapshot) {
+        liveIds.insert(liveRecord._entry._id);
+        CPPUNIT_ASSERT_EQUAL(true, history.findById(liveRecord._entry._id, record));
+        CPPUNIT_ASSERT_EQUAL(liveRecord._url, record._url);
+        CPPUNIT_ASSERT_EQUAL(liveRecord._entry._title, record._entry._title);
+    }
+    for (std::uint64_t id = 1; id <= history.getMaxSize(); ++id) {
+        if (0 == liveIds.count(id)) {
+            CPPUNIT_ASSERT_EQUAL(false, history.findById(id, record));
+        }
+    }
+}
+
+void ShardedUrlHistoryManagerTest::testLegacyDuplicateUrls()
+{
+    {
+        // Written before URLs were canonicalized: both spellings were kept
+        std::ofstream historyFile(_historyFilePath);
+        historyFile << "#geecxx-url-history 3\n";
+        historyFile << "1 1000 1500\nwebsite.com/b?x=%7e\nTitle B\nAuthor 1\n";
+        historyFile << "2 2000 3000\nwebsite.com/b?x=~\nTitle B\nAuthor 2\n";
+    }
+
+    ShardedUrlHistoryManager history(64, 4, _historyFilePath);
+    CPPUNIT_ASSERT_EQUAL(true, history.initFromFile());
+    CPPUNIT_ASSERT_EQUAL(size_t(1), history.getSize());
+    UrlHistoryEntry entry;
+    CPPUNIT_ASSERT_EQUAL(true, history.find("website.com/b?x=~", entry));
+    CPPUNIT_ASSERT_EQUAL(std::uint64_t(1), entry._id);
+    CPPUNIT_ASSERT_EQUAL(std::time_t(3000), entry._lastSeenTime);
+}
+
+void ShardedUrlHistoryManagerTest::testReload()
+{
+    // Rounded up, each shard holds 3 entries: 12 overall
+    ShardedUrlHistoryManager history(10, 4, _historyFilePath);
+    for (size_t i = 0; i < 64; ++i) {
+        CPPUNIT_ASSERT_EQUAL(true, history.insert("http://www.website.com/page" + std::to_string(i), "Title",
+                                                  "Author"));
+    }
+    CPPUNIT_ASSERT_EQUAL(history.getMaxSize(), history.getSize());
+    CPPUNIT_ASSERT(history.getSize() > 10);
+    CPPUNIT_ASSERT_EQUAL(true, history.saveToFile());
+
+    // Entries are written from the oldest to the newest
+    std::ifstream historyFile(_historyFilePath);
+    std::string line;
+    CPPUNIT_ASSERT(std::getline(historyFile, line));
+    std::uint64_t lastId = 0;
+    size_t recordCount = 0;
+    while (std::getline(historyFile, line)) {
+        const std::uint64_t id = std::stoull(line);
+        CPPUNIT_ASSERT(id > lastId);
+        lastId = id;
+        ++recordCount;
+        for (size_t i = 0; i < 3; ++i) {
+            CPPUNIT_ASSERT(std::getline(historyFile, line));
+        }
+    }
+    CPPUNIT_ASSERT_EQUAL(history.getSize(), recordCount);
+
+    // Nothing is lost on reload, new ids follow the loaded ones
+    ShardedUrlHistoryManager reloadedHistory(10, 4, _historyFilePath);
+    CPPUNIT_ASSERT_EQUAL(true, reloadedHistory.initFromFile());
+    CPPUNIT_ASSERT_EQUAL(history.getSize(), reloadedHistory.getSize());
+    std::shared_ptr<const UrlHistorySnapshot> snapshot = history.takeSnapshot();
+    for (const UrlHistoryRecord& record : *snapshot) {
+        UrlHistoryEntry entry;
+        CPPUNIT_ASSERT_EQUAL(true, reloadedHistory.find(record._url, entry));
+        CPPUNIT_ASSERT_EQUAL(record._entry._id, entry._id);
+    }
+    CPPUNIT_ASSERT_EQUAL(true, reloadedHistory.insert("http://www.otherwebsite.com/", "Title", "Author"));
+    UrlHistoryEntry entry;
+    CPPUNIT_ASSERT_EQUAL(true, reloadedHistory.find("http://www.otherwebsite.com/", entry));
+    CPPUNIT_ASSERT_EQUAL(std::uint64_t(65), entry._id);
+}
+
+}
@@ -0,0 +1,160 @@
+/*
+ * Copyright (c) 2015, Romain Létendart
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "soaktest.h"
+
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+
+#include "bot.h"
+#include "connection.h"
+#include "webinforetriever.h"
+
+namespace geecxx
+{
+
+CPPUNIT_TEST_SUITE_REGISTRATION(SoakTest);
+
+void SoakTest::setUp()
+{
+    // Titles of the mock URLs are never found, without going through DNS
+    WebInfoRetriever::getInstance().setTitleFixtures(std::make_shared<TitleFixtures>());
+}
+
+void SoakTest::tearDown()
+{
+    WebInfoRetriever::getInstance().setTitleFixtures(nullptr);
+}
+
+MockIrcStats SoakTest::runSession(const MockIrcScript& script)
+{
+    MockIrcServer server(script);
+    CPPUNIT_ASSERT(server.open());
+    std::thread serverThread([&server]() {
+        server.run();
+    });
+
+    // The bot's own connection is offline, its lines go through this one
+    Connection connection("127.0.0.1", std::to_string(server.getPort()));
+    Bot bot;
+    bot.initOffline("geecxx", script._channel, nullptr, [&connection](std::string_view line) {
+        connection.writeMessage(line);
+    });
+    connection.setExternalReadHandler([&bot](std::string_view line) {
+        bot.handleLine(line);
+    });
+    const bool opened = connection.open();
+    if (opened) {
+        bot.nick("geecxx");
+        bot.join(script._channel);
+        connection.listen();
+    } else {
+        server.stop();
+    }
+    serverThread.join();
+    CPPUNIT_ASSERT(opened);
+    CPPUNIT_ASSERT(!connection.isAlive());
+    return server.getStats();
+}
+
+// Actual tests
+void SoakTest::testLoad()
+{
+    MockIrcScript script;
+    script._lineCount = 5000;
+    script._urlDensity = 0.2;
+    script._repeatRatio = 0.5;
+    const MockIrcStats stats = runSession(script);
+
+    CPPUNIT_ASSERT_EQUAL(script._lineCount, stats._sentLineCount);
+    CPPUNIT_ASSERT(0 != stats._repeatedUrlLineCount);
+    CPPUNIT_ASSERT_EQUAL(size_t(50), stats._pingCount);
+    CPPUNIT_ASSERT_EQUAL(stats._pingCount, stats._pongLatenciesUs.size());
+    CPPUNIT_ASSERT_EQUAL(stats._repeatedUrlLineCount, stats._replyLatenciesUs.size());
+    CPPUNIT_ASSERT(!stats._disconnected);
+    CPPUNIT_ASSERT(!stats._floodKilled);
+}
+
+void SoakTest::testPacedLoad()
+{
+    MockIrcScript script;
+    script._lineCount = 500;
+    script._linesPerSecond = 2000;
+    script._urlDensity = 0.5;
+    script._pingInterval = 10;
+    const auto start = MockIrcServer::Clock::now();
+    const MockIrcStats stats = runSession(script);
+
+    // The last line is due after 249.5ms
+    CPPUNIT_ASSERT(MockIrcServer::Clock::now() - start >= std::chrono::milliseconds(249));
+    CPPUNIT_ASSERT_EQUAL(script._lineCount, stats._sentLineCount);
+    CPPUNIT_ASSERT_EQUAL(stats._pingCount, stats._pongLatenciesUs.size());
+    CPPUNIT_ASSERT_EQUAL(stats._repeatedUrlLineCount, stats._replyLatenciesUs.size());
+}
+
+void SoakTest::testDisconnect()
+{
+    MockIrcScript script;
+    script._lineCount = 5000;
+    script._disconnectAfter = 1000;
+    const MockIrcStats stats = runSession(script);
+
+    // The bot stops listening once the server is gone
+    CPPUNIT_ASSERT(stats._disconnected);
+    CPPUNIT_ASSERT_EQUAL(script._disconnectAfter, stats._sentLineCount);
+}
+
+void SoakTest::testSlowReads()
+{
+    MockIrcScript script;
+    script._lineCount = 300;
+    script._urlDensity = 1.0;
+    script._repeatRatio = 0.9;
+    script._maxLineSize = 20;
+    script._readDelay = std::chrono::milliseconds(1);
+    const MockIrcStats stats = runSession(script);
+
+    // Replies are late, none is lost
+    CPPUNIT_ASSERT_EQUAL(stats._pingCount, stats._pongLatenciesUs.size());
+    CPPUNIT_ASSERT_EQUAL(stats._repeatedUrlLineCount, stats._replyLatenciesUs.size());
+    CPPUNIT_ASSERT(stats._replyLatenciesUs.back() >= 1000);
+}
+
+void SoakTest::testFloodKill()
+{
+    MockIrcScript script;
+    script._lineCount = 1000;
+    script._urlDensity = 1.0;
+    script._repeatRatio = 1.0;
+    script._maxClientLinesPerSecond = 20;
+    const MockIrcStats stats = runSession(script);
+
+    // NICK, USER and JOIN, then 17 replies at most
+    CPPUNIT_ASSERT(stats._floodKilled);
+    CPPUNIT_ASSERT(stats._replyLatenciesUs.size() <= 17);
+}
+
+}
@@ -0,0 +1,68 @@
+/*
+ * Copyright (c) 2015, Romain Létendart
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#pragma once
+
+#include <cppunit/extensions/HelperMacros.h>
+#include <cppunit/TestFixture.h>
+
+#include "mockircserver.h"
+
+namespace geecxx
+{
+
+class SoakTest : public CPPUNIT_NS::TestFixture
+{
+    CPPUNIT_TEST_SUITE(SoakTest);
+    CPPUNIT_TEST(testLoad);
+    CPPUNIT_TEST(testPacedLoad);
+    CPPUNIT_TEST(testDisconnect);
+    CPPUNIT_TEST(testSlowReads);
+    CPPUNIT_TEST(testFloodKill);
+    CPPUNIT_TEST_SUITE_END();
+
+public:
+    SoakTest() = default;
+    ~SoakTest() = default;
+
+    void setUp();
+    void tearDown();
+
+    // Actual tests
+    void testLoad();
+    void testPacedLoad();
+    void testDisconnect();
+    void testSlowReads();
+    void testFloodKill();
+private:
+    /**
+     * Play a script to a bot connected to a mock IRC server, until the
+     * server ends the session
+     * @param[in] script script of the server
+     * @return what happened during the session
+     */
+    MockIrcStats runSession(const MockIrcScript& script);
+};
+
+}
@@ -0,0 +1,229 @@
+/*
+ * Copyright (c) 2015, Romain Létendart
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "stringutilstest.h"
+
+#include <algorithm>
+#include <cctype>
+#include <random>
+#include <string>
+
+#include "stringutils.h"
+
+namespace geecxx
+{
+
+CPPUNIT_TEST_SUITE_REGISTRATION(StringUtilsTest);
+
+namespace
+{
+
+/**
+ * Reference: the former implementation of findNoCase
+ */
+size_t findNoCaseReference(const std::string& haystack, const std::string& needle)
+{
+    if (needle.empty()) {
+        return 0;
+    }
+    auto it = std::search(haystack.begin(), haystack.end(), needle.begin(), needle.end(),
+                          [](char c1, char c2) { return std::toupper(c1) == std::toupper(c2); });
+    return it == haystack.end() ? std::string::npos : std::distance(haystack.begin(), it);
+}
+
+}
+
+void StringUtilsTest::setUp()
+{
+}
+
+void StringUtilsTest::tearDown()
+{
+}
+
+// Actual tests
+void StringUtilsTest::testFindNoCase()
+{
+    CPPUNIT_ASSERT_EQUAL(size_t(6), stringutils::findNoCase("<html><TITLE>Page</TITLE>", "<title>"));
+    CPPUNIT_ASSERT_EQUAL(size_t(17), stringutils::findNoCase("<html><TITLE>Page</TITLE>", "</Title>"));
+    CPPUNIT_ASSERT_EQUAL(std::string::npos, stringutils::findNoCase("<html><TITLE>Page", "</title>"));
+    CPPUNIT_ASSERT_EQUAL(size_t(0), stringutils::findNoCase("Content-Type: text/html", "content-type: "));
+    CPPUNIT_ASSERT_EQUAL(size_t(0), stringutils::findNoCase("abc", ""));
+    CPPUNIT_ASSERT_EQUAL(std::string::npos, stringutils::findNoCase("", "a"));
+    CPPUNIT_ASSERT_EQUAL(std::string::npos, stringutils::findNoCase("ab", "abc"));
+    // Only ASCII letters are folded
+    CPPUNIT_ASSERT_EQUAL(std::string::npos, stringutils::findNoCase("[\\]", "{|}"));
+    CPPUNIT_ASSERT_EQUAL(std::string::npos, stringutils::findNoCase("\xc3\xa9", "\xc3\x89"));
+    CPPUNIT_ASSERT_EQUAL(size_t(1), stringutils::findNoCase("a\xff" "B", "\xff" "b"));
+
+    const stringutils::NoCaseSearcher searcher("ab");
+    const std::string haystack("xxABxxaBxx");
+    CPPUNIT_ASSERT_EQUAL(size_t(2), searcher.find(haystack));
+    CPPUNIT_ASSERT_EQUAL(size_t(2), searcher.find(haystack, 2));
+    CPPUNIT_ASSERT_EQUAL(size_t(6), searcher.find(haystack, 3));
+    CPPUNIT_ASSERT_EQUAL(std::string::npos, searcher.find(haystack, 7));
+    CPPUNIT_ASSERT_EQUAL(std::string::npos, searcher.find(haystack, 11));
+    CPPUNIT_ASSERT_EQUAL(size_t(3), searcher.find(std::string_view(haystack.data() + 3, 6)));
+}
+
+void StringUtilsTest::testNoCaseSearcherImplementations()
+{
+    typedef stringutils::NoCaseSearcher::Implementation Implementation;
+    CPPUNIT_ASSERT_EQUAL(true, stringutils::NoCaseSearcher::isSupported(Implementation::SCALAR));
+    const Implementation implementations[] = {Implementation::SCALAR, Implementation::SSE2, Implementation::AVX2};
+
+    // Small alphabet so that candidates are frequent, matches at every
+    // offset of the blocks and around the end of the haystack
+    std::mt19937 generator(42);
+    const std::string alphabet("aAbB<>/\xe9");
+    std::uniform_int_distribution<size_t> letterDistribution(0, alphabet.size() - 1);
+    for (size_t needleSize = 1; needleSize <= 40; needleSize += 3) {
+        for (size_t haystackSize = 0; haystackSize <= 130; ++haystackSize) {
+            std::string needle, haystack;
+            for (size_t i = 0; i < needleSize; ++i) {
+                needle.push_back(alphabet[letterDistribution(generator)]);
+            }
+            for (size_t i = 0; i < haystackSize; ++i) {
+                haystack.push_back(alphabet[letterDistribution(generator)]);
+            }
+            if (haystackSize >= needleSize && 0 != haystackSize % 2) {
+                // Plant a match, with its case swapped
+                std::string match(needle);
+                std::transform(match.begin(), match.end(), match.begin(), [](char c) {
+                    return std::islower(c) ? std::toupper(c) : std::tolower(c);
+                });
+                haystack.replace(generator() % (haystackSize - needleSize + 1), needleSize, match);
+            }
+
+            const size_t expectedIndex = findNoCaseReference(haystack, needle);
+            for (Implementation implementation : implementations) {
+                if (!stringutils::NoCaseSearcher::isSupported(implementation)) {
+                    continue;
+                }
+                const stringutils::NoCaseSearcher searcher(needle, implementation);
+                CPPUNIT_ASSERT(implementation == searcher.getImplementation());
+                CPPUNIT_ASSERT_EQUAL(expectedIndex, searcher.find(haystack));
+            }
+        }
+    }
+}
+
+void StringUtilsTest::testFormatInline()
+{
+    const struct
+    {
+        const char* _input;
+        const char* _output;
+    } strings[] = {
+        {"", ""},
+        {" \t\n\r\v\f", ""},
+        {"word", "word"},
+        {"  Some\n\ttitle  \r\n", "Some title"},
+        {"a b  c   d", "a b c d"},
+        // No-break, en, ideographic and line separator spaces
+        {"\xc2\xa0" "Caf\xc3\xa9\xc2\xa0\xc2\xa0" "cr\xc3\xa8me\xe2\x80\x82", "Caf\xc3\xa9 cr\xc3\xa8me"},
+        {"a\xe3\x80\x80" "b\xe2\x80\xa8" "c\xe1\x9a\x80" "d\xe2\x81\x9f" "e\xc2\x85" "f", "a b c d e f"},
+        // Look-alikes: zero width space, em dash, truncated sequences
+        {"a\xe2\x80\x8b" "b\xe2\x80\x94" "c", "a\xe2\x80\x8b" "b\xe2\x80\x94" "c"},
+        {"a \xc2", "a \xc2"},
+        {"a \xe2\x80", "a \xe2\x80"},
+        // Runs crossing the 16 bytes blocks
+        {"0123456789abcde                 0123456789abcdef 0", "0123456789abcde 0123456789abcdef 0"},
+        {"0123456789abcdef\xc2\xa0\xc2\xa0" "0123456789abcdef0123456789abcdef   ",
+         "0123456789abcdef 0123456789abcdef0123456789abcdef"},
+    };
+    for (const auto& string : strings) {
+        std::string s(string._input);
+        stringutils::formatInline(s);
+        CPPUNIT_ASSERT_EQUAL(std::string(string._output), s);
+    }
+
+    // Larger than the stack, which the former implementation copied it to
+    const size_t wordCount = 4 * 1024 * 1024;
+    std::string title;
+    for (size_t i = 0; i < wordCount; ++i) {
+        title.append("ab \n ");
+    }
+    stringutils::formatInline(title);
+    CPPUNIT_ASSERT_EQUAL(wordCount * 3 - 1, title.size());
+    CPPUNIT_ASSERT_EQUAL(std::string("ab ab "), title.substr(0, 6));
+}
+
+void StringUtilsTest::testShorten()
+{
+    const struct
+    {
+        const char* _input;
+        size_t _maxSize;
+        const char* _output;
+    } strings[] = {
+        {"abcdefghij", 10, "abcdefghij"},
+        {"abcdefghij", 8, "ab[..]ij"},
+        {"abcdefghij", 9, "abc[..]ij"},
+        {"abcdefghij", 5, "abcde"},
+        {"abcdefghij", 0, ""},
+        // Multi-byte sequences, "é" taking 2 bytes
+        {"\xc3\xa9\xc3\xa9\xc3\xa9\xc3\xa9\xc3\xa9", 8, "\xc3\xa9[..]\xc3\xa9"},
+        {"\xc3\xa9\xc3\xa9\xc3\xa9\xc3\xa9\xc3\xa9", 9, "\xc3\xa9[..]\xc3\xa9"},
+        {"\xc3\xa9\xc3\xa9\xc3\xa9\xc3\xa9\xc3\xa9\xc3\xa9", 11, "\xc3\xa9\xc3\xa9[..]\xc3\xa9"},
+        {"\xc3\xa9\xc3\xa9\xc3\xa9", 3, "\xc3\xa9"},
+        {"\xe6\x97\xa5\xe6\x9c\xac\xe8\xaa\x9e\xe6\x97\xa5\xe6\x9c\xac", 11, "\xe6\x97\xa5[..]\xe6\x9c\xac"},
+        // "e" followed by a combining acute accent
+        {"ae\xcc\x81" "bcdefghi", 8, "a[..]ghi"},
+        {"abcdefgh" "e\xcc\x81" "i", 9, "abc[..]i"},
+        // Emojis joined by zero width joiners, or with a skin tone
+        {"a\xf0\x9f\x91\xa8\xe2\x80\x8d\xf0\x9f\x91\xa9" "bcdefghijklmnop", 12, "a[..]jklmnop"},
+        {"abcdefghijklmn\xf0\x9f\x91\x8d\xf0\x9f\x8f\xbd", 14, "abcde[..]"},
+        {"abc\xf0\x9f\x91\xa8\xe2\x80\x8d\xf0\x9f\x91\xa9" "defghijklmnopqrstu", 24, "abc[..]efghijklmnopqrstu"},
+    };
+    for (const auto& string : strings) {
+        CPPUNIT_ASSERT_EQUAL_MESSAGE(string._input, std::string(string._output),
+                                     stringutils::shorten(string._input, string._maxSize));
+    }
+
+    // Random cuts never split a sequence
+    std::mt19937 generator(42);
+    const char* characters[] = {"a", "\xc3\xa9", "\xe6\x97\xa5", "\xf0\x9f\x98\x80", "e\xcc\x81"};
+    char output[64];
+    for (size_t i = 0; i < 1000; ++i) {
+        std::string s;
+        while (s.size() < 60) {
+            s.append(characters[generator() % 5]);
+        }
+        const size_t maxSize = generator() % 64;
+        const size_t size = stringutils::shorten(s, maxSize, output);
+        CPPUNIT_ASSERT(size <= maxSize);
+        CPPUNIT_ASSERT(maxSize < 6 || size + 7 > maxSize);
+        for (size_t j = 0; j + 1 < size; ++j) {
+            const unsigned char c = output[j];
+            if (c >= 0xc0) {
+                const size_t length = c >= 0xf0 ? 4 : c >= 0xe0 ? 3 : 2;
+                CPPUNIT_ASSERT(j + length <= size);
+            }
+        }
+        CPPUNIT_ASSERT(size == 0 || static_cast<unsigned char>(output[size - 1]) < 0xc0);
+    }
+}
+
+}
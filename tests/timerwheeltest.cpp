@@ -0,0 +1,131 @@
+/*
+ * Copyright (c) 2015, Romain Létendart
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "timerwheeltest.h"
+
+#include <cstdint>
+#include <vector>
+
+#include "timerwheel.h"
+
+namespace geecxx
+{
+
+CPPUNIT_TEST_SUITE_REGISTRATION(TimerWheelTest);
+
+void TimerWheelTest::setUp()
+{
+}
+
+void TimerWheelTest::tearDown()
+{
+}
+
+// Actual tests
+void TimerWheelTest::testExpiryOrder()
+{
+    TimerWheel wheel(100);
+    wheel.schedule(1, 105);
+    wheel.schedule(2, 103);
+    // Already expired: fires on the next tick
+    wheel.schedule(3, 50);
+    CPPUNIT_ASSERT_EQUAL(size_t(3), wheel.getSize());
+
+    std::vector<std::uint64_t> expired;
+    const auto collect = [&expired](std::uint64_t key) {
+        expired.push_back(key);
+    };
+    wheel.advance(102, collect);
+    CPPUNIT_ASSERT_EQUAL(size_t(1), expired.size());
+    CPPUNIT_ASSERT_EQUAL(std::uint64_t(3), expired[0]);
+
+    wheel.advance(104, collect);
+    CPPUNIT_ASSERT_EQUAL(size_t(2), expired.size());
+    CPPUNIT_ASSERT_EQUAL(std::uint64_t(2), expired[1]);
+
+    // Going back in time does nothing
+    wheel.advance(10, collect);
+    CPPUNIT_ASSERT_EQUAL(TimerWheel::Tick(104), wheel.getCurrentTick());
+
+    wheel.advance(105, collect);
+    CPPUNIT_ASSERT_EQUAL(size_t(3), expired.size());
+    CPPUNIT_ASSERT_EQUAL(std::uint64_t(1), expired[2]);
+    CPPUNIT_ASSERT_EQUAL(size_t(0), wheel.getSize());
+}
+
+void TimerWheelTest::testCascade()
+{
+    // Timers far enough to be filed in every level, none must fire early
+    const TimerWheel::Tick start = 1000000007;
+    TimerWheel wheel(start);
+    const std::vector<TimerWheel::Tick> delays = {1, 63, 64, 65, 4095, 4096, 4097, 300000, 20000000};
+    for (size_t i = 0; i < delays.size(); ++i) {
+        wheel.schedule(i, start + delays[i]);
+    }
+
+    TimerWheel::Tick expiryTick = 0;
+    size_t expiredCount = 0;
+    for (TimerWheel::Tick tick = start + 1; tick <= start + delays.back(); ++tick) {
+        wheel.advance(tick, [&](std::uint64_t key) {
+            CPPUNIT_ASSERT_EQUAL(start + delays[key], tick);
+            expiryTick = tick;
+            ++expiredCount;
+        });
+    }
+    CPPUNIT_ASSERT_EQUAL(delays.size(), expiredCount);
+    CPPUNIT_ASSERT_EQUAL(start + delays.back(), expiryTick);
+
+    // Same thing when advancing by large steps
+    wheel.reset(start);
+    for (size_t i = 0; i < delays.size(); ++i) {
+        wheel.schedule(i, start + delays[i]);
+    }
+    expiredCount = 0;
+    wheel.advance(start + 4096, [&](std::uint64_t key) {
+        CPPUNIT_ASSERT(delays[key] <= 4096);
+        ++expiredCount;
+    });
+    CPPUNIT_ASSERT_EQUAL(size_t(6), expiredCount);
+    CPPUNIT_ASSERT_EQUAL(size_t(3), wheel.getSize());
+}
+
+void TimerWheelTest::testReschedule()
+{
+    TimerWheel wheel(0);
+    wheel.schedule(42, 10);
+
+    size_t expiredCount = 0;
+    wheel.advance(100, [&](std::uint64_t key) {
+        ++expiredCount;
+        if (expiredCount < 3) {
+            // Scheduled again from the expiry tick
+            wheel.schedule(key, wheel.getCurrentTick() + 10);
+        }
+    });
+    CPPUNIT_ASSERT_EQUAL(size_t(3), expiredCount);
+    CPPUNIT_ASSERT_EQUAL(size_t(0), wheel.getSize());
+    CPPUNIT_ASSERT_EQUAL(TimerWheel::Tick(100), wheel.getCurrentTick());
+}
+
+}
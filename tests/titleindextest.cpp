@@ -0,0 +1,125 @@
+/*
+ * Copyright (c) 2015, Romain Létendart
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "titleindextest.h"
+
+#include <vector>
+
+#include "titleindex.h"
+#include "urlhistorymanager.h"
+
+namespace geecxx
+{
+
+CPPUNIT_TEST_SUITE_REGISTRATION(TitleIndexTest);
+
+void TitleIndexTest::setUp()
+{
+}
+
+void TitleIndexTest::tearDown()
+{
+}
+
+// Actual tests
+void TitleIndexTest::testTokenize()
+{
+    std::vector<std::string> terms;
+
+    TitleIndex::tokenize("Hello, World! C++17 -- hello again", terms);
+    const std::vector<std::string> expectedTerms = {"hello", "world", "c", "17", "again"};
+    // Single characters are skipped
+    CPPUNIT_ASSERT_EQUAL(size_t(4), terms.size());
+    CPPUNIT_ASSERT_EQUAL(expectedTerms[0], terms[0]);
+    CPPUNIT_ASSERT_EQUAL(expectedTerms[1], terms[1]);
+    CPPUNIT_ASSERT_EQUAL(expectedTerms[3], terms[2]);
+    CPPUNIT_ASSERT_EQUAL(expectedTerms[4], terms[3]);
+
+    // Latin-1 letters are case-folded, typographic punctuation splits terms
+    TitleIndex::tokenize("\xC3\x89t\xC3\xA9 \xC2\xAB" "CAF\xC3\x89" "\xC2\xBB\xE2\x80\x94" "d\xC3\xA9j\xC3\xA0", terms);
+    CPPUNIT_ASSERT_EQUAL(size_t(3), terms.size());
+    CPPUNIT_ASSERT_EQUAL(std::string("\xC3\xA9t\xC3\xA9"), terms[0]);
+    CPPUNIT_ASSERT_EQUAL(std::string("caf\xC3\xA9"), terms[1]);
+    CPPUNIT_ASSERT_EQUAL(std::string("d\xC3\xA9j\xC3\xA0"), terms[2]);
+}
+
+void TitleIndexTest::testSearch()
+{
+    TitleIndex index;
+    index.add(1, "Rust compiler release notes");
+    index.add(2, "C++ compiler benchmarks");
+    index.add(3, "Weather forecast");
+    index.add(4, "Compiler explorer");
+    CPPUNIT_ASSERT_EQUAL(size_t(4), index.getDocumentCount());
+
+    // Titles containing the rarest term come first, then newest first
+    std::vector<TitleSearchResult> results = index.search("compiler benchmarks", 10);
+    CPPUNIT_ASSERT_EQUAL(size_t(3), results.size());
+    CPPUNIT_ASSERT_EQUAL(std::uint64_t(2), results[0]._id);
+    CPPUNIT_ASSERT_EQUAL(std::uint64_t(4), results[1]._id);
+    CPPUNIT_ASSERT_EQUAL(std::uint64_t(1), results[2]._id);
+
+    results = index.search("COMPILER", 2);
+    CPPUNIT_ASSERT_EQUAL(size_t(2), results.size());
+    CPPUNIT_ASSERT_EQUAL(std::uint64_t(4), results[0]._id);
+
+    CPPUNIT_ASSERT_EQUAL(size_t(0), index.search("unknown", 10).size());
+
+    // Removed titles can't be found anymore, unused terms are dropped
+    const size_t termCount = index.getTermCount();
+    index.remove(2, "C++ compiler benchmarks");
+    CPPUNIT_ASSERT_EQUAL(size_t(0), index.search("benchmarks", 10).size());
+    CPPUNIT_ASSERT_EQUAL(size_t(2), index.search("compiler", 10).size());
+    CPPUNIT_ASSERT_EQUAL(termCount - 1, index.getTermCount());
+    CPPUNIT_ASSERT_EQUAL(size_t(3), index.getDocumentCount());
+}
+
+void TitleIndexTest::testHistorySearch()
+{
+    UrlHistoryManager history(64, "");
+    history.enableTitleIndex();
+
+    for (size_t i = 1; i <= 4 * history.getMaxSize(); ++i) {
+        CPPUNIT_ASSERT_EQUAL(true, history.insert("http://www.website.com/page" + std::to_string(i),
+                                                  "Page number" + std::to_string(i)
+                                                  + (0 == i % 2 ? " even" : " odd"), "Author"));
+    }
+
+    // Evicted titles are removed from the index
+    CPPUNIT_ASSERT_EQUAL(history.getMaxSize(), history.getTitleIndex()->getDocumentCount());
+    CPPUNIT_ASSERT_EQUAL(3 * history.getMaxSize(), history.getTitleIndex()->getPostingCount());
+    CPPUNIT_ASSERT_EQUAL(size_t(0), history.search("number1", 10).size());
+
+    std::vector<UrlHistoryRecord> records = history.search("number256 even", 3);
+    CPPUNIT_ASSERT_EQUAL(size_t(3), records.size());
+    CPPUNIT_ASSERT_EQUAL(std::uint64_t(256), records[0]._entry._id);
+    CPPUNIT_ASSERT_EQUAL(std::string("Page number256 even"), records[0]._entry._title);
+    CPPUNIT_ASSERT_EQUAL(std::string("website.com/page256"), records[0]._url);
+    CPPUNIT_ASSERT_EQUAL(std::uint64_t(254), records[1]._entry._id);
+
+    history.clear();
+    CPPUNIT_ASSERT_EQUAL(size_t(0), history.getTitleIndex()->getTermCount());
+}
+
+}
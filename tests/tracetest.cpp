@@ -0,0 +1,187 @@
+/*
+ * Copyright (c) 2015, Romain Létendart
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "tracetest.h"
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+#include <string>
+
+#include "logger.h"
+#include "trace.h"
+
+namespace geecxx
+{
+
+namespace
+{
+
+/**
+ * Trace of a line whose URL took 5ms to fetch, 4ms of them downloading
+ */
+void fillTrace(Trace& trace)
+{
+    const Trace::Clock::time_point start = trace.getStart();
+    const auto at = [start](int us) {
+        return start + std::chrono::microseconds(us);
+    };
+    trace.addSpan("parse_urls", at(0), at(100));
+    trace.openSpan();
+    trace.openSpan();
+    trace.addSpan("download", at(1200), at(5200));
+    trace.closeSpan("fetch", at(200), at(5200));
+    trace.closeSpan("process_url", at(100), at(6000));
+    trace.addLabel("https://example.org/a");
+    trace.addLabel("https://example.org/\"b\"");
+    trace.finish(at(6000));
+}
+
+}
+
+CPPUNIT_TEST_SUITE_REGISTRATION(TraceTest);
+
+void TraceTest::setUp()
+{
+}
+
+void TraceTest::tearDown()
+{
+    Tracer::getInstance().setThreshold(0);
+    Tracer::getInstance().setSampleRate(1);
+    Logger::getInstance().setOutput(std::cout);
+    std::remove(_traceFilePath.c_str());
+}
+
+// Actual tests
+void TraceTest::testSpans()
+{
+    // No current trace, nothing happens
+    CPPUNIT_ASSERT(nullptr == Trace::getCurrent());
+    {
+        ScopedSpan span("ignored");
+    }
+
+    Trace trace("line");
+    Trace::setCurrent(&trace);
+    {
+        ScopedSpan outerSpan("outer");
+        ScopedSpan innerSpan("inner");
+    }
+    Trace::setCurrent(nullptr);
+    trace.finish();
+
+    // Spans are added as they end
+    CPPUNIT_ASSERT_EQUAL(size_t(2), trace.getSpanCount());
+    CPPUNIT_ASSERT_EQUAL(std::string("inner"), std::string(trace.getSpan(0)._name));
+    CPPUNIT_ASSERT_EQUAL(1u, trace.getSpan(0)._depth);
+    CPPUNIT_ASSERT_EQUAL(std::string("outer"), std::string(trace.getSpan(1)._name));
+    CPPUNIT_ASSERT_EQUAL(0u, trace.getSpan(1)._depth);
+    CPPUNIT_ASSERT(trace.getSpan(1)._startUs <= trace.getSpan(0)._startUs);
+    CPPUNIT_ASSERT(trace.getSpan(1)._durationUs <= trace.getDurationUs());
+
+    // Spans beyond the capacity are dropped
+    for (size_t i = 0; i < Trace::MAX_SPAN_COUNT; ++i) {
+        trace.addSpan("extra", trace.getStart(), trace.getStart());
+    }
+    CPPUNIT_ASSERT_EQUAL(size_t(Trace::MAX_SPAN_COUNT), trace.getSpanCount());
+    CPPUNIT_ASSERT_EQUAL(size_t(2), trace.getDroppedSpanCount());
+}
+
+void TraceTest::testSlowTraces()
+{
+    Trace trace("line");
+    fillTrace(trace);
+    Tracer& tracer = Tracer::getInstance();
+    std::ostringstream output;
+    Logger::getInstance().setOutput(output);
+
+    // Disabled
+    CPPUNIT_ASSERT_EQUAL(false, tracer.isEnabled());
+    CPPUNIT_ASSERT_EQUAL(false, tracer.submit(trace));
+
+    // Not slow enough
+    tracer.setThreshold(6001);
+    CPPUNIT_ASSERT_EQUAL(true, tracer.isEnabled());
+    CPPUNIT_ASSERT_EQUAL(false, tracer.submit(trace));
+
+    // One slow trace out of two
+    tracer.setThreshold(6000);
+    tracer.setSampleRate(2);
+    size_t reportedCount = 0;
+    for (int i = 0; i < 4; ++i) {
+        reportedCount += tracer.submit(trace) ? 1 : 0;
+    }
+    CPPUNIT_ASSERT_EQUAL(size_t(2), reportedCount);
+
+    Logger::getInstance().flush();
+    const std::string expectedLog = "[WARNING]: Slow line: parse_urls=100us process_url=5900us "
+                                    "process_url/fetch=5000us process_url/fetch/download=4000us "
+                                    "trace_us=6000 urls=https://example.org/a https://example.org/\"b\"\n";
+    const std::string log = output.str();
+    const size_t firstLog = log.find(expectedLog);
+    CPPUNIT_ASSERT(std::string::npos != firstLog);
+    CPPUNIT_ASSERT(std::string::npos != log.find(expectedLog, firstLog + 1));
+}
+
+void TraceTest::testChromeEvents()
+{
+    Trace trace("line");
+    fillTrace(trace);
+    const std::uint64_t startUs = std::chrono::duration_cast<std::chrono::microseconds>(
+            trace.getStart().time_since_epoch()).count();
+
+    std::string json;
+    Tracer::appendChromeEvents(trace, json);
+    const std::string expectedJson =
+            "{\"name\":\"line\",\"cat\":\"geecxx\",\"ph\":\"X\",\"ts\":" + std::to_string(startUs)
+            + ",\"dur\":6000,\"pid\":1,\"tid\":1,"
+              "\"args\":{\"urls\":\"https://example.org/a https://example.org/\\\"b\\\"\"}},\n"
+              "{\"name\":\"parse_urls\",\"cat\":\"geecxx\",\"ph\":\"X\",\"ts\":" + std::to_string(startUs)
+            + ",\"dur\":100,\"pid\":1,\"tid\":1},\n"
+              "{\"name\":\"download\",\"cat\":\"geecxx\",\"ph\":\"X\",\"ts\":" + std::to_string(startUs + 1200)
+            + ",\"dur\":4000,\"pid\":1,\"tid\":1},\n"
+              "{\"name\":\"fetch\",\"cat\":\"geecxx\",\"ph\":\"X\",\"ts\":" + std::to_string(startUs + 200)
+            + ",\"dur\":5000,\"pid\":1,\"tid\":1},\n"
+              "{\"name\":\"process_url\",\"cat\":\"geecxx\",\"ph\":\"X\",\"ts\":" + std::to_string(startUs + 100)
+            + ",\"dur\":5900,\"pid\":1,\"tid\":1},\n";
+    CPPUNIT_ASSERT_EQUAL(expectedJson, json);
+
+    // Reported traces are appended to the trace file
+    std::ostringstream output;
+    Logger::getInstance().setOutput(output);
+    Tracer& tracer = Tracer::getInstance();
+    CPPUNIT_ASSERT_EQUAL(true, tracer.openTraceFile(_traceFilePath));
+    tracer.setThreshold(1);
+    CPPUNIT_ASSERT_EQUAL(true, tracer.submit(trace));
+    CPPUNIT_ASSERT_EQUAL(true, tracer.submit(trace));
+    std::ifstream file(_traceFilePath);
+    const std::string contents((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    CPPUNIT_ASSERT_EQUAL("[\n" + expectedJson + expectedJson, contents);
+}
+
+}
@@ -0,0 +1,108 @@
+/*
+ * Copyright (c) 2015, Romain Létendart
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "trafficrecordertest.h"
+
+#include <cstdio>
+#include <fstream>
+#include <thread>
+
+#include "trafficrecorder.h"
+
+namespace geecxx
+{
+
+CPPUNIT_TEST_SUITE_REGISTRATION(TrafficRecorderTest);
+
+void TrafficRecorderTest::setUp()
+{
+}
+
+void TrafficRecorderTest::tearDown()
+{
+    std::remove(_trafficFilePath.c_str());
+}
+
+// Actual tests
+void TrafficRecorderTest::testRoundTrip()
+{
+    {
+        TrafficRecorder recorder(_trafficFilePath);
+        CPPUNIT_ASSERT(recorder.open());
+        recorder.recordLine(":alice!alice@example.com PRIVMSG #channel :see http://example.com/a");
+        recorder.recordTitle("http://example.com/a", true, "Page A");
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        recorder.recordLine("PING :irc.example.com");
+        recorder.recordLine("");
+        recorder.recordTitle("http://example.com/b", false, "ignored");
+        recorder.recordTitle("http://example.com/c", true, "");
+        recorder.recordTitle("http://example.com/a", true, "Page A, updated");
+    }
+
+    TrafficRecording recording;
+    CPPUNIT_ASSERT(recording.load(_trafficFilePath));
+    const std::vector<RecordedLine>& lines = recording.getLines();
+    CPPUNIT_ASSERT_EQUAL(size_t(3), lines.size());
+    CPPUNIT_ASSERT_EQUAL(std::string(":alice!alice@example.com PRIVMSG #channel :see http://example.com/a"),
+                         lines[0]._line);
+    CPPUNIT_ASSERT_EQUAL(std::string("PING :irc.example.com"), lines[1]._line);
+    CPPUNIT_ASSERT_EQUAL(std::string(), lines[2]._line);
+    CPPUNIT_ASSERT(lines[1]._timeUs >= lines[0]._timeUs + 2000);
+    CPPUNIT_ASSERT(lines[2]._timeUs >= lines[1]._timeUs);
+
+    const TitleFixtures& titles = *recording.getTitles();
+    CPPUNIT_ASSERT_EQUAL(size_t(3), titles.size());
+    CPPUNIT_ASSERT(titles.at("http://example.com/a")._found);
+    CPPUNIT_ASSERT_EQUAL(std::string("Page A, updated"), titles.at("http://example.com/a")._title);
+    CPPUNIT_ASSERT(!titles.at("http://example.com/b")._found);
+    CPPUNIT_ASSERT(titles.at("http://example.com/c")._found);
+    CPPUNIT_ASSERT_EQUAL(std::string(), titles.at("http://example.com/c")._title);
+}
+
+void TrafficRecorderTest::testInvalidFile()
+{
+    TrafficRecording recording;
+    CPPUNIT_ASSERT(!recording.load(_trafficFilePath));
+
+    {
+        std::ofstream file(_trafficFilePath, std::ios::binary);
+        file << "GXLOG";
+    }
+    CPPUNIT_ASSERT(!recording.load(_trafficFilePath));
+
+    {
+        TrafficRecorder recorder(_trafficFilePath);
+        CPPUNIT_ASSERT(recorder.open());
+        recorder.recordLine("PING :irc.example.com");
+    }
+    {
+        // Payload cut short
+        std::ofstream file(_trafficFilePath, std::ios::binary | std::ios::app);
+        const char record[] = {'\0', '\0', '\0', '\0', '\0', '\0', '\0', '\0', '\0', '\x10', '\0', '\0', '\0', 'P'};
+        file.write(record, sizeof(record));
+    }
+    CPPUNIT_ASSERT(!recording.load(_trafficFilePath));
+}
+
+}
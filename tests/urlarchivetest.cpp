@@ -0,0 +1,244 @@
+/*
+ * Copyright (c) 2015, Romain Létendart
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "urlarchivetest.h"
+
+#include <cstdio>
+#include <memory>
+#include <unistd.h>
+
+#include "bloomfilter.h"
+#include "historypersister.h"
+#include "stringutils.h"
+#include "urlarchive.h"
+#include "urlhistorymanager.h"
+
+namespace geecxx
+{
+
+CPPUNIT_TEST_SUITE_REGISTRATION(UrlArchiveTest);
+
+void UrlArchiveTest::setUp()
+{
+}
+
+void UrlArchiveTest::tearDown()
+{
+    char bucketFileName[48];
+    for (size_t bucket = 0; bucket < _bucketCount; ++bucket) {
+        std::snprintf(bucketFileName, sizeof(bucketFileName), "/bucket-%03zu.txt", bucket);
+        std::remove((_archiveDirectoryPath + bucketFileName).c_str());
+    }
+    std::remove((_archiveDirectoryPath + "/filter.bin").c_str());
+    rmdir(_archiveDirectoryPath.c_str());
+    std::remove(_historyFilePath.c_str());
+}
+
+// Actual tests
+void UrlArchiveTest::testBloomFilter()
+{
+    BloomFilter filter(1000, 0.01);
+    CPPUNIT_ASSERT(filter.getBitCount() >= 9585);
+    CPPUNIT_ASSERT_EQUAL(size_t(7), filter.getHashCount());
+
+    for (size_t i = 0; i < 1000; ++i) {
+        filter.add("http://www.website.com/page" + std::to_string(i));
+    }
+
+    // No false negatives
+    for (size_t i = 0; i < 1000; ++i) {
+        CPPUNIT_ASSERT_EQUAL(true, filter.mightContain("http://www.website.com/page" + std::to_string(i)));
+    }
+
+    // False positives stay close to the target rate
+    size_t falsePositiveCount = 0;
+    for (size_t i = 0; i < 10000; ++i) {
+        if (filter.mightContain("http://www.otherwebsite.com/page" + std::to_string(i))) {
+            ++falsePositiveCount;
+        }
+    }
+    CPPUNIT_ASSERT(falsePositiveCount < 200);
+    CPPUNIT_ASSERT(filter.getEstimatedFalsePositiveRate() < 0.02);
+
+    // Saved filters are read back identically, whatever the parameters of
+    // the reading one
+    const std::string filterFilePath = _historyFilePath + ".filter";
+    CPPUNIT_ASSERT_EQUAL(true, filter.saveToFile(filterFilePath));
+    BloomFilter readFilter(10, 0.5);
+    CPPUNIT_ASSERT_EQUAL(true, readFilter.loadFromFile(filterFilePath));
+    std::remove(filterFilePath.c_str());
+    CPPUNIT_ASSERT_EQUAL(filter.getBitCount(), readFilter.getBitCount());
+    CPPUNIT_ASSERT_EQUAL(filter.getHashCount(), readFilter.getHashCount());
+    CPPUNIT_ASSERT_EQUAL(filter.getItemCount(), readFilter.getItemCount());
+    CPPUNIT_ASSERT_EQUAL(true, readFilter.mightContain("http://www.website.com/page42"));
+}
+
+void UrlArchiveTest::testColdStore()
+{
+    std::shared_ptr<UrlArchive> archive(new UrlArchive(_archiveDirectoryPath, 1000, 0.01, _bucketCount));
+    CPPUNIT_ASSERT_EQUAL(true, archive->init());
+
+    UrlHistoryManager history(2, _historyFilePath);
+    history.setArchive(archive);
+    HistoryPersister persister(_historyFilePath);
+    persister.setArchive(archive);
+
+    CPPUNIT_ASSERT_EQUAL(true, history.insert("http://www.websiteA.com/", "Title A", "Author A"));
+    CPPUNIT_ASSERT_EQUAL(true, history.insert("http://www.websiteB.com/", "Title B", "Author B"));
+    CPPUNIT_ASSERT_EQUAL(true, history.insert("http://www.websiteC.com/", "Title C", "Author C"));
+    CPPUNIT_ASSERT_EQUAL(size_t(2), history.getSize());
+
+    // The evicted entry is still known, before and after reaching the disk
+    UrlHistoryEntry entry;
+    CPPUNIT_ASSERT_EQUAL(true, history.find("http://www.websiteA.com/", entry));
+    CPPUNIT_ASSERT_EQUAL(std::string("Title A"), entry._title);
+    CPPUNIT_ASSERT_EQUAL(true, persister.submit(history.takeSnapshot()));
+    CPPUNIT_ASSERT_EQUAL(true, persister.flush());
+    entry = UrlHistoryEntry();
+    CPPUNIT_ASSERT_EQUAL(true, history.find("http://www.websiteA.com/", entry));
+    CPPUNIT_ASSERT_EQUAL(std::string("Title A"), entry._title);
+    CPPUNIT_ASSERT_EQUAL(std::string("Author A"), entry._messageAuthor);
+
+    // Hot entries don't touch the cold store, unknown ones are filtered out
+    CPPUNIT_ASSERT_EQUAL(true, history.find("http://www.websiteC.com/", entry));
+    CPPUNIT_ASSERT_EQUAL(std::string("Title C"), entry._title);
+    CPPUNIT_ASSERT_EQUAL(false, history.find("http://www.websiteD.com/", entry));
+
+    const UrlArchiveStats stats = archive->getStats();
+    CPPUNIT_ASSERT_EQUAL(std::uint64_t(4), stats._lookupCount);
+    CPPUNIT_ASSERT_EQUAL(std::uint64_t(2), stats._coldHitCount);
+    CPPUNIT_ASSERT_EQUAL(std::uint64_t(1), stats._archivedUrlCount);
+    CPPUNIT_ASSERT_EQUAL(std::uint64_t(3), stats._filterItemCount);
+    CPPUNIT_ASSERT_EQUAL(stats._lookupCount - 3,
+                         stats._avoidedLookupCount + stats._falsePositiveCount);
+}
+
+void UrlArchiveTest::testFilterRebuild()
+{
+    {
+        std::shared_ptr<UrlArchive> archive(new UrlArchive(_archiveDirectoryPath, 1000, 0.01, _bucketCount));
+        CPPUNIT_ASSERT_EQUAL(true, archive->init());
+        UrlHistoryManager history(1, _historyFilePath);
+        history.setArchive(archive);
+        CPPUNIT_ASSERT_EQUAL(true, history.insert("http://www.websiteA.com/", "Title A", "Author A"));
+        CPPUNIT_ASSERT_EQUAL(true, history.insert("http://www.websiteB.com/", "Title B", "Author B"));
+        CPPUNIT_ASSERT_EQUAL(true, archive->flush());
+    }
+
+    // Filter sized differently, archived URLs must be added back
+    UrlArchive archive(_archiveDirectoryPath, 2000, 0.001, _bucketCount);
+    CPPUNIT_ASSERT_EQUAL(true, archive.init());
+    CPPUNIT_ASSERT_EQUAL(true, archive.mightContain(stringutils::formatUrl("http://www.websiteA.com/")));
+    CPPUNIT_ASSERT_EQUAL(std::uint64_t(1), archive.getStats()._filterItemCount);
+    CPPUNIT_ASSERT_EQUAL(true, archive.flush());
+
+    // Matching filter is read as is
+    UrlArchive sameArchive(_archiveDirectoryPath, 2000, 0.001, _bucketCount);
+    CPPUNIT_ASSERT_EQUAL(true, sameArchive.init());
+    CPPUNIT_ASSERT_EQUAL(std::uint64_t(1), sameArchive.getStats()._filterItemCount);
+    UrlHistoryEntry entry;
+    CPPUNIT_ASSERT_EQUAL(true, sameArchive.find(stringutils::formatUrl("http://www.websiteA.com/"), entry));
+    CPPUNIT_ASSERT_EQUAL(std::string("Author A"), entry._messageAuthor);
+}
+
+void UrlArchiveTest::testReload()
+{
+    {
+        std::shared_ptr<UrlArchive> archive(new UrlArchive(_archiveDirectoryPath, 1000, 0.01, _bucketCount));
+        CPPUNIT_ASSERT_EQUAL(true, archive->init());
+        UrlHistoryManager history(2, _historyFilePath);
+        history.setArchive(archive);
+        CPPUNIT_ASSERT_EQUAL(true, history.insert("http://www.websiteA.com/", "Title A", "Author A"));
+        CPPUNIT_ASSERT_EQUAL(true, history.insert("http://www.websiteB.com/", "Title B", "Author B"));
+        CPPUNIT_ASSERT_EQUAL(true, history.insert("http://www.websiteC.com/", "Title C", "Author C"));
+        CPPUNIT_ASSERT_EQUAL(true, history.saveToFile());
+        CPPUNIT_ASSERT_EQUAL(true, archive->flush());
+    }
+
+    // The history is added to the filter again on every start, the count of
+    // URLs it holds must not drift
+    for (size_t restart = 0; restart < 2; ++restart) {
+        std::shared_ptr<UrlArchive> archive(new UrlArchive(_archiveDirectoryPath, 1000, 0.01, _bucketCount));
+        CPPUNIT_ASSERT_EQUAL(true, archive->init());
+        UrlHistoryManager history(2, _historyFilePath);
+        history.setArchive(archive);
+        CPPUNIT_ASSERT_EQUAL(true, history.initFromFile());
+        const UrlArchiveStats stats = archive->getStats();
+        CPPUNIT_ASSERT_EQUAL(std::uint64_t(3), stats._filterItemCount);
+        CPPUNIT_ASSERT(stats._estimatedFalsePositiveRate < 1e-6);
+        CPPUNIT_ASSERT_EQUAL(true, archive->flush());
+    }
+}
+
+void UrlArchiveTest::testRecordIndex()
+{
+    const size_t urlCount = 64;
+    const auto getUrl = [](size_t i) {
+        return stringutils::formatUrl("http://www.website.com/page" + std::to_string(i));
+    };
+    const auto getEntry = [](size_t i, const std::string& author) {
+        UrlHistoryEntry entry;
+        entry._id = i + 1;
+        entry._title = "Title " + std::to_string(i);
+        entry._messageAuthor = author;
+        return entry;
+    };
+
+    // Records are written over two runs, every bucket file is appended to
+    {
+        UrlArchive archive(_archiveDirectoryPath, 1000, 0.01, _bucketCount);
+        CPPUNIT_ASSERT_EQUAL(true, archive.init());
+        for (size_t i = 0; i < urlCount / 2; ++i) {
+            archive.add(getUrl(i));
+            archive.archive(getUrl(i), getEntry(i, "First author"));
+        }
+        CPPUNIT_ASSERT_EQUAL(true, archive.flush());
+    }
+
+    UrlArchive archive(_archiveDirectoryPath, 1000, 0.01, _bucketCount);
+    CPPUNIT_ASSERT_EQUAL(true, archive.init());
+    for (size_t i = urlCount / 4; i < urlCount; ++i) {
+        archive.add(getUrl(i));
+        archive.archive(getUrl(i), getEntry(i, "Second author"));
+    }
+    CPPUNIT_ASSERT_EQUAL(true, archive.flush());
+
+    // Records indexed on startup and on flush are both found, the oldest one
+    // of a URL archived twice first
+    UrlHistoryEntry entry;
+    for (size_t i = 0; i < urlCount; ++i) {
+        CPPUNIT_ASSERT_EQUAL(true, archive.find(getUrl(i), entry));
+        CPPUNIT_ASSERT_EQUAL(std::uint64_t(i + 1), entry._id);
+        CPPUNIT_ASSERT_EQUAL("Title " + std::to_string(i), entry._title);
+        CPPUNIT_ASSERT_EQUAL(std::string(i < urlCount / 2 ? "First author" : "Second author"),
+                             entry._messageAuthor);
+    }
+
+    CPPUNIT_ASSERT_EQUAL(false, archive.find(stringutils::formatUrl("http://www.otherwebsite.com/"), entry));
+    const UrlArchiveStats stats = archive.getStats();
+    CPPUNIT_ASSERT_EQUAL(std::uint64_t(urlCount), stats._coldHitCount);
+    CPPUNIT_ASSERT_EQUAL(std::uint64_t(1), stats._falsePositiveCount);
+}
+
+}
@@ -28,6 +28,7 @@
 #include <fstream>
 
 #include "logger.h"
+#include "stringutils.h"
 #include "urlhistorymanager.h"
 
 namespace geecxx
@@ -46,7 +47,7 @@ void UrlHistoryManagerTest::tearDown()
         // File exists, we need to delete it
         historyFile.close();
         if (0 != remove(_historyFilePath.c_str())) {
-            LOG_ERROR("Unable to remove file: " + _historyFilePath);
+            LOG_ERROR("Unable to remove file: ", _historyFilePath);
         }
     } // else, nothing to clean up
 }
@@ -91,7 +92,8 @@ void UrlHistoryManagerTest::testAll()
         std::string expectedTitle = "Title_" + std::to_string(i);
         UrlHistoryEntry entry;
         CPPUNIT_ASSERT_EQUAL(true, history.find(url, entry));
-        CPPUNIT_ASSERT_EQUAL(i - history.getMaxSize(), entry._id);
+        // Ids keep increasing once the history is full
+        CPPUNIT_ASSERT_EQUAL(std::uint64_t(i), entry._id);
     }
 
     UrlHistoryEntry entry;
@@ -125,6 +127,52 @@ void UrlHistoryManagerTest::testSimilarUrls()
     CPPUNIT_ASSERT_EQUAL(true, history.insert("HTTP://WWW.WEBSITE.COM/resource1", "", ""));
 }
 
+void UrlHistoryManagerTest::testUrlCanonicalization()
+{
+    UrlHistoryManager history;
+
+    CPPUNIT_ASSERT_EQUAL(true, history.insert("HTTP://example.com:80/a/../b?x=%7e", "", ""));
+    CPPUNIT_ASSERT_EQUAL(false, history.insert("example.com/b?x=~", "", ""));
+    CPPUNIT_ASSERT_EQUAL(false, history.insert("https://www.example.com:443/./b?x=%7E#a#b", "", ""));
+    // Not the default port of the scheme
+    CPPUNIT_ASSERT_EQUAL(true, history.insert("https://example.com:80/b?x=~", "", ""));
+    // "#" inside the query starts the fragment
+    CPPUNIT_ASSERT_EQUAL(true, history.insert("http://example.com/c?x=1", "", ""));
+    CPPUNIT_ASSERT_EQUAL(false, history.insert("http://example.com/c?x=1#y=2", "", ""));
+    // "www." is only removed from the beginning of the host
+    CPPUNIT_ASSERT_EQUAL(true, history.insert("http://example.com/www.page", "", ""));
+    CPPUNIT_ASSERT_EQUAL(true, history.insert("http://example.com/page", "", ""));
+
+    const struct
+    {
+        const char* _url;
+        const char* _canonicalUrl;
+    } urls[] = {
+        {"http://www.Example.COM", "example.com/"},
+        {"http://example.com./", "example.com/"},
+        {"www.com", "www.com/"},
+        {"http://user@HOST.com:/", "user@host.com/"},
+        {"https://x.com:0443/p/./q/../r/", "x.com/p/r/"},
+        {"x.com:80/", "x.com:80/"},
+        {"http://[::1]:8080/a?b#c", "[::1]:8080/a?b"},
+        {"http://a.com/../../g", "a.com/g"},
+        {"http://a.com/a/b/c/./../../g", "a.com/a/g"},
+        {"http://a.com/a/b/..", "a.com/a/"},
+        {"http://a.com/a%2fb%41%zz?q=%2a", "a.com/a%2FbA%zz?q=%2A"},
+        {"http://a.com/Caf\xc3\xa9 au lait", "a.com/Caf%C3%A9%20au%20lait"},
+        {"http://b\xc3\xbc" "cher.example/", "xn--bcher-kva.example/"},
+        {"http://M\xc3\x9cNCHEN.de", "xn--mnchen-3ya.de/"},
+        {"http://\xe4\xbe\x8b\xe3\x81\x88.jp/", "xn--r8jz45g.jp/"},
+    };
+    std::string canonicalUrl;
+    for (const auto& url : urls) {
+        stringutils::canonicalizeUrl(url._url, canonicalUrl);
+        CPPUNIT_ASSERT_EQUAL(std::string(url._canonicalUrl), canonicalUrl);
+        // History files hold canonical forms, which are read back
+        CPPUNIT_ASSERT_EQUAL(canonicalUrl, stringutils::formatUrl(canonicalUrl));
+    }
+}
+
 void UrlHistoryManagerTest::testInitFromSaveToFile()
 {
     // History size (== 8) is arbitrary here
@@ -173,4 +221,222 @@ void UrlHistoryManagerTest::testEmptyHistoryFile()
     CPPUNIT_ASSERT_EQUAL(true, history.initFromFile());
 }
 
+void UrlHistoryManagerTest::testStorageRecycling()
+{
+    UrlHistoryManager history(64, _historyFilePath);
+    const std::string urlPrefix = "http://www.website.com/page";
+
+    for (size_t i = 1; i <= history.getMaxSize(); ++i) {
+        CPPUNIT_ASSERT_EQUAL(true, history.insert(urlPrefix + std::to_string(i),
+                                                  "Title_" + std::to_string(i), "Author"));
+    }
+    const size_t storageBytes = history.getStringStorageBytes();
+
+    // Evicted entries give their storage back to the new ones
+    for (size_t i = history.getMaxSize() + 1; i <= 4 * history.getMaxSize(); ++i) {
+        CPPUNIT_ASSERT_EQUAL(true, history.insert(urlPrefix + std::to_string(i),
+                                                  "Title_" + std::to_string(i), "Author"));
+    }
+    CPPUNIT_ASSERT_EQUAL(storageBytes, history.getStringStorageBytes());
+
+    // Entries are still complete after their storage has been recycled
+    UrlHistoryEntry entry;
+    CPPUNIT_ASSERT_EQUAL(true, history.find(urlPrefix + std::to_string(4 * history.getMaxSize()), entry));
+    CPPUNIT_ASSERT_EQUAL(std::string("Title_") + std::to_string(4 * history.getMaxSize()), entry._title);
+    CPPUNIT_ASSERT_EQUAL(std::string("Author"), entry._messageAuthor);
+}
+
+void UrlHistoryManagerTest::testFindById()
+{
+    UrlHistoryManager history(4, _historyFilePath);
+    const std::string urlPrefix = "http://www.website.com/page";
+
+    for (size_t i = 1; i <= 10; ++i) {
+        CPPUNIT_ASSERT_EQUAL(true, history.insert(urlPrefix + std::to_string(i),
+                                                  "Title_" + std::to_string(i), "Author"));
+    }
+
+    // Evicted entries must not be found
+    UrlHistoryRecord record;
+    for (std::uint64_t id = 1; id <= 6; ++id) {
+        CPPUNIT_ASSERT_EQUAL(false, history.findById(id, record));
+    }
+    for (std::uint64_t id = 7; id <= 10; ++id) {
+        CPPUNIT_ASSERT_EQUAL(true, history.findById(id, record));
+        CPPUNIT_ASSERT_EQUAL(id, record._entry._id);
+        CPPUNIT_ASSERT_EQUAL(std::string("Title_") + std::to_string(id), record._entry._title);
+        UrlHistoryEntry entry;
+        CPPUNIT_ASSERT_EQUAL(true, history.find(record._url, entry));
+        CPPUNIT_ASSERT_EQUAL(id, entry._id);
+    }
+    CPPUNIT_ASSERT_EQUAL(false, history.findById(11, record));
+
+    // Ids survive a save/load cycle, new ones follow them
+    CPPUNIT_ASSERT_EQUAL(true, history.saveToFile());
+    UrlHistoryManager readHistory(4, _historyFilePath);
+    CPPUNIT_ASSERT_EQUAL(true, readHistory.initFromFile());
+    CPPUNIT_ASSERT_EQUAL(true, readHistory.findById(7, record));
+    CPPUNIT_ASSERT_EQUAL(std::string("Title_7"), record._entry._title);
+    UrlHistoryEntry entry;
+    CPPUNIT_ASSERT_EQUAL(true, readHistory.insert(urlPrefix + "11", "Title_11", "Author", entry));
+    CPPUNIT_ASSERT_EQUAL(std::uint64_t(11), entry._id);
+
+    // Ids are stored on 32 bits
+    record._url = urlPrefix + "12";
+    record._entry._id = UINT32_MAX;
+    CPPUNIT_ASSERT_EQUAL(true, readHistory.insertRecord(record));
+    CPPUNIT_ASSERT_EQUAL(true, readHistory.findById(UINT32_MAX, record));
+    record._url = urlPrefix + "13";
+    record._entry._id = std::uint64_t(UINT32_MAX) + 1;
+    CPPUNIT_ASSERT_EQUAL(false, readHistory.insertRecord(record));
+}
+
+void UrlHistoryManagerTest::testLegacyHistoryFile()
+{
+    {
+        // Format used before ids were saved: url, title, author
+        std::ofstream historyFile(_historyFilePath);
+        historyFile << "website.com/a\nTitle A\nAuthor A\n";
+        historyFile << "website.com/b\nTitle B\nAuthor B\n";
+    }
+
+    UrlHistoryManager history(8, _historyFilePath);
+    CPPUNIT_ASSERT_EQUAL(true, history.initFromFile());
+    CPPUNIT_ASSERT_EQUAL(size_t(2), history.getSize());
+
+    UrlHistoryEntry entry;
+    CPPUNIT_ASSERT_EQUAL(true, history.find("http://www.website.com/b", entry));
+    CPPUNIT_ASSERT_EQUAL(std::uint64_t(2), entry._id);
+    CPPUNIT_ASSERT_EQUAL(std::string("Author B"), entry._messageAuthor);
+    CPPUNIT_ASSERT_EQUAL(true, history.insert("http://www.website.com/c", "Title C", "Author C", entry));
+    CPPUNIT_ASSERT_EQUAL(std::uint64_t(3), entry._id);
+}
+
+void UrlHistoryManagerTest::testLegacyDuplicateUrls()
+{
+    {
+        // Written before URLs were canonicalized: both spellings were kept
+        std::ofstream historyFile(_historyFilePath);
+        historyFile << "#geecxx-url-history 3\n";
+        historyFile << "1 1000 1500\nwebsite.com/b?x=%7e\nTitle B\nAuthor 1\n";
+        historyFile << "2 2000 3000\nwebsite.com/b?x=~\nTitle B\nAuthor 2\n";
+        historyFile << "3 2500 2500\nwebsite.com/c\nTitle C\nAuthor 3\n";
+    }
+
+    UrlHistoryManager history(8, _historyFilePath);
+    CPPUNIT_ASSERT_EQUAL(true, history.initFromFile());
+    CPPUNIT_ASSERT_EQUAL(size_t(2), history.getSize());
+
+    // The oldest entry is kept, it was last seen with the newest one
+    UrlHistoryEntry entry;
+    CPPUNIT_ASSERT_EQUAL(true, history.find("http://website.com/b?x=~", entry));
+    CPPUNIT_ASSERT_EQUAL(std::uint64_t(1), entry._id);
+    CPPUNIT_ASSERT_EQUAL(std::string("Author 1"), entry._messageAuthor);
+    CPPUNIT_ASSERT_EQUAL(std::time_t(1000), entry._insertionTime);
+    CPPUNIT_ASSERT_EQUAL(std::time_t(3000), entry._lastSeenTime);
+    UrlHistoryRecord record;
+    CPPUNIT_ASSERT_EQUAL(false, history.findById(2, record));
+    CPPUNIT_ASSERT_EQUAL(true, history.findById(3, record));
+
+    // The id of the merged entry isn't reused
+    CPPUNIT_ASSERT_EQUAL(true, history.insert("http://website.com/d", "Title D", "Author 4", entry));
+    CPPUNIT_ASSERT_EQUAL(std::uint64_t(4), entry._id);
+}
+
+void UrlHistoryManagerTest::testExpiry()
+{
+    UrlHistoryManager history(8, _historyFilePath);
+    std::time_t currentTime = 1000000;
+    history.setClock([&currentTime]() {
+        return currentTime;
+    });
+    history.setMaxAge(100);
+    const std::string urlPrefix = "http://www.website.com/page";
+
+    UrlHistoryEntry entry;
+    for (size_t i = 1; i <= 4; ++i) {
+        CPPUNIT_ASSERT_EQUAL(true, history.insert(urlPrefix + std::to_string(i),
+                                                  "Title_" + std::to_string(i), "Author", entry));
+        CPPUNIT_ASSERT_EQUAL(currentTime, entry._insertionTime);
+        currentTime += 10;
+    }
+    CPPUNIT_ASSERT_EQUAL(currentTime, history.now());
+
+    // Page 1 posted again: its expiry is pushed back, not its insertion time
+    CPPUNIT_ASSERT_EQUAL(true, history.markSeen(urlPrefix + "1"));
+    currentTime = 1000000 + 125;
+    CPPUNIT_ASSERT_EQUAL(size_t(2), history.expire());
+    CPPUNIT_ASSERT_EQUAL(size_t(2), history.getSize());
+    CPPUNIT_ASSERT_EQUAL(false, history.find(urlPrefix + "2", entry));
+    CPPUNIT_ASSERT_EQUAL(false, history.find(urlPrefix + "3", entry));
+    CPPUNIT_ASSERT_EQUAL(true, history.find(urlPrefix + "1", entry));
+    CPPUNIT_ASSERT_EQUAL(std::time_t(1000000), entry._insertionTime);
+    CPPUNIT_ASSERT_EQUAL(std::time_t(1000040), entry._lastSeenTime);
+
+    // Removed places are reused, times survive a save/load cycle
+    for (size_t i = 5; i <= 14; ++i) {
+        CPPUNIT_ASSERT_EQUAL(true, history.insert(urlPrefix + std::to_string(i),
+                                                  "Title_" + std::to_string(i), "Author"));
+    }
+    CPPUNIT_ASSERT_EQUAL(history.getMaxSize(), history.getSize());
+    CPPUNIT_ASSERT_EQUAL(true, history.find(urlPrefix + "14", entry));
+    CPPUNIT_ASSERT_EQUAL(true, history.saveToFile());
+    UrlHistoryManager readHistory(8, _historyFilePath);
+    CPPUNIT_ASSERT_EQUAL(true, readHistory.initFromFile());
+    UrlHistoryEntry readEntry;
+    CPPUNIT_ASSERT_EQUAL(true, readHistory.find(urlPrefix + "14", readEntry));
+    CPPUNIT_ASSERT_EQUAL(entry._insertionTime, readEntry._insertionTime);
+    CPPUNIT_ASSERT_EQUAL(entry._lastSeenTime, readEntry._lastSeenTime);
+
+    // Everything expires eventually
+    currentTime += 1000;
+    CPPUNIT_ASSERT_EQUAL(history.getMaxSize(), history.expire());
+    CPPUNIT_ASSERT_EQUAL(size_t(0), history.getSize());
+    CPPUNIT_ASSERT_EQUAL(size_t(0), history.expire());
+}
+
+void UrlHistoryManagerTest::testExpiryAfterCompaction()
+{
+    UrlHistoryManager history(4, _historyFilePath);
+    std::time_t currentTime = 1000000;
+    history.setClock([&currentTime]() {
+        return currentTime;
+    });
+    history.setMaxAge(100);
+    const std::string urlPrefix = "http://www.website.com/page";
+
+    CPPUNIT_ASSERT_EQUAL(true, history.insert(urlPrefix + "1", "Title_1", "Author"));
+    CPPUNIT_ASSERT_EQUAL(true, history.insert(urlPrefix + "2", "Title_2", "Author"));
+    currentTime += 50;
+    CPPUNIT_ASSERT_EQUAL(true, history.insert(urlPrefix + "3", "Title_3", "Author"));
+    CPPUNIT_ASSERT_EQUAL(true, history.insert(urlPrefix + "4", "Title_4", "Author"));
+    CPPUNIT_ASSERT_EQUAL(true, history.markSeen(urlPrefix + "1"));
+
+    // Only the entry in the middle expires, the next insertion compacts the
+    // history: live ids now span more than its maximum size
+    currentTime += 51;
+    CPPUNIT_ASSERT_EQUAL(size_t(1), history.expire());
+    CPPUNIT_ASSERT_EQUAL(true, history.insert(urlPrefix + "5", "Title_5", "Author"));
+    CPPUNIT_ASSERT_EQUAL(size_t(4), history.getSize());
+
+    UrlHistoryRecord record;
+    UrlHistoryEntry entry;
+    CPPUNIT_ASSERT_EQUAL(false, history.findById(2, record));
+    for (std::uint64_t id : {1, 3, 4, 5}) {
+        CPPUNIT_ASSERT_EQUAL(true, history.findById(id, record));
+        CPPUNIT_ASSERT_EQUAL(std::string("Title_") + std::to_string(id), record._entry._title);
+        CPPUNIT_ASSERT_EQUAL(true, history.find(record._url, entry));
+        CPPUNIT_ASSERT_EQUAL(id, entry._id);
+    }
+
+    // Survivors still expire, each on time
+    currentTime = 1000000 + 151;
+    CPPUNIT_ASSERT_EQUAL(size_t(3), history.expire());
+    CPPUNIT_ASSERT_EQUAL(false, history.find(urlPrefix + "1", entry));
+    CPPUNIT_ASSERT_EQUAL(true, history.findById(5, record));
+    currentTime = 1000000 + 202;
+    CPPUNIT_ASSERT_EQUAL(size_t(1), history.expire());
+    CPPUNIT_ASSERT_EQUAL(size_t(0), history.getSize());
+}
+
 }
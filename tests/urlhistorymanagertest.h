@@ -38,8 +38,15 @@ class UrlHistoryManagerTest : public CPPUNIT_NS::TestFixture
     CPPUNIT_TEST_SUITE(UrlHistoryManagerTest);
     CPPUNIT_TEST(testAll);
     CPPUNIT_TEST(testSimilarUrls);
+    CPPUNIT_TEST(testUrlCanonicalization);
     CPPUNIT_TEST(testInitFromSaveToFile);
     CPPUNIT_TEST(testEmptyHistoryFile);
+    CPPUNIT_TEST(testStorageRecycling);
+    CPPUNIT_TEST(testFindById);
+    CPPUNIT_TEST(testLegacyHistoryFile);
+    CPPUNIT_TEST(testLegacyDuplicateUrls);
+    CPPUNIT_TEST(testExpiry);
+    CPPUNIT_TEST(testExpiryAfterCompaction);
     CPPUNIT_TEST_SUITE_END();
 
 public:
@@ -52,8 +59,15 @@ public:
     // Actual tests
     void testAll();
     void testSimilarUrls();
+    void testUrlCanonicalization();
     void testInitFromSaveToFile();
     void testEmptyHistoryFile();
+    void testStorageRecycling();
+    void testFindById();
+    void testLegacyHistoryFile();
+    void testLegacyDuplicateUrls();
+    void testExpiry();
+    void testExpiryAfterCompaction();
 private:
     const std::string _historyFilePath = std::string(GEECXX_TEST_DATA_DIR) + "url-history-test.txt";
 };
@@ -0,0 +1,258 @@
+/*
+ * Copyright (c) 2015, Romain Létendart
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "urlrewritertest.h"
+
+#include <cstdio>
+#include <memory>
+#include <sstream>
+
+#include "shardedurlhistorymanager.h"
+#include "stringutils.h"
+#include "urlhistorymanager.h"
+#include "urlrewriter.h"
+
+namespace geecxx
+{
+
+CPPUNIT_TEST_SUITE_REGISTRATION(UrlRewriterTest);
+
+namespace
+{
+
+bool loadRules(UrlRewriter& rewriter, const std::string& rules)
+{
+    std::istringstream input(rules);
+    return rewriter.load(input, "test");
+}
+
+/**
+ * Rewrite a URL once formatted, and check that rewriting the result again
+ * leaves it unchanged
+ *
+ * @return rewritten URL, the formatted one if no rule matched
+ */
+std::string rewrite(const UrlRewriter& rewriter, const std::string& url)
+{
+    const std::string formattedUrl = stringutils::formatUrl(url);
+    std::string output;
+    if (!rewriter.rewrite(formattedUrl, output)) {
+        return formattedUrl;
+    }
+    std::string secondOutput;
+    if (rewriter.rewrite(output, secondOutput)) {
+        CPPUNIT_ASSERT_EQUAL(output, secondOutput);
+    }
+    return output;
+}
+
+}
+
+void UrlRewriterTest::setUp()
+{
+}
+
+void UrlRewriterTest::tearDown()
+{
+}
+
+// Actual tests
+void UrlRewriterTest::testLoad()
+{
+    UrlRewriter rewriter;
+    CPPUNIT_ASSERT_EQUAL(size_t(0), rewriter.getRuleCount());
+    CPPUNIT_ASSERT_EQUAL(true, loadRules(rewriter, "# Comment\n"
+                                                   "\n"
+                                                   "  * strip-params utm_*\n"
+                                                   "example.com\thost example.org\n"));
+    CPPUNIT_ASSERT_EQUAL(size_t(2), rewriter.getRuleCount());
+
+    // Invalid rules leave the previous ones in place
+    const char* invalidRules[] = {
+        "example.com\n",
+        "example.com rename example.org\n",
+        "example.com host\n",
+        "example.com host a b\n",
+        "example.com strip-params\n",
+        "*example.com host example.org\n",
+        "*. host example.org\n",
+        "example..com host example.org\n",
+        "* strip-params a\nexample.com\n",
+    };
+    for (const char* rules : invalidRules) {
+        CPPUNIT_ASSERT_EQUAL_MESSAGE(rules, false, loadRules(rewriter, rules));
+        CPPUNIT_ASSERT_EQUAL(size_t(2), rewriter.getRuleCount());
+    }
+    CPPUNIT_ASSERT_EQUAL(false, rewriter.loadFromFile(std::string(GEECXX_TEST_DATA_DIR) + "missing.rules"));
+    CPPUNIT_ASSERT_EQUAL(size_t(2), rewriter.getRuleCount());
+
+    CPPUNIT_ASSERT_EQUAL(true, loadRules(rewriter, ""));
+    CPPUNIT_ASSERT_EQUAL(size_t(0), rewriter.getRuleCount());
+    std::string output;
+    CPPUNIT_ASSERT_EQUAL(false, rewriter.rewrite("example.com/", output));
+}
+
+void UrlRewriterTest::testHostPatterns()
+{
+    UrlRewriter rewriter;
+    CPPUNIT_ASSERT_EQUAL(true, loadRules(rewriter, "example.com path exact\n"
+                                                   "*.example.com path sub-{sub}\n"
+                                                   "*.b.example.com path deep-{sub}\n"
+                                                   "EXAMPLE.net. path case\n"));
+    CPPUNIT_ASSERT_EQUAL(std::string("example.com/exact"), rewrite(rewriter, "example.com/a"));
+    CPPUNIT_ASSERT_EQUAL(std::string("a.example.com/sub-a"), rewrite(rewriter, "a.example.com/a"));
+    CPPUNIT_ASSERT_EQUAL(std::string("b.example.com/sub-b"), rewrite(rewriter, "b.example.com/a"));
+    // Both patterns match, the last rule wins
+    CPPUNIT_ASSERT_EQUAL(std::string("x.b.example.com/deep-x"), rewrite(rewriter, "x.b.example.com/a"));
+    CPPUNIT_ASSERT_EQUAL(std::string("x.y.a.example.com/sub-x.y.a"), rewrite(rewriter, "x.y.a.example.com/"));
+    CPPUNIT_ASSERT_EQUAL(std::string("example.net/case"), rewrite(rewriter, "example.net"));
+    // Ports and user info aren't part of the host
+    CPPUNIT_ASSERT_EQUAL(std::string("user@example.com:8080/exact"), rewrite(rewriter, "user@example.com:8080/a"));
+    // Labels must match entirely
+    CPPUNIT_ASSERT_EQUAL(std::string("anexample.com/a"), rewrite(rewriter, "anexample.com/a"));
+    CPPUNIT_ASSERT_EQUAL(std::string("example.com.au/a"), rewrite(rewriter, "example.com.au/a"));
+    CPPUNIT_ASSERT_EQUAL(std::string("com/a"), rewrite(rewriter, "com/a"));
+
+    CPPUNIT_ASSERT_EQUAL(true, loadRules(rewriter, "* path any\n"));
+    CPPUNIT_ASSERT_EQUAL(std::string("example.org/any"), rewrite(rewriter, "example.org/a"));
+    CPPUNIT_ASSERT_EQUAL(std::string("[::1]:80/any"), rewrite(rewriter, "[::1]:80/a"));
+}
+
+void UrlRewriterTest::testActions()
+{
+    UrlRewriter rewriter;
+    CPPUNIT_ASSERT_EQUAL(true, loadRules(rewriter, "* strip-params utm_* fbclid\n"
+                                                   "keep.com keep-params v list\n"
+                                                   "amp.com strip-path-segments amp amp.html\n"));
+    CPPUNIT_ASSERT_EQUAL(std::string("a.com/p?b=1&c"), rewrite(rewriter, "a.com/p?utm_source=x&b=1&fbclid=y&c&utm_=z"));
+    CPPUNIT_ASSERT_EQUAL(std::string("a.com/p"), rewrite(rewriter, "a.com/p?utm_source=x&fbclid"));
+    // Names match entirely, unless they end with '*'
+    CPPUNIT_ASSERT_EQUAL(std::string("a.com/p?fbclid2=1&utm=2"), rewrite(rewriter, "a.com/p?fbclid2=1&utm=2"));
+    CPPUNIT_ASSERT_EQUAL(std::string("a.com/p"), rewrite(rewriter, "a.com/p?"));
+
+    CPPUNIT_ASSERT_EQUAL(std::string("keep.com/w?v=1&list=2"), rewrite(rewriter, "keep.com/w?feature=x&v=1&t=3&list=2"));
+    CPPUNIT_ASSERT_EQUAL(std::string("keep.com/w"), rewrite(rewriter, "keep.com/w?feature=x"));
+
+    CPPUNIT_ASSERT_EQUAL(std::string("amp.com/news/1"), rewrite(rewriter, "amp.com/amp/news/1/amp.html"));
+    CPPUNIT_ASSERT_EQUAL(std::string("amp.com/news/amplified/"), rewrite(rewriter, "amp.com/news/amp/amplified/"));
+    CPPUNIT_ASSERT_EQUAL(std::string("amp.com/?q=amp"), rewrite(rewriter, "amp.com/amp?q=amp"));
+}
+
+void UrlRewriterTest::testTemplates()
+{
+    UrlRewriter rewriter;
+    CPPUNIT_ASSERT_EQUAL(true, loadRules(rewriter, "short.com url long.com/watch?v={path1}\n"
+                                                   "*.mobile.com host {sub}.com\n"
+                                                   "path.com path v/{path2+}\n"
+                                                   "query.com url search.com/?{query}\n"
+                                                   "param.com url param.com/?id={param:id}\n"
+                                                   "cdn.com url {path2+}\n"));
+    CPPUNIT_ASSERT_EQUAL(std::string("long.com/watch?v=abc"), rewrite(rewriter, "https://short.com/abc?t=1"));
+    CPPUNIT_ASSERT_EQUAL(std::string("fr.com/x"), rewrite(rewriter, "fr.mobile.com/x"));
+    CPPUNIT_ASSERT_EQUAL(std::string("path.com/v/b/c/d?q=1"), rewrite(rewriter, "path.com/a/b/c/d?q=1"));
+    CPPUNIT_ASSERT_EQUAL(std::string("search.com/?q=1&r"), rewrite(rewriter, "query.com/p?q=1&r"));
+    CPPUNIT_ASSERT_EQUAL(std::string("param.com/?id=42"), rewrite(rewriter, "param.com/page?x=1&id=42"));
+    // Results are formatted
+    CPPUNIT_ASSERT_EQUAL(std::string("example.com/a"), rewrite(rewriter, "cdn.com/c/WWW.Example.COM/a#f"));
+}
+
+void UrlRewriterTest::testDefaultRules()
+{
+    UrlRewriter rewriter;
+    CPPUNIT_ASSERT_EQUAL(true, rewriter.loadFromFile(_rulesFilePath));
+
+    const struct
+    {
+        const char* _url;
+        const char* _rewrittenUrl;
+    } urls[] = {
+        {"https://youtu.be/dQw4w9WgXcQ?t=42", "youtube.com/watch?v=dQw4w9WgXcQ"},
+        {"https://m.youtube.com/watch?v=dQw4w9WgXcQ&feature=share", "youtube.com/watch?v=dQw4w9WgXcQ"},
+        {"https://www.youtube.com/watch?v=dQw4w9WgXcQ&list=PL1", "youtube.com/watch?v=dQw4w9WgXcQ&list=PL1"},
+        {"https://en.m.wikipedia.org/wiki/C%2B%2B", "en.wikipedia.org/wiki/C%2B%2B"},
+        {"https://mobile.twitter.com/user/status/1", "twitter.com/user/status/1"},
+        {"https://www-example-com.cdn.ampproject.org/c/s/www.example.com/article?amp=1", "example.com/article"},
+        {"http://example.com/a?utm_source=irc&utm_medium=chat&b=1&gclid=x", "example.com/a?b=1"},
+        {"http://example.com/a?fbclid=x", "example.com/a"},
+        {"http://example.com/a?b=1", "example.com/a?b=1"},
+    };
+    for (const auto& url : urls) {
+        CPPUNIT_ASSERT_EQUAL_MESSAGE(url._url, std::string(url._rewrittenUrl), rewrite(rewriter, url._url));
+    }
+}
+
+void UrlRewriterTest::testHistory()
+{
+    std::shared_ptr<UrlRewriter> rewriter = std::make_shared<UrlRewriter>();
+    CPPUNIT_ASSERT_EQUAL(true, loadRules(*rewriter, "* strip-params utm_*\n"
+                                                    "youtu.be url youtube.com/watch?v={path1}\n"));
+    UrlHistoryManager history;
+    history.setRewriter(rewriter);
+
+    CPPUNIT_ASSERT_EQUAL(true, history.insert("https://www.youtube.com/watch?v=abc", "Title", "author"));
+    CPPUNIT_ASSERT_EQUAL(false, history.insert("https://youtu.be/abc?utm_source=share", "Title", "author"));
+    UrlHistoryEntry entry;
+    CPPUNIT_ASSERT_EQUAL(true, history.find("youtu.be/abc", entry));
+    CPPUNIT_ASSERT_EQUAL(std::string("Title"), entry._title);
+    CPPUNIT_ASSERT_EQUAL(false, history.find("youtu.be/abd", entry));
+
+    history.setRewriter(nullptr);
+    CPPUNIT_ASSERT_EQUAL(false, history.find("youtu.be/abc", entry));
+}
+
+void UrlRewriterTest::testHistoryFileUnderNewRule()
+{
+    const std::string historyFilePath = std::string(GEECXX_TEST_DATA_DIR) + "url-rewriter-history-test.txt";
+    {
+        // Saved before the rule was added: both URLs were kept
+        UrlHistoryManager history(8, historyFilePath);
+        CPPUNIT_ASSERT_EQUAL(true, history.insert("https://example.com/a?utm_source=feed", "Title", "author1"));
+        CPPUNIT_ASSERT_EQUAL(true, history.insert("https://example.com/a?utm_source=share", "Title", "author2"));
+        CPPUNIT_ASSERT_EQUAL(true, history.insert("https://example.com/b", "Title B", "author3"));
+        CPPUNIT_ASSERT_EQUAL(true, history.saveToFile());
+    }
+
+    std::shared_ptr<UrlRewriter> rewriter = std::make_shared<UrlRewriter>();
+    CPPUNIT_ASSERT_EQUAL(true, loadRules(*rewriter, "* strip-params utm_*\n"));
+
+    UrlHistoryManager history(8, historyFilePath);
+    history.setRewriter(rewriter);
+    CPPUNIT_ASSERT_EQUAL(true, history.initFromFile());
+    CPPUNIT_ASSERT_EQUAL(size_t(2), history.getSize());
+    UrlHistoryEntry entry;
+    CPPUNIT_ASSERT_EQUAL(true, history.find("https://example.com/a", entry));
+    CPPUNIT_ASSERT_EQUAL(std::uint64_t(1), entry._id);
+    CPPUNIT_ASSERT_EQUAL(std::string("author1"), entry._messageAuthor);
+
+    ShardedUrlHistoryManager shardedHistory(8, 4, historyFilePath);
+    shardedHistory.setRewriter(rewriter);
+    CPPUNIT_ASSERT_EQUAL(true, shardedHistory.initFromFile());
+    CPPUNIT_ASSERT_EQUAL(size_t(2), shardedHistory.getSize());
+    CPPUNIT_ASSERT_EQUAL(true, shardedHistory.find("https://example.com/a?utm_medium=x", entry));
+    CPPUNIT_ASSERT_EQUAL(std::uint64_t(1), entry._id);
+
+    std::remove(historyFilePath.c_str());
+}
+
+}
@@ -0,0 +1,68 @@
+/*
+ * Copyright (c) 2015, Romain Létendart
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#pragma once
+
+#include "testconfig.h"
+
+#include <cppunit/extensions/HelperMacros.h>
+#include <cppunit/TestFixture.h>
+#include <string>
+
+namespace geecxx
+{
+
+class UrlRewriterTest : public CPPUNIT_NS::TestFixture
+{
+    CPPUNIT_TEST_SUITE(UrlRewriterTest);
+    CPPUNIT_TEST(testLoad);
+    CPPUNIT_TEST(testHostPatterns);
+    CPPUNIT_TEST(testActions);
+    CPPUNIT_TEST(testTemplates);
+    CPPUNIT_TEST(testDefaultRules);
+    CPPUNIT_TEST(testHistory);
+    CPPUNIT_TEST(testHistoryFileUnderNewRule);
+    CPPUNIT_TEST_SUITE_END();
+
+public:
+    UrlRewriterTest() = default;
+    ~UrlRewriterTest() = default;
+
+    void setUp();
+    void tearDown();
+
+    // Actual tests
+    void testLoad();
+    void testHostPatterns();
+    void testActions();
+    void testTemplates();
+    void testDefaultRules();
+    void testHistory();
+    void testHistoryFileUnderNewRule();
+
+private:
+    const std::string _rulesFilePath = std::string(GEECXX_SOURCE_CONF_DIR) + "url-rewrite.rules";
+};
+
+}
@@ -0,0 +1,232 @@
+/*
+ * Copyright (c) 2015, Romain Létendart
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "webinforetrievertest.h"
+
+#include <chrono>
+#include <string>
+
+#include "testconfig.h"
+#include "webinforetriever.h"
+
+namespace geecxx
+{
+
+CPPUNIT_TEST_SUITE_REGISTRATION(WebInfoRetrieverTest);
+
+void WebInfoRetrieverTest::setUp()
+{
+    WebInfoRetriever::getInstance().setTimeout(std::chrono::milliseconds(2000));
+    _server.reset(new HttpStubServer());
+    CPPUNIT_ASSERT(_server->start());
+}
+
+void WebInfoRetrieverTest::tearDown()
+{
+    _server.reset();
+    WebInfoRetriever::getInstance().setTimeout(std::chrono::milliseconds(15000));
+    WebInfoRetriever::getInstance().setCaFilePath(GEECXX_CONF_DIR "ca-bundle.crt");
+}
+
+// Actual tests
+void WebInfoRetrieverTest::testTitle()
+{
+    HttpStubPage page;
+    page._body = HttpStubServer::makeHtml("Stub page");
+    _server->setPage("/page", page);
+    page._body = "<html><head></head><body>No title</body></html>";
+    _server->setPage("/untitled", page);
+
+    std::string title;
+    CPPUNIT_ASSERT(WebInfoRetriever::getInstance().retrievePageTitle(_server->getUrl("/page?id=1"), title));
+    CPPUNIT_ASSERT_EQUAL(std::string("Stub page"), title);
+    // HEAD, then GET
+    CPPUNIT_ASSERT_EQUAL(size_t(2), _server->getRequestCount());
+
+    CPPUNIT_ASSERT(WebInfoRetriever::getInstance().retrievePageTitle(_server->getUrl("/untitled"), title));
+    CPPUNIT_ASSERT_EQUAL(std::string(), title);
+}
+
+void WebInfoRetrieverTest::testTitlePosition()
+{
+    HttpStubPage page;
+    page._body = HttpStubServer::makeHtml("\n  Far &amp;   <TITLE>-like\t title ", 100000, 1000000);
+    _server->setPage("/far", page);
+    page._body = HttpStubServer::makeHtml("Upper case");
+    page._body.replace(page._body.find("<title>"), 7, "<TITLE>");
+    page._body.replace(page._body.find("</title>"), 8, "</TiTlE>");
+    _server->setPage("/upper", page);
+
+    std::string title;
+    CPPUNIT_ASSERT(WebInfoRetriever::getInstance().retrievePageTitle(_server->getUrl("/far"), title));
+    CPPUNIT_ASSERT_EQUAL(std::string("Far & <TITLE>-like title"), title);
+    CPPUNIT_ASSERT(WebInfoRetriever::getInstance().retrievePageTitle(_server->getUrl("/upper"), title));
+    CPPUNIT_ASSERT_EQUAL(std::string("Upper case"), title);
+}
+
+void WebInfoRetrieverTest::testChunked()
+{
+    HttpStubPage page;
+    page._body = HttpStubServer::makeHtml("Chunked page", 5000, 20000);
+    page._chunked = true;
+    page._dripSize = 1000;
+    _server->setPage("/chunked", page);
+
+    std::string title;
+    CPPUNIT_ASSERT(WebInfoRetriever::getInstance().retrievePageTitle(_server->getUrl("/chunked"), title));
+    CPPUNIT_ASSERT_EQUAL(std::string("Chunked page"), title);
+}
+
+void WebInfoRetrieverTest::testRedirects()
+{
+    HttpStubPage page;
+    page._body = HttpStubServer::makeHtml("Final page");
+    _server->setPage("/final", page);
+    HttpStubPage redirect;
+    redirect._contentType.clear();
+    redirect._statusCode = 301;
+    redirect._location = "/final";
+    _server->setPage("/r3", redirect);
+    redirect._statusCode = 302;
+    redirect._location = _server->getUrl("/r3");
+    _server->setPage("/r2", redirect);
+    redirect._statusCode = 307;
+    redirect._location = "/r2";
+    _server->setPage("/r1", redirect);
+
+    std::string title;
+    CPPUNIT_ASSERT(WebInfoRetriever::getInstance().retrievePageTitle(_server->getUrl("/r1"), title));
+    CPPUNIT_ASSERT_EQUAL(std::string("Final page"), title);
+    // Both requests follow the chain
+    CPPUNIT_ASSERT_EQUAL(size_t(8), _server->getRequestCount());
+}
+
+void WebInfoRetrieverTest::testSlowDrip()
+{
+    HttpStubPage page;
+    page._body = HttpStubServer::makeHtml("Slow page", 0, 2000);
+    page._dripSize = 200;
+    page._dripInterval = std::chrono::milliseconds(20);
+    _server->setPage("/slow", page);
+
+    std::string title;
+    CPPUNIT_ASSERT(WebInfoRetriever::getInstance().retrievePageTitle(_server->getUrl("/slow"), title));
+    CPPUNIT_ASSERT_EQUAL(std::string("Slow page"), title);
+
+    // The whole body is waited for, even once the title is there
+    WebInfoRetriever::getInstance().setTimeout(std::chrono::milliseconds(100));
+    CPPUNIT_ASSERT(!WebInfoRetriever::getInstance().retrievePageTitle(_server->getUrl("/slow"), title));
+}
+
+void WebInfoRetrieverTest::testStall()
+{
+    HttpStubPage page;
+    page._stall = true;
+    _server->setPage("/stall", page);
+
+    WebInfoRetriever::getInstance().setTimeout(std::chrono::milliseconds(200));
+    const auto start = std::chrono::steady_clock::now();
+    std::string title;
+    CPPUNIT_ASSERT(!WebInfoRetriever::getInstance().retrievePageTitle(_server->getUrl("/stall"), title));
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+    CPPUNIT_ASSERT(elapsed >= std::chrono::milliseconds(200));
+    CPPUNIT_ASSERT(elapsed < std::chrono::milliseconds(1500));
+}
+
+void WebInfoRetrieverTest::testContentType()
+{
+    HttpStubPage page;
+    page._body = HttpStubServer::makeHtml("Not HTML");
+    page._contentType = "application/json";
+    _server->setPage("/json", page);
+    page._contentType = "text/plain";
+    _server->setPage("/text", page);
+    page._contentType.clear();
+    _server->setPage("/none", page);
+    page._contentType = "text/html";
+    _server->setPage("/html", page);
+
+    // Only the headers are retrieved
+    std::string title;
+    CPPUNIT_ASSERT(!WebInfoRetriever::getInstance().retrievePageTitle(_server->getUrl("/json"), title));
+    CPPUNIT_ASSERT(!WebInfoRetriever::getInstance().retrievePageTitle(_server->getUrl("/text"), title));
+    CPPUNIT_ASSERT(!WebInfoRetriever::getInstance().retrievePageTitle(_server->getUrl("/none"), title));
+    CPPUNIT_ASSERT_EQUAL(size_t(3), _server->getRequestCount());
+    CPPUNIT_ASSERT(WebInfoRetriever::getInstance().retrievePageTitle(_server->getUrl("/html"), title));
+    CPPUNIT_ASSERT_EQUAL(std::string("Not HTML"), title);
+}
+
+void WebInfoRetrieverTest::testStatusCodes()
+{
+    const std::pair<int, const char*> statusCodes[] = {
+        {400, "HTTP 400 - Bad Request"},
+        {401, "HTTP 401 - Unauthorized"},
+        {403, "HTTP 403 - Forbidden"},
+        {404, "HTTP 404 - Not Found"},
+        {418, "HTTP 418 - No description available"},
+        {429, "HTTP 429 - Too many requests"},
+        {500, "HTTP 500 - Internal Server Error"},
+        {502, "HTTP 502 - Bad Gateway"},
+        {503, "HTTP 503 - Service Unavailable"},
+        {504, "HTTP 504 - Gateway Timeout"},
+    };
+    for (const auto& statusCode : statusCodes) {
+        HttpStubPage page;
+        page._statusCode = statusCode.first;
+        page._body = HttpStubServer::makeHtml("Error page");
+        const std::string path = "/" + std::to_string(statusCode.first);
+        _server->setPage(path, page);
+
+        std::string title;
+        CPPUNIT_ASSERT(WebInfoRetriever::getInstance().retrievePageTitle(_server->getUrl(path), title));
+        CPPUNIT_ASSERT_EQUAL(std::string(statusCode.second), title);
+    }
+    // Errors which aren't HTML pages aren't reported
+    HttpStubPage page;
+    page._statusCode = 500;
+    page._contentType = "text/plain";
+    _server->setPage("/500", page);
+    std::string title;
+    CPPUNIT_ASSERT(!WebInfoRetriever::getInstance().retrievePageTitle(_server->getUrl("/500"), title));
+}
+
+void WebInfoRetrieverTest::testHttps()
+{
+    HttpStubServer server(GEECXX_SOURCE_TEST_DATA_DIR);
+    CPPUNIT_ASSERT(server.start());
+    HttpStubPage page;
+    page._body = HttpStubServer::makeHtml("Secure page");
+    server.setPage("/secure", page);
+
+    // Certificate signed by another CA
+    WebInfoRetriever::getInstance().setCaFilePath(GEECXX_SOURCE_TEST_DATA_DIR "stub-other-ca.pem");
+    std::string title;
+    CPPUNIT_ASSERT(!WebInfoRetriever::getInstance().retrievePageTitle(server.getUrl("/secure"), title));
+
+    WebInfoRetriever::getInstance().setCaFilePath(GEECXX_SOURCE_TEST_DATA_DIR "stub-ca.pem");
+    CPPUNIT_ASSERT(WebInfoRetriever::getInstance().retrievePageTitle(server.getUrl("/secure"), title));
+    CPPUNIT_ASSERT_EQUAL(std::string("Secure page"), title);
+}
+
+}
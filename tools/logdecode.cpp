@@ -0,0 +1,131 @@
+/*
+ * Copyright (c) 2015, Romain Létendart
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "logrecord.h"
+#include "logsink.h"
+
+namespace
+{
+
+/**
+ * Decode a binary log file (see geecxx::LogFormat::BINARY)
+ * @param[in] filePath path to the binary log file
+ * @param[in,out] sink sink the decoded records are written to
+ * @return true upon success, false if the file is missing or invalid
+ */
+bool decodeFile(const std::string& filePath, geecxx::LogSink& sink)
+{
+    std::ifstream file(filePath, std::ios::binary);
+    if (!file) {
+        std::cerr << "Couldn't open " << filePath << std::endl;
+        return false;
+    }
+
+    // The last byte of the header is the version, version 1 has no module
+    char header[sizeof(geecxx::LogSink::BINARY_HEADER)];
+    const size_t magicSize = sizeof(header) - 1;
+    if (!file.read(header, sizeof(header))
+        || 0 != std::memcmp(header, geecxx::LogSink::BINARY_HEADER, magicSize)
+        || header[magicSize] < 1 || header[magicSize] > geecxx::LogSink::BINARY_HEADER[magicSize]) {
+        std::cerr << filePath << " is not a binary log file" << std::endl;
+        return false;
+    }
+    const bool hasModule = header[magicSize] >= 2;
+
+    geecxx::LogRecord record;
+    std::vector<char> payload;
+    size_t recordCount = 0;
+    std::uint32_t size;
+    while (file.read(reinterpret_cast<char*>(&size), sizeof(size))) {
+        std::uint8_t level;
+        std::uint8_t module = static_cast<std::uint8_t>(geecxx::LogModule::GENERAL);
+        std::int64_t time;
+        payload.resize(size);
+        if (!file.read(reinterpret_cast<char*>(&level), sizeof(level))
+            || (hasModule && !file.read(reinterpret_cast<char*>(&module), sizeof(module)))
+            || !file.read(reinterpret_cast<char*>(&time), sizeof(time))
+            || !file.read(payload.data(), size)
+            || level > static_cast<std::uint8_t>(geecxx::LogLevel::ERROR)
+            || module >= geecxx::LOG_MODULE_COUNT) {
+            std::cerr << filePath << ": truncated or invalid record #" << recordCount << std::endl;
+            sink.flush();
+            return false;
+        }
+
+        record.assign(static_cast<geecxx::LogLevel>(level), time, payload.data(), size);
+        record.setModule(static_cast<geecxx::LogModule>(module));
+        if (!record.forEachValue([](const geecxx::LogValue&) {})) {
+            std::cerr << filePath << ": invalid arguments in record #" << recordCount << std::endl;
+            sink.flush();
+            return false;
+        }
+        sink.write(record);
+        if (0 == ++recordCount % 1024) {
+            sink.flush();
+        }
+    }
+    sink.flush();
+    return true;
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+    geecxx::LogFormat format = geecxx::LogFormat::TEXT;
+    std::vector<std::string> filePaths;
+    for (int i = 1; i < argc; ++i) {
+        const std::string argument = argv[i];
+        if ("--json" == argument) {
+            format = geecxx::LogFormat::JSON;
+        } else if ("-h" == argument || "--help" == argument) {
+            filePaths.clear();
+            break;
+        } else {
+            filePaths.push_back(argument);
+        }
+    }
+    if (filePaths.empty()) {
+        std::cerr << "Usage: geecxx-logdecode [--json] <file>..." << std::endl;
+        std::cerr << "Print binary log files written by geecxx --log-format binary, as text" << std::endl;
+        std::cerr << "or as JSON lines (--json)." << std::endl;
+        return -1;
+    }
+
+    geecxx::LogSink sink(format, std::cout);
+    int exitStatus = 0;
+    for (const std::string& filePath : filePaths) {
+        if (!decodeFile(filePath, sink)) {
+            exitStatus = -1;
+        }
+    }
+    return exitStatus;
+}
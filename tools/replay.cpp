@@ -0,0 +1,178 @@
+/*
+ * Copyright (c) 2015, Romain Létendart
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "bot.h"
+#include "logger.h"
+#include "trace.h"
+#include "trafficrecorder.h"
+#include "urlrewriter.h"
+#include "webinforetriever.h"
+
+namespace
+{
+
+typedef std::chrono::steady_clock Clock;
+
+/**
+ * Durations of the handling of the lines, in microseconds, per stage: the
+ * whole line ("line") and each span of its trace (see geecxx::ScopedSpan)
+ */
+typedef std::map<std::string, std::vector<std::uint64_t>> StageDurations;
+
+/**
+ * Record the durations of a finished trace
+ * @param[in] trace trace of the handling of a line
+ * @param[in,out] stageDurations durations per stage
+ */
+void addDurations(const geecxx::Trace& trace, StageDurations& stageDurations)
+{
+    stageDurations[trace.getName()].push_back(trace.getDurationUs());
+    for (size_t i = 0; i < trace.getSpanCount(); ++i) {
+        const geecxx::TraceSpan& span = trace.getSpan(i);
+        stageDurations[span._name].push_back(span._durationUs);
+    }
+}
+
+/**
+ * Get a percentile of sorted durations
+ * @param[in] durations durations, sorted in ascending order
+ * @param[in] percentile percentile, between 0 and 100
+ * @return duration of the percentile, nearest rank
+ */
+std::uint64_t getPercentile(const std::vector<std::uint64_t>& durations, double percentile)
+{
+    const size_t rank = static_cast<size_t>(percentile / 100.0 * durations.size() + 0.5);
+    return durations[std::min(std::max<size_t>(rank, 1), durations.size()) - 1];
+}
+
+void printReport(size_t lineCount, size_t urlCount, size_t sentLineCount, double elapsedSeconds,
+                 StageDurations& stageDurations)
+{
+    std::cout << "Lines: " << lineCount << " (" << lineCount / elapsedSeconds << "/s)" << std::endl;
+    std::cout << "URLs: " << urlCount << " (" << urlCount / elapsedSeconds << "/s)" << std::endl;
+    std::cout << "Lines sent: " << sentLineCount << std::endl;
+    std::cout << "Elapsed: " << elapsedSeconds << "s" << std::endl;
+    std::cout << "Latency (us):\tcount\tp50\tp90\tp99\tp99.9\tmax" << std::endl;
+    for (StageDurations::value_type& stage : stageDurations) {
+        std::vector<std::uint64_t>& durations = stage.second;
+        std::sort(durations.begin(), durations.end());
+        std::cout << "  " << stage.first << "\t" << durations.size()
+                  << "\t" << getPercentile(durations, 50)
+                  << "\t" << getPercentile(durations, 90)
+                  << "\t" << getPercentile(durations, 99)
+                  << "\t" << getPercentile(durations, 99.9)
+                  << "\t" << durations.back() << std::endl;
+    }
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+    bool realTime = true;
+    std::string nickname = "geecxx";
+    std::string channel;
+    std::string rewriteRulesPath;
+    std::string filePath;
+    bool validArguments = true;
+    for (int i = 1; i < argc; ++i) {
+        const std::string argument = argv[i];
+        if ("--fast" == argument) {
+            realTime = false;
+        } else if ("--nick" == argument && i + 1 < argc) {
+            nickname = argv[++i];
+        } else if ("--channel" == argument && i + 1 < argc) {
+            channel = argv[++i];
+        } else if ("--rewrite-rules" == argument && i + 1 < argc) {
+            rewriteRulesPath = argv[++i];
+        } else if (filePath.empty() && !argument.empty() && '-' != argument[0]) {
+            filePath = argument;
+        } else {
+            validArguments = false;
+        }
+    }
+    if (!validArguments || filePath.empty()) {
+        std::cerr << "Usage: geecxx-replay [--fast] [--nick <nickname>] [--channel <channel>]" << std::endl;
+        std::cerr << "                     [--rewrite-rules <file>] <file>" << std::endl;
+        std::cerr << "Feed traffic recorded by geecxx --record-traffic to an offline bot, at the" << std::endl;
+        std::cerr << "recorded pace or as fast as possible (--fast), titles being those recorded." << std::endl;
+        std::cerr << "Nickname (default: geecxx) and channel should be those of the recorded" << std::endl;
+        std::cerr << "session, replies being sent privately otherwise." << std::endl;
+        return -1;
+    }
+
+    // The report is written to the standard output
+    geecxx::Logger::getInstance().setOutput(std::cerr);
+
+    geecxx::TrafficRecording recording;
+    if (!recording.load(filePath)) {
+        return -1;
+    }
+    std::shared_ptr<geecxx::UrlRewriter> urlRewriter;
+    if (!rewriteRulesPath.empty()) {
+        urlRewriter = std::make_shared<geecxx::UrlRewriter>();
+        if (!urlRewriter->loadFromFile(rewriteRulesPath)) {
+            return -1;
+        }
+    }
+    geecxx::WebInfoRetriever::getInstance().setTitleFixtures(recording.getTitles());
+
+    size_t sentLineCount = 0;
+    geecxx::Bot bot;
+    bot.initOffline(nickname, channel, urlRewriter, [&sentLineCount](std::string_view) {
+        ++sentLineCount;
+    });
+
+    StageDurations stageDurations;
+    const Clock::time_point start = Clock::now();
+    for (const geecxx::RecordedLine& line : recording.getLines()) {
+        if (realTime) {
+            std::this_thread::sleep_until(start + std::chrono::microseconds(line._timeUs));
+        }
+        geecxx::Trace trace("line");
+        geecxx::Trace::setCurrent(&trace);
+        bot.handleLine(line._line);
+        geecxx::Trace::setCurrent(nullptr);
+        trace.finish();
+        addDurations(trace, stageDurations);
+    }
+    const double elapsedSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    const StageDurations::const_iterator urlDurations = stageDurations.find("process_url");
+    const size_t urlCount = stageDurations.end() == urlDurations ? 0 : urlDurations->second.size();
+    printReport(recording.getLines().size(), urlCount, sentLineCount, elapsedSeconds, stageDurations);
+
+    geecxx::Logger::getInstance().flush();
+    return 0;
+}